@@ -0,0 +1,97 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferAsyncAction.h"
+
+#include "StyleTransferModule.h"
+#include "StyleTransferSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/Texture2D.h"
+
+UStyleTransferAsyncAction* UStyleTransferAsyncAction::Create(UObject* WorldContextObject, EOperation Operation)
+{
+	UStyleTransferAsyncAction* Action = NewObject<UStyleTransferAsyncAction>();
+	Action->Operation = Operation;
+	const UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (World && World->GetGameInstance())
+	{
+		Action->StyleTransferSubsystem = World->GetGameInstance()->GetSubsystem<UStyleTransferSubsystem>();
+	}
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+UStyleTransferAsyncAction* UStyleTransferAsyncAction::RequestStyle(UObject* WorldContextObject, TSoftObjectPtr<UTexture2D> StyleTexture)
+{
+	UStyleTransferAsyncAction* Action = Create(WorldContextObject, EOperation::RequestStyle);
+	Action->StyleTexture = StyleTexture;
+	return Action;
+}
+
+UStyleTransferAsyncAction* UStyleTransferAsyncAction::ApplyStyle(UObject* WorldContextObject, int32 StyleHandle)
+{
+	UStyleTransferAsyncAction* Action = Create(WorldContextObject, EOperation::ApplyStyle);
+	Action->Index = StyleHandle;
+	return Action;
+}
+
+UStyleTransferAsyncAction* UStyleTransferAsyncAction::LoadNetworks(UObject* WorldContextObject)
+{
+	return Create(WorldContextObject, EOperation::LoadNetworks);
+}
+
+UStyleTransferAsyncAction* UStyleTransferAsyncAction::SetNetworkLOD(UObject* WorldContextObject, int32 LOD)
+{
+	UStyleTransferAsyncAction* Action = Create(WorldContextObject, EOperation::SetNetworkLOD);
+	Action->Index = LOD;
+	return Action;
+}
+
+void UStyleTransferAsyncAction::Activate()
+{
+	UStyleTransferSubsystem* Subsystem = StyleTransferSubsystem.Get();
+	if (!Subsystem)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("No style transfer subsystem for the async action"));
+		Complete(false);
+		return;
+	}
+
+	// the futures are fulfilled on the game thread, so the continuations can fire the delegate directly
+	TWeakObjectPtr<UStyleTransferAsyncAction> WeakThis(this);
+	auto CompleteBool = [WeakThis](TFuture<bool> bSuccess)
+	{
+		if (UStyleTransferAsyncAction* This = WeakThis.Get())
+		{
+			This->Complete(bSuccess.Get(), This->Operation == EOperation::ApplyStyle ? This->Index : INDEX_NONE);
+		}
+	};
+
+	switch (Operation)
+	{
+	case EOperation::RequestStyle:
+		Subsystem->RequestStyleAsync(StyleTexture).Then([WeakThis](TFuture<int32> StyleHandle)
+		{
+			if (UStyleTransferAsyncAction* This = WeakThis.Get())
+			{
+				This->Complete(StyleHandle.Get() != INDEX_NONE, StyleHandle.Get());
+			}
+		});
+		break;
+	case EOperation::ApplyStyle:
+		Subsystem->ApplyStyleAsync(Index).Then(CompleteBool);
+		break;
+	case EOperation::LoadNetworks:
+		Subsystem->LoadNetworksAsync().Then(CompleteBool);
+		break;
+	case EOperation::SetNetworkLOD:
+		Subsystem->SetNetworkLODAsync(Index).Then(CompleteBool);
+		break;
+	}
+}
+
+void UStyleTransferAsyncAction::Complete(bool bSuccess, int32 StyleHandle)
+{
+	Completed.Broadcast(bSuccess, StyleHandle);
+	SetReadyToDestroy();
+}
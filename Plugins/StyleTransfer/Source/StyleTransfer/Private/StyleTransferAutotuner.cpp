@@ -0,0 +1,255 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferAutotuner.h"
+
+#include "InterpolateTensorsCS.h"
+#include "Misc/ConfigCacheIni.h"
+#include "NeuralNetwork.h"
+#include "OutputTensorToSceneColorCS.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RHI.h"
+#include "SceneColorToInputTensorCS.h"
+#include "ShadowMaskToInputTensorCS.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferProfiler.h"
+#include "StyleTransferSceneViewExtension.h"
+
+FCriticalSection FStyleTransferAutotuner::ResultsCriticalSection;
+TMap<FString, int32> FStyleTransferAutotuner::Results;
+
+namespace StyleTransferAutotune
+{
+	const TCHAR* GetKernelName(EStyleTransferKernel Kernel)
+	{
+		switch (Kernel)
+		{
+		case EStyleTransferKernel::SceneColorToInputTensor: return TEXT("SceneColorToInputTensor");
+		case EStyleTransferKernel::ShadowMaskToInputTensor: return TEXT("ShadowMaskToInputTensor");
+		case EStyleTransferKernel::OutputTensorToSceneColor: return TEXT("OutputTensorToSceneColor");
+		case EStyleTransferKernel::InterpolateTensors: return TEXT("InterpolateTensors");
+		default: checkNoEntry(); return TEXT("");
+		}
+	}
+
+	/** Must match the dispatch sizes FStyleTransferSceneViewExtension uses for the kernels */
+	FIntVector GetDispatchSize(EStyleTransferKernel Kernel, const FNeuralTensor& Tensor)
+	{
+		if (Kernel == EStyleTransferKernel::InterpolateTensors)
+			return {static_cast<int32>(Tensor.Num()), 1, 1};
+		return {static_cast<int32>(Tensor.GetSize(1)), static_cast<int32>(Tensor.GetSize(2)), 1};
+	}
+
+	struct FKernelTensor
+	{
+		EStyleTransferKernel Kernel;
+		FNeuralTensor* Tensor;
+	};
+
+	/** Collects the tensor every kernel writes or reads. Uses the default tensors of the networks if the inference context is INDEX_NONE. */
+	TArray<FKernelTensor> GetKernelTensors(UNeuralNetwork* StyleTransferNetwork, int32 StyleTransferInferenceContext,
+	                                       UNeuralNetwork* StylePredictionNetwork, int32 StylePredictionInferenceContext)
+	{
+		auto GetInputTensor = [](UNeuralNetwork* Network, int32 InferenceContext, int32 Index) -> FNeuralTensor*
+		{
+			return InferenceContext == INDEX_NONE
+				       ? const_cast<FNeuralTensor*>(&Network->GetInputTensor(Index))
+				       : &Network->GetInputTensorForContextMutable(InferenceContext, Index);
+		};
+
+		TArray<FKernelTensor> KernelTensors;
+		const int32 ContentInputTensorIndex = StyleTransferProfiler::FindInputTensorIndex(StyleTransferNetwork, TEXT("content"));
+		const int32 StyleWeightsInputTensorIndex = StyleTransferProfiler::FindInputTensorIndex(StyleTransferNetwork, TEXT("style_weights"));
+		const int32 StyleParamsInputTensorIndex = StyleTransferProfiler::FindInputTensorIndex(StyleTransferNetwork, TEXT("style_params"));
+		if (ContentInputTensorIndex != INDEX_NONE)
+		{
+			KernelTensors.Add({EStyleTransferKernel::SceneColorToInputTensor, GetInputTensor(StyleTransferNetwork, StyleTransferInferenceContext, ContentInputTensorIndex)});
+		}
+		if (StyleWeightsInputTensorIndex != INDEX_NONE)
+		{
+			KernelTensors.Add({EStyleTransferKernel::ShadowMaskToInputTensor, GetInputTensor(StyleTransferNetwork, StyleTransferInferenceContext, StyleWeightsInputTensorIndex)});
+		}
+		KernelTensors.Add({
+			EStyleTransferKernel::OutputTensorToSceneColor,
+			StyleTransferInferenceContext == INDEX_NONE
+				? const_cast<FNeuralTensor*>(&StyleTransferNetwork->GetOutputTensor(0))
+				: &StyleTransferNetwork->GetOutputTensorForContextMutable(StyleTransferInferenceContext, 0)
+		});
+		if (StylePredictionNetwork)
+		{
+			KernelTensors.Add({EStyleTransferKernel::SceneColorToInputTensor, GetInputTensor(StylePredictionNetwork, StylePredictionInferenceContext, 0)});
+			if (StyleParamsInputTensorIndex != INDEX_NONE)
+			{
+				KernelTensors.Add({EStyleTransferKernel::InterpolateTensors, GetInputTensor(StyleTransferNetwork, StyleTransferInferenceContext, StyleParamsInputTensorIndex)});
+			}
+		}
+		return KernelTensors;
+	}
+}
+
+void FStyleTransferAutotuner::LoadResults()
+{
+	TArray<FString> SectionLines;
+	GConfig->GetSection(*GetConfigSection(), SectionLines, GGameUserSettingsIni);
+
+	FScopeLock Lock(&ResultsCriticalSection);
+	Results.Reset();
+	for (const FString& Line : SectionLines)
+	{
+		FString Key, Value;
+		if (Line.Split(TEXT("="), &Key, &Value))
+		{
+			Results.Add(Key, FCString::Atoi(*Value));
+		}
+	}
+	UE_LOG(LogStyleTransfer, Verbose, TEXT("Loaded %i autotune results from [%s]"), Results.Num(), *GetConfigSection());
+}
+
+void FStyleTransferAutotuner::SaveResults()
+{
+	const FString Section = GetConfigSection();
+	{
+		FScopeLock Lock(&ResultsCriticalSection);
+		for (const TPair<FString, int32>& Result : Results)
+		{
+			GConfig->SetInt(*Section, *Result.Key, Result.Value, GGameUserSettingsIni);
+		}
+	}
+	GConfig->Flush(false, GGameUserSettingsIni);
+}
+
+int32 FStyleTransferAutotuner::GetPermutationId(EStyleTransferKernel Kernel, const FIntVector& DispatchSize)
+{
+	FScopeLock Lock(&ResultsCriticalSection);
+	const int32* PermutationId = Results.Find(GetResultKey(Kernel, DispatchSize));
+	return PermutationId && *PermutationId >= 0 && *PermutationId < GetNumPermutations(Kernel) ? *PermutationId : 0;
+}
+
+bool FStyleTransferAutotuner::HasResult(EStyleTransferKernel Kernel, const FIntVector& DispatchSize)
+{
+	FScopeLock Lock(&ResultsCriticalSection);
+	return Results.Contains(GetResultKey(Kernel, DispatchSize));
+}
+
+int32 FStyleTransferAutotuner::GetNumPermutations(EStyleTransferKernel Kernel)
+{
+	switch (Kernel)
+	{
+	case EStyleTransferKernel::SceneColorToInputTensor: return FSceneColorToInputTensorCS::FPermutationDomain::PermutationCount;
+	case EStyleTransferKernel::ShadowMaskToInputTensor: return FShadowMaskToInputTensorCS::FPermutationDomain::PermutationCount;
+	case EStyleTransferKernel::OutputTensorToSceneColor: return FOutputTensorToSceneColorCS::FPermutationDomain::PermutationCount;
+	case EStyleTransferKernel::InterpolateTensors: return FInterpolateTensorsCS::FPermutationDomain::PermutationCount;
+	default: checkNoEntry(); return 1;
+	}
+}
+
+bool FStyleTransferAutotuner::NeedsAutotune(const UNeuralNetwork* StyleTransferNetwork, const UNeuralNetwork* StylePredictionNetwork)
+{
+	// the default tensors are only read here
+	const TArray<StyleTransferAutotune::FKernelTensor> KernelTensors = StyleTransferAutotune::GetKernelTensors(
+		const_cast<UNeuralNetwork*>(StyleTransferNetwork), INDEX_NONE, const_cast<UNeuralNetwork*>(StylePredictionNetwork), INDEX_NONE);
+	for (const StyleTransferAutotune::FKernelTensor& KernelTensor : KernelTensors)
+	{
+		if (!HasResult(KernelTensor.Kernel, StyleTransferAutotune::GetDispatchSize(KernelTensor.Kernel, *KernelTensor.Tensor)))
+			return true;
+	}
+	return false;
+}
+
+void FStyleTransferAutotuner::Autotune_RenderThread(FRHICommandListImmediate& RHICmdList, int32 Iterations, bool bForce,
+                                                    UNeuralNetwork* StyleTransferNetwork, int32 StyleTransferInferenceContext,
+                                                    UNeuralNetwork* StylePredictionNetwork, int32 StylePredictionInferenceContext)
+{
+	check(IsInRenderingThread());
+	using namespace StyleTransferAutotune;
+
+	const TArray<FKernelTensor> KernelTensors = GetKernelTensors(StyleTransferNetwork, StyleTransferInferenceContext, StylePredictionNetwork, StylePredictionInferenceContext);
+	FNeuralTensor* PredictedStyleParamsTensor = StylePredictionNetwork
+		                                            ? &StylePredictionNetwork->GetOutputTensorForContextMutable(StylePredictionInferenceContext, 0)
+		                                            : nullptr;
+
+	TSet<FString> TunedKeys;
+	for (const FKernelTensor& KernelTensor : KernelTensors)
+	{
+		const FIntVector DispatchSize = GetDispatchSize(KernelTensor.Kernel, *KernelTensor.Tensor);
+		const FString Key = GetResultKey(KernelTensor.Kernel, DispatchSize);
+		if (TunedKeys.Contains(Key) || (!bForce && HasResult(KernelTensor.Kernel, DispatchSize)))
+			continue;
+		TunedKeys.Add(Key);
+
+		// the kernels convert between tensors and textures of the same size as the tensor
+		const FIntPoint TextureSize = {FMath::Max(DispatchSize.Y, 1), FMath::Max(DispatchSize.X, 1)};
+		TRefCountPtr<IPooledRenderTarget> PooledTexture;
+		if (KernelTensor.Kernel != EStyleTransferKernel::InterpolateTensors)
+		{
+			FRDGBuilder GraphBuilder(RHICmdList);
+			const FRDGTextureDesc TextureDesc = FRDGTextureDesc::Create2D(TextureSize, PF_FloatRGBA, FClearValueBinding::Black,
+				TexCreate_ShaderResource | TexCreate_RenderTargetable | TexCreate_UAV);
+			FRDGTextureRef Texture = GraphBuilder.CreateTexture(TextureDesc, TEXT("StyleTransferAutotuneSource"));
+			AddClearRenderTargetPass(GraphBuilder, Texture, FLinearColor(0.5f, 0.5f, 0.5f, 1.f));
+			GraphBuilder.QueueTextureExtraction(Texture, &PooledTexture);
+			GraphBuilder.Execute();
+		}
+
+		FNeuralTensor& Tensor = *KernelTensor.Tensor;
+		int32 FastestPermutationId = 0;
+		double FastestAverage = TNumericLimits<double>::Max();
+		for (int32 PermutationId = 0; PermutationId < GetNumPermutations(KernelTensor.Kernel); ++PermutationId)
+		{
+			StyleTransferProfiler::FPassTimings Timings;
+			Timings.Name = FString::Printf(TEXT("%s(%i)"), *Key, PermutationId);
+			StyleTransferProfiler::ProfilePasses_RenderThread(RHICmdList, Timings, Iterations, [&](FRDGBuilder& GraphBuilder)
+			{
+				Tensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				switch (KernelTensor.Kernel)
+				{
+				case EStyleTransferKernel::SceneColorToInputTensor:
+					FStyleTransferSceneViewExtension::TextureToTensorRGB(GraphBuilder, GraphBuilder.RegisterExternalTexture(PooledTexture), Tensor, FIntRect(), PermutationId);
+					break;
+				case EStyleTransferKernel::ShadowMaskToInputTensor:
+					FStyleTransferSceneViewExtension::TextureToTensorGrayscale(GraphBuilder, GraphBuilder.RegisterExternalTexture(PooledTexture), Tensor, FIntRect(), PermutationId);
+					break;
+				case EStyleTransferKernel::OutputTensorToSceneColor:
+					FStyleTransferSceneViewExtension::TensorToTexture(GraphBuilder, PooledTexture->GetDesc(), Tensor, PermutationId);
+					break;
+				case EStyleTransferKernel::InterpolateTensors:
+					PredictedStyleParamsTensor->GPUToRDGBuilder_RenderThread(&GraphBuilder);
+					FStyleTransferSceneViewExtension::InterpolateTensors(GraphBuilder, Tensor, *PredictedStyleParamsTensor, *PredictedStyleParamsTensor, 0.5f, PermutationId);
+					break;
+				default:
+					checkNoEntry();
+				}
+			});
+
+			UE_LOG(LogStyleTransfer, Verbose, TEXT("%-64s %8.4fms"), *Timings.Name, Timings.GetAverage());
+			if (Timings.Milliseconds.Num() && Timings.GetAverage() < FastestAverage)
+			{
+				FastestAverage = Timings.GetAverage();
+				FastestPermutationId = PermutationId;
+			}
+		}
+
+		UE_LOG(LogStyleTransfer, Log, TEXT("Autotuned %s to permutation %i (%.4fms)"), *Key, FastestPermutationId, FastestAverage);
+		FScopeLock Lock(&ResultsCriticalSection);
+		Results.Add(Key, FastestPermutationId);
+	}
+}
+
+FString FStyleTransferAutotuner::GetConfigSection()
+{
+	// results are only valid for the GPU they were measured on
+	FString AdapterName = GRHIAdapterName.IsEmpty() ? TEXT("Unknown") : GRHIAdapterName;
+	for (TCHAR& Character : AdapterName)
+	{
+		if (!FChar::IsAlnum(Character))
+		{
+			Character = TEXT('_');
+		}
+	}
+	return FString::Printf(TEXT("StyleTransferAutotune.%s"), *AdapterName);
+}
+
+FString FStyleTransferAutotuner::GetResultKey(EStyleTransferKernel Kernel, const FIntVector& DispatchSize)
+{
+	return FString::Printf(TEXT("%s_%ix%ix%i"), StyleTransferAutotune::GetKernelName(Kernel), DispatchSize.X, DispatchSize.Y, DispatchSize.Z);
+}
@@ -0,0 +1,51 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FRHICommandListImmediate;
+class UNeuralNetwork;
+
+enum class EStyleTransferKernel : uint8
+{
+	SceneColorToInputTensor,
+	ShadowMaskToInputTensor,
+	OutputTensorToSceneColor,
+	InterpolateTensors,
+	Num
+};
+
+/**
+ * Picks the fastest thread group size permutation of each style transfer kernel for each dispatch size on the current GPU.
+ * Results are stored in the game user settings per GPU so the measurements only have to run once.
+ */
+class FStyleTransferAutotuner
+{
+public:
+	static void LoadResults();
+	static void SaveResults();
+
+	/** Fastest measured permutation or permutation 0 if this dispatch size has not been tuned yet. Safe to call from any thread. */
+	static int32 GetPermutationId(EStyleTransferKernel Kernel, const FIntVector& DispatchSize);
+	static bool HasResult(EStyleTransferKernel Kernel, const FIntVector& DispatchSize);
+	static int32 GetNumPermutations(EStyleTransferKernel Kernel);
+
+	/** Whether any kernel used with the tensor sizes of these networks has not been tuned yet. StylePredictionNetwork may be null. */
+	static bool NeedsAutotune(const UNeuralNetwork* StyleTransferNetwork, const UNeuralNetwork* StylePredictionNetwork);
+
+	/**
+	 * Times all permutations of every kernel with the tensors of the given inference contexts and stores the fastest ones.
+	 * Kernels that already have a result are skipped unless bForce is set. StylePredictionNetwork may be null.
+	 */
+	static void Autotune_RenderThread(FRHICommandListImmediate& RHICmdList, int32 Iterations, bool bForce,
+	                                  UNeuralNetwork* StyleTransferNetwork, int32 StyleTransferInferenceContext,
+	                                  UNeuralNetwork* StylePredictionNetwork, int32 StylePredictionInferenceContext);
+
+private:
+	static FString GetConfigSection();
+	static FString GetResultKey(EStyleTransferKernel Kernel, const FIntVector& DispatchSize);
+
+	static FCriticalSection ResultsCriticalSection;
+	static TMap<FString, int32> Results;
+};
@@ -0,0 +1,186 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferBatchRenderer.h"
+
+#include "ImagePixelData.h"
+#include "ImageWriteQueue.h"
+#include "ImageWriteTask.h"
+#include "NeuralNetwork.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "ScreenPass.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferSceneViewExtension.h"
+#include "Modules/ModuleManager.h"
+
+static TArray<int32, TInlineAllocator<3>> GetBatchInputIndices(const UNeuralNetwork* Network)
+{
+	// same order as the packed tensors of the scene view extension
+	TArray<int32, TInlineAllocator<3>> BatchInputIndices;
+	for (const TCHAR* TensorName : {TEXT("content"), TEXT("style_weights"), TEXT("style_params")})
+	{
+		for (uint32 i = 0; i < Network->GetInputTensorNumber(); ++i)
+		{
+			if (Network->GetInputTensor(i).GetName() == TensorName)
+			{
+				BatchInputIndices.Add(i);
+			}
+		}
+	}
+	return BatchInputIndices;
+}
+
+FStyleTransferBatchRenderer::FStyleTransferBatchRenderer(UNeuralNetwork* InNetwork, int32 InBatchContext, int32 InBatchSize, FString InFileNameFormat)
+	: Network(InNetwork)
+	, BatchContext(InBatchContext)
+	, BatchSize(FMath::Max(InBatchSize, 1))
+	, FileNameFormat(MoveTemp(InFileNameFormat))
+	, ImageWriteQueue(&FModuleManager::LoadModuleChecked<IImageWriteQueueModule>("ImageWriteQueue").GetWriteQueue())
+	, BatchInputIndices(GetBatchInputIndices(InNetwork))
+{
+}
+
+FStyleTransferBatchRenderer::~FStyleTransferBatchRenderer()
+{
+	if (GetNumPendingFrames())
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("%i stylized frames were not written"), GetNumPendingFrames());
+	}
+}
+
+void FStyleTransferBatchRenderer::ResizeBatchTensors(UNeuralNetwork* Network, int32 BatchContext, int32 BatchSize)
+{
+	check(IsInGameThread());
+	if (BatchSize <= 1)
+		return;
+
+	auto ResizeTensor = [BatchSize](FNeuralTensor& Tensor)
+	{
+		TArray<int64> Sizes = Tensor.GetSizes();
+		Sizes[0] = BatchSize;
+		Tensor.SetNumUninitialized(Tensor.GetDataType(), Sizes);
+	};
+	for (const int32 InputIndex : GetBatchInputIndices(Network))
+	{
+		ResizeTensor(Network->GetInputTensorForContextMutable(BatchContext, InputIndex));
+	}
+	ResizeTensor(Network->GetOutputTensorForContextMutable(BatchContext, 0));
+	UE_LOG(LogStyleTransfer, Log, TEXT("Stylizing %i frames per batch"), BatchSize);
+}
+
+void FStyleTransferBatchRenderer::AddFrame_RenderThread(FRDGBuilder& GraphBuilder, int32 FrameNumber, TConstArrayView<FNeuralTensor*> PackedTensors, FNeuralTensor& ScratchOutputTensor, FIntPoint OutputSize)
+{
+	check(IsInRenderingThread());
+	check(PackedTensors.Num() == BatchInputIndices.Num());
+
+	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransferBatch");
+	const int32 Slot = BatchFrames.Num();
+	for (int32 i = 0; i < PackedTensors.Num(); ++i)
+	{
+		FNeuralTensor& BatchTensor = Network->GetInputTensorForContextMutable(BatchContext, BatchInputIndices[i]);
+		BatchTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		const uint64 NumBytes = PackedTensors[i]->NumInBytes();
+		checkf(BatchTensor.NumInBytes() == NumBytes * BatchSize, TEXT("Tensor %s does not match the batch"), *BatchTensor.GetName());
+		AddCopyBufferPass(GraphBuilder, BatchTensor.GetBufferUAVRef()->GetParent(), Slot * NumBytes, PackedTensors[i]->GetBufferSRVRef()->GetParent(), 0, NumBytes);
+	}
+
+	FBatchFrame& BatchFrame = BatchFrames.AddDefaulted_GetRef();
+	BatchFrame.FrameNumber = FrameNumber;
+	BatchFrame.OutputSize = OutputSize;
+
+	if (BatchFrames.Num() == BatchSize)
+	{
+		RunBatch(GraphBuilder, ScratchOutputTensor);
+	}
+}
+
+void FStyleTransferBatchRenderer::Flush_RenderThread(FRDGBuilder& GraphBuilder, FNeuralTensor& ScratchOutputTensor)
+{
+	check(IsInRenderingThread());
+	if (BatchFrames.Num())
+	{
+		RDG_EVENT_SCOPE(GraphBuilder, "StyleTransferBatch");
+		// the unused slots still hold the inputs of the previous batch, their outputs are dropped
+		RunBatch(GraphBuilder, ScratchOutputTensor);
+	}
+}
+
+void FStyleTransferBatchRenderer::RunBatch(FRDGBuilder& GraphBuilder, FNeuralTensor& ScratchOutputTensor)
+{
+	Network->Run(GraphBuilder, BatchContext);
+
+	FNeuralTensor& BatchOutputTensor = Network->GetOutputTensorForContextMutable(BatchContext, 0);
+	BatchOutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	ScratchOutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	const uint64 NumOutputBytes = ScratchOutputTensor.NumInBytes();
+	const FRDGTextureDesc OutputDesc = FRDGTextureDesc::Create2D(FIntPoint(1, 1), PF_FloatRGBA, FClearValueBinding::Black, TexCreate_ShaderResource);
+
+	for (int32 Slot = 0; Slot < BatchFrames.Num(); ++Slot)
+	{
+		AddCopyBufferPass(GraphBuilder, ScratchOutputTensor.GetBufferUAVRef()->GetParent(), 0, BatchOutputTensor.GetBufferSRVRef()->GetParent(), Slot * NumOutputBytes, NumOutputBytes);
+		FRDGTexture* OutputTexture = FStyleTransferSceneViewExtension::TensorToTexture(GraphBuilder, OutputDesc, ScratchOutputTensor);
+
+		FScreenPassRenderTarget FrameTarget(
+			GraphBuilder.CreateTexture(
+				FRDGTextureDesc::Create2D(BatchFrames[Slot].OutputSize, PF_B8G8R8A8, FClearValueBinding::Black, TexCreate_RenderTargetable | TexCreate_ShaderResource),
+				TEXT("StyleTransferBatchFrame")),
+			ERenderTargetLoadAction::ENoAction);
+		FStyleTransferSceneViewExtension::AddRescalingTextureCopy(GraphBuilder, *OutputTexture, FrameTarget);
+
+		FPendingReadback& PendingReadback = PendingReadbacks.AddDefaulted_GetRef();
+		PendingReadback.Frame = BatchFrames[Slot];
+		PendingReadback.Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("StyleTransferBatchFrameReadback"));
+		AddEnqueueCopyPass(GraphBuilder, PendingReadback.Readback.Get(), FrameTarget.Texture);
+	}
+	BatchFrames.Reset();
+}
+
+void FStyleTransferBatchRenderer::Tick_RenderThread(bool bWait)
+{
+	check(IsInRenderingThread());
+	if (bWait && PendingReadbacks.Num())
+	{
+		// only the fences of the readbacks are waited for, not all work the GPU was given
+		FRHICommandListExecutor::GetImmediateCommandList().ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+		for (const FPendingReadback& PendingReadback : PendingReadbacks)
+		{
+			while (!PendingReadback.Readback->IsReady())
+			{
+				FPlatformProcess::SleepNoStats(0.001f);
+			}
+		}
+	}
+
+	// frames are written in order so a sequence on disk never has holes
+	int32 NumWritten = 0;
+	while (NumWritten < PendingReadbacks.Num() && PendingReadbacks[NumWritten].Readback->IsReady())
+	{
+		WriteImage(PendingReadbacks[NumWritten]);
+		++NumWritten;
+	}
+	PendingReadbacks.RemoveAt(0, NumWritten);
+}
+
+void FStyleTransferBatchRenderer::WriteImage(FPendingReadback& PendingReadback) const
+{
+	const FIntPoint Size = PendingReadback.Frame.OutputSize;
+	TArray64<FColor> Pixels;
+	Pixels.SetNumUninitialized(static_cast<int64>(Size.X) * Size.Y);
+
+	int32 RowPitchInPixels = 0;
+	const FColor* ReadbackPixels = static_cast<const FColor*>(PendingReadback.Readback->Lock(RowPitchInPixels));
+	for (int32 Y = 0; Y < Size.Y; ++Y)
+	{
+		FMemory::Memcpy(&Pixels[static_cast<int64>(Y) * Size.X], ReadbackPixels + static_cast<int64>(Y) * RowPitchInPixels, Size.X * sizeof(FColor));
+	}
+	PendingReadback.Readback->Unlock();
+
+	TUniquePtr<FImageWriteTask> ImageWriteTask = MakeUnique<FImageWriteTask>();
+	ImageWriteTask->Format = EImageFormat::PNG;
+	ImageWriteTask->Filename = FileNameFormat.Replace(TEXT("{frame}"), *FString::Printf(TEXT("%04i"), PendingReadback.Frame.FrameNumber));
+	ImageWriteTask->bOverwriteFile = true;
+	ImageWriteTask->PixelData = MakeUnique<TImagePixelData<FColor>>(Size, MoveTemp(Pixels));
+	// the tonemapped output is opaque
+	ImageWriteTask->PixelPreProcessors.Add(TAsyncAlphaWrite<FColor>(255));
+	ImageWriteQueue->Enqueue(MoveTemp(ImageWriteTask));
+}
@@ -0,0 +1,79 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+
+class FRHIGPUTextureReadback;
+class IImageWriteQueue;
+class UNeuralNetwork;
+struct FNeuralTensor;
+
+/**
+ * Stylizes the frames of an offline render, e.g. of Movie Render Queue, and writes them to image files.
+ * The packed inputs of BatchSize frames are gathered in the batch dimension of a separate inference context and run at once.
+ * The outputs are read back and encoded by the image write queue so neither the GPU nor the render thread wait for the disk.
+ * Only used on the render thread after construction.
+ */
+class FStyleTransferBatchRenderer
+{
+public:
+	/**
+	 * @param InBatchContext context of InNetwork that is owned by the caller and only used by this renderer
+	 * @param InBatchSize number of frames per inference, has to be 1 unless the network has a dynamic batch dimension
+	 * @param InFileNameFormat path of the written images with {frame} being replaced by the frame number
+	 */
+	FStyleTransferBatchRenderer(UNeuralNetwork* InNetwork, int32 InBatchContext, int32 InBatchSize, FString InFileNameFormat);
+	~FStyleTransferBatchRenderer();
+
+	/** Resizes the batch dimension of the inputs and the output of a new BatchContext. Has to be called before the renderer is created. */
+	static void ResizeBatchTensors(UNeuralNetwork* Network, int32 BatchContext, int32 BatchSize);
+
+	UNeuralNetwork* GetNetwork() const { return Network; }
+
+	/**
+	 * Adds the packed inputs of a frame to the batch and runs the batch once it is full.
+	 * @param PackedTensors content, style_weights if the network has it and style_params of a context of the same network with batch size 1
+	 * @param ScratchOutputTensor output of that context, overwritten with each output of the batch
+	 * @param OutputSize size of the written image, usually the size of the view
+	 */
+	void AddFrame_RenderThread(FRDGBuilder& GraphBuilder, int32 FrameNumber, TConstArrayView<FNeuralTensor*> PackedTensors, FNeuralTensor& ScratchOutputTensor, FIntPoint OutputSize);
+
+	/** Runs the frames of an incomplete batch. */
+	void Flush_RenderThread(FRDGBuilder& GraphBuilder, FNeuralTensor& ScratchOutputTensor);
+
+	/** Passes the images whose readbacks completed to the image write queue. With bWait it blocks until all readbacks completed. */
+	void Tick_RenderThread(bool bWait = false);
+
+	int32 GetNumPendingFrames() const { return BatchFrames.Num() + PendingReadbacks.Num(); }
+
+private:
+	struct FBatchFrame
+	{
+		int32 FrameNumber = INDEX_NONE;
+		FIntPoint OutputSize = FIntPoint::ZeroValue;
+	};
+
+	struct FPendingReadback
+	{
+		FBatchFrame Frame;
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+	};
+
+	void RunBatch(FRDGBuilder& GraphBuilder, FNeuralTensor& ScratchOutputTensor);
+	void WriteImage(FPendingReadback& PendingReadback) const;
+
+	TObjectPtr<UNeuralNetwork> Network;
+	int32 BatchContext = INDEX_NONE;
+	int32 BatchSize = 1;
+	FString FileNameFormat;
+	IImageWriteQueue* ImageWriteQueue;
+	/** Inputs of the BatchContext in the order of the packed tensors */
+	TArray<int32, TInlineAllocator<3>> BatchInputIndices;
+
+	/** Frames whose inputs are in the batch tensors, in slot order */
+	TArray<FBatchFrame> BatchFrames;
+	/** Oldest first */
+	TArray<FPendingReadback> PendingReadbacks;
+};
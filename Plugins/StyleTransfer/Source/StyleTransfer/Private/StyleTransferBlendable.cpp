@@ -0,0 +1,32 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferBlendable.h"
+
+#include "SceneView.h"
+
+void UStyleTransferBlendable::OverrideBlendableSettings(FSceneView& View, float Weight) const
+{
+	FStyleTransferBlendableData Data;
+	Data.Weight = FMath::Clamp(Weight, 0.f, 1.f);
+	Data.Strength = bEnabled ? Strength : 0.f;
+	Data.StyleIndex = bEnabled ? StyleIndex : INDEX_NONE;
+	View.FinalPostProcessSettings.BlendableManager.PushBlendableData(Data.Weight, Data);
+}
+
+FStyleTransferViewSettings UStyleTransferBlendable::GetViewSettings(const FSceneView& View, bool bRequireBlendable)
+{
+	FStyleTransferViewSettings Settings;
+	Settings.Strength = bRequireBlendable ? 0.f : 1.f;
+
+	// blendables are pushed in the order of the volume priorities
+	FBlendableEntry* Iterator = nullptr;
+	while (const FStyleTransferBlendableData* Data = View.FinalPostProcessSettings.BlendableManager.IterateBlendables<FStyleTransferBlendableData>(Iterator))
+	{
+		Settings.Strength = FMath::Lerp(Settings.Strength, Data->Strength, Data->Weight);
+		if (Data->Weight >= 0.5f && Data->StyleIndex != INDEX_NONE)
+		{
+			Settings.StyleIndex = Data->StyleIndex;
+		}
+	}
+	return Settings;
+}
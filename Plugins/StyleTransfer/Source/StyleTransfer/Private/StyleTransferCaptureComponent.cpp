@@ -0,0 +1,43 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferCaptureComponent.h"
+
+#include "StyleTransferModule.h"
+#include "StyleTransferSubsystem.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+void UStyleTransferCaptureComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!SceneCapture)
+	{
+		SceneCapture = GetOwner()->FindComponentByClass<USceneCaptureComponent2D>();
+	}
+	if (!SceneCapture)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("%s has no scene capture to stylize"), *GetPathName());
+		return;
+	}
+
+	const UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	if (UStyleTransferSubsystem* StyleTransferSubsystem = GameInstance ? GameInstance->GetSubsystem<UStyleTransferSubsystem>() : nullptr)
+	{
+		StyleTransferSubsystem->AddStylizedSceneCapture(SceneCapture, InferenceResolution, UpdateInterval);
+	}
+}
+
+void UStyleTransferCaptureComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	const UGameInstance* GameInstance = GetWorld()->GetGameInstance();
+	UStyleTransferSubsystem* StyleTransferSubsystem = GameInstance ? GameInstance->GetSubsystem<UStyleTransferSubsystem>() : nullptr;
+	if (StyleTransferSubsystem && SceneCapture)
+	{
+		StyleTransferSubsystem->RemoveStylizedSceneCapture(SceneCapture);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
@@ -0,0 +1,198 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferContentShapeCache.h"
+
+#include "NeuralNetwork.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferSettings.h"
+#include "StyleTransferStats.h"
+
+namespace StyleTransferContentShape
+{
+	bool HasSpatialDimensions(const FNeuralTensor& Tensor)
+	{
+		const FString& TensorName = Tensor.GetName();
+		return Tensor.GetSizes().Num() == 4 && (TensorName == TEXT("content") || TensorName == TEXT("style_weights"));
+	}
+
+	void ResizeTensor(FNeuralTensor& Tensor, FIntPoint ContentSize)
+	{
+		// tensors have shape (1, Y, X, C)
+		if (Tensor.GetSize(1) == ContentSize.Y && Tensor.GetSize(2) == ContentSize.X)
+			return;
+
+		TArray<int64> Sizes = Tensor.GetSizes();
+		Sizes[1] = ContentSize.Y;
+		Sizes[2] = ContentSize.X;
+		Tensor.SetNumUninitialized(Tensor.GetDataType(), Sizes);
+	}
+
+	/** Number of floats per pixel over all tensors with spatial dimensions */
+	int64 GetChannelsPerPixel(const UNeuralNetwork* StyleTransferNetwork)
+	{
+		int64 ChannelsPerPixel = 0;
+		for (uint32 i = 0; i < StyleTransferNetwork->GetInputTensorNumber(); ++i)
+		{
+			const FNeuralTensor& InputTensor = StyleTransferNetwork->GetInputTensor(i);
+			if (HasSpatialDimensions(InputTensor))
+			{
+				ChannelsPerPixel += InputTensor.GetSize(3);
+			}
+		}
+		return ChannelsPerPixel + StyleTransferNetwork->GetOutputTensor(0).GetSize(3);
+	}
+}
+
+FStyleTransferContentShapeCache::FStyleTransferContentShapeCache(UNeuralNetwork* InStyleTransferNetwork, FIsWithinMemoryBudgetFunction InIsWithinMemoryBudget, FRunAfterRenderThreadFunction InRunAfterRenderThread)
+	: StyleTransferNetwork(InStyleTransferNetwork)
+	, IsWithinMemoryBudget(MoveTemp(InIsWithinMemoryBudget))
+	, RunAfterRenderThread(MoveTemp(InRunAfterRenderThread))
+	, ChannelsPerPixel(StyleTransferContentShape::GetChannelsPerPixel(InStyleTransferNetwork))
+{
+}
+
+FStyleTransferContentShapeCache::~FStyleTransferContentShapeCache()
+{
+	for (const FEntry& Entry : Entries)
+	{
+		StyleTransferNetwork->DestroyInferenceContext(Entry.InferenceContext);
+	}
+}
+
+int32 FStyleTransferContentShapeCache::Update(FIntPoint ViewSize)
+{
+	check(IsInGameThread());
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	const float Hysteresis = StyleTransferSettings->ContentShapeHysteresis;
+
+	if (CurrentEntryIndex == INDEX_NONE || !IsWithinHysteresis(ViewSize, Entries[CurrentEntryIndex].ContentSize, Hysteresis))
+	{
+		CurrentEntryIndex = FindOrAddEntry(GetContentSizeForView(ViewSize, StyleTransferSettings->ContentShapeStride));
+		if (CurrentEntryIndex == INDEX_NONE)
+			return INDEX_NONE;
+	}
+
+	FEntry& CurrentEntry = Entries[CurrentEntryIndex];
+	CurrentEntry.LastUsedFrame = GFrameCounter;
+	return CurrentEntry.InferenceContext;
+}
+
+int32 FStyleTransferContentShapeCache::GetInferenceContext(FIntPoint ContentSize)
+{
+	check(IsInGameThread());
+	const int32 EntryIndex = FindOrAddEntry(ContentSize);
+	if (EntryIndex == INDEX_NONE)
+		return INDEX_NONE;
+
+	FEntry& Entry = Entries[EntryIndex];
+	Entry.LastUsedFrame = GFrameCounter;
+	return Entry.InferenceContext;
+}
+
+int32 FStyleTransferContentShapeCache::FindOrAddEntry(FIntPoint ContentSize)
+{
+	const int32 EntryIndex = Entries.IndexOfByPredicate([ContentSize](const FEntry& Entry) { return Entry.ContentSize == ContentSize; });
+	if (EntryIndex != INDEX_NONE)
+		return EntryIndex;
+
+	// contexts that were used this frame are kept even if that exceeds NumCachedContentShapes, e.g. both parts of a foveated view
+	const int32 NumCachedContentShapes = FMath::Max(GetDefault<UStyleTransferSettings>()->NumCachedContentShapes, 1);
+	while (Entries.Num() >= NumCachedContentShapes)
+	{
+		if (!EvictLeastRecentlyUsed())
+			break;
+	}
+
+	const int64 ContextSize = GetContextSize(ContentSize);
+	if (!IsWithinMemoryBudget(ContextSize))
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Not creating Inference Context for content size %ix%i because it exceeds r.StyleTransfer.MemoryBudgetMB"), ContentSize.X, ContentSize.Y);
+		return INDEX_NONE;
+	}
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for content size %ix%i"), ContentSize.X, ContentSize.Y);
+	LLM_SCOPE_BYTAG(StyleTransfer);
+	FEntry& Entry = Entries.AddDefaulted_GetRef();
+	Entry.ContentSize = ContentSize;
+	Entry.InferenceContext = StyleTransferNetwork->CreateInferenceContext();
+	checkf(Entry.InferenceContext != INDEX_NONE, TEXT("Could not create inference context for StyleTransferNetwork"));
+	ResizeTensors(StyleTransferNetwork, Entry.InferenceContext, ContentSize);
+	return Entries.Num() - 1;
+}
+
+int64 FStyleTransferContentShapeCache::GetMemory() const
+{
+	int64 Memory = *EvictedMemory;
+	for (const FEntry& Entry : Entries)
+	{
+		Memory += GetContextSize(Entry.ContentSize);
+	}
+	return Memory;
+}
+
+FIntPoint FStyleTransferContentShapeCache::GetContentSizeForView(FIntPoint ViewSize, int32 Stride)
+{
+	Stride = FMath::Max(Stride, 1);
+	return {
+		FMath::Max(FMath::RoundToInt(static_cast<float>(ViewSize.X) / Stride), 1) * Stride,
+		FMath::Max(FMath::RoundToInt(static_cast<float>(ViewSize.Y) / Stride), 1) * Stride,
+	};
+}
+
+bool FStyleTransferContentShapeCache::IsWithinHysteresis(FIntPoint ViewSize, FIntPoint ContentSize, float Hysteresis)
+{
+	return FMath::Abs(ViewSize.X - ContentSize.X) <= Hysteresis * ContentSize.X
+		&& FMath::Abs(ViewSize.Y - ContentSize.Y) <= Hysteresis * ContentSize.Y;
+}
+
+void FStyleTransferContentShapeCache::ResizeTensors(UNeuralNetwork* StyleTransferNetwork, int32 InferenceContext, FIntPoint ContentSize)
+{
+	check(IsInGameThread());
+	for (uint32 i = 0; i < StyleTransferNetwork->GetInputTensorNumber(); ++i)
+	{
+		FNeuralTensor& InputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(InferenceContext, i);
+		if (StyleTransferContentShape::HasSpatialDimensions(InputTensor))
+		{
+			StyleTransferContentShape::ResizeTensor(InputTensor, ContentSize);
+		}
+	}
+	StyleTransferContentShape::ResizeTensor(StyleTransferNetwork->GetOutputTensorForContextMutable(InferenceContext, 0), ContentSize);
+}
+
+int64 FStyleTransferContentShapeCache::GetContextSize(FIntPoint ContentSize) const
+{
+	return static_cast<int64>(ContentSize.X) * ContentSize.Y * ChannelsPerPixel * sizeof(float);
+}
+
+int64 FStyleTransferContentShapeCache::GetContextSize(const UNeuralNetwork* StyleTransferNetwork, FIntPoint ContentSize)
+{
+	return static_cast<int64>(ContentSize.X) * ContentSize.Y * StyleTransferContentShape::GetChannelsPerPixel(StyleTransferNetwork) * sizeof(float);
+}
+
+bool FStyleTransferContentShapeCache::EvictLeastRecentlyUsed()
+{
+	int32 LeastRecentlyUsedIndex = 0;
+	for (int32 i = 1; i < Entries.Num(); ++i)
+	{
+		if (Entries[i].LastUsedFrame < Entries[LeastRecentlyUsedIndex].LastUsedFrame)
+		{
+			LeastRecentlyUsedIndex = i;
+		}
+	}
+	if (Entries.IsEmpty() || Entries[LeastRecentlyUsedIndex].LastUsedFrame == GFrameCounter)
+		return false;
+
+	const FEntry& Entry = Entries[LeastRecentlyUsedIndex];
+	UE_LOG(LogStyleTransfer, Log, TEXT("Destroying Inference Context for content size %ix%i"), Entry.ContentSize.X, Entry.ContentSize.Y);
+	// frames that were already enqueued might still use the context
+	const int64 ContextSize = GetContextSize(Entry.ContentSize);
+	*EvictedMemory += ContextSize;
+	RunAfterRenderThread([Network = StyleTransferNetwork, InferenceContext = Entry.InferenceContext, ContextSize, EvictedMemory = EvictedMemory]()
+	{
+		Network->DestroyInferenceContext(InferenceContext);
+		*EvictedMemory -= ContextSize;
+	});
+	Entries.RemoveAt(LeastRecentlyUsedIndex);
+	CurrentEntryIndex = INDEX_NONE;
+	return true;
+}
@@ -0,0 +1,70 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UNeuralNetwork;
+
+/**
+ * Inference contexts of a StyleTransferNetwork with dynamic spatial dimensions for the most recently used content sizes.
+ * The content size follows the view size in multiples of the network stride but only changes once the view size leaves the hysteresis band around it.
+ * Game thread only. Evicted contexts are destroyed once the render thread is done with them.
+ */
+class FStyleTransferContentShapeCache
+{
+public:
+	using FIsWithinMemoryBudgetFunction = TFunction<bool(int64)>;
+	/** Runs the callback on the game thread once the rendering commands enqueued so far are done */
+	using FRunAfterRenderThreadFunction = TFunction<void(TFunction<void()>)>;
+
+	FStyleTransferContentShapeCache(UNeuralNetwork* InStyleTransferNetwork, FIsWithinMemoryBudgetFunction InIsWithinMemoryBudget, FRunAfterRenderThreadFunction InRunAfterRenderThread);
+	/** Rendering commands using the cached contexts and the evicted ones have to be done before destroying the cache. */
+	~FStyleTransferContentShapeCache();
+
+	/** Returns the inference context to use for a view of the given size or INDEX_NONE if no context could be created. */
+	int32 Update(FIntPoint ViewSize);
+	/** Returns a context of exactly ContentSize without the hysteresis of Update, e.g. for the parts of a foveated view, or INDEX_NONE if it could not be created. */
+	int32 GetInferenceContext(FIntPoint ContentSize);
+
+	FIntPoint GetContentSize() const { return CurrentEntryIndex != INDEX_NONE ? Entries[CurrentEntryIndex].ContentSize : FIntPoint::ZeroValue; }
+	/** Memory of the cached contexts and of the evicted ones which are not destroyed yet */
+	int64 GetMemory() const;
+
+	static FIntPoint GetContentSizeForView(FIntPoint ViewSize, int32 Stride);
+	static bool IsWithinHysteresis(FIntPoint ViewSize, FIntPoint ContentSize, float Hysteresis);
+	/** Memory of a context of the network with tensors resized to ContentSize */
+	static int64 GetContextSize(const UNeuralNetwork* StyleTransferNetwork, FIntPoint ContentSize);
+
+	/**
+	 * Sets the spatial dimensions of the content, style weights and output tensors of the context if they do not match ContentSize yet.
+	 * Only call it right after creating the context, the tensors must not be reallocated once the render thread used them.
+	 */
+	static void ResizeTensors(UNeuralNetwork* StyleTransferNetwork, int32 InferenceContext, FIntPoint ContentSize);
+
+private:
+	struct FEntry
+	{
+		FIntPoint ContentSize = FIntPoint::ZeroValue;
+		int32 InferenceContext = INDEX_NONE;
+		uint64 LastUsedFrame = 0;
+	};
+
+	int64 GetContextSize(FIntPoint ContentSize) const;
+	/** @return the index of the entry or INDEX_NONE if its context exceeds the memory budget */
+	int32 FindOrAddEntry(FIntPoint ContentSize);
+	/** @return false if every entry was used this frame */
+	bool EvictLeastRecentlyUsed();
+
+	UNeuralNetwork* StyleTransferNetwork;
+	FIsWithinMemoryBudgetFunction IsWithinMemoryBudget;
+	FRunAfterRenderThreadFunction RunAfterRenderThread;
+
+	/** Number of floats per pixel over all tensors with spatial dimensions */
+	int64 ChannelsPerPixel = 0;
+
+	TArray<FEntry> Entries;
+	int32 CurrentEntryIndex = INDEX_NONE;
+	/** Memory of the evicted contexts which are not destroyed yet, shared with the callbacks destroying them */
+	TSharedRef<int64> EvictedMemory = MakeShared<int64>(0);
+};
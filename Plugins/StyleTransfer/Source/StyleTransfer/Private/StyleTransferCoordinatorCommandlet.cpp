@@ -0,0 +1,195 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferCoordinatorCommandlet.h"
+
+#include "StyleTransferDistributedJob.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferRecording.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+UStyleTransferCoordinatorCommandlet::UStyleTransferCoordinatorCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UStyleTransferCoordinatorCommandlet::Main(const FString& Params)
+{
+	FString RecordingPath, OutputFormat;
+	if (!FParse::Value(*Params, TEXT("Recording="), RecordingPath) || !FParse::Value(*Params, TEXT("Output="), OutputFormat) || !OutputFormat.Contains(TEXT("{frame}")))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Usage: -run=StyleTransferCoordinator -Recording=<path> -Output=<path with {frame}> [-Job=<directory>] [-Workers=<count>] [-PinWorkers] ")
+			TEXT("[-ChunkSize=16] [-Network=<object path>] [-StyleParams=<path>] [-Timeout=60] [-MaxAttempts=3]"));
+		return 1;
+	}
+	FString JobDirectory = FPaths::ProjectSavedDir() / TEXT("StyleTransferJobs") / FGuid::NewGuid().ToString();
+	FParse::Value(*Params, TEXT("Job="), JobDirectory);
+	// the inference runtime of every worker already runs on a thread per core, more workers mostly compete for them
+	int32 NumLocalWorkers = FMath::Clamp(FPlatformMisc::NumberOfCores() / 8, 1, 4);
+	FParse::Value(*Params, TEXT("Workers="), NumLocalWorkers);
+	NumLocalWorkers = FMath::Max(NumLocalWorkers, 0);
+	int32 ChunkSize = 16;
+	FParse::Value(*Params, TEXT("ChunkSize="), ChunkSize);
+	ChunkSize = FMath::Max(ChunkSize, 1);
+	FString NetworkPath, StyleParamsPath;
+	FParse::Value(*Params, TEXT("Network="), NetworkPath);
+	FParse::Value(*Params, TEXT("StyleParams="), StyleParamsPath);
+	double Timeout = 60.;
+	FParse::Value(*Params, TEXT("Timeout="), Timeout);
+	int32 MaxAttempts = 3;
+	FParse::Value(*Params, TEXT("MaxAttempts="), MaxAttempts);
+	MaxAttempts = FMath::Max(MaxAttempts, 1);
+
+	// only the frame count is needed, the workers map the recording themselves
+	FStyleTransferRecordingReader Reader;
+	if (!Reader.Open(RecordingPath))
+		return 1;
+	const int32 NumChunks = FMath::DivideAndRoundUp(Reader.GetNumFrames(), ChunkSize);
+
+	TArray<uint8> StyleParams;
+	if (!StyleParamsPath.IsEmpty())
+	{
+		const FStyleTransferRecordingTensorDesc* StyleParamsDesc = Reader.GetTensorDescs().FindByPredicate([](const FStyleTransferRecordingTensorDesc& TensorDesc)
+		{
+			return TensorDesc.GetName() == TEXT("style_params");
+		});
+		if (!FFileHelper::LoadFileToArray(StyleParams, *StyleParamsPath) || !StyleParamsDesc || static_cast<uint64>(StyleParams.Num()) != StyleParamsDesc->NumBytes)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("%s does not match the style_params of %s"), *StyleParamsPath, *RecordingPath);
+			return 1;
+		}
+	}
+
+	// the workers may run in other directories or on other machines
+	FString JobParams = FString::Printf(TEXT("-Recording=\"%s\" -Output=\"%s\" -ChunkSize=%i"),
+	                                    *FPaths::ConvertRelativePathToFull(RecordingPath), *FPaths::ConvertRelativePathToFull(OutputFormat), ChunkSize);
+	if (!NetworkPath.IsEmpty())
+	{
+		JobParams += FString::Printf(TEXT(" -Network=\"%s\""), *NetworkPath);
+	}
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(FPaths::ConvertRelativePathToFull(OutputFormat)), true);
+	FStyleTransferDistributedJob Job(JobDirectory);
+	if (!Job.Create(JobParams, NumChunks, StyleParams))
+		return 1;
+
+	UE_LOG(LogStyleTransfer, Display, TEXT("Distributing %i frames of %s in %i chunks through %s"), Reader.GetNumFrames(), *RecordingPath, NumChunks, *Job.GetDirectory());
+
+	struct FLocalWorker
+	{
+		FString Name;
+		FString Params;
+		FProcHandle Process;
+		int32 NumLaunches = 0;
+	};
+	TArray<FLocalWorker> LocalWorkers;
+	// every worker gets its own cores so the inference threads of the workers do not compete
+	const bool bPinWorkers = FParse::Param(*Params, TEXT("PinWorkers")) && NumLocalWorkers > 0;
+	const int32 CoresPerWorker = FMath::Max(FMath::Min(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 64) / FMath::Max(NumLocalWorkers, 1), 1);
+	for (int32 WorkerIndex = 0; WorkerIndex < NumLocalWorkers; ++WorkerIndex)
+	{
+		FLocalWorker& LocalWorker = LocalWorkers.AddDefaulted_GetRef();
+		LocalWorker.Name = FString::Printf(TEXT("%s-local%i"), FPlatformProcess::ComputerName(), WorkerIndex);
+		LocalWorker.Params = FString::Printf(TEXT("-run=StyleTransferDistributedWorker -Job=\"%s\" -Worker=%s -nullrhi -unattended -nosplash -stdout"), *Job.GetDirectory(), *LocalWorker.Name);
+		if (FPaths::IsProjectFilePathSet())
+		{
+			LocalWorker.Params = FString::Printf(TEXT("\"%s\" %s"), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *LocalWorker.Params);
+		}
+		if (bPinWorkers && (WorkerIndex + 1) * CoresPerWorker <= 64)
+		{
+			const uint64 AffinityMask = (CoresPerWorker == 64 ? MAX_uint64 : ((uint64(1) << CoresPerWorker) - 1)) << (WorkerIndex * CoresPerWorker);
+			LocalWorker.Params += FString::Printf(TEXT(" -Affinity=%llx"), AffinityMask);
+		}
+	}
+	if (LocalWorkers.IsEmpty())
+	{
+		UE_LOG(LogStyleTransfer, Display, TEXT("Waiting for workers: -run=StyleTransferDistributedWorker -Job=\"%s\""), *Job.GetDirectory());
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	int32 LastNumDoneChunks = 0;
+	int32 LastNumPendingChunks = NumChunks;
+	double LastProgressTime = StartTime;
+	while (true)
+	{
+		const int32 NumDoneChunks = Job.GetNumChunks(TEXT("Done"));
+		const int32 NumFailedChunks = Job.GetNumChunks(TEXT("Failed"));
+		const int32 NumPendingChunks = Job.GetNumChunks(TEXT("Pending"));
+		if (NumDoneChunks != LastNumDoneChunks)
+		{
+			const int32 NumFramesDone = FMath::Min(NumDoneChunks * ChunkSize, Reader.GetNumFrames());
+			UE_LOG(LogStyleTransfer, Display, TEXT("%i of %i chunks done, %.2f frames per second"), NumDoneChunks, NumChunks, NumFramesDone / (FPlatformTime::Seconds() - StartTime));
+		}
+		if (NumDoneChunks != LastNumDoneChunks || NumPendingChunks != LastNumPendingChunks)
+		{
+			LastNumDoneChunks = NumDoneChunks;
+			LastNumPendingChunks = NumPendingChunks;
+			LastProgressTime = FPlatformTime::Seconds();
+		}
+		if (NumDoneChunks + NumFailedChunks >= NumChunks)
+			break;
+
+		// RequeueStaleChunks only sees claimed chunks, the pending ones would wait forever once the local workers gave up
+		const bool bLocalWorkersGaveUp = LocalWorkers.Num() && LocalWorkers.FindByPredicate([MaxAttempts](const FLocalWorker& LocalWorker)
+		{
+			return LocalWorker.NumLaunches <= MaxAttempts || (LocalWorker.Process.IsValid() && FPlatformProcess::IsProcRunning(LocalWorker.Process));
+		}) == nullptr;
+		if (bLocalWorkersGaveUp && NumPendingChunks && FPlatformTime::Seconds() - LastProgressTime >= Timeout)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("All local workers exited %i times and no chunk was claimed for %.0fs, giving up on the pending chunks"), MaxAttempts + 1, Timeout);
+			Job.FailPendingChunks();
+			LastProgressTime = FPlatformTime::Seconds();
+		}
+
+		// local workers that exited are launched again as long as there is work, a worker that keeps crashing fails its chunks eventually
+		for (FLocalWorker& LocalWorker : LocalWorkers)
+		{
+			if (LocalWorker.Process.IsValid() && FPlatformProcess::IsProcRunning(LocalWorker.Process))
+				continue;
+			if (LocalWorker.NumLaunches > MaxAttempts)
+				continue;
+
+			if (LocalWorker.NumLaunches > 0)
+			{
+				UE_LOG(LogStyleTransfer, Warning, TEXT("Worker %s exited, launching it again"), *LocalWorker.Name);
+			}
+			FPlatformProcess::CloseProc(LocalWorker.Process);
+			LocalWorker.Process = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *LocalWorker.Params, true, true, true, nullptr, 0, nullptr, nullptr);
+			++LocalWorker.NumLaunches;
+			if (!LocalWorker.Process.IsValid())
+			{
+				UE_LOG(LogStyleTransfer, Error, TEXT("Could not launch worker %s %s"), FPlatformProcess::ExecutablePath(), *LocalWorker.Params);
+			}
+		}
+
+		Job.RequeueStaleChunks(Timeout, MaxAttempts, [&LocalWorkers](const FString& WorkerName)
+		{
+			FLocalWorker* LocalWorker = LocalWorkers.FindByPredicate([&WorkerName](const FLocalWorker& Worker) { return Worker.Name == WorkerName; });
+			return LocalWorker && !(LocalWorker->Process.IsValid() && FPlatformProcess::IsProcRunning(LocalWorker->Process));
+		});
+		FPlatformProcess::SleepNoStats(0.5f);
+	}
+
+	Job.Finish();
+	for (FLocalWorker& LocalWorker : LocalWorkers)
+	{
+		if (LocalWorker.Process.IsValid())
+		{
+			FPlatformProcess::WaitForProc(LocalWorker.Process);
+			FPlatformProcess::CloseProc(LocalWorker.Process);
+		}
+	}
+
+	const int32 NumFailedChunks = Job.GetNumChunks(TEXT("Failed"));
+	const double Duration = FPlatformTime::Seconds() - StartTime;
+	UE_LOG(LogStyleTransfer, Display, TEXT("Stylized %i frames in %.1fs, %.2f frames per second"), Reader.GetNumFrames(), Duration, Reader.GetNumFrames() / Duration);
+	if (NumFailedChunks)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("%i chunks of %i frames failed, see %s/Failed"), NumFailedChunks, ChunkSize, *Job.GetDirectory());
+		return 1;
+	}
+	return 0;
+}
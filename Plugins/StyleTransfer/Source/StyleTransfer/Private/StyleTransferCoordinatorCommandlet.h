@@ -0,0 +1,30 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StyleTransferCoordinatorCommandlet.generated.h"
+
+/**
+ * Stylizes the frames of a recording made with r.StyleTransfer.Record on several CPU workers and writes them as PNGs.
+ * The frames are split into chunks of ChunkSize frames that workers claim through a shared job directory, see FStyleTransferDistributedJob.
+ * Workers is the number of local workers that are launched, more can join from other machines that reach the job directory.
+ * Chunks of workers that exit or do not report progress for Timeout seconds are requeued, up to MaxAttempts times.
+ * StyleParams is a raw style_params tensor that is distributed once and replaces the recorded style of every frame.
+ *
+ * Usage: -run=StyleTransferCoordinator -Recording=<path> -Output=<path with {frame}> [-Job=<directory>] [-Workers=<count>] [-PinWorkers]
+ *        [-ChunkSize=16] [-Network=<object path>] [-StyleParams=<path>] [-Timeout=60] [-MaxAttempts=3]
+ */
+UCLASS()
+class UStyleTransferCoordinatorCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStyleTransferCoordinatorCommandlet();
+
+	// - UCommandlet
+	virtual int32 Main(const FString& Params) override;
+	// --
+};
@@ -0,0 +1,252 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferCpuExecutor.h"
+
+#include "NeuralNetwork.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "ScreenPass.h"
+#include "StyleTransferModule.h"
+#include "Async/ParallelFor.h"
+
+namespace StyleTransferCpu
+{
+	/** A single pixel is too little work to be worth a task */
+	constexpr int32 PixelsPerTask = 4096;
+
+	template <typename FunctionType>
+	void ParallelForPixels(int32 NumPixels, FunctionType&& Function)
+	{
+		ParallelFor(FMath::DivideAndRoundUp(NumPixels, PixelsPerTask), [NumPixels, &Function](int32 TaskIndex)
+		{
+			const int32 EndPixelIndex = FMath::Min((TaskIndex + 1) * PixelsPerTask, NumPixels);
+			for (int32 PixelIndex = TaskIndex * PixelsPerTask; PixelIndex < EndPixelIndex; ++PixelIndex)
+			{
+				Function(PixelIndex);
+			}
+		});
+	}
+
+	void ImageToTensorRGB(TConstArrayView<FLinearColor> Image, TArrayView<float> OutTensorData)
+	{
+		check(OutTensorData.Num() == Image.Num() * 3);
+		ParallelForPixels(Image.Num(), [&](int32 PixelIndex)
+		{
+			OutTensorData[PixelIndex * 3 + 0] = Image[PixelIndex].R;
+			OutTensorData[PixelIndex * 3 + 1] = Image[PixelIndex].G;
+			OutTensorData[PixelIndex * 3 + 2] = Image[PixelIndex].B;
+		});
+	}
+
+	void ImageToTensorGrayscale(TConstArrayView<FLinearColor> Image, TArrayView<float> OutTensorData)
+	{
+		check(OutTensorData.Num() == Image.Num());
+		ParallelForPixels(Image.Num(), [&](int32 PixelIndex)
+		{
+			OutTensorData[PixelIndex] = Image[PixelIndex].R;
+		});
+	}
+
+	void TensorToImage(TConstArrayView<float> TensorData, FIntPoint ImageSize, TArray<FLinearColor>& OutImage)
+	{
+		OutImage.SetNumUninitialized(ImageSize.X * ImageSize.Y);
+		check(TensorData.Num() >= OutImage.Num() * 3);
+		ParallelForPixels(OutImage.Num(), [&](int32 PixelIndex)
+		{
+			const int32 TensorIndex = PixelIndex * 3;
+			OutImage[PixelIndex] = FLinearColor(TensorData[TensorIndex + 0], TensorData[TensorIndex + 1], TensorData[TensorIndex + 2], 0.f);
+		});
+	}
+}
+
+BEGIN_SHADER_PARAMETER_STRUCT(FUploadCpuOutputParameters,)
+	RDG_TEXTURE_ACCESS(Texture, ERHIAccess::CopyDest)
+END_SHADER_PARAMETER_STRUCT()
+
+/** Number of frames whose readbacks may be in flight, further frames are dropped */
+constexpr int32 MaxPendingCpuFrames = 2;
+
+FStyleTransferCpuExecutor::FStyleTransferCpuExecutor(UNeuralNetwork* InNetwork)
+	: Network(InNetwork)
+{
+	ensure(Network->GetDeviceType() == ENeuralDeviceType::CPU);
+	for (uint32 i = 0; i < Network->GetInputTensorNumber(); i++)
+	{
+		const FString& TensorName = Network->GetInputTensor(i).GetName();
+		if (TensorName == "content") ContentInputTensorIndex = i;
+		else if (TensorName == "style_weights") StyleWeightsInputTensorIndex = i;
+		else if (TensorName == "style_params") StyleParamsInputTensorIndex = i;
+	}
+	check(ContentInputTensorIndex != INDEX_NONE);
+	check(StyleParamsInputTensorIndex != INDEX_NONE);
+
+	// the content tensor has shape (1, Y, X, C)
+	const FNeuralTensor& ContentTensor = Network->GetInputTensor(ContentInputTensorIndex);
+	ContentSize = FIntPoint(ContentTensor.GetSize(2), ContentTensor.GetSize(1));
+}
+
+FStyleTransferCpuExecutor::~FStyleTransferCpuExecutor()
+{
+	if (InferenceTask.IsValid())
+	{
+		InferenceTask.Wait();
+	}
+}
+
+void FStyleTransferCpuExecutor::SetStyleParams_RenderThread(FRDGBuilder& GraphBuilder, FRDGBufferRef InStyleParams, TArray<int32> Mapping)
+{
+	check(IsInRenderingThread());
+	StyleParamsMapping = MoveTemp(Mapping);
+	NumPredictedStyleParams = InStyleParams->Desc.NumElements;
+	// a newer style replaces the one that is still being read back
+	StyleParamsReadback = MakeUnique<FRHIGPUBufferReadback>(TEXT("StyleTransferCpuStyleParamsReadback"));
+	AddEnqueueCopyPass(GraphBuilder, StyleParamsReadback.Get(), InStyleParams, NumPredictedStyleParams * sizeof(float));
+}
+
+TUniquePtr<FRHIGPUTextureReadback> FStyleTransferCpuExecutor::AddResampledReadback(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FScreenPassTexture& Source, const TCHAR* Name) const
+{
+	const FRDGTextureDesc ResampledDesc = FRDGTextureDesc::Create2D(ContentSize, PF_A32B32G32R32F, FClearValueBinding::Black, TexCreate_RenderTargetable | TexCreate_ShaderResource);
+	FRDGTextureRef ResampledTexture = GraphBuilder.CreateTexture(ResampledDesc, Name);
+	AddDrawTexturePass(GraphBuilder, View, Source, FScreenPassRenderTarget(ResampledTexture, ERenderTargetLoadAction::ENoAction));
+	TUniquePtr<FRHIGPUTextureReadback> Readback = MakeUnique<FRHIGPUTextureReadback>(Name);
+	AddEnqueueCopyPass(GraphBuilder, Readback.Get(), ResampledTexture);
+	return Readback;
+}
+
+void FStyleTransferCpuExecutor::SetStyleWeights_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, FRDGTextureRef StyleWeightsMask)
+{
+	check(IsInRenderingThread());
+	// newer weights replace the ones that are still being read back
+	StyleWeightsReadback = AddResampledReadback(GraphBuilder, View, FScreenPassTexture(StyleWeightsMask), TEXT("StyleTransferCpuStyleWeights"));
+}
+
+void FStyleTransferCpuExecutor::Submit_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FScreenPassTexture& SceneColor)
+{
+	check(IsInRenderingThread());
+	if (PendingFrames.Num() >= MaxPendingCpuFrames)
+		return;
+
+	PendingFrames.Add(AddResampledReadback(GraphBuilder, View, SceneColor, TEXT("StyleTransferCpuContent")));
+}
+
+void FStyleTransferCpuExecutor::ReadImage(FRHIGPUTextureReadback& Readback, TArray<FLinearColor>& OutImage) const
+{
+	int32 RowPitchInPixels = 0;
+	const FLinearColor* Pixels = static_cast<const FLinearColor*>(Readback.Lock(RowPitchInPixels));
+	OutImage.SetNumUninitialized(ContentSize.X * ContentSize.Y);
+	for (int32 Y = 0; Y < ContentSize.Y; ++Y)
+	{
+		FMemory::Memcpy(&OutImage[Y * ContentSize.X], Pixels + Y * RowPitchInPixels, ContentSize.X * sizeof(FLinearColor));
+	}
+	Readback.Unlock();
+}
+
+FRDGTextureRef FStyleTransferCpuExecutor::Tick_RenderThread(FRDGBuilder& GraphBuilder)
+{
+	check(IsInRenderingThread());
+
+	if (StyleParamsReadback && StyleParamsReadback->IsReady())
+	{
+		const float* PredictedStyleParams = static_cast<const float*>(StyleParamsReadback->Lock(NumPredictedStyleParams * sizeof(float)));
+		if (StyleParamsMapping.Num())
+		{
+			StyleParams.SetNumUninitialized(StyleParamsMapping.Num());
+			for (int32 i = 0; i < StyleParamsMapping.Num(); ++i)
+			{
+				StyleParams[i] = PredictedStyleParams[StyleParamsMapping[i]];
+			}
+		}
+		else
+		{
+			StyleParams = TArray<float>(PredictedStyleParams, NumPredictedStyleParams);
+		}
+		StyleParamsReadback->Unlock();
+		StyleParamsReadback.Reset();
+	}
+
+	if (StyleWeightsReadback && StyleWeightsReadback->IsReady())
+	{
+		ReadImage(*StyleWeightsReadback, StyleWeightsImage);
+		StyleWeightsReadback.Reset();
+		bStyleWeightsChanged = true;
+	}
+
+	const bool bIsNetworkIdle = !InferenceTask.IsValid() || InferenceTask.IsCompleted();
+	FRDGTextureRef OutputTexture = nullptr;
+	if (bIsNetworkIdle && bInferenceOutputPending)
+	{
+		OutputTexture = GraphBuilder.CreateTexture(
+			FRDGTextureDesc::Create2D(ContentSize, PF_A32B32G32R32F, FClearValueBinding::Black, TexCreate_ShaderResource),
+			TEXT("StyleTransferCpuOutput"));
+
+		FUploadCpuOutputParameters* Parameters = GraphBuilder.AllocParameters<FUploadCpuOutputParameters>();
+		Parameters->Texture = OutputTexture;
+		const TArray<FLinearColor>* Pixels = GraphBuilder.AllocObject<TArray<FLinearColor>>(MoveTemp(InferenceOutput));
+		GraphBuilder.AddPass(
+			RDG_EVENT_NAME("UploadCpuOutput"),
+			Parameters,
+			ERDGPassFlags::Copy | ERDGPassFlags::NeverCull,
+			[Parameters, Pixels, Size = ContentSize](FRHICommandListImmediate& RHICmdList)
+			{
+				RHICmdList.UpdateTexture2D(Parameters->Texture->GetRHI(), 0, FUpdateTextureRegion2D(0, 0, 0, 0, Size.X, Size.Y),
+				                           Size.X * sizeof(FLinearColor), reinterpret_cast<const uint8*>(Pixels->GetData()));
+			});
+		GraphBuilder.QueueTextureExtraction(OutputTexture, &OutputTarget);
+		bInferenceOutputPending = false;
+	}
+	else if (OutputTarget)
+	{
+		OutputTexture = GraphBuilder.RegisterExternalTexture(OutputTarget);
+	}
+
+	// only the newest complete frame is worth running, older ones would just add latency
+	int32 NewestReadyFrame = INDEX_NONE;
+	for (int32 i = 0; i < PendingFrames.Num() && PendingFrames[i]->IsReady(); ++i)
+	{
+		NewestReadyFrame = i;
+	}
+	const bool bHasStyleWeights = StyleWeightsInputTensorIndex == INDEX_NONE || StyleWeightsImage.Num();
+	if (bIsNetworkIdle && NewestReadyFrame != INDEX_NONE && StyleParams.Num() && bHasStyleWeights)
+	{
+		TArray<FLinearColor> ContentImage;
+		ReadImage(*PendingFrames[NewestReadyFrame], ContentImage);
+		PendingFrames.RemoveAt(0, NewestReadyFrame + 1);
+
+		// the network keeps its inputs, so unchanged weights do not have to be converted again
+		TArray<FLinearColor> FrameStyleWeightsImage;
+		if (bStyleWeightsChanged)
+		{
+			FrameStyleWeightsImage = StyleWeightsImage;
+			bStyleWeightsChanged = false;
+		}
+
+		bInferenceOutputPending = true;
+		InferenceTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [this, ContentImage = MoveTemp(ContentImage), StyleWeightsImage = MoveTemp(FrameStyleWeightsImage), FrameStyleParams = StyleParams]()
+		{
+			TRACE_CPUPROFILER_EVENT_SCOPE(StyleTransferCpuInference);
+			TArray<float> TensorData;
+			TensorData.SetNumUninitialized(ContentImage.Num() * 3);
+			StyleTransferCpu::ImageToTensorRGB(ContentImage, TensorData);
+			Network->SetInputFromArrayCopy(TensorData, ContentInputTensorIndex);
+			if (StyleWeightsImage.Num())
+			{
+				TensorData.SetNumUninitialized(StyleWeightsImage.Num());
+				StyleTransferCpu::ImageToTensorGrayscale(StyleWeightsImage, TensorData);
+				Network->SetInputFromArrayCopy(TensorData, StyleWeightsInputTensorIndex);
+			}
+			Network->SetInputFromArrayCopy(FrameStyleParams, StyleParamsInputTensorIndex);
+
+			Network->Run();
+
+			const TArray<float> OutputData = Network->GetOutputTensor(0).GetArrayCopy<float>();
+			StyleTransferCpu::TensorToImage(OutputData, ContentSize, InferenceOutput);
+		});
+	}
+	else if (NewestReadyFrame != INDEX_NONE && !bIsNetworkIdle)
+	{
+		// the network is busy, keep only the newest frame so the readbacks do not pile up
+		PendingFrames.RemoveAt(0, NewestReadyFrame);
+	}
+
+	return OutputTexture;
+}
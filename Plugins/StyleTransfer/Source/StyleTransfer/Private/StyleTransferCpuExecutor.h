@@ -0,0 +1,90 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+#include "Tasks/Task.h"
+
+class FRHIGPUBufferReadback;
+class FRHIGPUTextureReadback;
+class FViewInfo;
+class UNeuralNetwork;
+struct FScreenPassTexture;
+
+/** CPU equivalents of the tensor conversion shaders for images that already have the size of the tensor */
+namespace StyleTransferCpu
+{
+	/** CPU equivalent of SceneColorToInputTensor.usf */
+	void ImageToTensorRGB(TConstArrayView<FLinearColor> Image, TArrayView<float> OutTensorData);
+	/** CPU equivalent of ShadowMaskToInputTensor.usf, only the red channel is used */
+	void ImageToTensorGrayscale(TConstArrayView<FLinearColor> Image, TArrayView<float> OutTensorData);
+	/** CPU equivalent of OutputTensorToSceneColor.usf */
+	void TensorToImage(TConstArrayView<float> TensorData, FIntPoint ImageSize, TArray<FLinearColor>& OutImage);
+}
+
+/**
+ * Runs a style transfer network whose device type is CPU for the stylized view.
+ * The GPU only resamples the view to the size of the content tensor, the readbacks are converted to tensors,
+ * run and converted back to an image on a worker thread so neither the game nor the render thread wait for the inference.
+ * The output lags behind by the readback and the inference latency, frames that arrive while the network runs are dropped.
+ * Only used on the render thread after construction.
+ */
+class STYLETRANSFER_API FStyleTransferCpuExecutor
+{
+public:
+	explicit FStyleTransferCpuExecutor(UNeuralNetwork* InNetwork);
+	/** Waits for the inference that is still running */
+	~FStyleTransferCpuExecutor();
+
+	UNeuralNetwork* GetNetwork() const { return Network; }
+	/** X is the width of the content tensor */
+	FIntPoint GetContentSize() const { return ContentSize; }
+
+	/** Reads the style params back and passes them to the network through Mapping once they arrived. An empty Mapping uses them as they are. */
+	void SetStyleParams_RenderThread(FRDGBuilder& GraphBuilder, FRDGBufferRef StyleParams, TArray<int32> Mapping);
+
+	/** Reads the style weights mask back and uses it for all inferences that start after it arrived. Only needed if the network has style_weights. */
+	void SetStyleWeights_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, FRDGTextureRef StyleWeightsMask);
+
+	/** Queues the readback of the view resampled to the size of the content tensor. */
+	void Submit_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FScreenPassTexture& SceneColor);
+
+	/**
+	 * Starts the inference of the newest complete readback if the network is idle and uploads a finished output.
+	 * @return the newest output or nullptr if no inference finished yet
+	 */
+	FRDGTextureRef Tick_RenderThread(FRDGBuilder& GraphBuilder);
+
+private:
+	/** Resamples Source to the size of the content tensor and queues its readback */
+	TUniquePtr<FRHIGPUTextureReadback> AddResampledReadback(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FScreenPassTexture& Source, const TCHAR* Name) const;
+	void ReadImage(FRHIGPUTextureReadback& Readback, TArray<FLinearColor>& OutImage) const;
+
+	TObjectPtr<UNeuralNetwork> Network;
+	int32 ContentInputTensorIndex = INDEX_NONE;
+	int32 StyleWeightsInputTensorIndex = INDEX_NONE;
+	int32 StyleParamsInputTensorIndex = INDEX_NONE;
+	/** X is the width of the content tensor */
+	FIntPoint ContentSize = FIntPoint::ZeroValue;
+
+	/** Readbacks of the content, oldest first */
+	TArray<TUniquePtr<FRHIGPUTextureReadback>> PendingFrames;
+
+	TUniquePtr<FRHIGPUTextureReadback> StyleWeightsReadback;
+	TArray<FLinearColor> StyleWeightsImage;
+	/** Set if the StyleWeightsImage was not passed to the network yet */
+	bool bStyleWeightsChanged = false;
+
+	TUniquePtr<FRHIGPUBufferReadback> StyleParamsReadback;
+	TArray<int32> StyleParamsMapping;
+	uint32 NumPredictedStyleParams = 0;
+	TArray<float> StyleParams;
+
+	UE::Tasks::TTask<void> InferenceTask;
+	/** Written by InferenceTask, read on the render thread once it completed */
+	TArray<FLinearColor> InferenceOutput;
+	bool bInferenceOutputPending = false;
+
+	TRefCountPtr<IPooledRenderTarget> OutputTarget;
+};
@@ -0,0 +1,168 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferDistributedJob.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "StyleTransferModule.h"
+
+FStyleTransferDistributedJob::FStyleTransferDistributedJob(const FString& InDirectory)
+	: Directory(FPaths::ConvertRelativePathToFull(InDirectory))
+{
+}
+
+bool FStyleTransferDistributedJob::Create(const FString& JobParams, int32 NumChunks, TConstArrayView<uint8> StyleParams)
+{
+	IFileManager& FileManager = IFileManager::Get();
+	if (FileManager.DirectoryExists(*Directory))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Job directory %s already exists"), *Directory);
+		return false;
+	}
+
+	for (const TCHAR* State : {TEXT("Pending"), TEXT("Claimed"), TEXT("Requeue"), TEXT("Done"), TEXT("Failed")})
+	{
+		if (!FileManager.MakeDirectory(*(Directory / State), true))
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Could not create job directory %s"), *Directory);
+			return false;
+		}
+	}
+
+	if (StyleParams.Num() && !FFileHelper::SaveArrayToFile(StyleParams, *GetStyleParamsPath()))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not write %s"), *GetStyleParamsPath());
+		return false;
+	}
+
+	for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+	{
+		if (!FFileHelper::SaveStringToFile(TEXT("0"), *(Directory / TEXT("Pending") / GetChunkName(Chunk))))
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Could not write chunk %i of job %s"), Chunk, *Directory);
+			return false;
+		}
+	}
+
+	// workers only start once the params exist, so they are written last
+	return FFileHelper::SaveStringToFile(JobParams, *(Directory / TEXT("Job.txt")));
+}
+
+bool FStyleTransferDistributedJob::LoadParams(FString& OutJobParams) const
+{
+	return FFileHelper::LoadFileToString(OutJobParams, *(Directory / TEXT("Job.txt")));
+}
+
+int32 FStyleTransferDistributedJob::ClaimChunk(const FString& WorkerName) const
+{
+	TArray<FString> PendingChunks;
+	IFileManager::Get().FindFiles(PendingChunks, *(Directory / TEXT("Pending")), nullptr);
+	PendingChunks.Sort();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	for (const FString& ChunkName : PendingChunks)
+	{
+		// only one of the workers that try to claim the chunk at the same time can rename it
+		const FString ClaimedPath = Directory / TEXT("Claimed") / ChunkName + TEXT(".") + WorkerName;
+		if (PlatformFile.MoveFile(*ClaimedPath, *(Directory / TEXT("Pending") / ChunkName)))
+		{
+			TouchChunk(FCString::Atoi(*ChunkName), WorkerName);
+			return FCString::Atoi(*ChunkName);
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FStyleTransferDistributedJob::TouchChunk(int32 Chunk, const FString& WorkerName) const
+{
+	IFileManager::Get().SetTimeStamp(*(Directory / TEXT("Claimed") / GetChunkName(Chunk) + TEXT(".") + WorkerName), FDateTime::UtcNow());
+}
+
+bool FStyleTransferDistributedJob::CompleteChunk(int32 Chunk, const FString& WorkerName) const
+{
+	// fails if the coordinator requeued the chunk in the meantime, another worker writes the same frames again then
+	const FString ClaimedPath = Directory / TEXT("Claimed") / GetChunkName(Chunk) + TEXT(".") + WorkerName;
+	return FPlatformFileManager::Get().GetPlatformFile().MoveFile(*(Directory / TEXT("Done") / GetChunkName(Chunk)), *ClaimedPath);
+}
+
+int32 FStyleTransferDistributedJob::RequeueStaleChunks(double Timeout, int32 MaxAttempts, TFunctionRef<bool(const FString& WorkerName)> IsWorkerLost) const
+{
+	IFileManager& FileManager = IFileManager::Get();
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	TArray<FString> ClaimedChunks;
+	FileManager.FindFiles(ClaimedChunks, *(Directory / TEXT("Claimed")), nullptr);
+
+	int32 NumRequeued = 0;
+	const FDateTime Now = FDateTime::UtcNow();
+	for (const FString& ClaimedName : ClaimedChunks)
+	{
+		FString ChunkName, WorkerName;
+		if (!ClaimedName.Split(TEXT("."), &ChunkName, &WorkerName))
+			continue;
+
+		const FString ClaimedPath = Directory / TEXT("Claimed") / ClaimedName;
+		const FDateTime LastTouched = FileManager.GetTimeStamp(*ClaimedPath);
+		// the worker may have completed the chunk since it was found
+		if (LastTouched == FDateTime::MinValue())
+			continue;
+		if (!IsWorkerLost(WorkerName) && (Now - LastTouched).GetTotalSeconds() < Timeout)
+			continue;
+
+		// taking the chunk away first fails if the worker completes it at the same time
+		const FString RequeuePath = Directory / TEXT("Requeue") / ChunkName;
+		if (!PlatformFile.MoveFile(*RequeuePath, *ClaimedPath))
+			continue;
+
+		FString AttemptsString;
+		FFileHelper::LoadFileToString(AttemptsString, *RequeuePath);
+		const int32 Attempts = FCString::Atoi(*AttemptsString) + 1;
+		if (Attempts >= MaxAttempts)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Giving up on chunk %s after %i attempts, the last one by worker %s"), *ChunkName, Attempts, *WorkerName);
+			PlatformFile.MoveFile(*(Directory / TEXT("Failed") / ChunkName), *RequeuePath);
+			continue;
+		}
+
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Worker %s lost chunk %s, requeueing it"), *WorkerName, *ChunkName);
+		FFileHelper::SaveStringToFile(FString::FromInt(Attempts), *RequeuePath);
+		PlatformFile.MoveFile(*(Directory / TEXT("Pending") / ChunkName), *RequeuePath);
+		++NumRequeued;
+	}
+	return NumRequeued;
+}
+
+int32 FStyleTransferDistributedJob::FailPendingChunks() const
+{
+	TArray<FString> PendingChunks;
+	IFileManager::Get().FindFiles(PendingChunks, *(Directory / TEXT("Pending")), nullptr);
+
+	int32 NumFailed = 0;
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	for (const FString& ChunkName : PendingChunks)
+	{
+		// a worker may claim the chunk at the same time
+		if (PlatformFile.MoveFile(*(Directory / TEXT("Failed") / ChunkName), *(Directory / TEXT("Pending") / ChunkName)))
+		{
+			++NumFailed;
+		}
+	}
+	return NumFailed;
+}
+
+int32 FStyleTransferDistributedJob::GetNumChunks(const TCHAR* State) const
+{
+	TArray<FString> Chunks;
+	IFileManager::Get().FindFiles(Chunks, *(Directory / State), nullptr);
+	return Chunks.Num();
+}
+
+void FStyleTransferDistributedJob::Finish() const
+{
+	FFileHelper::SaveStringToFile(FString(), *(Directory / TEXT("Finished")));
+}
+
+bool FStyleTransferDistributedJob::IsFinished() const
+{
+	return IFileManager::Get().FileExists(*(Directory / TEXT("Finished")));
+}
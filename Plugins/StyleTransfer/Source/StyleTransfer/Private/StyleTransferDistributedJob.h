@@ -0,0 +1,61 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Shared directory through which a coordinator hands out the frames of a recording to stylization workers.
+ *
+ * Layout:
+ *   Job.txt                    commandlet params of the job, e.g. -Recording= -Output= -ChunkSize=
+ *   StyleParams.bin            style_params used for every frame if the coordinator distributes them
+ *   Pending/<chunk>            chunks no worker claimed yet, containing the number of failed attempts
+ *   Claimed/<chunk>.<worker>   chunks a worker stylizes, the worker touches the file after every frame
+ *   Requeue/<chunk>            chunks the coordinator took away from a lost worker
+ *   Done/<chunk>               chunks whose frames are written
+ *   Failed/<chunk>             chunks that were given up on after too many attempts
+ *   Finished                   written by the coordinator once no chunk is left, workers exit when they see it
+ *
+ * Chunks are claimed by renaming them, which is atomic on local and network file systems,
+ * so any number of workers on any number of machines can share a job.
+ */
+class FStyleTransferDistributedJob
+{
+public:
+	explicit FStyleTransferDistributedJob(const FString& InDirectory);
+
+	const FString& GetDirectory() const { return Directory; }
+	FString GetStyleParamsPath() const { return Directory / TEXT("StyleParams.bin"); }
+
+	/** Creates the directory of a new job with all chunks pending. StyleParams may be empty. */
+	bool Create(const FString& JobParams, int32 NumChunks, TConstArrayView<uint8> StyleParams);
+	bool LoadParams(FString& OutJobParams) const;
+
+	/** @return the claimed chunk or INDEX_NONE if none is pending */
+	int32 ClaimChunk(const FString& WorkerName) const;
+	/** Keeps the chunk from being handed to another worker */
+	void TouchChunk(int32 Chunk, const FString& WorkerName) const;
+	bool CompleteChunk(int32 Chunk, const FString& WorkerName) const;
+
+	/**
+	 * Returns chunks whose worker was lost or did not touch them for Timeout seconds to the pending ones.
+	 * Chunks that failed MaxAttempts times are moved to Failed instead.
+	 * @return number of requeued chunks
+	 */
+	int32 RequeueStaleChunks(double Timeout, int32 MaxAttempts, TFunctionRef<bool(const FString& WorkerName)> IsWorkerLost) const;
+	/**
+	 * Moves all pending chunks to Failed, e.g. once no worker is left to claim them.
+	 * @return number of failed chunks
+	 */
+	int32 FailPendingChunks() const;
+
+	int32 GetNumChunks(const TCHAR* State) const;
+	void Finish() const;
+	bool IsFinished() const;
+
+	static FString GetChunkName(int32 Chunk) { return FString::Printf(TEXT("%06i"), Chunk); }
+
+private:
+	FString Directory;
+};
@@ -0,0 +1,173 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferDistributedWorkerCommandlet.h"
+
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "NeuralNetwork.h"
+#include "StyleTransferCpuExecutor.h"
+#include "StyleTransferDistributedJob.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferRecording.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Modules/ModuleManager.h"
+
+UStyleTransferDistributedWorkerCommandlet::UStyleTransferDistributedWorkerCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UStyleTransferDistributedWorkerCommandlet::Main(const FString& Params)
+{
+	FString JobDirectory;
+	if (!FParse::Value(*Params, TEXT("Job="), JobDirectory))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Usage: -run=StyleTransferDistributedWorker -Job=<directory> [-Worker=<name>] [-Affinity=<hex core mask>]"));
+		return 1;
+	}
+	FString WorkerName = FString::Printf(TEXT("%s-%u"), FPlatformProcess::ComputerName(), FPlatformProcess::GetCurrentProcessId());
+	FParse::Value(*Params, TEXT("Worker="), WorkerName);
+
+	// threads the inference runtime creates while loading the network inherit the mask on Linux
+	FString Affinity;
+	if (FParse::Value(*Params, TEXT("Affinity="), Affinity))
+	{
+		const uint64 AffinityMask = FCString::Strtoui64(*Affinity, nullptr, 16);
+		UE_LOG(LogStyleTransfer, Display, TEXT("Pinning inference to core mask 0x%llx"), AffinityMask);
+		FPlatformProcess::SetThreadAffinityMask(AffinityMask);
+	}
+
+	const FStyleTransferDistributedJob Job(JobDirectory);
+	FString JobParams;
+	if (!Job.LoadParams(JobParams))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("%s is not a distributed style transfer job"), *Job.GetDirectory());
+		return 1;
+	}
+	FString RecordingPath, OutputFormat, NetworkPath;
+	int32 ChunkSize = 0;
+	FParse::Value(*JobParams, TEXT("Recording="), RecordingPath);
+	FParse::Value(*JobParams, TEXT("Output="), OutputFormat);
+	FParse::Value(*JobParams, TEXT("Network="), NetworkPath);
+	FParse::Value(*JobParams, TEXT("ChunkSize="), ChunkSize);
+	if (ChunkSize <= 0)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Job %s has no ChunkSize"), *Job.GetDirectory());
+		return 1;
+	}
+
+	FStyleTransferRecordingReader Reader;
+	if (!Reader.Open(RecordingPath))
+		return 1;
+
+	UNeuralNetwork* StyleTransferNetwork = StyleTransferRecording::LoadNetworkForCpu(NetworkPath);
+	if (!StyleTransferNetwork)
+		return 1;
+
+	// the distributed style params are set once and replace the recorded ones of every frame
+	TArray<uint8> StyleParams;
+	FFileHelper::LoadFileToArray(StyleParams, *Job.GetStyleParamsPath(), FILEREAD_Silent);
+
+	const TArray<FStyleTransferRecordingTensorDesc>& TensorDescs = Reader.GetTensorDescs();
+	TArray<int32> InputTensorIndices;
+	if (!StyleTransferRecording::FindInputTensorIndices(StyleTransferNetwork, TensorDescs, InputTensorIndices))
+		return 1;
+	for (int32 TensorIndex = 0; TensorIndex < TensorDescs.Num(); ++TensorIndex)
+	{
+		const FStyleTransferRecordingTensorDesc& TensorDesc = TensorDescs[TensorIndex];
+		int32& InputTensorIndex = InputTensorIndices[TensorIndex];
+		if (StyleParams.Num() && TensorDesc.GetName() == TEXT("style_params"))
+		{
+			if (static_cast<uint64>(StyleParams.Num()) != TensorDesc.NumBytes)
+			{
+				UE_LOG(LogStyleTransfer, Error, TEXT("The style params of job %s do not match the style_params input of %s"), *Job.GetDirectory(), *StyleTransferNetwork->GetName());
+				return 1;
+			}
+			StyleTransferNetwork->SetInputFromVoidPointerCopy(StyleParams.GetData(), InputTensorIndex);
+			InputTensorIndex = INDEX_NONE;
+		}
+	}
+
+	const FNeuralTensor& OutputTensor = StyleTransferNetwork->GetOutputTensor(0);
+	const FIntPoint ImageSize(static_cast<int32>(OutputTensor.GetSize(2)), static_cast<int32>(OutputTensor.GetSize(1)));
+	const TSharedPtr<IImageWrapper> ImageWrapper = FModuleManager::LoadModuleChecked<IImageWrapperModule>("ImageWrapper").CreateImageWrapper(EImageFormat::PNG);
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	UE_LOG(LogStyleTransfer, Display, TEXT("Worker %s stylizes %s of job %s with %s"), *WorkerName, *RecordingPath, *Job.GetDirectory(), *StyleTransferNetwork->GetName());
+
+	int32 NumFramesWritten = 0;
+	double RunMsSum = 0;
+	TArray<FLinearColor> Image;
+	TArray<FColor> Pixels;
+	while (true)
+	{
+		const int32 Chunk = Job.ClaimChunk(WorkerName);
+		if (Chunk == INDEX_NONE)
+		{
+			if (Job.IsFinished())
+				break;
+
+			// lost chunks of other workers may still be requeued
+			FPlatformProcess::SleepNoStats(0.5f);
+			continue;
+		}
+
+		const int32 FirstFrame = Chunk * ChunkSize;
+		const int32 EndFrame = FMath::Min(FirstFrame + ChunkSize, Reader.GetNumFrames());
+		for (int32 FrameIndex = FirstFrame; FrameIndex < EndFrame; ++FrameIndex)
+		{
+			if (!Reader.IsFrameValid(FrameIndex))
+			{
+				UE_LOG(LogStyleTransfer, Warning, TEXT("Frame %i of %s is corrupt and skipped"), FrameIndex, *RecordingPath);
+				continue;
+			}
+			for (int32 TensorIndex = 0; TensorIndex < TensorDescs.Num(); ++TensorIndex)
+			{
+				if (InputTensorIndices[TensorIndex] != INDEX_NONE)
+				{
+					StyleTransferNetwork->SetInputFromVoidPointerCopy(Reader.GetTensorData(FrameIndex, TensorIndex), InputTensorIndices[TensorIndex]);
+				}
+			}
+
+			const double RunStartTime = FPlatformTime::Seconds();
+			StyleTransferNetwork->Run();
+			RunMsSum += (FPlatformTime::Seconds() - RunStartTime) * 1000.;
+
+			StyleTransferCpu::TensorToImage(OutputTensor.GetArrayCopy<float>(), ImageSize, Image);
+			Pixels.SetNumUninitialized(Image.Num());
+			for (int32 i = 0; i < Image.Num(); ++i)
+			{
+				// the network stylizes the tonemapped scene color, so the output is not converted again
+				Pixels[i] = Image[i].ToFColor(false);
+				Pixels[i].A = 255;
+			}
+			ImageWrapper->SetRaw(Pixels.GetData(), Pixels.Num() * Pixels.GetTypeSize(), ImageSize.X, ImageSize.Y, ERGBFormat::BGRA, 8);
+
+			// frames are renamed into place so a lost worker never leaves a partial image behind
+			const FString FramePath = OutputFormat.Replace(TEXT("{frame}"), *FString::Printf(TEXT("%04llu"), Reader.GetFrameHeader(FrameIndex).FrameNumber));
+			const FString TempFramePath = FramePath + TEXT(".") + WorkerName;
+			// a requeued chunk overwrites the frames the lost worker wrote
+			PlatformFile.DeleteFile(*FramePath);
+			if (!FFileHelper::SaveArrayToFile(ImageWrapper->GetCompressed(), *TempFramePath) || !PlatformFile.MoveFile(*FramePath, *TempFramePath))
+			{
+				UE_LOG(LogStyleTransfer, Error, TEXT("Could not write %s"), *FramePath);
+				return 1;
+			}
+			++NumFramesWritten;
+			Job.TouchChunk(Chunk, WorkerName);
+		}
+
+		if (!Job.CompleteChunk(Chunk, WorkerName))
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Chunk %i was requeued before worker %s completed it"), Chunk, *WorkerName);
+		}
+		UE_LOG(LogStyleTransfer, Display, TEXT("Completed chunk %i, %i frames written, average run time %.3fms"), Chunk, NumFramesWritten, RunMsSum / FMath::Max(NumFramesWritten, 1));
+	}
+
+	UE_LOG(LogStyleTransfer, Display, TEXT("Worker %s exits after %i frames"), *WorkerName, NumFramesWritten);
+	return 0;
+}
@@ -0,0 +1,26 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StyleTransferDistributedWorkerCommandlet.generated.h"
+
+/**
+ * Stylizes chunks of the frames of a distributed job on the CPU and writes them as PNGs, see UStyleTransferCoordinatorCommandlet.
+ * Launched by the coordinator for local workers or by hand on every machine that can reach the job directory. Exits once the job is finished.
+ *
+ * Usage: -run=StyleTransferDistributedWorker -Job=<directory> [-Worker=<name>] [-Affinity=<hex core mask>]
+ */
+UCLASS()
+class UStyleTransferDistributedWorkerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStyleTransferDistributedWorkerCommandlet();
+
+	// - UCommandlet
+	virtual int32 Main(const FString& Params) override;
+	// --
+};
@@ -0,0 +1,300 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferInferenceWorker.h"
+
+#include "NeuralNetwork.h"
+#include "NeuralTensor.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "StyleTransferModule.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/Paths.h"
+
+TAutoConsoleVariable<bool> CVarInferenceWorkerLaunch(
+	TEXT("r.StyleTransfer.InferenceWorker.Launch"),
+	true,
+	TEXT("Set to true to launch the inference worker process with -run=StyleTransferWorker. If false a worker has to be started manually with the ring name from the log")
+);
+
+TAutoConsoleVariable<int32> CVarInferenceWorkerNumSlots(
+	TEXT("r.StyleTransfer.InferenceWorker.NumSlots"),
+	3,
+	TEXT("Number of frames that can be in flight between the game and the inference worker")
+);
+
+TAutoConsoleVariable<FString> CVarInferenceWorkerAffinity(
+	TEXT("r.StyleTransfer.InferenceWorker.Affinity"),
+	TEXT(""),
+	TEXT("Hexadecimal core mask the launched inference worker pins its inference threads to, e.g. 0xF0. Empty does not pin")
+);
+
+FStyleTransferInferenceRing::~FStyleTransferInferenceRing()
+{
+	Unmap();
+}
+
+bool FStyleTransferInferenceRing::Create(const FString& InName, const FString& NetworkPath, TArrayView<const FNeuralTensor* const> Tensors, int32 NumSlots)
+{
+	check(!Region);
+	check(NumSlots > 0);
+	Name = InName;
+
+	FStyleTransferInferenceRingHeader Header;
+	TArray<FStyleTransferRecordingTensorDesc> TensorDescs;
+	uint32 SlotOffset = sizeof(FStyleTransferInferenceSlotHeader);
+	for (const FNeuralTensor* Tensor : Tensors)
+	{
+		FStyleTransferRecordingTensorDesc& TensorDesc = TensorDescs.AddDefaulted_GetRef();
+		FCStringAnsi::Strncpy(TensorDesc.Name, TCHAR_TO_ANSI(*Tensor->GetName()), StyleTransferRecording::MaxTensorNameLength);
+		const TArray<int64>& Sizes = Tensor->GetSizes();
+		checkf(Sizes.Num() <= StyleTransferRecording::MaxTensorDimensions, TEXT("Tensor %s has too many dimensions for the inference ring"), *Tensor->GetName());
+		TensorDesc.NumDimensions = Sizes.Num();
+		FMemory::Memcpy(TensorDesc.Sizes, Sizes.GetData(), Sizes.Num() * Sizes.GetTypeSize());
+		TensorDesc.NumBytes = Tensor->NumInBytes();
+		TensorDesc.FrameOffset = SlotOffset;
+		SlotOffset = Align(SlotOffset + TensorDesc.NumBytes, StyleTransferRecording::Alignment);
+	}
+
+	Header.NumTensors = TensorDescs.Num();
+	Header.NumSlots = NumSlots;
+	Header.SlotSize = SlotOffset;
+	Header.TotalSize = sizeof(Header) + TensorDescs.Num() * TensorDescs.GetTypeSize() + Header.SlotSize * NumSlots;
+	Header.OwnerProcessId = FPlatformProcess::GetCurrentProcessId();
+	FCStringAnsi::Strncpy(Header.NetworkPath, TCHAR_TO_ANSI(*NetworkPath), StyleTransferInferenceRing::MaxNetworkPathLength);
+
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, true, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, Header.TotalSize);
+	if (!Region)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not create shared memory %s for the inference ring"), *Name);
+		return false;
+	}
+
+	Data = static_cast<uint8*>(Region->GetAddress());
+	FirstSlot = Data + sizeof(Header) + TensorDescs.Num() * TensorDescs.GetTypeSize();
+	FMemory::Memzero(Data, Header.TotalSize);
+	FMemory::Memcpy(Data + sizeof(Header), TensorDescs.GetData(), TensorDescs.Num() * TensorDescs.GetTypeSize());
+	// the header goes last so a worker that opens the ring early never sees a valid magic with incomplete descs
+	FMemory::Memcpy(Data, &Header, sizeof(Header));
+	FPlatformMisc::MemoryBarrier();
+	return true;
+}
+
+bool FStyleTransferInferenceRing::Open(const FString& InName)
+{
+	check(!Region);
+	Name = InName;
+
+	// the size is only known after reading the header
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, false, FPlatformMemory::ESharedMemoryAccess::Read, sizeof(FStyleTransferInferenceRingHeader));
+	if (!Region)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not open inference ring %s"), *Name);
+		return false;
+	}
+	const FStyleTransferInferenceRingHeader Header = *static_cast<FStyleTransferInferenceRingHeader*>(Region->GetAddress());
+	Unmap();
+
+	if (Header.Magic != StyleTransferInferenceRing::Magic || Header.Version != StyleTransferInferenceRing::Version)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("%s is not an inference ring of version %u"), *Name, StyleTransferInferenceRing::Version);
+		return false;
+	}
+
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(Name, false, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, Header.TotalSize);
+	if (!Region)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not open inference ring %s"), *Name);
+		return false;
+	}
+	Data = static_cast<uint8*>(Region->GetAddress());
+	FirstSlot = Data + sizeof(Header) + Header.NumTensors * sizeof(FStyleTransferRecordingTensorDesc);
+	return true;
+}
+
+void FStyleTransferInferenceRing::Unmap()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		Region = nullptr;
+		Data = FirstSlot = nullptr;
+	}
+}
+
+TArrayView<const FStyleTransferRecordingTensorDesc> FStyleTransferInferenceRing::GetTensorDescs() const
+{
+	return MakeArrayView(reinterpret_cast<const FStyleTransferRecordingTensorDesc*>(Data + sizeof(FStyleTransferInferenceRingHeader)), GetHeader().NumTensors);
+}
+
+FStyleTransferInferenceSlotHeader& FStyleTransferInferenceRing::GetSlotHeader(int32 SlotIndex) const
+{
+	check(SlotIndex >= 0 && SlotIndex < static_cast<int32>(GetHeader().NumSlots));
+	return *reinterpret_cast<FStyleTransferInferenceSlotHeader*>(FirstSlot + SlotIndex * GetHeader().SlotSize);
+}
+
+uint8* FStyleTransferInferenceRing::GetTensorData(int32 SlotIndex, int32 TensorIndex) const
+{
+	return reinterpret_cast<uint8*>(&GetSlotHeader(SlotIndex)) + GetTensorDescs()[TensorIndex].FrameOffset;
+}
+
+FStyleTransferInferenceWorkerClient::FStyleTransferInferenceWorkerClient(const UNeuralNetwork* Network, TArrayView<const FNeuralTensor* const> InputTensors)
+{
+	TArray<const FNeuralTensor*, TInlineAllocator<4>> Tensors(InputTensors);
+	Tensors.Add(&Network->GetOutputTensor(0));
+
+	const FString RingName = FString::Printf(TEXT("StyleTransferInferenceRing_%u_%s"), FPlatformProcess::GetCurrentProcessId(), *FGuid::NewGuid().ToString());
+	if (!Ring.Create(RingName, Network->GetPathName(), Tensors, FMath::Max(CVarInferenceWorkerNumSlots.GetValueOnGameThread(), 1)))
+		return;
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Created inference ring %s with %u slots of %llu bytes"), *RingName, Ring.GetHeader().NumSlots, Ring.GetHeader().SlotSize);
+
+	if (CVarInferenceWorkerLaunch.GetValueOnGameThread())
+	{
+		FString Params = FString::Printf(TEXT("-run=StyleTransferWorker -Ring=%s -nullrhi -unattended -nosplash -stdout"), *RingName);
+		if (FPaths::IsProjectFilePathSet())
+		{
+			Params = FString::Printf(TEXT("\"%s\" %s"), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()), *Params);
+		}
+		const FString Affinity = CVarInferenceWorkerAffinity.GetValueOnGameThread();
+		if (!Affinity.IsEmpty())
+		{
+			Params += FString::Printf(TEXT(" -Affinity=%s"), *Affinity);
+		}
+
+		WorkerProcess = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Params, true, true, true, nullptr, 0, nullptr, nullptr);
+		if (!WorkerProcess.IsValid())
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Could not launch the inference worker %s %s"), FPlatformProcess::ExecutablePath(), *Params);
+		}
+	}
+	else
+	{
+		UE_LOG(LogStyleTransfer, Display, TEXT("Waiting for an inference worker: -run=StyleTransferWorker -Ring=%s"), *RingName);
+	}
+}
+
+FStyleTransferInferenceWorkerClient::~FStyleTransferInferenceWorkerClient()
+{
+	if (Ring.IsValid())
+	{
+		FPlatformAtomics::AtomicStore(&Ring.GetHeader().bShutdown, 1);
+	}
+	// the worker exits on its own once it sees the shutdown flag
+	if (WorkerProcess.IsValid())
+	{
+		FPlatformProcess::CloseProc(WorkerProcess);
+	}
+}
+
+void FStyleTransferInferenceWorkerClient::Submit_RenderThread(FRDGBuilder& GraphBuilder, TArrayView<FNeuralTensor* const> InputTensors, uint64 FrameNumber)
+{
+	check(IsInRenderingThread());
+	if (!Ring.IsValid())
+		return;
+
+	const TArrayView<const FStyleTransferRecordingTensorDesc> TensorDescs = Ring.GetTensorDescs();
+	check(InputTensors.Num() == TensorDescs.Num() - 1);
+
+	const int32 SlotIndex = GetSlotIndex(NextFence);
+	const FStyleTransferInferenceSlotHeader& SlotHeader = Ring.GetSlotHeader(SlotIndex);
+	const bool bSlotIsPending = PendingSubmissions.ContainsByPredicate([this, SlotIndex](const FPendingSubmission& PendingSubmission) { return GetSlotIndex(PendingSubmission.Fence) == SlotIndex; });
+	if (bSlotIsPending || FPlatformAtomics::AtomicRead(&SlotHeader.SubmittedFence) != FPlatformAtomics::AtomicRead(&SlotHeader.CompletedFence))
+	{
+		// the worker is behind, dropping frames keeps the latency bounded
+		return;
+	}
+
+	for (int32 i = 0; i < InputTensors.Num(); ++i)
+	{
+		if (InputTensors[i]->NumInBytes() != TensorDescs[i].NumBytes)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Tensor %s changed its size, frame is not sent to the inference worker"), *InputTensors[i]->GetName());
+			return;
+		}
+	}
+
+	FPendingSubmission& PendingSubmission = PendingSubmissions.AddDefaulted_GetRef();
+	PendingSubmission.Fence = NextFence++;
+	PendingSubmission.FrameNumber = FrameNumber;
+	for (int32 i = 0; i < InputTensors.Num(); ++i)
+	{
+		TUniquePtr<FRHIGPUBufferReadback>& Readback = PendingSubmission.Readbacks.Emplace_GetRef(MakeUnique<FRHIGPUBufferReadback>(TEXT("StyleTransferInferenceWorkerReadback")));
+		AddEnqueueCopyPass(GraphBuilder, Readback.Get(), InputTensors[i]->GetBufferSRVRef()->GetParent(), TensorDescs[i].NumBytes);
+	}
+}
+
+void FStyleTransferInferenceWorkerClient::Tick_RenderThread()
+{
+	check(IsInRenderingThread());
+	if (!Ring.IsValid())
+		return;
+
+	if (WorkerProcess.IsValid() && !bReportedLostWorker && !FPlatformProcess::IsProcRunning(WorkerProcess))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("The inference worker for %s exited, see its log for details"), *Ring.GetName());
+		bReportedLostWorker = true;
+	}
+
+	// slots have to be submitted in fence order so only the oldest pending submissions are checked
+	while (PendingSubmissions.Num())
+	{
+		FPendingSubmission& PendingSubmission = PendingSubmissions[0];
+		for (const TUniquePtr<FRHIGPUBufferReadback>& Readback : PendingSubmission.Readbacks)
+		{
+			if (!Readback->IsReady())
+				return;
+		}
+
+		const int32 SlotIndex = GetSlotIndex(PendingSubmission.Fence);
+		const TArrayView<const FStyleTransferRecordingTensorDesc> TensorDescs = Ring.GetTensorDescs();
+		for (int32 i = 0; i < PendingSubmission.Readbacks.Num(); ++i)
+		{
+			const uint64 NumBytes = TensorDescs[i].NumBytes;
+			const void* TensorData = PendingSubmission.Readbacks[i]->Lock(NumBytes);
+			FMemory::Memcpy(Ring.GetTensorData(SlotIndex, i), TensorData, NumBytes);
+			PendingSubmission.Readbacks[i]->Unlock();
+		}
+
+		FStyleTransferInferenceSlotHeader& SlotHeader = Ring.GetSlotHeader(SlotIndex);
+		SlotHeader.FrameNumber = PendingSubmission.FrameNumber;
+		FPlatformAtomics::AtomicStore(&SlotHeader.SubmittedFence, PendingSubmission.Fence);
+
+		PendingSubmissions.RemoveAt(0);
+	}
+}
+
+bool FStyleTransferInferenceWorkerClient::FetchOutput_RenderThread(FRDGBuilder& GraphBuilder, FNeuralTensor& OutputTensor)
+{
+	check(IsInRenderingThread());
+	if (!Ring.IsValid())
+		return false;
+
+	int32 NewestSlotIndex = INDEX_NONE;
+	int64 NewestFence = LastFetchedFence;
+	for (int32 SlotIndex = 0; SlotIndex < static_cast<int32>(Ring.GetHeader().NumSlots); ++SlotIndex)
+	{
+		const FStyleTransferInferenceSlotHeader& SlotHeader = Ring.GetSlotHeader(SlotIndex);
+		const int64 CompletedFence = FPlatformAtomics::AtomicRead(&SlotHeader.CompletedFence);
+		// Tick_RenderThread may have published the slot again, then the worker might be overwriting the output while it is copied.
+		// Only this thread publishes slots, so the output of a slot that is not published again stays intact during the copy below.
+		if (CompletedFence > NewestFence && FPlatformAtomics::AtomicRead(&SlotHeader.SubmittedFence) == CompletedFence)
+		{
+			NewestFence = CompletedFence;
+			NewestSlotIndex = SlotIndex;
+		}
+	}
+
+	if (NewestSlotIndex != INDEX_NONE)
+	{
+		const int32 OutputIndex = Ring.GetHeader().NumTensors - 1;
+		const uint64 NumBytes = Ring.GetTensorDescs()[OutputIndex].NumBytes;
+		check(NumBytes == OutputTensor.NumInBytes());
+
+		// the slot can be reused by the next submission before the upload executes so the data is copied right away
+		OutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		GraphBuilder.QueueBufferUpload(OutputTensor.GetBufferUAVRef()->GetParent(), Ring.GetTensorData(NewestSlotIndex, OutputIndex), NumBytes, ERDGInitialDataFlags::None);
+		LastFetchedFence = NewestFence;
+		bHasOutput = true;
+	}
+	return bHasOutput;
+}
@@ -0,0 +1,136 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "StyleTransferRecording.h"
+
+struct FNeuralTensor;
+class FRHIGPUBufferReadback;
+class FRDGBuilder;
+class UNeuralNetwork;
+
+/**
+ * Shared memory ring through which the packed network inputs of a frame are handed to an inference worker process
+ * (see UStyleTransferWorkerCommandlet) and the network output is handed back.
+ *
+ * Layout:
+ *   FStyleTransferInferenceRingHeader
+ *   FStyleTransferRecordingTensorDesc[Header.NumTensors], the packed network inputs followed by the network output
+ *   Header.NumSlots slots, each consisting of
+ *     FStyleTransferInferenceSlotHeader
+ *     the raw data of every tensor in the order of the descs, each starting at a multiple of StyleTransferRecording::Alignment
+ *
+ * Every submitted frame gets the next fence and fence N always uses slot N % NumSlots.
+ * The client publishes a slot by writing its fence to SubmittedFence after the inputs were written,
+ * the worker publishes the output by setting CompletedFence to SubmittedFence after the output was written.
+ * A slot can only be reused once both fences are equal.
+ */
+namespace StyleTransferInferenceRing
+{
+	constexpr uint32 Magic = 0x52495453; // "STIR"
+	constexpr uint32 Version = 1;
+	constexpr int32 MaxNetworkPathLength = 256;
+}
+
+struct FStyleTransferInferenceRingHeader
+{
+	uint32 Magic = StyleTransferInferenceRing::Magic;
+	uint32 Version = StyleTransferInferenceRing::Version;
+	uint32 NumTensors = 0;
+	uint32 NumSlots = 0;
+	uint64 SlotSize = 0;
+	uint64 TotalSize = 0;
+	uint32 OwnerProcessId = 0;
+	/** Set by the client when it goes away so the worker exits. */
+	volatile int32 bShutdown = 0;
+	/** Incremented by the worker while it polls the ring. */
+	volatile int64 WorkerHeartbeat = 0;
+	/** Object path of the network the worker has to load. */
+	ANSICHAR NetworkPath[StyleTransferInferenceRing::MaxNetworkPathLength] = {};
+};
+
+struct FStyleTransferInferenceSlotHeader
+{
+	volatile int64 SubmittedFence = 0;
+	volatile int64 CompletedFence = 0;
+	uint64 FrameNumber = 0;
+	/** Time the worker spent in UNeuralNetwork::Run for this slot. */
+	float RunMs = 0;
+	uint32 Padding = 0;
+};
+
+static_assert(sizeof(FStyleTransferInferenceRingHeader) % StyleTransferRecording::Alignment == 0, "Ring header must keep the alignment of the tensor data");
+static_assert(sizeof(FStyleTransferInferenceSlotHeader) % StyleTransferRecording::Alignment == 0, "Slot header must keep the alignment of the tensor data");
+
+/**
+ * Maps the shared memory of a ring. Used by the client to create it and by the worker to open it.
+ */
+class STYLETRANSFER_API FStyleTransferInferenceRing
+{
+public:
+	~FStyleTransferInferenceRing();
+
+	/** Creates the shared memory for the given tensors whose last one is the network output. */
+	bool Create(const FString& InName, const FString& NetworkPath, TArrayView<const FNeuralTensor* const> Tensors, int32 NumSlots);
+	/** Maps a ring that was created by another process. */
+	bool Open(const FString& InName);
+
+	bool IsValid() const { return Region != nullptr; }
+	const FString& GetName() const { return Name; }
+
+	FStyleTransferInferenceRingHeader& GetHeader() const { return *reinterpret_cast<FStyleTransferInferenceRingHeader*>(Data); }
+	TArrayView<const FStyleTransferRecordingTensorDesc> GetTensorDescs() const;
+	FStyleTransferInferenceSlotHeader& GetSlotHeader(int32 SlotIndex) const;
+	uint8* GetTensorData(int32 SlotIndex, int32 TensorIndex) const;
+
+private:
+	void Unmap();
+
+	FString Name;
+	FPlatformMemory::FSharedMemoryRegion* Region = nullptr;
+	uint8* Data = nullptr;
+	uint8* FirstSlot = nullptr;
+};
+
+/**
+ * Hands the packed inputs of the stylized frames to an inference worker and uploads its results.
+ * The output lags behind the submitted frames by the readback and the inference latency.
+ * Only used on the render thread after construction.
+ */
+class STYLETRANSFER_API FStyleTransferInferenceWorkerClient
+{
+public:
+	/** Creates the ring for the given inputs and the first output of Network and launches a worker process if r.StyleTransfer.InferenceWorker.Launch is set. */
+	FStyleTransferInferenceWorkerClient(const UNeuralNetwork* Network, TArrayView<const FNeuralTensor* const> InputTensors);
+	~FStyleTransferInferenceWorkerClient();
+
+	bool IsValid() const { return Ring.IsValid(); }
+
+	/** Queues the readback of the inputs which have to be the ones passed to the constructor. The frame is dropped if the worker is still busy with the slot. */
+	void Submit_RenderThread(FRDGBuilder& GraphBuilder, TArrayView<FNeuralTensor* const> InputTensors, uint64 FrameNumber);
+
+	/** Copies the inputs whose readbacks are complete into their slots. */
+	void Tick_RenderThread();
+
+	/** Uploads the newest output the worker completed to OutputTensor. @return false if the worker did not complete any frame yet */
+	bool FetchOutput_RenderThread(FRDGBuilder& GraphBuilder, FNeuralTensor& OutputTensor);
+
+private:
+	struct FPendingSubmission
+	{
+		int64 Fence = 0;
+		uint64 FrameNumber = 0;
+		TArray<TUniquePtr<FRHIGPUBufferReadback>> Readbacks;
+	};
+
+	int32 GetSlotIndex(int64 Fence) const { return static_cast<int32>(Fence % Ring.GetHeader().NumSlots); }
+
+	FStyleTransferInferenceRing Ring;
+	FProcHandle WorkerProcess;
+	TArray<FPendingSubmission> PendingSubmissions;
+	int64 NextFence = 1;
+	int64 LastFetchedFence = 0;
+	bool bHasOutput = false;
+	bool bReportedLostWorker = false;
+};
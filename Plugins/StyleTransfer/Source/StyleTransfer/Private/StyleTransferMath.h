@@ -0,0 +1,20 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** static_cast that ensures the value fits into OutType and clamps it otherwise */
+template <class OutType, class InType>
+OutType CastNarrowingSafe(InType InValue)
+{
+	if (!ensure(InValue <= TNumericLimits<OutType>::Max()))
+	{
+		return TNumericLimits<OutType>::Max();
+	}
+	if (!ensure(InValue >= TNumericLimits<OutType>::Min()))
+	{
+		return TNumericLimits<OutType>::Min();
+	}
+	return static_cast<OutType>(InValue);
+}
@@ -2,16 +2,53 @@
 
 #include "StyleTransferModule.h"
 
+#include "NeuralNetwork.h"
 #include "ShaderCore.h"
+#include "StyleTransferAutotuner.h"
+#include "StyleTransferStats.h"
 #include "Interfaces/IPluginManager.h"
 #include "Logging/LogMacros.h"
 
 DEFINE_LOG_CATEGORY(LogStyleTransfer)
 
+LLM_DEFINE_TAG(StyleTransfer);
+
+DEFINE_STAT(STAT_StyleTransfer_TransferContextMemory);
+DEFINE_STAT(STAT_StyleTransfer_PredictionContextMemory);
+DEFINE_STAT(STAT_StyleTransfer_OutputTextureMemory);
+DEFINE_STAT(STAT_StyleTransfer_TotalMemory);
+DEFINE_STAT(STAT_StyleTransfer_NumResidentStyles);
+
+TAutoConsoleVariable<int32> CVarStyleTransferMemoryBudget(
+	TEXT("r.StyleTransfer.MemoryBudgetMB"),
+	0,
+	TEXT("Maximum memory in MB the inference contexts of the style transfer may use. Styles that do not fit are not made resident and contexts that do not fit are not created. 0 means no budget.")
+);
+
+int64 StyleTransferMemory::GetInferenceContextSize(const UNeuralNetwork* Network)
+{
+	int64 Size = 0;
+	for (int64 i = 0; i < Network->GetInputTensorNumber(); ++i)
+	{
+		Size += Network->GetInputTensor(i).NumInBytes();
+	}
+	for (int64 i = 0; i < Network->GetOutputTensorNumber(); ++i)
+	{
+		Size += Network->GetOutputTensor(i).NumInBytes();
+	}
+	return Size;
+}
+
+int64 StyleTransferMemory::GetBudget()
+{
+	return static_cast<int64>(FMath::Max(CVarStyleTransferMemoryBudget.GetValueOnAnyThread(), 0)) * 1024 * 1024;
+}
+
 #define LOCTEXT_NAMESPACE "FStyleTransferModule"
 
 void FStyleTransferModule::StartupModule()
 {
+	FStyleTransferAutotuner::LoadResults();
 }
 
 void FStyleTransferModule::ShutdownModule()
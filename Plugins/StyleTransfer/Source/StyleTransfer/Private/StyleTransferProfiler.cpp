@@ -0,0 +1,248 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferProfiler.h"
+
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "NeuralNetwork.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RenderingThread.h"
+#include "StyleTransferAutotuner.h"
+#include "ScreenPass.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferSceneViewExtension.h"
+#include "StyleTransferSubsystem.h"
+
+namespace StyleTransferProfiler
+{
+	int32 FindInputTensorIndex(const UNeuralNetwork* Network, const FString& TensorName)
+	{
+		for (uint32 i = 0; i < Network->GetInputTensorNumber(); ++i)
+		{
+			if (Network->GetInputTensor(i).GetName() == TensorName)
+				return i;
+		}
+		return INDEX_NONE;
+	}
+
+	void ProfilePasses_RenderThread(FRHICommandListImmediate& RHICmdList, FPassTimings& Timings, int32 Iterations, const FAddPassesFunction& AddPasses)
+	{
+		TArray<TPair<FRenderQueryRHIRef, FRenderQueryRHIRef>> Queries;
+		for (int32 Iteration = -1; Iteration < Iterations; ++Iteration)
+		{
+			FRenderQueryRHIRef BeginQuery = RHICreateRenderQuery(RQT_AbsoluteTime);
+			FRenderQueryRHIRef EndQuery = RHICreateRenderQuery(RQT_AbsoluteTime);
+
+			RHICmdList.EndRenderQuery(BeginQuery);
+			FRDGBuilder GraphBuilder(RHICmdList);
+			{
+				RDG_EVENT_SCOPE(GraphBuilder, "%s", *Timings.Name);
+				AddPasses(GraphBuilder);
+			}
+			GraphBuilder.Execute();
+			RHICmdList.EndRenderQuery(EndQuery);
+
+			if (Iteration >= 0)
+			{
+				Queries.Emplace(BeginQuery, EndQuery);
+			}
+		}
+
+		RHICmdList.SubmitCommandsAndFlushGPU();
+		RHICmdList.ImmediateFlush(EImmediateFlushType::FlushRHIThread);
+
+		for (const TPair<FRenderQueryRHIRef, FRenderQueryRHIRef>& QueryPair : Queries)
+		{
+			uint64 BeginMicroseconds = 0, EndMicroseconds = 0;
+			const bool bHasResults = RHIGetRenderQueryResult(QueryPair.Key, BeginMicroseconds, true)
+				&& RHIGetRenderQueryResult(QueryPair.Value, EndMicroseconds, true);
+			if (bHasResults && EndMicroseconds >= BeginMicroseconds)
+			{
+				Timings.Milliseconds.Add((EndMicroseconds - BeginMicroseconds) / 1000.0);
+			}
+		}
+	}
+
+	void WriteCsv(TArray<FPassTimings>& AllTimings, FIntPoint SourceSize)
+	{
+		AllTimings.Sort([](const FPassTimings& A, const FPassTimings& B) { return A.GetAverage() > B.GetAverage(); });
+
+		FString Csv = TEXT("Pass,AverageMs,MinMs,MaxMs,Iterations\n");
+		for (const FPassTimings& Timings : AllTimings)
+		{
+			Csv += FString::Printf(TEXT("%s,%.4f,%.4f,%.4f,%i\n"), *Timings.Name, Timings.GetAverage(), Timings.GetMin(), Timings.GetMax(), Timings.Milliseconds.Num());
+			UE_LOG(LogStyleTransfer, Log, TEXT("%-48s %8.4fms (min %8.4fms, max %8.4fms)"), *Timings.Name, Timings.GetAverage(), Timings.GetMin(), Timings.GetMax());
+		}
+
+		const FString CsvPath = FPaths::ProfilingDir() / TEXT("StyleTransfer") / FString::Printf(TEXT("StyleTransferProfile_%ix%i_%s.csv"),
+			SourceSize.X, SourceSize.Y, *FDateTime::Now().ToString());
+		if (FFileHelper::SaveStringToFile(Csv, *CsvPath))
+		{
+			UE_LOG(LogStyleTransfer, Log, TEXT("Wrote style transfer profile to %s"), *CsvPath);
+		}
+		else
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Could not write style transfer profile to %s"), *CsvPath);
+		}
+	}
+
+	void Profile(const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 50;
+		const FIntPoint SourceSize = Args.Num() > 2 ? FIntPoint(FCString::Atoi(*Args[1]), FCString::Atoi(*Args[2])) : FIntPoint(1920, 1080);
+
+		UStyleTransferSubsystem* StyleTransferSubsystem = World && World->GetGameInstance() ? World->GetGameInstance()->GetSubsystem<UStyleTransferSubsystem>() : nullptr;
+		UNeuralNetwork* StyleTransferNetwork = StyleTransferSubsystem ? StyleTransferSubsystem->GetStyleTransferNetwork() : nullptr;
+		UNeuralNetwork* StylePredictionNetwork = StyleTransferSubsystem ? StyleTransferSubsystem->GetStylePredictionNetwork() : nullptr;
+		if (!StyleTransferNetwork || !StyleTransferNetwork->IsLoaded() || !StylePredictionNetwork || !StylePredictionNetwork->IsLoaded())
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Networks are not loaded. Enable r.StyleTransfer.Enabled or warm up the style transfer before profiling."));
+			return;
+		}
+
+		// use separate contexts so the profiling does not change the state of the stylized viewport
+		const int32 StyleTransferInferenceContext = StyleTransferNetwork->CreateInferenceContext();
+		const int32 StylePredictionInferenceContext = StylePredictionNetwork->CreateInferenceContext();
+		checkf(StyleTransferInferenceContext != INDEX_NONE && StylePredictionInferenceContext != INDEX_NONE, TEXT("Could not create inference contexts for profiling"));
+
+		const int32 ContentInputTensorIndex = FindInputTensorIndex(StyleTransferNetwork, TEXT("content"));
+		const int32 StyleWeightsInputTensorIndex = FindInputTensorIndex(StyleTransferNetwork, TEXT("style_weights"));
+		const int32 StyleParamsInputTensorIndex = FindInputTensorIndex(StyleTransferNetwork, TEXT("style_params"));
+
+		UE_LOG(LogStyleTransfer, Log, TEXT("Profiling style transfer with %i iterations at %ix%i"), Iterations, SourceSize.X, SourceSize.Y);
+
+		FlushRenderingCommands();
+		ENQUEUE_RENDER_COMMAND(StyleTransferProfile)([=](FRHICommandListImmediate& RHICmdList)
+		{
+			TRefCountPtr<IPooledRenderTarget> PooledSourceTexture;
+			{
+				FRDGBuilder GraphBuilder(RHICmdList);
+				const FRDGTextureDesc SourceDesc = FRDGTextureDesc::Create2D(SourceSize, PF_FloatRGBA, FClearValueBinding::Black,
+					TexCreate_ShaderResource | TexCreate_RenderTargetable | TexCreate_UAV);
+				FRDGTextureRef SourceTexture = GraphBuilder.CreateTexture(SourceDesc, TEXT("StyleTransferProfileSource"));
+				AddClearRenderTargetPass(GraphBuilder, SourceTexture, FLinearColor(0.5f, 0.5f, 0.5f, 1.f));
+				GraphBuilder.QueueTextureExtraction(SourceTexture, &PooledSourceTexture);
+				GraphBuilder.Execute();
+			}
+
+			FNeuralTensor& ContentTensor = StyleTransferNetwork->GetInputTensorForContextMutable(StyleTransferInferenceContext, ContentInputTensorIndex);
+			FNeuralTensor& StyleParamsTensor = StyleTransferNetwork->GetInputTensorForContextMutable(StyleTransferInferenceContext, StyleParamsInputTensorIndex);
+			FNeuralTensor& OutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(StyleTransferInferenceContext, 0);
+			FNeuralTensor& StyleImageTensor = StylePredictionNetwork->GetInputTensorForContextMutable(StylePredictionInferenceContext, 0);
+			FNeuralTensor& PredictedStyleParamsTensor = StylePredictionNetwork->GetOutputTensorForContextMutable(StylePredictionInferenceContext, 0);
+
+			TArray<FPassTimings> AllTimings;
+			auto Profile = [&](const TCHAR* Name, const FAddPassesFunction& AddPasses)
+			{
+				FPassTimings& Timings = AllTimings.AddDefaulted_GetRef();
+				Timings.Name = Name;
+				ProfilePasses_RenderThread(RHICmdList, Timings, Iterations, AddPasses);
+			};
+
+			Profile(TEXT("TextureToTensorRGB(content)"), [&](FRDGBuilder& GraphBuilder)
+			{
+				ContentTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				FStyleTransferSceneViewExtension::TextureToTensorRGB(GraphBuilder, GraphBuilder.RegisterExternalTexture(PooledSourceTexture), ContentTensor);
+			});
+			if (StyleWeightsInputTensorIndex != INDEX_NONE)
+			{
+				FNeuralTensor& StyleWeightsTensor = StyleTransferNetwork->GetInputTensorForContextMutable(StyleTransferInferenceContext, StyleWeightsInputTensorIndex);
+				Profile(TEXT("TextureToTensorGrayscale(style_weights)"), [&](FRDGBuilder& GraphBuilder)
+				{
+					StyleWeightsTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+					FStyleTransferSceneViewExtension::TextureToTensorGrayscale(GraphBuilder, GraphBuilder.RegisterExternalTexture(PooledSourceTexture), StyleWeightsTensor);
+				});
+			}
+			// NNI does not expose per operator timings, so the network is measured as a single sub-graph.
+			// Use ProfileGPU with the UEOnly back end to see the individual operator passes.
+			Profile(TEXT("StyleTransferNetwork"), [&](FRDGBuilder& GraphBuilder)
+			{
+				StyleTransferNetwork->Run(GraphBuilder, StyleTransferInferenceContext);
+			});
+			Profile(TEXT("TensorToTexture"), [&](FRDGBuilder& GraphBuilder)
+			{
+				FRDGTextureRef SourceTexture = GraphBuilder.RegisterExternalTexture(PooledSourceTexture);
+				OutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				FStyleTransferSceneViewExtension::TensorToTexture(GraphBuilder, SourceTexture->Desc, OutputTensor);
+			});
+			Profile(TEXT("RescalingTextureCopy"), [&](FRDGBuilder& GraphBuilder)
+			{
+				FRDGTextureRef SourceTexture = GraphBuilder.RegisterExternalTexture(PooledSourceTexture);
+				FRDGTextureDesc DestinationDesc = SourceTexture->Desc;
+				DestinationDesc.Extent = {static_cast<int32>(OutputTensor.GetSize(2)), static_cast<int32>(OutputTensor.GetSize(1))};
+				FScreenPassRenderTarget Destination(GraphBuilder.CreateTexture(DestinationDesc, TEXT("StyleTransferProfileDestination")), ERenderTargetLoadAction::ENoAction);
+				FStyleTransferSceneViewExtension::AddRescalingTextureCopy(GraphBuilder, *SourceTexture, Destination);
+			});
+			Profile(TEXT("TextureToTensorRGB(style)"), [&](FRDGBuilder& GraphBuilder)
+			{
+				StyleImageTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				FStyleTransferSceneViewExtension::TextureToTensorRGB(GraphBuilder, GraphBuilder.RegisterExternalTexture(PooledSourceTexture), StyleImageTensor, FIntRect(), INDEX_NONE, true);
+			});
+			Profile(TEXT("StylePredictionNetwork"), [&](FRDGBuilder& GraphBuilder)
+			{
+				StylePredictionNetwork->Run(GraphBuilder, StylePredictionInferenceContext);
+			});
+			Profile(TEXT("InterpolateTensors"), [&](FRDGBuilder& GraphBuilder)
+			{
+				StyleParamsTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				FStyleTransferSceneViewExtension::InterpolateTensors(GraphBuilder, StyleParamsTensor, PredictedStyleParamsTensor, PredictedStyleParamsTensor, 0.5f);
+			});
+
+			WriteCsv(AllTimings, SourceSize);
+		});
+		FlushRenderingCommands();
+
+		StyleTransferNetwork->DestroyInferenceContext(StyleTransferInferenceContext);
+		StylePredictionNetwork->DestroyInferenceContext(StylePredictionInferenceContext);
+	}
+
+	void Autotune(const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 Iterations = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 20;
+
+		UStyleTransferSubsystem* StyleTransferSubsystem = World && World->GetGameInstance() ? World->GetGameInstance()->GetSubsystem<UStyleTransferSubsystem>() : nullptr;
+		UNeuralNetwork* StyleTransferNetwork = StyleTransferSubsystem ? StyleTransferSubsystem->GetStyleTransferNetwork() : nullptr;
+		UNeuralNetwork* StylePredictionNetwork = StyleTransferSubsystem ? StyleTransferSubsystem->GetStylePredictionNetwork() : nullptr;
+		if (!StyleTransferNetwork || !StyleTransferNetwork->IsLoaded() || !StylePredictionNetwork || !StylePredictionNetwork->IsLoaded())
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Networks are not loaded. Enable r.StyleTransfer.Enabled or warm up the style transfer before autotuning."));
+			return;
+		}
+
+		const int32 StyleTransferInferenceContext = StyleTransferNetwork->CreateInferenceContext();
+		const int32 StylePredictionInferenceContext = StylePredictionNetwork->CreateInferenceContext();
+		checkf(StyleTransferInferenceContext != INDEX_NONE && StylePredictionInferenceContext != INDEX_NONE, TEXT("Could not create inference contexts for autotuning"));
+
+		FlushRenderingCommands();
+		ENQUEUE_RENDER_COMMAND(StyleTransferAutotune)([=](FRHICommandListImmediate& RHICmdList)
+		{
+			FStyleTransferAutotuner::Autotune_RenderThread(RHICmdList, Iterations, true,
+			                                               StyleTransferNetwork, StyleTransferInferenceContext,
+			                                               StylePredictionNetwork, StylePredictionInferenceContext);
+		});
+		FlushRenderingCommands();
+
+		StyleTransferNetwork->DestroyInferenceContext(StyleTransferInferenceContext);
+		StylePredictionNetwork->DestroyInferenceContext(StylePredictionInferenceContext);
+		FStyleTransferAutotuner::SaveResults();
+	}
+}
+
+FAutoConsoleCommandWithWorldAndArgs StyleTransferProfileCommand(
+	TEXT("r.StyleTransfer.Profile"),
+	TEXT("Profiles all style transfer passes and networks and writes the timings sorted by cost to a csv in the profiling directory.\n")
+	TEXT("Usage: r.StyleTransfer.Profile [Iterations=50] [Width=1920 Height=1080]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StyleTransferProfiler::Profile)
+);
+
+FAutoConsoleCommandWithWorldAndArgs StyleTransferAutotuneCommand(
+	TEXT("r.StyleTransfer.Autotune"),
+	TEXT("Measures all thread group sizes of the style transfer kernels again and stores the fastest ones for this GPU.\n")
+	TEXT("Usage: r.StyleTransfer.Autotune [Iterations=20]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StyleTransferProfiler::Autotune)
+);
@@ -0,0 +1,38 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FRDGBuilder;
+class FRHICommandListImmediate;
+class UNeuralNetwork;
+
+namespace StyleTransferProfiler
+{
+	struct FPassTimings
+	{
+		FString Name;
+		TArray<double> Milliseconds;
+
+		double GetAverage() const
+		{
+			double Sum = 0;
+			for (const double Value : Milliseconds) Sum += Value;
+			return Milliseconds.Num() ? Sum / Milliseconds.Num() : 0;
+		}
+
+		double GetMin() const { return Milliseconds.Num() ? FMath::Min(Milliseconds) : 0; }
+		double GetMax() const { return Milliseconds.Num() ? FMath::Max(Milliseconds) : 0; }
+	};
+
+	using FAddPassesFunction = TFunction<void(FRDGBuilder&)>;
+
+	int32 FindInputTensorIndex(const UNeuralNetwork* Network, const FString& TensorName);
+
+	/**
+	 * Runs the passes in their own graph for the given number of iterations and records GPU timestamps around each graph.
+	 * One additional iteration runs first and is not recorded so resource allocation and PSO creation do not distort the results.
+	 */
+	void ProfilePasses_RenderThread(FRHICommandListImmediate& RHICmdList, FPassTimings& Timings, int32 Iterations, const FAddPassesFunction& AddPasses);
+}
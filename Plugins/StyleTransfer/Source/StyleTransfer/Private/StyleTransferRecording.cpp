@@ -0,0 +1,213 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferRecording.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "NeuralNetwork.h"
+#include "NeuralTensor.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferSettings.h"
+
+FStyleTransferRecorder::FStyleTransferRecorder(const FString& InFilePath, int32 InNumFramesToRecord, TArrayView<const FNeuralTensor* const> Tensors)
+	: FilePath(InFilePath)
+	, FileWriter(IFileManager::Get().CreateFileWriter(*InFilePath))
+	, NumFramesToRecord(InNumFramesToRecord)
+{
+	if (!FileWriter)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not open %s for recording"), *FilePath);
+		return;
+	}
+
+	uint32 FrameOffset = sizeof(FStyleTransferRecordingFrameHeader);
+	for (const FNeuralTensor* Tensor : Tensors)
+	{
+		FStyleTransferRecordingTensorDesc& TensorDesc = TensorDescs.AddDefaulted_GetRef();
+		FCStringAnsi::Strncpy(TensorDesc.Name, TCHAR_TO_ANSI(*Tensor->GetName()), StyleTransferRecording::MaxTensorNameLength);
+		const TArray<int64>& Sizes = Tensor->GetSizes();
+		checkf(Sizes.Num() <= StyleTransferRecording::MaxTensorDimensions, TEXT("Tensor %s has too many dimensions to be recorded"), *Tensor->GetName());
+		TensorDesc.NumDimensions = Sizes.Num();
+		FMemory::Memcpy(TensorDesc.Sizes, Sizes.GetData(), Sizes.Num() * Sizes.GetTypeSize());
+		TensorDesc.NumBytes = Tensor->NumInBytes();
+		TensorDesc.FrameOffset = FrameOffset;
+		FrameOffset = Align(FrameOffset + TensorDesc.NumBytes, StyleTransferRecording::Alignment);
+	}
+
+	Header.NumTensors = TensorDescs.Num();
+	Header.FrameSize = FrameOffset;
+	FileWriter->Serialize(&Header, sizeof(Header));
+	FileWriter->Serialize(TensorDescs.GetData(), TensorDescs.Num() * TensorDescs.GetTypeSize());
+	FrameBuffer.SetNumZeroed(Header.FrameSize);
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Recording %i frames of %u bytes to %s"), NumFramesToRecord, Header.FrameSize, *FilePath);
+}
+
+FStyleTransferRecorder::~FStyleTransferRecorder()
+{
+	if (FileWriter)
+	{
+		FileWriter->Close();
+		UE_LOG(LogStyleTransfer, Log, TEXT("Recorded %i frames to %s"), NumFramesWritten, *FilePath);
+	}
+}
+
+void FStyleTransferRecorder::AddFrame_RenderThread(FRDGBuilder& GraphBuilder, TArrayView<FNeuralTensor* const> Tensors, const FStyleTransferRecordingFrameHeader& FrameHeader)
+{
+	check(IsInRenderingThread());
+	check(Tensors.Num() == TensorDescs.Num());
+	if (!NeedsMoreFrames())
+		return;
+	for (int32 i = 0; i < Tensors.Num(); ++i)
+	{
+		if (Tensors[i]->NumInBytes() != TensorDescs[i].NumBytes)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Tensor %s changed its size during the recording, frame is not recorded"), *Tensors[i]->GetName());
+			return;
+		}
+	}
+
+	FPendingFrame& PendingFrame = PendingFrames.AddDefaulted_GetRef();
+	PendingFrame.Header = FrameHeader;
+	PendingFrame.Header.FrameIndex = NumFramesQueued++;
+	for (int32 i = 0; i < Tensors.Num(); ++i)
+	{
+		TUniquePtr<FRHIGPUBufferReadback>& Readback = PendingFrame.Readbacks.Emplace_GetRef(MakeUnique<FRHIGPUBufferReadback>(TEXT("StyleTransferRecordingReadback")));
+		AddEnqueueCopyPass(GraphBuilder, Readback.Get(), Tensors[i]->GetBufferSRVRef()->GetParent(), TensorDescs[i].NumBytes);
+	}
+}
+
+void FStyleTransferRecorder::Tick_RenderThread()
+{
+	check(IsInRenderingThread());
+
+	// frames have to be written in order so only the oldest pending frames are checked
+	while (PendingFrames.Num() && FileWriter)
+	{
+		FPendingFrame& PendingFrame = PendingFrames[0];
+		for (const TUniquePtr<FRHIGPUBufferReadback>& Readback : PendingFrame.Readbacks)
+		{
+			if (!Readback->IsReady())
+				return;
+		}
+
+		FMemory::Memcpy(FrameBuffer.GetData(), &PendingFrame.Header, sizeof(PendingFrame.Header));
+		for (int32 i = 0; i < TensorDescs.Num(); ++i)
+		{
+			const uint32 NumBytes = TensorDescs[i].NumBytes;
+			const void* TensorData = PendingFrame.Readbacks[i]->Lock(NumBytes);
+			FMemory::Memcpy(FrameBuffer.GetData() + TensorDescs[i].FrameOffset, TensorData, NumBytes);
+			PendingFrame.Readbacks[i]->Unlock();
+		}
+		FileWriter->Serialize(FrameBuffer.GetData(), FrameBuffer.Num());
+		++NumFramesWritten;
+
+		PendingFrames.RemoveAt(0);
+	}
+}
+
+bool FStyleTransferRecordingReader::Open(const FString& FilePath)
+{
+	MappedFileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+	if (!MappedFileHandle)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not map recording %s"), *FilePath);
+		return false;
+	}
+
+	const int64 FileSize = MappedFileHandle->GetFileSize();
+	MappedFileRegion.Reset(MappedFileHandle->MapRegion(0, FileSize));
+	if (!MappedFileRegion || FileSize < static_cast<int64>(sizeof(FStyleTransferRecordingHeader)))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not map recording %s"), *FilePath);
+		return false;
+	}
+
+	const uint8* Data = MappedFileRegion->GetMappedPtr();
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+	if (Header.Magic != StyleTransferRecording::FileMagic || Header.Version != StyleTransferRecording::Version)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("%s is not a style transfer recording of version %u"), *FilePath, StyleTransferRecording::Version);
+		return false;
+	}
+
+	const int64 DescsSize = Header.NumTensors * sizeof(FStyleTransferRecordingTensorDesc);
+	if (FileSize < static_cast<int64>(sizeof(Header)) + DescsSize || Header.FrameSize == 0)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Recording %s is truncated"), *FilePath);
+		return false;
+	}
+
+	TensorDescs.SetNumUninitialized(Header.NumTensors);
+	FMemory::Memcpy(TensorDescs.GetData(), Data + sizeof(Header), DescsSize);
+	for (const FStyleTransferRecordingTensorDesc& TensorDesc : TensorDescs)
+	{
+		if (TensorDesc.FrameOffset < sizeof(FStyleTransferRecordingFrameHeader) || TensorDesc.FrameOffset + TensorDesc.NumBytes > Header.FrameSize)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Tensor %s of recording %s lies outside of its frame"), *TensorDesc.GetName(), *FilePath);
+			return false;
+		}
+	}
+
+	FirstFrame = Data + sizeof(Header) + DescsSize;
+	// a recording that was interrupted may end in a partially written frame which is ignored
+	NumFrames = static_cast<int32>((FileSize - sizeof(Header) - DescsSize) / Header.FrameSize);
+	return true;
+}
+
+const FStyleTransferRecordingFrameHeader& FStyleTransferRecordingReader::GetFrameHeader(int32 FrameIndex) const
+{
+	check(FrameIndex >= 0 && FrameIndex < NumFrames);
+	return *reinterpret_cast<const FStyleTransferRecordingFrameHeader*>(FirstFrame + static_cast<int64>(FrameIndex) * Header.FrameSize);
+}
+
+bool FStyleTransferRecordingReader::IsFrameValid(int32 FrameIndex) const
+{
+	return GetFrameHeader(FrameIndex).Magic == StyleTransferRecording::FrameMagic;
+}
+
+const uint8* FStyleTransferRecordingReader::GetTensorData(int32 FrameIndex, int32 TensorIndex) const
+{
+	if (!IsFrameValid(FrameIndex))
+		return nullptr;
+	return FirstFrame + static_cast<int64>(FrameIndex) * Header.FrameSize + TensorDescs[TensorIndex].FrameOffset;
+}
+
+UNeuralNetwork* StyleTransferRecording::LoadNetworkForCpu(const FString& NetworkPath)
+{
+	UNeuralNetwork* Network = NetworkPath.IsEmpty()
+		                          ? GetDefault<UStyleTransferSettings>()->StyleTransferNetwork.LoadSynchronous()
+		                          : LoadObject<UNeuralNetwork>(nullptr, *NetworkPath);
+	if (!Network || !Network->IsLoaded())
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Network %s could not be loaded"), NetworkPath.IsEmpty() ? TEXT("StyleTransferNetwork") : *NetworkPath);
+		return nullptr;
+	}
+	Network->SetDeviceType(ENeuralDeviceType::CPU, ENeuralDeviceType::CPU, ENeuralDeviceType::CPU);
+	return Network;
+}
+
+bool StyleTransferRecording::FindInputTensorIndices(const UNeuralNetwork* Network, TArrayView<const FStyleTransferRecordingTensorDesc> TensorDescs, TArray<int32>& OutInputTensorIndices)
+{
+	OutInputTensorIndices.Reset(TensorDescs.Num());
+	for (const FStyleTransferRecordingTensorDesc& TensorDesc : TensorDescs)
+	{
+		int32& InputTensorIndex = OutInputTensorIndices.Add_GetRef(INDEX_NONE);
+		for (uint32 i = 0; i < Network->GetInputTensorNumber(); ++i)
+		{
+			if (Network->GetInputTensor(i).GetName() == TensorDesc.GetName())
+			{
+				InputTensorIndex = i;
+				break;
+			}
+		}
+		if (InputTensorIndex == INDEX_NONE || Network->GetInputTensor(InputTensorIndex).NumInBytes() != TensorDesc.NumBytes)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Tensor %s does not match any input of %s"), *TensorDesc.GetName(), *Network->GetName());
+			return false;
+		}
+	}
+	return true;
+}
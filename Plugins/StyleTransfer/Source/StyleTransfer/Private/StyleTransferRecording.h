@@ -0,0 +1,141 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/MappedFileHandle.h"
+
+struct FNeuralTensor;
+class FRHIGPUBufferReadback;
+class FRDGBuilder;
+class UNeuralNetwork;
+
+/**
+ * Streaming file of the packed network inputs of consecutive frames.
+ *
+ * Layout:
+ *   FStyleTransferRecordingHeader
+ *   FStyleTransferRecordingTensorDesc[Header.NumTensors]
+ *   Frames, each consisting of
+ *     FStyleTransferRecordingFrameHeader
+ *     the raw data of every tensor in the order of the descs, each starting at a multiple of StyleTransferRecording::Alignment
+ *
+ * Every frame has the same size so a memory mapped reader can seek to any frame directly.
+ */
+namespace StyleTransferRecording
+{
+	constexpr uint32 FileMagic = 0x43525453; // "STRC"
+	constexpr uint32 FrameMagic = 0x52465453; // "STFR"
+	constexpr uint32 Version = 1;
+	constexpr uint32 Alignment = 16;
+	constexpr int32 MaxTensorNameLength = 32;
+	constexpr int32 MaxTensorDimensions = 6;
+}
+
+struct FStyleTransferRecordingHeader
+{
+	uint32 Magic = StyleTransferRecording::FileMagic;
+	uint32 Version = StyleTransferRecording::Version;
+	uint32 NumTensors = 0;
+	uint32 FrameSize = 0;
+};
+
+struct FStyleTransferRecordingTensorDesc
+{
+	ANSICHAR Name[StyleTransferRecording::MaxTensorNameLength] = {};
+	int64 Sizes[StyleTransferRecording::MaxTensorDimensions] = {};
+	uint32 NumDimensions = 0;
+	/** Offset of the tensor data relative to the start of its frame header. */
+	uint32 FrameOffset = 0;
+	uint64 NumBytes = 0;
+
+	FString GetName() const { return FString(ANSI_TO_TCHAR(Name)); }
+};
+
+struct FStyleTransferRecordingFrameHeader
+{
+	uint32 Magic = StyleTransferRecording::FrameMagic;
+	uint32 FrameIndex = 0;
+	uint64 FrameNumber = 0;
+	double TimeSeconds = 0;
+	FIntRect ViewRect;
+	FIntPoint SceneColorExtent;
+	uint32 Padding[4] = {};
+};
+
+static_assert(sizeof(FStyleTransferRecordingHeader) % StyleTransferRecording::Alignment == 0, "Recording header must keep the alignment of the tensor data");
+static_assert(sizeof(FStyleTransferRecordingTensorDesc) % StyleTransferRecording::Alignment == 0, "Recording tensor desc must keep the alignment of the tensor data");
+static_assert(sizeof(FStyleTransferRecordingFrameHeader) % StyleTransferRecording::Alignment == 0, "Recording frame header must keep the alignment of the tensor data");
+
+/**
+ * Reads the network input tensors of the frames in flight back from the GPU and appends them to a recording file.
+ * Only used on the render thread.
+ */
+class STYLETRANSFER_API FStyleTransferRecorder
+{
+public:
+	FStyleTransferRecorder(const FString& InFilePath, int32 InNumFramesToRecord, TArrayView<const FNeuralTensor* const> Tensors);
+	~FStyleTransferRecorder();
+
+	/** Queues the readback of the tensors which have to be the same, in the same order, as the ones passed to the constructor. */
+	void AddFrame_RenderThread(FRDGBuilder& GraphBuilder, TArrayView<FNeuralTensor* const> Tensors, const FStyleTransferRecordingFrameHeader& FrameHeader);
+
+	/** Writes all frames whose readbacks are complete. */
+	void Tick_RenderThread();
+
+	bool IsDone() const { return NumFramesWritten >= NumFramesToRecord || !FileWriter; }
+	bool NeedsMoreFrames() const { return NumFramesQueued < NumFramesToRecord && FileWriter; }
+
+private:
+	struct FPendingFrame
+	{
+		FStyleTransferRecordingFrameHeader Header;
+		TArray<TUniquePtr<FRHIGPUBufferReadback>> Readbacks;
+	};
+
+	FString FilePath;
+	TUniquePtr<FArchive> FileWriter;
+	FStyleTransferRecordingHeader Header;
+	TArray<FStyleTransferRecordingTensorDesc> TensorDescs;
+	TArray<FPendingFrame> PendingFrames;
+	TArray<uint8> FrameBuffer;
+	int32 NumFramesToRecord = 0;
+	int32 NumFramesQueued = 0;
+	int32 NumFramesWritten = 0;
+};
+
+/**
+ * Memory maps a recording so the tensor data of every frame can be used without copying it.
+ */
+class STYLETRANSFER_API FStyleTransferRecordingReader
+{
+public:
+	bool Open(const FString& FilePath);
+
+	int32 GetNumFrames() const { return NumFrames; }
+	const TArray<FStyleTransferRecordingTensorDesc>& GetTensorDescs() const { return TensorDescs; }
+
+	const FStyleTransferRecordingFrameHeader& GetFrameHeader(int32 FrameIndex) const;
+	/** False if the frame does not start with the frame magic, e.g. because the file was written to while it was mapped. */
+	bool IsFrameValid(int32 FrameIndex) const;
+	/** nullptr if the frame is not valid. */
+	const uint8* GetTensorData(int32 FrameIndex, int32 TensorIndex) const;
+
+private:
+	TUniquePtr<IMappedFileHandle> MappedFileHandle;
+	TUniquePtr<IMappedFileRegion> MappedFileRegion;
+	FStyleTransferRecordingHeader Header;
+	TArray<FStyleTransferRecordingTensorDesc> TensorDescs;
+	const uint8* FirstFrame = nullptr;
+	int32 NumFrames = 0;
+};
+
+/** Shared by the commandlets that run recorded tensors on the CPU */
+namespace StyleTransferRecording
+{
+	/** Loads the network at NetworkPath or the StyleTransferNetwork of the settings if it is empty and makes it run on the CPU. Logs why it returns nullptr. */
+	UNeuralNetwork* LoadNetworkForCpu(const FString& NetworkPath);
+
+	/** Finds the input of Network with the name and size of every desc. Logs which desc does not match and returns false then. */
+	bool FindInputTensorIndices(const UNeuralNetwork* Network, TArrayView<const FStyleTransferRecordingTensorDesc> TensorDescs, TArray<int32>& OutInputTensorIndices);
+}
@@ -0,0 +1,102 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferReplayCommandlet.h"
+
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "NeuralNetwork.h"
+#include "StyleTransferCpuExecutor.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferRecording.h"
+
+UStyleTransferReplayCommandlet::UStyleTransferReplayCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UStyleTransferReplayCommandlet::Main(const FString& Params)
+{
+	FString RecordingPath;
+	if (!FParse::Value(*Params, TEXT("Recording="), RecordingPath))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Usage: -run=StyleTransferReplay -Recording=<path> [-Network=<object path>] [-Iterations=1] [-Csv=<path>]"));
+		return 1;
+	}
+	FString NetworkPath;
+	FParse::Value(*Params, TEXT("Network="), NetworkPath);
+	int32 Iterations = 1;
+	FParse::Value(*Params, TEXT("Iterations="), Iterations);
+	Iterations = FMath::Max(Iterations, 1);
+	FString CsvPath;
+	FParse::Value(*Params, TEXT("Csv="), CsvPath);
+
+	FStyleTransferRecordingReader Reader;
+	if (!Reader.Open(RecordingPath))
+		return 1;
+
+	UNeuralNetwork* StyleTransferNetwork = StyleTransferRecording::LoadNetworkForCpu(NetworkPath);
+	if (!StyleTransferNetwork)
+		return 1;
+
+	const TArray<FStyleTransferRecordingTensorDesc>& TensorDescs = Reader.GetTensorDescs();
+	TArray<int32> InputTensorIndices;
+	if (!StyleTransferRecording::FindInputTensorIndices(StyleTransferNetwork, TensorDescs, InputTensorIndices))
+		return 1;
+
+	UE_LOG(LogStyleTransfer, Display, TEXT("Replaying %i frames of %s with %i iterations each"), Reader.GetNumFrames(), *RecordingPath, Iterations);
+
+	FString Csv = TEXT("Frame,FrameNumber,RunMs,ConversionMs,OutputCrc,ImageCrc\n");
+	TArray<double> RunTimes;
+	TArray<FLinearColor> Image;
+	for (int32 FrameIndex = 0; FrameIndex < Reader.GetNumFrames(); ++FrameIndex)
+	{
+		if (!Reader.IsFrameValid(FrameIndex))
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Frame %i of %s is corrupt and skipped"), FrameIndex, *RecordingPath);
+			continue;
+		}
+		const FStyleTransferRecordingFrameHeader& FrameHeader = Reader.GetFrameHeader(FrameIndex);
+		for (int32 TensorIndex = 0; TensorIndex < TensorDescs.Num(); ++TensorIndex)
+		{
+			StyleTransferNetwork->SetInputFromVoidPointerCopy(Reader.GetTensorData(FrameIndex, TensorIndex), InputTensorIndices[TensorIndex]);
+		}
+
+		const double RunStartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			StyleTransferNetwork->Run();
+		}
+		const double RunMs = (FPlatformTime::Seconds() - RunStartTime) * 1000. / Iterations;
+		RunTimes.Add(RunMs);
+
+		const FNeuralTensor& OutputTensor = StyleTransferNetwork->GetOutputTensor(0);
+		const TArray<float> OutputData = OutputTensor.GetArrayCopy<float>();
+		const double ConversionStartTime = FPlatformTime::Seconds();
+		StyleTransferCpu::TensorToImage(OutputData, {static_cast<int32>(OutputTensor.GetSize(2)), static_cast<int32>(OutputTensor.GetSize(1))}, Image);
+		const double ConversionMs = (FPlatformTime::Seconds() - ConversionStartTime) * 1000.;
+
+		const uint32 OutputCrc = FCrc::MemCrc32(OutputData.GetData(), OutputData.Num() * OutputData.GetTypeSize());
+		const uint32 ImageCrc = FCrc::MemCrc32(Image.GetData(), Image.Num() * Image.GetTypeSize());
+		UE_LOG(LogStyleTransfer, Display, TEXT("Frame %4i (%llu): run %8.3fms, conversion %8.3fms, output crc %08x, image crc %08x"),
+			FrameIndex, FrameHeader.FrameNumber, RunMs, ConversionMs, OutputCrc, ImageCrc);
+		Csv += FString::Printf(TEXT("%i,%llu,%.4f,%.4f,%08x,%08x\n"), FrameIndex, FrameHeader.FrameNumber, RunMs, ConversionMs, OutputCrc, ImageCrc);
+	}
+
+	if (RunTimes.Num())
+	{
+		double RunTimeSum = 0;
+		for (const double RunTime : RunTimes) RunTimeSum += RunTime;
+		UE_LOG(LogStyleTransfer, Display, TEXT("Run time average %.3fms, min %.3fms, max %.3fms"), RunTimeSum / RunTimes.Num(), FMath::Min(RunTimes), FMath::Max(RunTimes));
+	}
+
+	if (!CsvPath.IsEmpty() && !FFileHelper::SaveStringToFile(Csv, *CsvPath))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not write %s"), *CsvPath);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,25 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StyleTransferReplayCommandlet.generated.h"
+
+/**
+ * Feeds a recording made with r.StyleTransfer.Record through the style transfer network on the CPU and reports timings and output checksums.
+ *
+ * Usage: -run=StyleTransferReplay -Recording=<path> [-Network=<object path>] [-Iterations=1] [-Csv=<path>]
+ */
+UCLASS()
+class UStyleTransferReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStyleTransferReplayCommandlet();
+
+	// - UCommandlet
+	virtual int32 Main(const FString& Params) override;
+	// --
+};
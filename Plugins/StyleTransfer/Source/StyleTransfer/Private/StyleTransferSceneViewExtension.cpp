@@ -12,9 +12,9 @@
 #include "SceneView.h"
 #include "ScreenPass.h"
 #include "CommonRenderResources.h"
+#include "FoveatedCompositeCS.h"
+#include "GatherTensorCS.h"
 #include "InterpolateTensorsCS.h"
-#include "IPixWinPlugin.h"
-#include "IPixWinPlugin.h"
 #include "IRenderCaptureProvider.h"
 #include "NeuralNetwork.h"
 #include "RenderGraphEvent.h"
@@ -22,12 +22,27 @@
 #include "Containers/DynamicRHIResourceArray.h"
 #include "PostProcess/PostProcessMaterial.h"
 #include "OutputTensorToSceneColorCS.h"
+#include "OutputTensorToTargetCS.h"
 #include "PixelShaderUtils.h"
+#include "QuantizeTensorCS.h"
 #include "RendererUtils.h"
 #include "SceneColorToInputTensorCS.h"
 #include "ShadowMaskToInputTensorCS.h"
+#include "StyleTransferAutotuner.h"
+#include "StyleTransferBatchRenderer.h"
+#include "StyleTransferBlendable.h"
+#include "StyleTransferContentShapeCache.h"
+#include "StyleTransferCpuExecutor.h"
+#include "StyleTransferInferenceWorker.h"
+#include "StyleTransferMath.h"
 #include "StyleTransferModule.h"
+#include "StyleTransferRecording.h"
+#include "StyleTransferSettings.h"
+#include "StyleTransferStats.h"
+#include "StyleTransferStyleWeights.h"
 #include "StyleTransferSubsystem.h"
+#include "StyleWeightsMaskCS.h"
+#include "SystemTextures.h"
 
 TAutoConsoleVariable<bool> CVarAutoCaptureStyleTransfer(
 	TEXT("r.StyleTransfer.AutoCaptureTransfer"),
@@ -35,20 +50,43 @@ TAutoConsoleVariable<bool> CVarAutoCaptureStyleTransfer(
 	TEXT("Set to true to automatically capture the style transfer when it is done")
 );
 
-template <class OutType, class InType>
-OutType CastNarrowingSafe(InType InValue)
-{
-	if (!ensure(InValue <= TNumericLimits<OutType>::Max()))
-	{
-		return TNumericLimits<OutType>::Max();
-	}
-	if (!ensure(InValue >= TNumericLimits<OutType>::Min()))
-	{
-		return TNumericLimits<OutType>::Min();
-	}
-	return static_cast<OutType>(InValue);
-}
+TAutoConsoleVariable<int32> CVarSceneCaptureMaxInferencesPerFrame(
+	TEXT("r.StyleTransfer.SceneCapture.MaxInferencesPerFrame"),
+	1,
+	TEXT("Maximum number of stylized scene captures that run the network in one frame. The others reuse their previous output until it is their turn")
+);
+
+TAutoConsoleVariable<bool> CVarDirectOutput(
+	TEXT("r.StyleTransfer.DirectOutput"),
+	true,
+	TEXT("Set to true to unpack the network output straight into the output of the post process pass in one compute pass. ")
+	TEXT("Falls back to unpacking it into an intermediate texture and copying that if the output can not be written by compute shaders")
+);
+
+TAutoConsoleVariable<bool> CVarFoveated(
+	TEXT("r.StyleTransfer.Foveated"),
+	false,
+	TEXT("Set to true to stylize an inset at full resolution around the focus point and the downsampled view instead of the whole view at full resolution. ")
+	TEXT("Only has an effect with a dynamic content shape and if the network runs in process on the GPU, both parts get contexts of their own size")
+);
+
+TAutoConsoleVariable<float> CVarFoveatedInsetScale(
+	TEXT("r.StyleTransfer.Foveated.InsetScale"),
+	0.35f,
+	TEXT("Size of the full resolution inset of r.StyleTransfer.Foveated relative to the view")
+);
+
+TAutoConsoleVariable<float> CVarFoveatedPeripheryScale(
+	TEXT("r.StyleTransfer.Foveated.PeripheryScale"),
+	0.25f,
+	TEXT("Resolution at which r.StyleTransfer.Foveated stylizes the whole view relative to the view. The result is upsampled")
+);
 
+TAutoConsoleVariable<float> CVarFoveatedBlendStart(
+	TEXT("r.StyleTransfer.Foveated.BlendStart"),
+	0.5f,
+	TEXT("Distance from the focus point relative to the inset radius at which the inset starts to blend into the periphery")
+);
 
 FStyleTransferSceneViewExtension::FStyleTransferSceneViewExtension(const FAutoRegister& AutoRegister, UWorld* World, FViewportClient* AssociatedViewportClient, UNeuralNetwork* InStyleTransferNetwork, TSharedRef<int32> InInferenceContext)
 	: FWorldSceneViewExtension(AutoRegister, World)
@@ -56,12 +94,18 @@ FStyleTransferSceneViewExtension::FStyleTransferSceneViewExtension(const FAutoRe
 	  , StyleTransferNetwork(InStyleTransferNetwork)
 	  , LinkedViewportClient(AssociatedViewportClient)
 	  , InferenceContext(InInferenceContext)
+	  , InferenceContext_GameThread(InInferenceContext)
+	  , StyleWeights(MakeUnique<FStyleTransferStyleWeights>())
 {
-	ensure(InStyleTransferNetwork->GetDeviceType() == ENeuralDeviceType::GPU);
+	FindInputTensorIndices();
+}
 
-	for (uint32 i = 0; i < InStyleTransferNetwork->GetInputTensorNumber(); i++)
+void FStyleTransferSceneViewExtension::FindInputTensorIndices()
+{
+	ContentInputTensorIndex = StyleWeightsInputTensorIndex = StyleParamsInputTensorIndex = INDEX_NONE;
+	for (uint32 i = 0; i < StyleTransferNetwork->GetInputTensorNumber(); i++)
 	{
-		const FString& TensorName = InStyleTransferNetwork->GetInputTensor(i).GetName();
+		const FString& TensorName = StyleTransferNetwork->GetInputTensor(i).GetName();
 		if (TensorName == "content") ContentInputTensorIndex = i;
 		else if (TensorName == "style_weights") StyleWeightsInputTensorIndex = i;
 		else if (TensorName == "style_params") StyleParamsInputTensorIndex = i;
@@ -70,16 +114,306 @@ FStyleTransferSceneViewExtension::FStyleTransferSceneViewExtension(const FAutoRe
 	check(StyleParamsInputTensorIndex != INDEX_NONE);
 }
 
+void FStyleTransferSceneViewExtension::SetStyleTransferNetwork(UNeuralNetwork* InStyleTransferNetwork, TSharedRef<int32> InInferenceContext)
+{
+	check(IsInGameThread());
+	StyleTransferNetworkWeakPtr = InStyleTransferNetwork;
+	InferenceContext_GameThread = InInferenceContext;
+	// the worker runs a copy of the network so it has to be restarted with the new one
+	TUniquePtr<FStyleTransferInferenceWorkerClient> NewInferenceWorker = bUseInferenceWorker ? CreateInferenceWorker(InStyleTransferNetwork) : nullptr;
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetNetwork)([this, InStyleTransferNetwork, InInferenceContext, NewInferenceWorker = MoveTemp(NewInferenceWorker)](FRHICommandListImmediate&) mutable
+	{
+		StyleTransferNetwork = InStyleTransferNetwork;
+		InferenceWorker = MoveTemp(NewInferenceWorker);
+		InferenceContext = InInferenceContext;
+		// belongs to the previous network, the next frame picks one of the new network
+		ContentInferenceContext = INDEX_NONE;
+		FoveatedInsetContext = INDEX_NONE;
+		FoveatedPeripheryContext = INDEX_NONE;
+		StyleWeightsTarget = nullptr;
+		// their contexts belong to the previous network, the subsystem adds them again
+		SceneCaptures.Reset();
+		SceneCaptureStyleParamsBuffer.SafeRelease();
+		FindInputTensorIndices();
+		if (Recorder)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Recording stopped because the style transfer network changed"));
+			Recorder.Reset();
+		}
+	});
+}
+
+FStyleTransferSceneViewExtension::~FStyleTransferSceneViewExtension() = default;
+
+TArray<FNeuralTensor*, TInlineAllocator<3>> FStyleTransferSceneViewExtension::GetPackedInputTensors_RenderThread(int32 Context) const
+{
+	TArray<FNeuralTensor*, TInlineAllocator<3>> Tensors;
+	Tensors.Add(&StyleTransferNetwork->GetInputTensorForContextMutable(Context, ContentInputTensorIndex));
+	if (StyleWeightsInputTensorIndex != INDEX_NONE)
+	{
+		Tensors.Add(&StyleTransferNetwork->GetInputTensorForContextMutable(Context, StyleWeightsInputTensorIndex));
+	}
+	Tensors.Add(&StyleTransferNetwork->GetInputTensorForContextMutable(Context, StyleParamsInputTensorIndex));
+	return Tensors;
+}
+
+void FStyleTransferSceneViewExtension::StartRecording(const FString& FilePath, int32 NumFrames)
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(StyleTransferStartRecording)([this, FilePath, NumFrames](FRHICommandListImmediate&)
+	{
+		if (CpuExecutor)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Recording is not supported while the network runs on the CPU"));
+			return;
+		}
+		const TArray<FNeuralTensor*, TInlineAllocator<3>> Tensors = GetPackedInputTensors_RenderThread(GetActiveInferenceContext_RenderThread());
+		Recorder = MakeUnique<FStyleTransferRecorder>(FilePath, NumFrames, TArray<const FNeuralTensor*, TInlineAllocator<3>>(Tensors));
+	});
+}
+
+TUniquePtr<FStyleTransferInferenceWorkerClient> FStyleTransferSceneViewExtension::CreateInferenceWorker(UNeuralNetwork* Network)
+{
+	check(IsInGameThread());
+	if (!Network)
+		return nullptr;
+
+	// same order as GetPackedInputTensors_RenderThread
+	TArray<const FNeuralTensor*, TInlineAllocator<3>> InputTensors;
+	for (const TCHAR* TensorName : {TEXT("content"), TEXT("style_weights"), TEXT("style_params")})
+	{
+		for (uint32 i = 0; i < Network->GetInputTensorNumber(); i++)
+		{
+			if (Network->GetInputTensor(i).GetName() == TensorName)
+			{
+				InputTensors.Add(&Network->GetInputTensor(i));
+			}
+		}
+	}
+
+	TUniquePtr<FStyleTransferInferenceWorkerClient> NewInferenceWorker = MakeUnique<FStyleTransferInferenceWorkerClient>(Network, InputTensors);
+	if (!NewInferenceWorker->IsValid())
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not create the inference worker, running the network in process"));
+		return nullptr;
+	}
+	return NewInferenceWorker;
+}
+
+void FStyleTransferSceneViewExtension::SetUseInferenceWorker(bool bInUseInferenceWorker)
+{
+	check(IsInGameThread());
+	if (bUseInferenceWorker == bInUseInferenceWorker)
+		return;
+
+	bUseInferenceWorker = bInUseInferenceWorker;
+	TUniquePtr<FStyleTransferInferenceWorkerClient> NewInferenceWorker = bUseInferenceWorker ? CreateInferenceWorker(StyleTransferNetworkWeakPtr.Get()) : nullptr;
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetInferenceWorker)([this, NewInferenceWorker = MoveTemp(NewInferenceWorker)](FRHICommandListImmediate&) mutable
+	{
+		InferenceWorker = MoveTemp(NewInferenceWorker);
+	});
+}
+
+void FStyleTransferSceneViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+	// scene captures have their own content size and are never part of a batch
+	if (InViewFamily.Views.Num() == 0 || InViewFamily.Views[0]->bIsSceneCapture)
+		return;
+
+	const FStyleTransferViewSettings ViewSettings = UStyleTransferBlendable::GetViewSettings(*InViewFamily.Views[0], bRequirePostProcessVolume_GameThread);
+	RequestedStyleIndex = ViewSettings.StyleIndex;
+	// the batch renderer does not show the view so it keeps stylizing
+	bBlendedOut = ViewSettings.Strength <= 0.f && !GetBatchFrameNumber;
+
+	if (GetBatchFrameNumber)
+	{
+		const int32 NewBatchFrameNumber = GetBatchFrameNumber();
+		if (NewBatchFrameNumber != INDEX_NONE && NewBatchFrameNumber != LastBatchFrameNumber)
+		{
+			LastBatchFrameNumber = NewBatchFrameNumber;
+			ENQUEUE_RENDER_COMMAND(StyleTransferBatchFrame)([this, NewBatchFrameNumber](FRHICommandListImmediate&)
+			{
+				BatchFrameNumber = NewBatchFrameNumber;
+			});
+		}
+	}
+
+	const bool bFoveated = CVarFoveated.GetValueOnGameThread() && !bUseInferenceWorker && !bHasCpuExecutor_GameThread && !GetBatchFrameNumber;
+	if (bFoveated && !ContentShapeCache && !bReportedFoveationWithoutContentShape)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("r.StyleTransfer.Foveated requires a network with a dynamic content shape, stylizing the whole view instead"));
+		bReportedFoveationWithoutContentShape = true;
+	}
+
+	// the blended out view is not stylized, so it does not need a context of its size
+	if (!ContentShapeCache || bBlendedOut)
+		return;
+
+	const FIntPoint ViewSize = InViewFamily.Views[0]->UnscaledViewRect.Size();
+	int32 NewFoveatedInsetContext = INDEX_NONE;
+	int32 NewFoveatedPeripheryContext = INDEX_NONE;
+	if (bFoveated)
+	{
+		const int32 Stride = GetDefault<UStyleTransferSettings>()->ContentShapeStride;
+		const auto GetScaledContentSize = [ViewSize, Stride](float Scale)
+		{
+			const FIntPoint ScaledViewSize = (FVector2D(ViewSize) * FMath::Clamp(Scale, 0.05f, 1.f)).IntPoint();
+			return FStyleTransferContentShapeCache::GetContentSizeForView(ScaledViewSize, Stride);
+		};
+		NewFoveatedInsetContext = ContentShapeCache->GetInferenceContext(GetScaledContentSize(CVarFoveatedInsetScale.GetValueOnGameThread()));
+		NewFoveatedPeripheryContext = NewFoveatedInsetContext != INDEX_NONE
+			                              ? ContentShapeCache->GetInferenceContext(GetScaledContentSize(CVarFoveatedPeripheryScale.GetValueOnGameThread()))
+			                              : INDEX_NONE;
+	}
+
+	// the foveated view does not need a context of the whole view size
+	const bool bUseFoveation = NewFoveatedPeripheryContext != INDEX_NONE;
+	const int32 NewContentInferenceContext = bUseFoveation ? INDEX_NONE : ContentShapeCache->Update(ViewSize);
+	const FIntPoint NewContentSize = bUseFoveation ? FIntPoint::ZeroValue : ContentShapeCache->GetContentSize();
+	ENQUEUE_RENDER_COMMAND(StyleTransferContentShape)([this, NewContentInferenceContext, NewContentSize, NewFoveatedInsetContext = bUseFoveation ? NewFoveatedInsetContext : INDEX_NONE, NewFoveatedPeripheryContext](FRHICommandListImmediate&)
+	{
+		ContentInferenceContext = NewContentInferenceContext;
+		ContentSize = NewContentSize;
+		FoveatedInsetContext = NewFoveatedInsetContext;
+		FoveatedPeripheryContext = NewFoveatedPeripheryContext;
+	});
+}
+
 bool FStyleTransferSceneViewExtension::IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const
 {
 	check(IsInGameThread());
 	return FWorldSceneViewExtension::IsActiveThisFrame_Internal(Context)
 		&& bIsEnabled
-		&& *InferenceContext != -1 && StyleTransferNetworkWeakPtr.IsValid();
+		&& (*InferenceContext_GameThread != -1 || bHasCpuExecutor_GameThread || bSceneCapturesOnly_GameThread) && StyleTransferNetworkWeakPtr.IsValid();
+}
+
+void FStyleTransferSceneViewExtension::SetRequirePostProcessVolume(bool bInRequirePostProcessVolume)
+{
+	check(IsInGameThread());
+	bRequirePostProcessVolume_GameThread = bInRequirePostProcessVolume;
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetRequirePostProcessVolume)([this, bInRequirePostProcessVolume](FRHICommandListImmediate&)
+	{
+		bRequirePostProcessVolume = bInRequirePostProcessVolume;
+	});
 }
 
-void FStyleTransferSceneViewExtension::AddRescalingTextureCopy(FRDGBuilder& GraphBuilder, FRDGTexture& RDGSourceTexture, FScreenPassRenderTarget& DestinationRenderTarget)
+void FStyleTransferSceneViewExtension::SetStyleWeightsSource(EStyleTransferStyleWeightsSource Source, float Constant, UTexture* Texture, FUintVector4 StencilValues)
 {
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetStyleWeightsSource)([this, Source, Constant, Texture, StencilValues](FRHICommandListImmediate&)
+	{
+		StyleWeights->SetSource_RenderThread(Source, Constant, Texture, StencilValues);
+	});
+}
+
+void FStyleTransferSceneViewExtension::SetBatchRenderer(TSharedPtr<FStyleTransferBatchRenderer, ESPMode::ThreadSafe> InBatchRenderer, TFunction<int32()> InGetFrameNumber)
+{
+	check(IsInGameThread());
+	GetBatchFrameNumber = InBatchRenderer ? MoveTemp(InGetFrameNumber) : nullptr;
+	LastBatchFrameNumber = INDEX_NONE;
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetBatchRenderer)([this, InBatchRenderer](FRHICommandListImmediate&)
+	{
+		BatchRenderer = InBatchRenderer;
+		BatchFrameNumber = INDEX_NONE;
+	});
+}
+
+void FStyleTransferSceneViewExtension::FlushBatchRenderer()
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(StyleTransferFlushBatchRenderer)([this](FRHICommandListImmediate& RHICmdList)
+	{
+		if (!BatchRenderer)
+			return;
+
+		FRDGBuilder GraphBuilder(RHICmdList);
+		FNeuralTensor& ScratchOutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(*InferenceContext, 0);
+		BatchRenderer->Flush_RenderThread(GraphBuilder, ScratchOutputTensor);
+		GraphBuilder.Execute();
+		BatchRenderer->Tick_RenderThread(true);
+	});
+	FlushRenderingCommands();
+}
+
+void FStyleTransferSceneViewExtension::AddSceneCapture(const FSceneViewStateInterface* ViewState, int32 InInferenceContext, FIntPoint InContentSize, int32 UpdateInterval)
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(StyleTransferAddSceneCapture)([this, ViewState, InInferenceContext, InContentSize, UpdateInterval](FRHICommandListImmediate&)
+	{
+		FSceneCapture& SceneCapture = SceneCaptures.FindOrAdd(ViewState);
+		SceneCapture.InferenceContext = InInferenceContext;
+		SceneCapture.ContentSize = InContentSize;
+		SceneCapture.UpdateInterval = UpdateInterval < 0 ? MAX_uint32 : UpdateInterval;
+		// the previous output is still shown until the new context stylized the view
+		SceneCapture.bRefreshRequested = true;
+	});
+}
+
+void FStyleTransferSceneViewExtension::RemoveSceneCapture(const FSceneViewStateInterface* ViewState)
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(StyleTransferRemoveSceneCapture)([this, ViewState](FRHICommandListImmediate&)
+	{
+		SceneCaptures.Remove(ViewState);
+	});
+}
+
+void FStyleTransferSceneViewExtension::RefreshSceneCapture(const FSceneViewStateInterface* ViewState)
+{
+	check(IsInGameThread());
+	ENQUEUE_RENDER_COMMAND(StyleTransferRefreshSceneCapture)([this, ViewState](FRHICommandListImmediate&)
+	{
+		if (FSceneCapture* SceneCapture = SceneCaptures.Find(ViewState))
+		{
+			SceneCapture->bRefreshRequested = true;
+		}
+	});
+}
+
+void FStyleTransferSceneViewExtension::SetSceneCapturesOnly(bool bInSceneCapturesOnly)
+{
+	check(IsInGameThread());
+	bSceneCapturesOnly_GameThread = bInSceneCapturesOnly;
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetSceneCapturesOnly)([this, bInSceneCapturesOnly](FRHICommandListImmediate&)
+	{
+		bSceneCapturesOnly = bInSceneCapturesOnly;
+	});
+}
+
+FRDGBufferRef FStyleTransferSceneViewExtension::GetSceneCaptureStyleParamsBuffer_RenderThread(FRDGBuilder& GraphBuilder)
+{
+	check(IsInRenderingThread());
+	if (!SceneCaptureStyleParamsBuffer)
+	{
+		const FNeuralTensor& StyleParamsInputTensor = StyleTransferNetwork->GetInputTensor(StyleParamsInputTensorIndex);
+		SceneCaptureStyleParamsBuffer = AllocatePooledBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), StyleParamsInputTensor.Num()), TEXT("StyleTransferSceneCaptureStyleParams"));
+	}
+	return GraphBuilder.RegisterExternalBuffer(SceneCaptureStyleParamsBuffer);
+}
+
+void FStyleTransferSceneViewExtension::SetFoveatedFocus(FVector2f InFoveatedFocus)
+{
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetFoveatedFocus)([this, InFoveatedFocus](FRHICommandListImmediate&)
+	{
+		FoveatedFocus = InFoveatedFocus;
+	});
+}
+
+void FStyleTransferSceneViewExtension::SetCpuExecutor(TSharedPtr<FStyleTransferCpuExecutor, ESPMode::ThreadSafe> InCpuExecutor)
+{
+	check(IsInGameThread());
+	bHasCpuExecutor_GameThread = InCpuExecutor.IsValid();
+	ENQUEUE_RENDER_COMMAND(StyleTransferSetCpuExecutor)([this, InCpuExecutor](FRHICommandListImmediate&)
+	{
+		CpuExecutor = InCpuExecutor;
+		StyleWeightsTarget = nullptr;
+	});
+}
+
+void FStyleTransferSceneViewExtension::AddRescalingTextureCopy(FRDGBuilder& GraphBuilder, FRDGTexture& RDGSourceTexture, FScreenPassRenderTarget& DestinationRenderTarget, float Opacity)
+{
+	const bool bBlend = Opacity < 1.f;
+
 	FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
 
 	TShaderMapRef<FScreenPassVS> VertexShader(ShaderMap);
@@ -89,11 +423,16 @@ void FStyleTransferSceneViewExtension::AddRescalingTextureCopy(FRDGBuilder& Grap
 	FCopyRectPS::FParameters* PixelShaderParameters = GraphBuilder.AllocParameters<FCopyRectPS::FParameters>();
 	PixelShaderParameters->InputTexture = &RDGSourceTexture;
 	PixelShaderParameters->InputSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
-	PixelShaderParameters->RenderTargets[0] = DestinationRenderTarget.GetRenderTargetBinding();
+	PixelShaderParameters->RenderTargets[0] = bBlend
+		                                          ? FRenderTargetBinding(DestinationRenderTarget.Texture, ERenderTargetLoadAction::ELoad)
+		                                          : DestinationRenderTarget.GetRenderTargetBinding();
 
 	ClearUnusedGraphResources(PixelShader, PixelShaderParameters);
 
-	FRHIBlendState* BlendState = FScreenPassPipelineState::FDefaultBlendState::GetRHI();
+	// Destination = Opacity * Source + (1 - Opacity) * Destination
+	FRHIBlendState* BlendState = bBlend
+		                             ? TStaticBlendState<CW_RGB, BO_Add, BF_BlendFactor, BF_InverseBlendFactor>::GetRHI()
+		                             : FScreenPassPipelineState::FDefaultBlendState::GetRHI();
 	FRHIDepthStencilState* DepthStencilState = FScreenPassPipelineState::FDefaultDepthStencilState::GetRHI();
 
 	const FScreenPassPipelineState PipelineState(VertexShader, PixelShader, BlendState, DepthStencilState);
@@ -102,11 +441,15 @@ void FStyleTransferSceneViewExtension::AddRescalingTextureCopy(FRDGBuilder& Grap
 		RDG_EVENT_NAME("RescalingTextureCopy"),
 		PixelShaderParameters,
 		ERDGPassFlags::Raster,
-		[PipelineState, Extent = DestinationRenderTarget.Texture->Desc.Extent, PixelShader, PixelShaderParameters](FRHICommandList& RHICmdList)
+		[PipelineState, Extent = DestinationRenderTarget.Texture->Desc.Extent, PixelShader, PixelShaderParameters, bBlend, Opacity](FRHICommandList& RHICmdList)
 		{
 			PipelineState.Validate();
 			RHICmdList.SetViewport(0.0f, 0.0f, 0.0f, Extent.X, Extent.Y, 1.0f);
 			SetScreenPassPipelineState(RHICmdList, PipelineState);
+			if (bBlend)
+			{
+				RHICmdList.SetBlendFactor(FLinearColor(Opacity, Opacity, Opacity, Opacity));
+			}
 			SetShaderParameters(RHICmdList, PixelShader, PixelShader.GetPixelShader(), *PixelShaderParameters);
 			DrawRectangle(
 				RHICmdList,
@@ -129,32 +472,7 @@ void FStyleTransferSceneViewExtension::SubscribeToPostProcessingPass(EPostProces
 	}
 }
 
-void FStyleTransferSceneViewExtension::PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily)
-{
-	return;
-	const FName RenderCaptureProviderType = IRenderCaptureProvider::GetModularFeatureName();
-	if (!IModularFeatures::Get().IsModularFeatureAvailable(RenderCaptureProviderType))
-		return;
-
-	IRenderCaptureProvider& RenderCaptureProvider = IModularFeatures::Get().GetModularFeature<IRenderCaptureProvider>(RenderCaptureProviderType);
-	if (bIsEnabled && NumFramesCaptured == -1)
-	{
-		RenderCaptureProvider.BeginCapture(&GRHICommandList.GetImmediateCommandList());
-		NumFramesCaptured = 0;
-	}
-
-	if (NumFramesCaptured >= 0)
-	{
-		++NumFramesCaptured;
-	}
-
-	if (NumFramesCaptured == 10)
-	{
-		RenderCaptureProvider.EndCapture(&GRHICommandList.GetImmediateCommandList());
-	}
-}
-
-FRDGTexture* FStyleTransferSceneViewExtension::TensorToTexture(FRDGBuilder& GraphBuilder, const FRDGTextureDesc& BaseDestinationDesc, const FNeuralTensor& SourceTensor)
+FRDGTexture* FStyleTransferSceneViewExtension::TensorToTexture(FRDGBuilder& GraphBuilder, const FRDGTextureDesc& BaseDestinationDesc, const FNeuralTensor& SourceTensor, int32 PermutationId)
 {
 	FIntVector SourceTensorDimensions = {
 		CastNarrowingSafe<int32>(SourceTensor.GetSize(1)),
@@ -173,17 +491,25 @@ FRDGTexture* FStyleTransferSceneViewExtension::TensorToTexture(FRDGBuilder& Grap
 	FRDGTexture* OutputTexture = GraphBuilder.CreateTexture(
 		DestinationDesc, TEXT("OutputTexture"));
 
+	const FIntVector DispatchSize = {SourceTensorDimensions.X, SourceTensorDimensions.Y, 1};
+	if (PermutationId == INDEX_NONE)
+	{
+		PermutationId = FStyleTransferAutotuner::GetPermutationId(EStyleTransferKernel::OutputTensorToSceneColor, DispatchSize);
+	}
+	const FOutputTensorToSceneColorCS::FPermutationDomain PermutationVector(PermutationId);
+	const bool bTransposedDispatch = PermutationVector.Get<FOutputTensorToSceneColorCS::FTransposedDispatchDimension>();
+
 	auto OutputTensorToSceneColorParameters = GraphBuilder.AllocParameters<FOutputTensorToSceneColorCS::FParameters>();
 	OutputTensorToSceneColorParameters->InputTensor = SourceTensor.GetBufferSRVRef();
 	OutputTensorToSceneColorParameters->OutputTexture = GraphBuilder.CreateUAV(OutputTexture);
 	OutputTensorToSceneColorParameters->TensorVolume = SourceTensor.Num();
 	OutputTensorToSceneColorParameters->TextureSize = DestinationDesc.Extent;
 	FIntVector OutputTensorToSceneColorGroupCount = FComputeShaderUtils::GetGroupCount(
-		{SourceTensorDimensions.X, SourceTensorDimensions.Y, 1},
-		FOutputTensorToSceneColorCS::ThreadGroupSize
+		bTransposedDispatch ? FIntVector(DispatchSize.Y, DispatchSize.X, 1) : DispatchSize,
+		FOutputTensorToSceneColorCS::GetThreadGroupSize(PermutationVector)
 	);
 
-	TShaderMapRef<FOutputTensorToSceneColorCS> OutputTensorToSceneColorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	TShaderMapRef<FOutputTensorToSceneColorCS> OutputTensorToSceneColorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("TensorToTexture"),
 		OutputTensorToSceneColorParameters,
@@ -198,52 +524,42 @@ FRDGTexture* FStyleTransferSceneViewExtension::TensorToTexture(FRDGBuilder& Grap
 	return OutputTexture;
 }
 
-FRDGTexture* TensorToTexture(FRDGBuilder& GraphBuilder, const FRDGTextureDesc& BaseDestinationDesc, const FNeuralTensor& SourceTensor)
+/** An empty SourceRect maps the tensor to the whole texture */
+static void GetInputUVTransform(const FIntRect& SourceRect, FIntPoint TextureExtent, FVector2f& OutUVOffset, FVector2f& OutUVScale)
 {
-	FIntVector SourceTensorDimensions = {
-		CastNarrowingSafe<int32>(SourceTensor.GetSize(1)),
-		CastNarrowingSafe<int32>(SourceTensor.GetSize(2)),
-		CastNarrowingSafe<int32>(SourceTensor.GetSize(3)),
-	};
-
-	// Reusing the same output description for our back buffer as SceneColor
-	FRDGTextureDesc DestinationDesc = BaseDestinationDesc;
-	// this is flipped because the Output tensor has the vertical dimension first
-	// while unreal has the horizontal dimension first
-	DestinationDesc.Extent = {SourceTensorDimensions[1], SourceTensorDimensions[0]};
-	DestinationDesc.Flags |= TexCreate_RenderTargetable | TexCreate_UAV;
-	FLinearColor ClearColor(0., 0., 0., 0.);
-	DestinationDesc.ClearValue = FClearValueBinding(ClearColor);
-	FRDGTexture* OutputTexture = GraphBuilder.CreateTexture(
-		DestinationDesc, TEXT("OutputTexture"));
-
-
-	auto OutputTensorToSceneColorParameters = GraphBuilder.AllocParameters<FOutputTensorToSceneColorCS::FParameters>();
-	OutputTensorToSceneColorParameters->InputTensor = SourceTensor.GetBufferSRVRef();
-	OutputTensorToSceneColorParameters->OutputTexture = GraphBuilder.CreateUAV(OutputTexture);
-	OutputTensorToSceneColorParameters->TensorVolume = SourceTensor.Num();
-	OutputTensorToSceneColorParameters->TextureSize = DestinationDesc.Extent;
-	FIntVector OutputTensorToSceneColorGroupCount = FComputeShaderUtils::GetGroupCount(
-		{SourceTensorDimensions.X, SourceTensorDimensions.Y, 1},
-		FOutputTensorToSceneColorCS::ThreadGroupSize
-	);
+	if (SourceRect.IsEmpty())
+	{
+		OutUVOffset = FVector2f::ZeroVector;
+		OutUVScale = FVector2f::UnitVector;
+		return;
+	}
+	OutUVOffset = FVector2f(SourceRect.Min) / FVector2f(TextureExtent);
+	OutUVScale = FVector2f(SourceRect.Size()) / FVector2f(TextureExtent);
+}
 
-	TShaderMapRef<FOutputTensorToSceneColorCS> OutputTensorToSceneColorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
-	GraphBuilder.AddPass(
-		RDG_EVENT_NAME("TensorToTexture"),
-		OutputTensorToSceneColorParameters,
-		ERDGPassFlags::Compute,
-		[OutputTensorToSceneColorCS, OutputTensorToSceneColorParameters, OutputTensorToSceneColorGroupCount](FRHICommandList& RHICommandList)
-		{
-			FComputeShaderUtils::Dispatch(RHICommandList, OutputTensorToSceneColorCS,
-			                              *OutputTensorToSceneColorParameters, OutputTensorToSceneColorGroupCount);
-		}
-	);
+/**
+ * Picks the mip whose texels are closest to the tensor elements without being smaller and the number of samples per axis
+ * that average the footprint left over that mip, e.g. if the source has no mips, so large sources do not alias.
+ */
+static void GetInputFilter(FIntPoint SourceSize, uint32 NumMips, FIntPoint TensorSize, float& OutMipLevel, uint32& OutSamplesPerAxis)
+{
+	const float Ratio = FMath::Max(static_cast<float>(SourceSize.X) / TensorSize.X, static_cast<float>(SourceSize.Y) / TensorSize.Y);
+	if (Ratio <= 1.f)
+	{
+		OutMipLevel = 0.f;
+		OutSamplesPerAxis = 1;
+		return;
+	}
 
-	return OutputTexture;
+	const int32 MipLevel = FMath::Clamp(FMath::FloorToInt(FMath::Log2(Ratio)), 0, static_cast<int32>(NumMips) - 1);
+	OutMipLevel = static_cast<float>(MipLevel);
+	// bilinear sampling covers up to two texels of the mip per axis
+	const float Footprint = Ratio / (1 << MipLevel);
+	OutSamplesPerAxis = FMath::Clamp(FMath::CeilToInt(Footprint / 2.f), 1, 8);
 }
 
-FRDGPassRef TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor)
+static FRDGPassRef TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor, const FIntRect& SourceRect = FIntRect(), int32 PermutationId = INDEX_NONE,
+                                      bool bFilter = false)
 {
 	const FIntVector InputTensorDimensions = {
 		CastNarrowingSafe<int32>(DestinationTensor.GetSize(1)),
@@ -252,19 +568,36 @@ FRDGPassRef TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceT
 	};
 	const FIntPoint RgbRenderTargetDimensions = SourceTexture->Desc.Extent;
 
+	const FIntVector DispatchSize = {InputTensorDimensions.X, InputTensorDimensions.Y, 1};
+	if (PermutationId == INDEX_NONE)
+	{
+		PermutationId = FStyleTransferAutotuner::GetPermutationId(EStyleTransferKernel::SceneColorToInputTensor, DispatchSize);
+	}
+	const FSceneColorToInputTensorCS::FPermutationDomain PermutationVector(PermutationId);
+
 	FSceneColorToInputTensorCS::FParameters* RgbToInputTensorParameters = GraphBuilder.AllocParameters<FSceneColorToInputTensorCS::FParameters>();
 	RgbToInputTensorParameters->TensorVolume = CastNarrowingSafe<uint32>(DestinationTensor.Num());
 	RgbToInputTensorParameters->InputTexture = SourceTexture;
 	RgbToInputTensorParameters->InputTextureSampler = TStaticSamplerState<SF_Bilinear>::GetRHI();
 	RgbToInputTensorParameters->OutputUAV = DestinationTensor.GetBufferUAVRef();
 	RgbToInputTensorParameters->OutputDimensions = {InputTensorDimensions.X, InputTensorDimensions.Y};
-	RgbToInputTensorParameters->HalfPixelUV = FVector2f(0.5f / RgbRenderTargetDimensions.X, 0.5 / RgbRenderTargetDimensions.Y);
+	GetInputUVTransform(SourceRect, RgbRenderTargetDimensions, RgbToInputTensorParameters->InputUVOffset, RgbToInputTensorParameters->InputUVScale);
+	const FIntPoint SourceSize = SourceRect.IsEmpty() ? RgbRenderTargetDimensions : SourceRect.Size();
+	RgbToInputTensorParameters->MipLevel = 0.f;
+	RgbToInputTensorParameters->SamplesPerAxis = 1;
+	if (bFilter)
+	{
+		GetInputFilter(SourceSize, SourceTexture->Desc.NumMips, FIntPoint(InputTensorDimensions.Y, InputTensorDimensions.X),
+		               RgbToInputTensorParameters->MipLevel, RgbToInputTensorParameters->SamplesPerAxis);
+	}
+	const float MipTexelSize = static_cast<float>(1 << static_cast<int32>(RgbToInputTensorParameters->MipLevel));
+	RgbToInputTensorParameters->HalfPixelUV = FVector2f(0.5f * MipTexelSize / RgbRenderTargetDimensions.X, 0.5f * MipTexelSize / RgbRenderTargetDimensions.Y);
 	FIntVector ComputeGroupCount = FComputeShaderUtils::GetGroupCount(
-		{InputTensorDimensions.X, InputTensorDimensions.Y, 1},
-		FSceneColorToInputTensorCS::ThreadGroupSize
+		DispatchSize,
+		FSceneColorToInputTensorCS::GetThreadGroupSize(PermutationVector)
 	);
 
-	TShaderMapRef<FSceneColorToInputTensorCS> RgbToInputTensorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	TShaderMapRef<FSceneColorToInputTensorCS> RgbToInputTensorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	return GraphBuilder.AddPass(
 		RDG_EVENT_NAME("TextureToTensorRGB(%s)", FSceneColorToInputTensorCS::StaticType.GetName()),
 		RgbToInputTensorParameters,
@@ -277,7 +610,13 @@ FRDGPassRef TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceT
 	);
 }
 
-FRDGPassRef TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor)
+/** Number of style parameter sets a style_weights tensor weighs, one per channel */
+static int32 GetNumStyleSets(const FNeuralTensor& StyleWeightsTensor)
+{
+	return CastNarrowingSafe<int32>(StyleWeightsTensor.GetSize(3));
+}
+
+static FRDGPassRef TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor, const FIntRect& SourceRect = FIntRect(), int32 PermutationId = INDEX_NONE)
 {
 	const FIntVector InputTensorDimensions = {
 		CastNarrowingSafe<int32>(DestinationTensor.GetSize(1)),
@@ -286,6 +625,13 @@ FRDGPassRef TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef S
 	};
 	const FIntPoint GrayscaleRenderTargetDimensions = SourceTexture->Desc.Extent;
 
+	const FIntVector DispatchSize = {InputTensorDimensions.X, InputTensorDimensions.Y, 1};
+	if (PermutationId == INDEX_NONE)
+	{
+		PermutationId = FStyleTransferAutotuner::GetPermutationId(EStyleTransferKernel::ShadowMaskToInputTensor, DispatchSize);
+	}
+	const FShadowMaskToInputTensorCS::FPermutationDomain PermutationVector(PermutationId);
+
 	FShadowMaskToInputTensorCS::FParameters* GrayscaleToInputTensorParameters = GraphBuilder.AllocParameters<FShadowMaskToInputTensorCS::FParameters>();
 	GrayscaleToInputTensorParameters->TensorVolume = CastNarrowingSafe<uint32>(DestinationTensor.Num());
 	GrayscaleToInputTensorParameters->InputTexture = SourceTexture;
@@ -293,12 +639,14 @@ FRDGPassRef TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef S
 	GrayscaleToInputTensorParameters->OutputUAV = DestinationTensor.GetBufferUAVRef();
 	GrayscaleToInputTensorParameters->OutputDimensions = {InputTensorDimensions.X, InputTensorDimensions.Y};
 	GrayscaleToInputTensorParameters->HalfPixelUV = FVector2f(0.5f / GrayscaleRenderTargetDimensions.X, 0.5 / GrayscaleRenderTargetDimensions.Y);
+	GetInputUVTransform(SourceRect, GrayscaleRenderTargetDimensions, GrayscaleToInputTensorParameters->InputUVOffset, GrayscaleToInputTensorParameters->InputUVScale);
+	GrayscaleToInputTensorParameters->NumChannels = InputTensorDimensions.Z;
 	FIntVector ComputeGroupCount = FComputeShaderUtils::GetGroupCount(
-		{InputTensorDimensions.X, InputTensorDimensions.Y, 1},
-		FShadowMaskToInputTensorCS::ThreadGroupSize
+		DispatchSize,
+		FShadowMaskToInputTensorCS::GetThreadGroupSize(PermutationVector)
 	);
 
-	TShaderMapRef<FShadowMaskToInputTensorCS> GrayscaleToInputTensorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	TShaderMapRef<FShadowMaskToInputTensorCS> GrayscaleToInputTensorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	return GraphBuilder.AddPass(
 		RDG_EVENT_NAME("TextureToTensorGrayscale(%s)", FShadowMaskToInputTensorCS::StaticType.GetName()),
 		GrayscaleToInputTensorParameters,
@@ -311,27 +659,46 @@ FRDGPassRef TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef S
 	);
 }
 
-void FStyleTransferSceneViewExtension::TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor)
+void FStyleTransferSceneViewExtension::TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor, const FIntRect& SourceRect, int32 PermutationId,
+                                                         bool bFilter)
+{
+	::TextureToTensorRGB(GraphBuilder, SourceTexture, DestinationTensor, SourceRect, PermutationId, bFilter);
+}
+
+void FStyleTransferSceneViewExtension::TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor, const FIntRect& SourceRect, int32 PermutationId)
 {
-	::TextureToTensorRGB(GraphBuilder, SourceTexture, DestinationTensor);
+	::TextureToTensorGrayscale(GraphBuilder, SourceTexture, DestinationTensor, SourceRect, PermutationId);
 }
 
-void FStyleTransferSceneViewExtension::InterpolateTensors(FRDGBuilder& GraphBuilder, FNeuralTensor& DestinationTensor, const FNeuralTensor& InputTensorA, const FNeuralTensor& InputTensorB, float Alpha)
+void FStyleTransferSceneViewExtension::InterpolateTensors(FRDGBuilder& GraphBuilder, FNeuralTensor& DestinationTensor, const FNeuralTensor& InputTensorA, const FNeuralTensor& InputTensorB, float Alpha, int32 PermutationId)
+{
+	InterpolateBuffers(GraphBuilder, DestinationTensor.GetBufferUAVRef(), InputTensorA.GetBufferSRVRef(), InputTensorB.GetBufferSRVRef(),
+	                   CastNarrowingSafe<uint32>(DestinationTensor.Num()), Alpha, PermutationId);
+}
+
+void FStyleTransferSceneViewExtension::InterpolateBuffers(FRDGBuilder& GraphBuilder, FRDGBufferUAVRef Destination, FRDGBufferSRVRef InputA, FRDGBufferSRVRef InputB, uint32 Volume, float Alpha, int32 PermutationId)
 {
 	RDG_EVENT_SCOPE(GraphBuilder, "InterpolateTensors");
 
+	const FIntVector DispatchSize = {CastNarrowingSafe<int32>(Volume), 1, 1};
+	if (PermutationId == INDEX_NONE)
+	{
+		PermutationId = FStyleTransferAutotuner::GetPermutationId(EStyleTransferKernel::InterpolateTensors, DispatchSize);
+	}
+	const FInterpolateTensorsCS::FPermutationDomain PermutationVector(PermutationId);
+
 	auto InterpolateTensorsParameters = GraphBuilder.AllocParameters<FInterpolateTensorsCS::FParameters>();
-	InterpolateTensorsParameters->InputSrvA = InputTensorA.GetBufferSRVRef();
-	InterpolateTensorsParameters->InputSrvB = InputTensorB.GetBufferSRVRef();
-	InterpolateTensorsParameters->OutputUAV = DestinationTensor.GetBufferUAVRef();
+	InterpolateTensorsParameters->InputSrvA = InputA;
+	InterpolateTensorsParameters->InputSrvB = InputB;
+	InterpolateTensorsParameters->OutputUAV = Destination;
 	InterpolateTensorsParameters->Alpha = Alpha;
-	InterpolateTensorsParameters->TensorVolume = DestinationTensor.Num();
+	InterpolateTensorsParameters->TensorVolume = Volume;
 	FIntVector InterpolateTensorsThreadGroupCount = FComputeShaderUtils::GetGroupCount(
-		{CastNarrowingSafe<int32>(DestinationTensor.Num()), 1, 1},
-		FInterpolateTensorsCS::ThreadGroupSize
+		DispatchSize,
+		FInterpolateTensorsCS::GetThreadGroupSize(PermutationVector)
 	);
 
-	TShaderMapRef<FInterpolateTensorsCS> InterpolateTensorsCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	TShaderMapRef<FInterpolateTensorsCS> InterpolateTensorsCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
 	GraphBuilder.AddPass(
 		RDG_EVENT_NAME("InterpolateTensors"),
 		InterpolateTensorsParameters,
@@ -344,6 +711,146 @@ void FStyleTransferSceneViewExtension::InterpolateTensors(FRDGBuilder& GraphBuil
 	);
 }
 
+void FStyleTransferSceneViewExtension::QuantizeBuffer(FRDGBuilder& GraphBuilder, FRDGBufferSRVRef Input, uint32 Volume, FRDGBufferUAVRef QuantizedOutput, FRDGBufferUAVRef ScaleOffsetOutput)
+{
+	FQuantizeTensorCS::FParameters* QuantizeParameters = GraphBuilder.AllocParameters<FQuantizeTensorCS::FParameters>();
+	QuantizeParameters->InputSrv = Input;
+	QuantizeParameters->QuantizedOutputUAV = QuantizedOutput;
+	QuantizeParameters->ScaleOffsetOutputUAV = ScaleOffsetOutput;
+	QuantizeParameters->TensorVolume = Volume;
+
+	TShaderMapRef<FQuantizeTensorCS> QuantizeTensorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FComputeShaderUtils::AddPass(
+		GraphBuilder,
+		RDG_EVENT_NAME("QuantizeTensor"),
+		QuantizeTensorCS,
+		QuantizeParameters,
+		FIntVector(FMath::DivideAndRoundUp(Volume, FQuantizeTensorCS::ValuesPerBlock), 1, 1));
+}
+
+void FStyleTransferSceneViewExtension::InterpolateQuantizedBuffers(FRDGBuilder& GraphBuilder, FRDGBufferUAVRef Destination, FRDGBufferSRVRef QuantizedInputA, FRDGBufferSRVRef ScaleOffsetsA,
+                                                                   FRDGBufferSRVRef QuantizedInputB, FRDGBufferSRVRef ScaleOffsetsB, uint32 Volume, float Alpha)
+{
+	// same thread group shape as the float version
+	const FIntVector DispatchSize = {CastNarrowingSafe<int32>(Volume), 1, 1};
+	const FInterpolateQuantizedTensorsCS::FPermutationDomain PermutationVector(FStyleTransferAutotuner::GetPermutationId(EStyleTransferKernel::InterpolateTensors, DispatchSize));
+
+	FInterpolateQuantizedTensorsCS::FParameters* InterpolateParameters = GraphBuilder.AllocParameters<FInterpolateQuantizedTensorsCS::FParameters>();
+	InterpolateParameters->OutputUAV = Destination;
+	InterpolateParameters->QuantizedInputSrvA = QuantizedInputA;
+	InterpolateParameters->ScaleOffsetSrvA = ScaleOffsetsA;
+	InterpolateParameters->QuantizedInputSrvB = QuantizedInputB;
+	InterpolateParameters->ScaleOffsetSrvB = ScaleOffsetsB;
+	InterpolateParameters->Alpha = Alpha;
+	InterpolateParameters->TensorVolume = Volume;
+
+	TShaderMapRef<FInterpolateQuantizedTensorsCS> InterpolateQuantizedTensorsCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	FComputeShaderUtils::AddPass(
+		GraphBuilder,
+		RDG_EVENT_NAME("InterpolateQuantizedTensors"),
+		InterpolateQuantizedTensorsCS,
+		InterpolateParameters,
+		FComputeShaderUtils::GetGroupCount(DispatchSize, FInterpolateQuantizedTensorsCS::GetThreadGroupSize(PermutationVector)));
+}
+
+void FStyleTransferSceneViewExtension::GatherTensor(FRDGBuilder& GraphBuilder, FNeuralTensor& DestinationTensor, FRDGBufferSRVRef Source, TConstArrayView<int32> Indices)
+{
+	check(Indices.Num() == DestinationTensor.Num());
+	GatherBuffer(GraphBuilder, DestinationTensor.GetBufferUAVRef(), Source, Indices);
+}
+
+void FStyleTransferSceneViewExtension::GatherBuffer(FRDGBuilder& GraphBuilder, FRDGBufferUAVRef Destination, FRDGBufferSRVRef Source, TConstArrayView<int32> Indices)
+{
+
+	FRDGBufferRef IndicesBuffer = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), Indices.Num()), TEXT("GatherTensorIndices"));
+	GraphBuilder.QueueBufferUpload(IndicesBuffer, Indices.GetData(), Indices.Num() * Indices.GetTypeSize());
+
+	const FGatherTensorCS::FPermutationDomain PermutationVector;
+	auto GatherTensorParameters = GraphBuilder.AllocParameters<FGatherTensorCS::FParameters>();
+	GatherTensorParameters->InputSrv = Source;
+	GatherTensorParameters->Indices = GraphBuilder.CreateSRV(IndicesBuffer, PF_R32_UINT);
+	GatherTensorParameters->OutputUAV = Destination;
+	GatherTensorParameters->TensorVolume = CastNarrowingSafe<uint32>(Indices.Num());
+	FIntVector GatherTensorThreadGroupCount = FComputeShaderUtils::GetGroupCount(
+		FIntVector(Indices.Num(), 1, 1),
+		FGatherTensorCS::GetThreadGroupSize(PermutationVector)
+	);
+
+	TShaderMapRef<FGatherTensorCS> GatherTensorCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("GatherTensor"),
+		GatherTensorParameters,
+		ERDGPassFlags::Compute,
+		[GatherTensorCS, GatherTensorParameters, GatherTensorThreadGroupCount](FRHICommandList& RHICommandList)
+		{
+			FComputeShaderUtils::Dispatch(RHICommandList, GatherTensorCS,
+			                              *GatherTensorParameters, GatherTensorThreadGroupCount);
+		}
+	);
+}
+
+/** Creates the pipeline states of every permutation of the shader, so neither the autotuned thread group sizes nor the optional passes hitch on their first dispatch */
+template <class ShaderType>
+static void PrecacheComputePipelineStates(FRHIComputeCommandList& RHICmdList)
+{
+	FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+	for (int32 PermutationId = 0; PermutationId < ShaderType::FPermutationDomain::PermutationCount; ++PermutationId)
+	{
+		if (!ShaderMap->HasShader(&ShaderType::StaticType, PermutationId))
+			continue;
+
+		TShaderMapRef<ShaderType> Shader(ShaderMap, typename ShaderType::FPermutationDomain(PermutationId));
+		PipelineStateCache::GetAndOrCreateComputePipelineState(RHICmdList, Shader.GetComputeShader(), false);
+	}
+}
+
+void FStyleTransferSceneViewExtension::WarmUp_RenderThread(FRDGBuilder& GraphBuilder, UNeuralNetwork* StyleTransferNetwork, int32 InferenceContext, FRDGTextureRef DummySceneColor)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransferWarmUp");
+
+	// e.g. r.StyleTransfer.Foveated, the direct output, quantized styles, mapped network LODs and the style weights only run with some settings
+	FRHIComputeCommandList& RHICmdList = GraphBuilder.RHICmdList;
+	PrecacheComputePipelineStates<FSceneColorToInputTensorCS>(RHICmdList);
+	PrecacheComputePipelineStates<FShadowMaskToInputTensorCS>(RHICmdList);
+	PrecacheComputePipelineStates<FOutputTensorToSceneColorCS>(RHICmdList);
+	PrecacheComputePipelineStates<FOutputTensorToTargetCS>(RHICmdList);
+	PrecacheComputePipelineStates<FFoveatedCompositeCS>(RHICmdList);
+	PrecacheComputePipelineStates<FInterpolateTensorsCS>(RHICmdList);
+	PrecacheComputePipelineStates<FInterpolateQuantizedTensorsCS>(RHICmdList);
+	PrecacheComputePipelineStates<FQuantizeTensorCS>(RHICmdList);
+	PrecacheComputePipelineStates<FGatherTensorCS>(RHICmdList);
+	PrecacheComputePipelineStates<FStyleWeightsMaskCS>(RHICmdList);
+
+	for (uint32 i = 0; i < StyleTransferNetwork->GetInputTensorNumber(); i++)
+	{
+		FNeuralTensor& InputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(InferenceContext, i);
+		const FString& TensorName = InputTensor.GetName();
+		if (TensorName == "content")
+		{
+			InputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+			::TextureToTensorRGB(GraphBuilder, DummySceneColor, InputTensor);
+		}
+		else if (TensorName == "style_weights")
+		{
+			InputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+			::TextureToTensorGrayscale(GraphBuilder, DummySceneColor, InputTensor);
+		}
+	}
+
+	StyleTransferNetwork->Run(GraphBuilder, InferenceContext);
+
+	FNeuralTensor& OutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(InferenceContext, 0);
+	const FRDGTextureDesc DummyDesc = FRDGTextureDesc::Create2D(FIntPoint(1, 1), PF_FloatRGBA, FClearValueBinding::Black, TexCreate_ShaderResource);
+	FRDGTexture* OutputTexture = TensorToTexture(GraphBuilder, DummyDesc, OutputTensor);
+
+	FRDGTextureDesc DummyBackBufferDesc = OutputTexture->Desc;
+	DummyBackBufferDesc.Flags = TexCreate_ShaderResource | TexCreate_RenderTargetable;
+	FScreenPassRenderTarget DummyBackBuffer(GraphBuilder.CreateTexture(DummyBackBufferDesc, TEXT("WarmUpBackBuffer")), ERenderTargetLoadAction::ENoAction);
+	AddRescalingTextureCopy(GraphBuilder, *OutputTexture, DummyBackBuffer);
+	// post process volumes with a strength below 1 blend the scene color over the output
+	AddRescalingTextureCopy(GraphBuilder, *OutputTexture, DummyBackBuffer, 0.5f);
+}
+
 FScreenPassTexture FStyleTransferSceneViewExtension::PostProcessPassAfterTonemap_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View, const FPostProcessMaterialInputs& InOutInputs)
 {
 	const FScreenPassTexture& SceneColor = InOutInputs.Textures[(uint32)EPostProcessMaterialInput::SceneColor];
@@ -360,6 +867,15 @@ FScreenPassTexture FStyleTransferSceneViewExtension::PostProcessPassAfterTonemap
 
 	RDG_EVENT_SCOPE(GraphBuilder, "StyleTransfer");
 
+	if (Recorder)
+	{
+		Recorder->Tick_RenderThread();
+		if (Recorder->IsDone())
+		{
+			Recorder.Reset();
+		}
+	}
+
 	IRenderCaptureProvider* RenderCaptureProvider = nullptr;
 	if (CVarAutoCaptureStyleTransfer.GetValueOnRenderThread())
 	{
@@ -369,30 +885,408 @@ FScreenPassTexture FStyleTransferSceneViewExtension::PostProcessPassAfterTonemap
 	checkSlow(View.bIsViewInfo);
 	const FViewInfo& ViewInfo = static_cast<const FViewInfo&>(View);
 
-	FNeuralTensor& StyleTransferContentInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(*InferenceContext, ContentInputTensorIndex);
-	FNeuralTensor& StyleTransferStyleParamsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(*InferenceContext, StyleParamsInputTensorIndex);
+	LLM_SCOPE_BYTAG(StyleTransfer);
+
+	ViewStrength = UStyleTransferBlendable::GetViewSettings(View, bRequirePostProcessVolume).Strength;
+	// blended out views cost nothing but the pass through, the batch renderer does not show the view so it keeps stylizing
+	if (ViewStrength <= 0.f && !BatchRenderer)
+	{
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, nullptr);
+	}
+
+	// views that were added like scene captures reuse their output between inferences as well
+	if (View.bIsSceneCapture || (View.State && SceneCaptures.Contains(View.State)))
+	{
+		return StylizeSceneCapture_RenderThread(GraphBuilder, View, SceneColor, InOutInputs);
+	}
+	if (bSceneCapturesOnly)
+	{
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, nullptr);
+	}
+
+	if (CpuExecutor)
+	{
+		if (StyleWeightsInputTensorIndex != INDEX_NONE)
+		{
+			const bool bForce = StyleWeightsTarget != CpuExecutor.Get();
+			if (FRDGTextureRef StyleWeightsMask = StyleWeights->Update_RenderThread(GraphBuilder, ViewInfo, InOutInputs, CpuExecutor->GetContentSize(), 1, bForce))
+			{
+				CpuExecutor->SetStyleWeights_RenderThread(GraphBuilder, ViewInfo, StyleWeightsMask);
+				StyleWeightsTarget = CpuExecutor.Get();
+			}
+		}
+		CpuExecutor->Submit_RenderThread(GraphBuilder, ViewInfo, SceneColor);
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, CpuExecutor->Tick_RenderThread(GraphBuilder));
+	}
+
+	// the game thread only chooses foveation contexts if the network runs in process on the GPU, the inset runs in the active context
+	const bool bUseFoveation = FoveatedInsetContext != INDEX_NONE && FoveatedPeripheryContext != INDEX_NONE && !InferenceWorker && !BatchRenderer;
+	// the batch has the size of the fixed size context
+	const int32 ActiveInferenceContext = bUseFoveation ? FoveatedInsetContext : BatchRenderer ? *InferenceContext : GetActiveInferenceContext_RenderThread();
+
+	FNeuralTensor& StyleTransferContentInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(ActiveInferenceContext, ContentInputTensorIndex);
+	FNeuralTensor& StyleTransferStyleParamsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(ActiveInferenceContext, StyleParamsInputTensorIndex);
 
 	StyleTransferContentInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
 	StyleTransferStyleParamsInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
 
+	if (ActiveInferenceContext != *InferenceContext)
+	{
+		CopyStyleParams_RenderThread(GraphBuilder, ActiveInferenceContext);
+	}
+
+	FRDGTextureRef StyleWeightsMask = nullptr;
 	if (StyleWeightsInputTensorIndex != INDEX_NONE)
 	{
-		FNeuralTensor& StyleTransferStyleWeightsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(*InferenceContext, StyleWeightsInputTensorIndex);
+		FNeuralTensor& StyleTransferStyleWeightsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(ActiveInferenceContext, StyleWeightsInputTensorIndex);
 		StyleTransferStyleWeightsInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
 
-		check(GScreenShadowMaskTexture);
-		::TextureToTensorGrayscale(GraphBuilder, GScreenShadowMaskTexture, StyleTransferStyleWeightsInputTensor);
+		// the tensor keeps the previous weights if no new mask is generated, the packing upsamples the mask to the tensor size
+		// foveation packs different parts of the mask every frame, so it needs a mask every frame
+		const bool bForce = StyleWeightsTarget != &StyleTransferStyleWeightsInputTensor || bUseFoveation;
+		const FIntPoint StyleWeightsSize(StyleTransferStyleWeightsInputTensor.GetSize(2), StyleTransferStyleWeightsInputTensor.GetSize(1));
+		StyleWeightsMask = StyleWeights->Update_RenderThread(GraphBuilder, ViewInfo, InOutInputs, StyleWeightsSize, GetNumStyleSets(StyleTransferStyleWeightsInputTensor), bForce);
+		if (StyleWeightsMask && !bUseFoveation)
+		{
+			::TextureToTensorGrayscale(GraphBuilder, StyleWeightsMask, StyleTransferStyleWeightsInputTensor);
+			StyleWeightsTarget = &StyleTransferStyleWeightsInputTensor;
+		}
+		else if (bUseFoveation)
+		{
+			StyleWeightsTarget = nullptr;
+		}
 	}
 
-	::TextureToTensorRGB(GraphBuilder, SceneColor.Texture, StyleTransferContentInputTensor);
+	if (bUseFoveation)
+	{
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, StylizeFoveated_RenderThread(GraphBuilder, SceneColor, ActiveInferenceContext, FoveatedPeripheryContext, StyleWeightsMask));
+	}
 
-	StyleTransferNetwork->Run(GraphBuilder, *InferenceContext);
+	::TextureToTensorRGB(GraphBuilder, SceneColor.Texture, StyleTransferContentInputTensor, SceneColor.ViewRect);
 
+	if (BatchRenderer)
+	{
+		if (BatchFrameNumber != INDEX_NONE && BatchRenderer->GetNetwork() == StyleTransferNetwork)
+		{
+			FNeuralTensor& ScratchOutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(ActiveInferenceContext, 0);
+			BatchRenderer->AddFrame_RenderThread(GraphBuilder, BatchFrameNumber, GetPackedInputTensors_RenderThread(ActiveInferenceContext), ScratchOutputTensor, SceneColor.ViewRect.Size());
+			BatchFrameNumber = INDEX_NONE;
+		}
+		BatchRenderer->Tick_RenderThread();
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, nullptr);
+	}
+
+	if (Recorder && Recorder->NeedsMoreFrames())
+	{
+		FStyleTransferRecordingFrameHeader FrameHeader;
+		FrameHeader.FrameNumber = View.Family->FrameNumber;
+		FrameHeader.TimeSeconds = View.Family->Time.GetRealTimeSeconds();
+		FrameHeader.ViewRect = SceneColor.ViewRect;
+		FrameHeader.SceneColorExtent = SceneColor.Texture->Desc.Extent;
+		Recorder->AddFrame_RenderThread(GraphBuilder, GetPackedInputTensors_RenderThread(ActiveInferenceContext), FrameHeader);
+	}
+
+	FNeuralTensor& StyleTransferContentOutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(ActiveInferenceContext, 0);
+	if (InferenceWorker)
+	{
+		InferenceWorker->Tick_RenderThread();
+		InferenceWorker->Submit_RenderThread(GraphBuilder, GetPackedInputTensors_RenderThread(ActiveInferenceContext), View.Family->FrameNumber);
+		if (!InferenceWorker->FetchOutput_RenderThread(GraphBuilder, StyleTransferContentOutputTensor))
+		{
+			// nothing to show until the worker completed its first frame
+			return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, nullptr);
+		}
+	}
+	else
+	{
+		StyleTransferNetwork->Run(GraphBuilder, ActiveInferenceContext);
+	}
+
+	// the direct output has nothing to blend the scene color over
+	if (CVarDirectOutput.GetValueOnRenderThread() && ViewStrength >= 1.f)
+	{
+		FScreenPassTexture DirectOutput = OutputTensorToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, StyleTransferContentOutputTensor);
+		if (DirectOutput.IsValid())
+			return DirectOutput;
+	}
 
-	FNeuralTensor& StyleTransferContentOutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(*InferenceContext, 0);
 	FRDGTexture* StyleTransferRenderTargetTexture = TensorToTexture(GraphBuilder, SceneColor.Texture->Desc, StyleTransferContentOutputTensor);
 
-	TSharedPtr<FScreenPassRenderTarget> StyleTransferOutputTarget = MakeShared<FScreenPassRenderTarget>(StyleTransferRenderTargetTexture, SceneColor.ViewRect,
+	if (RenderCaptureProvider)
+	{
+		/*GraphBuilder.AddPass(RDG_EVENT_NAME("EndCapture"), ERDGPassFlags::None, [RenderCaptureProvider](FRHICommandListImmediate& RHICommandList)
+		{
+			RenderCaptureProvider->EndCapture(&RHICommandList);
+		});*/
+	}
+
+	return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, StyleTransferRenderTargetTexture);
+}
+
+bool FStyleTransferSceneViewExtension::ShouldStylizeSceneCapture(const FSceneCapture& SceneCapture, uint32 FrameNumber) const
+{
+	const auto IsDue = [FrameNumber](const FSceneCapture& Capture)
+	{
+		return !Capture.Output || Capture.bRefreshRequested || FrameNumber - Capture.LastStylizedFrame >= Capture.UpdateInterval;
+	};
+
+	if (!IsDue(SceneCapture) || NumSceneCaptureInferences >= CVarSceneCaptureMaxInferencesPerFrame.GetValueOnRenderThread())
+		return false;
+
+	// a due capture that waited longer and still renders this frame goes first, so captures rendered early can not starve the others
+	for (const TPair<const FSceneViewStateInterface*, FSceneCapture>& Other : SceneCaptures)
+	{
+		const FSceneCapture& OtherCapture = Other.Value;
+		const bool bRendersThisFrame = OtherCapture.LastRenderedFrame + 1 == FrameNumber;
+		if (&OtherCapture != &SceneCapture && bRendersThisFrame && IsDue(OtherCapture) && OtherCapture.LastStylizedFrame < SceneCapture.LastStylizedFrame)
+			return false;
+	}
+	return true;
+}
+
+FScreenPassTexture FStyleTransferSceneViewExtension::StylizeSceneCapture_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View, const FScreenPassTexture& SceneColor, const FPostProcessMaterialInputs& InOutInputs)
+{
+	FSceneCapture* SceneCapture = View.State ? SceneCaptures.Find(View.State) : nullptr;
+	if (!SceneCapture || CpuExecutor)
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, nullptr);
+
+	const uint32 FrameNumber = View.Family->FrameNumber;
+	if (FrameNumber != SceneCaptureFrameNumber)
+	{
+		SceneCaptureFrameNumber = FrameNumber;
+		NumSceneCaptureInferences = 0;
+	}
+	const bool bStylize = ShouldStylizeSceneCapture(*SceneCapture, FrameNumber);
+	SceneCapture->LastRenderedFrame = FrameNumber;
+	if (!bStylize)
+	{
+		FRDGTexture* PreviousOutput = SceneCapture->Output ? GraphBuilder.RegisterExternalTexture(SceneCapture->Output) : nullptr;
+		// e.g. an editor viewport that is resized, the previous output is stretched over the view until the view is refreshed
+		// instead of stylizing every view for every step of the resize
+		if (PreviousOutput && SceneCapture->OutputViewRect != SceneColor.ViewRect)
+		{
+			FRDGTextureDesc RescaledOutputDesc = SceneColor.Texture->Desc;
+			RescaledOutputDesc.Flags |= TexCreate_RenderTargetable | TexCreate_ShaderResource;
+			FScreenPassRenderTarget RescaledOutput(GraphBuilder.CreateTexture(RescaledOutputDesc, TEXT("StyleTransferRescaledSceneCaptureOutput")), SceneColor.ViewRect,
+			                                       ERenderTargetLoadAction::ENoAction);
+			AddRescalingTextureCopy(GraphBuilder, *PreviousOutput, RescaledOutput);
+			PreviousOutput = RescaledOutput.Texture;
+		}
+		return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, PreviousOutput);
+	}
+
+	RDG_EVENT_SCOPE(GraphBuilder, "SceneCapture");
+	++NumSceneCaptureInferences;
+	SceneCapture->LastStylizedFrame = FrameNumber;
+	SceneCapture->bRefreshRequested = false;
+
+	const int32 Context = SceneCapture->InferenceContext;
+
+	FNeuralTensor& ContentInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(Context, ContentInputTensorIndex);
+	ContentInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	::TextureToTensorRGB(GraphBuilder, SceneColor.Texture, ContentInputTensor, SceneColor.ViewRect);
+
+	// styles are only ever written to the fixed size context, or to the SceneCaptureStyleParamsBuffer without one
+	FNeuralTensor& StyleParamsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(Context, StyleParamsInputTensorIndex);
+	StyleParamsInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	FRDGBufferRef StyleParamsBuffer;
+	if (*InferenceContext != INDEX_NONE)
+	{
+		FNeuralTensor& StyleParamsTensor = StyleTransferNetwork->GetInputTensorForContextMutable(*InferenceContext, StyleParamsInputTensorIndex);
+		StyleParamsTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		StyleParamsBuffer = StyleParamsTensor.GetBufferSRVRef()->GetParent();
+	}
+	else
+	{
+		StyleParamsBuffer = GetSceneCaptureStyleParamsBuffer_RenderThread(GraphBuilder);
+	}
+	AddCopyBufferPass(GraphBuilder, StyleParamsInputTensor.GetBufferUAVRef()->GetParent(), StyleParamsBuffer);
+
+	if (StyleWeightsInputTensorIndex != INDEX_NONE)
+	{
+		// the style weights sources describe the main view, captures get the full style
+		FNeuralTensor& StyleWeightsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(Context, StyleWeightsInputTensorIndex);
+		StyleWeightsInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		const int32 NumStyleSets = GetNumStyleSets(StyleWeightsInputTensor);
+		if (NumStyleSets > 1)
+		{
+			const FIntPoint StyleWeightsSize(StyleWeightsInputTensor.GetSize(2), StyleWeightsInputTensor.GetSize(1));
+			::TextureToTensorGrayscale(GraphBuilder, FStyleTransferStyleWeights::CreateFullStyleMask(GraphBuilder, StyleWeightsSize, NumStyleSets), StyleWeightsInputTensor);
+		}
+		else
+		{
+			AddClearUAVFloatPass(GraphBuilder, StyleWeightsInputTensor.GetBufferUAVRef(), 1.f);
+		}
+	}
+
+	StyleTransferNetwork->Run(GraphBuilder, Context);
+
+	FNeuralTensor& OutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(Context, 0);
+	OutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	FRDGTexture* OutputTexture = TensorToTexture(GraphBuilder, SceneColor.Texture->Desc, OutputTensor);
+	GraphBuilder.QueueTextureExtraction(OutputTexture, &SceneCapture->Output);
+	SceneCapture->OutputViewRect = SceneColor.ViewRect;
+	return OutputToBackBuffer_RenderThread(GraphBuilder, SceneColor, InOutInputs, OutputTexture);
+}
+
+FRDGTexture* FStyleTransferSceneViewExtension::StylizeFoveated_RenderThread(FRDGBuilder& GraphBuilder, const FScreenPassTexture& SceneColor, int32 InsetContext, int32 PeripheryContext, FRDGTextureRef StyleWeightsMask)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "Foveated");
+
+	FNeuralTensor& InsetContentInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(InsetContext, ContentInputTensorIndex);
+	FNeuralTensor& InsetOutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(InsetContext, 0);
+	FNeuralTensor* InsetStyleWeightsInputTensor = StyleWeightsInputTensorIndex != INDEX_NONE
+		                                              ? &StyleTransferNetwork->GetInputTensorForContextMutable(InsetContext, StyleWeightsInputTensorIndex)
+		                                              : nullptr;
+	InsetOutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+
+	// the inset has the size of its content tensor so it is stylized at full resolution
+	const FIntRect ViewRect = SceneColor.ViewRect;
+	const FIntPoint ViewSize = ViewRect.Size();
+	const FIntPoint InsetSize = FIntPoint(FMath::Min<int32>(InsetContentInputTensor.GetSize(2), ViewSize.X), FMath::Min<int32>(InsetContentInputTensor.GetSize(1), ViewSize.Y));
+	const FIntPoint FocusPixel = ViewRect.Min + FIntPoint(FMath::RoundToInt(FoveatedFocus.X * ViewSize.X), FMath::RoundToInt(FoveatedFocus.Y * ViewSize.Y));
+	FIntPoint InsetMin = FocusPixel - InsetSize / 2;
+	InsetMin.X = FMath::Clamp(InsetMin.X, ViewRect.Min.X, ViewRect.Max.X - InsetSize.X);
+	InsetMin.Y = FMath::Clamp(InsetMin.Y, ViewRect.Min.Y, ViewRect.Max.Y - InsetSize.Y);
+	const FIntRect InsetRect(InsetMin, InsetMin + InsetSize);
+
+	FRDGTexture* PeripheryTexture;
+	{
+		RDG_EVENT_SCOPE(GraphBuilder, "Periphery");
+		// the downsampled view is stylized in its own smaller context and upsampled by the composite
+		FNeuralTensor& ContentInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(PeripheryContext, ContentInputTensorIndex);
+		FNeuralTensor& OutputTensor = StyleTransferNetwork->GetOutputTensorForContextMutable(PeripheryContext, 0);
+		ContentInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		OutputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		CopyStyleParams_RenderThread(GraphBuilder, PeripheryContext);
+
+		::TextureToTensorRGB(GraphBuilder, SceneColor.Texture, ContentInputTensor, ViewRect);
+		if (StyleWeightsInputTensorIndex != INDEX_NONE)
+		{
+			FNeuralTensor& StyleWeightsInputTensor = StyleTransferNetwork->GetInputTensorForContextMutable(PeripheryContext, StyleWeightsInputTensorIndex);
+			StyleWeightsInputTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+			::TextureToTensorGrayscale(GraphBuilder, StyleWeightsMask, StyleWeightsInputTensor);
+		}
+		StyleTransferNetwork->Run(GraphBuilder, PeripheryContext);
+		PeripheryTexture = TensorToTexture(GraphBuilder, SceneColor.Texture->Desc, OutputTensor);
+	}
+
+	FRDGTexture* InsetTexture;
+	{
+		RDG_EVENT_SCOPE(GraphBuilder, "Inset");
+		::TextureToTensorRGB(GraphBuilder, SceneColor.Texture, InsetContentInputTensor, InsetRect);
+		if (InsetStyleWeightsInputTensor)
+		{
+			// the mask covers the whole view at its own resolution
+			const FVector2f MaskScale = FVector2f(StyleWeightsMask->Desc.Extent) / FVector2f(ViewSize);
+			const FIntRect MaskInsetRect(
+				FIntPoint(FMath::FloorToInt((InsetRect.Min.X - ViewRect.Min.X) * MaskScale.X), FMath::FloorToInt((InsetRect.Min.Y - ViewRect.Min.Y) * MaskScale.Y)),
+				FIntPoint(FMath::CeilToInt((InsetRect.Max.X - ViewRect.Min.X) * MaskScale.X), FMath::CeilToInt((InsetRect.Max.Y - ViewRect.Min.Y) * MaskScale.Y)));
+			::TextureToTensorGrayscale(GraphBuilder, StyleWeightsMask, *InsetStyleWeightsInputTensor, MaskInsetRect);
+		}
+		StyleTransferNetwork->Run(GraphBuilder, InsetContext);
+		InsetTexture = TensorToTexture(GraphBuilder, SceneColor.Texture->Desc, InsetOutputTensor);
+	}
+
+	FRDGTextureDesc CompositeDesc = SceneColor.Texture->Desc;
+	CompositeDesc.Extent = ViewSize;
+	CompositeDesc.Flags |= TexCreate_RenderTargetable | TexCreate_UAV;
+	FRDGTexture* CompositeTexture = GraphBuilder.CreateTexture(CompositeDesc, TEXT("FoveatedComposite"));
+
+	FFoveatedCompositeCS::FParameters* Parameters = GraphBuilder.AllocParameters<FFoveatedCompositeCS::FParameters>();
+	Parameters->PeripheryTexture = PeripheryTexture;
+	Parameters->InsetTexture = InsetTexture;
+	Parameters->BilinearSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+	Parameters->OutputTexture = GraphBuilder.CreateUAV(CompositeTexture);
+	Parameters->OutputDimensions = ViewSize;
+	Parameters->InsetUVMin = FVector2f(InsetRect.Min - ViewRect.Min) / FVector2f(ViewSize);
+	Parameters->InsetUVSize = FVector2f(InsetSize) / FVector2f(ViewSize);
+	Parameters->BlendStart = FMath::Clamp(CVarFoveatedBlendStart.GetValueOnRenderThread(), 0.f, 0.99f);
+
+	const FFoveatedCompositeCS::FPermutationDomain PermutationVector;
+	const FIntVector ThreadGroupSize = FFoveatedCompositeCS::GetThreadGroupSize(PermutationVector);
+	TShaderMapRef<FFoveatedCompositeCS> FoveatedCompositeCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	FComputeShaderUtils::AddPass(
+		GraphBuilder,
+		RDG_EVENT_NAME("FoveatedComposite"),
+		FoveatedCompositeCS,
+		Parameters,
+		FComputeShaderUtils::GetGroupCount(ViewSize, FIntPoint(ThreadGroupSize.X, ThreadGroupSize.Y)));
+
+	return CompositeTexture;
+}
+
+void FStyleTransferSceneViewExtension::CopyStyleParams_RenderThread(FRDGBuilder& GraphBuilder, int32 Context) const
+{
+	FNeuralTensor& StyleParamsTensor = StyleTransferNetwork->GetInputTensorForContextMutable(*InferenceContext, StyleParamsInputTensorIndex);
+	FNeuralTensor& TargetStyleParamsTensor = StyleTransferNetwork->GetInputTensorForContextMutable(Context, StyleParamsInputTensorIndex);
+	StyleParamsTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	TargetStyleParamsTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	AddCopyBufferPass(GraphBuilder, TargetStyleParamsTensor.GetBufferUAVRef()->GetParent(), StyleParamsTensor.GetBufferSRVRef()->GetParent());
+}
+
+FScreenPassTexture FStyleTransferSceneViewExtension::OutputTensorToBackBuffer_RenderThread(FRDGBuilder& GraphBuilder, const FScreenPassTexture& SceneColor, const FPostProcessMaterialInputs& InOutInputs, const FNeuralTensor& OutputTensor)
+{
+	// the override output is usually the back buffer which often does not allow unordered access
+	const FRDGTextureDesc& OutputDesc = InOutInputs.OverrideOutput.IsValid() ? InOutInputs.OverrideOutput.Texture->Desc : SceneColor.Texture->Desc;
+	if (!UE::PixelFormat::HasCapabilities(OutputDesc.Format, EPixelFormatCapabilities::TypedUAVStore)
+		|| (InOutInputs.OverrideOutput.IsValid() && !EnumHasAnyFlags(OutputDesc.Flags, TexCreate_UAV)))
+	{
+		return FScreenPassTexture();
+	}
+
+	FScreenPassRenderTarget Output;
+	if (InOutInputs.OverrideOutput.IsValid())
+	{
+		Output = InOutInputs.OverrideOutput;
+		OutputTextureMemory = 0;
+	}
+	else
+	{
+		FRDGTextureDesc StyleTransferOutputDesc = OutputDesc;
+		StyleTransferOutputDesc.Flags |= TexCreate_UAV;
+		Output = FScreenPassRenderTarget(GraphBuilder.CreateTexture(StyleTransferOutputDesc, TEXT("StyleTransferOutput")), SceneColor.ViewRect, ERenderTargetLoadAction::ENoAction);
+		OutputTextureMemory = static_cast<int64>(StyleTransferOutputDesc.Extent.X) * StyleTransferOutputDesc.Extent.Y * GPixelFormats[StyleTransferOutputDesc.Format].BlockBytes;
+	}
+
+	const FIntPoint OutputRectSize = Output.ViewRect.Size();
+	FOutputTensorToTargetCS::FParameters* Parameters = GraphBuilder.AllocParameters<FOutputTensorToTargetCS::FParameters>();
+	Parameters->InputTensor = OutputTensor.GetBufferSRVRef();
+	Parameters->TensorSize = FIntPoint(OutputTensor.GetSize(2), OutputTensor.GetSize(1));
+	Parameters->OutputTexture = GraphBuilder.CreateUAV(Output.Texture);
+	Parameters->OutputRectMin = Output.ViewRect.Min;
+	Parameters->OutputRectSize = OutputRectSize;
+
+	const FOutputTensorToTargetCS::FPermutationDomain PermutationVector;
+	const FIntVector ThreadGroupSize = FOutputTensorToTargetCS::GetThreadGroupSize(PermutationVector);
+	TShaderMapRef<FOutputTensorToTargetCS> OutputTensorToTargetCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	FComputeShaderUtils::AddPass(
+		GraphBuilder,
+		RDG_EVENT_NAME("OutputTensorToTarget(%ix%i)", OutputRectSize.X, OutputRectSize.Y),
+		OutputTensorToTargetCS,
+		Parameters,
+		FComputeShaderUtils::GetGroupCount(OutputRectSize, FIntPoint(ThreadGroupSize.X, ThreadGroupSize.Y)));
+
+	return MoveTemp(Output);
+}
+
+FScreenPassTexture FStyleTransferSceneViewExtension::OutputToBackBuffer_RenderThread(FRDGBuilder& GraphBuilder, const FScreenPassTexture& SceneColor, const FPostProcessMaterialInputs& InOutInputs, FRDGTexture* StylizedTexture)
+{
+	if (!StylizedTexture)
+	{
+		if (!InOutInputs.OverrideOutput.IsValid())
+			return SceneColor;
+
+		FScreenPassRenderTarget BackBufferRenderTarget = InOutInputs.OverrideOutput;
+		AddRescalingTextureCopy(GraphBuilder, *SceneColor.Texture, BackBufferRenderTarget);
+		return MoveTemp(BackBufferRenderTarget);
+	}
+
+	const FRDGTextureDesc& OutputTextureDesc = StylizedTexture->Desc;
+	OutputTextureMemory = static_cast<int64>(OutputTextureDesc.Extent.X) * OutputTextureDesc.Extent.Y * GPixelFormats[OutputTextureDesc.Format].BlockBytes;
+
+	// stylized textures cover the view with their whole extent, e.g. the output tensor or the foveated composite, whatever the origin of the view rect
+	TSharedPtr<FScreenPassRenderTarget> StyleTransferOutputTarget = MakeShared<FScreenPassRenderTarget>(StylizedTexture, FIntRect(FIntPoint::ZeroValue, OutputTextureDesc.Extent),
 	                                                                                                    ERenderTargetLoadAction::EClear);
 
 
@@ -404,17 +1298,23 @@ FScreenPassTexture FStyleTransferSceneViewExtension::PostProcessPassAfterTonemap
 
 		AddRescalingTextureCopy(GraphBuilder, *StyleTransferOutputTarget->Texture, *BackBufferRenderTarget);
 	}
+	else if (ViewStrength < 1.f)
+	{
+		// the stylized texture may be the persistent output of a scene capture, so it is not blended in place
+		FRDGTextureDesc BlendedOutputDesc = SceneColor.Texture->Desc;
+		BlendedOutputDesc.Flags |= TexCreate_RenderTargetable | TexCreate_ShaderResource;
+		BackBufferRenderTarget = MakeShared<FScreenPassRenderTarget>(GraphBuilder.CreateTexture(BlendedOutputDesc, TEXT("StyleTransferBlendedOutput")), SceneColor.ViewRect,
+		                                                             ERenderTargetLoadAction::ENoAction);
+		AddRescalingTextureCopy(GraphBuilder, *StyleTransferOutputTarget->Texture, *BackBufferRenderTarget);
+	}
 	else
 	{
 		BackBufferRenderTarget = StyleTransferOutputTarget;
 	}
 
-	if (RenderCaptureProvider)
+	if (ViewStrength < 1.f)
 	{
-		/*GraphBuilder.AddPass(RDG_EVENT_NAME("EndCapture"), ERDGPassFlags::None, [RenderCaptureProvider](FRHICommandListImmediate& RHICommandList)
-		{
-			RenderCaptureProvider->EndCapture(&RHICommandList);
-		});*/
+		AddRescalingTextureCopy(GraphBuilder, *SceneColor.Texture, *BackBufferRenderTarget, 1.f - ViewStrength);
 	}
 
 	return MoveTemp(*BackBufferRenderTarget);
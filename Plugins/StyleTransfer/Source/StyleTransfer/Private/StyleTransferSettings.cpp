@@ -3,7 +3,27 @@
 
 #include "StyleTransferSettings.h"
 
+FSimpleMulticastDelegate UStyleTransferSettings::OnSettingsChanged;
+
 UStyleTransferSettings::UStyleTransferSettings()
 {
 	this->CategoryName = NAME_Game;
 }
+
+#if WITH_EDITOR
+void UStyleTransferSettings::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	// dragging a value would otherwise reload networks and predict styles every frame
+	if (PropertyChangedEvent.ChangeType != EPropertyChangeType::Interactive)
+	{
+		OnSettingsChanged.Broadcast();
+	}
+}
+#endif
+
+void UStyleTransferSettings::PostReloadConfig(FProperty* PropertyThatWasLoaded)
+{
+	Super::PostReloadConfig(PropertyThatWasLoaded);
+	OnSettingsChanged.Broadcast();
+}
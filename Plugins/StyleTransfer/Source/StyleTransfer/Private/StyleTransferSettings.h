@@ -7,6 +7,58 @@
 #include "UObject/Object.h"
 #include "StyleTransferSettings.generated.h"
 
+UENUM()
+enum class EStyleTransferStyleWeightsSource : uint8
+{
+	/** The screen shadow mask, only available if the renderer provides it this frame */
+	ShadowMask,
+	/** 1 where something is rendered into custom depth, 0 elsewhere */
+	CustomDepth,
+	/**
+	 * The red channel of the StyleWeightsTexture, e.g. a render target a material is drawn into.
+	 * With StyleRegions its red, green and blue channel select the regions in order.
+	 */
+	Texture,
+	/** StyleWeightsConstant everywhere */
+	Constant,
+	/** 1 where something is drawn with custom stencil, with StyleRegions the StencilValue of each region selects it */
+	CustomStencil,
+};
+
+USTRUCT()
+struct FStyleTransferStyleRegion
+{
+	GENERATED_BODY()
+
+	/** Index into the StyleTextures */
+	UPROPERTY(EditAnywhere, meta=(ClampMin=0))
+	int32 StyleIndex = 0;
+
+	/** Custom stencil value of the region if the StyleWeightsSource is CustomStencil */
+	UPROPERTY(EditAnywhere, meta=(ClampMin=1, ClampMax=255))
+	int32 StencilValue = 1;
+};
+
+USTRUCT()
+struct FStyleTransferNetworkLOD
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere)
+	TSoftObjectPtr<UNeuralNetwork> Network = nullptr;
+
+	/** Expected GPU time of one inference in milliseconds. Used to pick a LOD for r.StyleTransfer.NetworkLOD.TargetMs. */
+	UPROPERTY(EditAnywhere, meta=(ClampMin=0))
+	float CostMs = 0.f;
+
+	/**
+	 * Index of the predicted style parameter to use for each style_params element of this network.
+	 * Only needed if the network has fewer style parameters than the StylePredictionNetwork predicts.
+	 */
+	UPROPERTY(EditAnywhere)
+	TArray<int32> StyleParamsMapping;
+};
+
 /**
  *
  */
@@ -17,9 +69,36 @@ class STYLETRANSFER_API UStyleTransferSettings : public UDeveloperSettings
 public:
 	UStyleTransferSettings();
 
+	// - UObject
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+	virtual void PostReloadConfig(FProperty* PropertyThatWasLoaded) override;
+	// --
+
+	/** Broadcast on the game thread after the settings were edited or their config was reloaded */
+	static FSimpleMulticastDelegate OnSettingsChanged;
+
+	int32 GetNumNetworkLODs() const { return StyleTransferNetworkLODs.Num() + 1; }
+	const TSoftObjectPtr<UNeuralNetwork>& GetNetworkLOD(int32 LOD) const { return LOD == 0 ? StyleTransferNetwork : StyleTransferNetworkLODs[LOD - 1].Network; }
+	float GetNetworkLODCostMs(int32 LOD) const { return LOD == 0 ? StyleTransferNetworkCostMs : StyleTransferNetworkLODs[LOD - 1].CostMs; }
+	TConstArrayView<int32> GetNetworkLODStyleParamsMapping(int32 LOD) const { return LOD == 0 ? TConstArrayView<int32>() : StyleTransferNetworkLODs[LOD - 1].StyleParamsMapping; }
+
 	UPROPERTY(EditAnywhere, Config)
 	TSoftObjectPtr<UNeuralNetwork> StyleTransferNetwork = nullptr;
 
+	/** Expected GPU time of one inference of the StyleTransferNetwork in milliseconds. */
+	UPROPERTY(EditAnywhere, Config, meta=(ClampMin=0))
+	float StyleTransferNetworkCostMs = 0.f;
+
+	/** Cheaper variants of the StyleTransferNetwork ordered by decreasing quality. The StyleTransferNetwork itself is LOD 0, these are LOD 1 and up. */
+	UPROPERTY(EditAnywhere, Config)
+	TArray<FStyleTransferNetworkLOD> StyleTransferNetworkLODs;
+
+	/** Network LOD to use for each sg.PostProcessQuality level if neither r.StyleTransfer.NetworkLOD nor r.StyleTransfer.NetworkLOD.TargetMs is set. */
+	UPROPERTY(EditAnywhere, Config)
+	TArray<int32> NetworkLODPerPostProcessQuality;
+
 	UPROPERTY(EditAnywhere, Config)
 	TSoftObjectPtr<UNeuralNetwork> StylePredictionNetwork = nullptr;
 
@@ -28,4 +107,46 @@ public:
 
 	UPROPERTY(EditAnywhere, Config)
 	FRuntimeFloatCurve InterpolationCurve;
+
+	/** If set views are only stylized inside post process volumes with a Style Transfer Blendable, otherwise they are stylized with full strength outside of them. */
+	UPROPERTY(EditAnywhere, Config)
+	bool bRequirePostProcessVolume = false;
+
+	/** Where the style_weights input of the StyleTransferNetwork comes from if it has one. */
+	UPROPERTY(EditAnywhere, Config)
+	EStyleTransferStyleWeightsSource StyleWeightsSource = EStyleTransferStyleWeightsSource::ShadowMask;
+
+	UPROPERTY(EditAnywhere, Config, meta=(EditCondition="StyleWeightsSource==EStyleTransferStyleWeightsSource::Texture"))
+	TSoftObjectPtr<UTexture> StyleWeightsTexture = nullptr;
+
+	UPROPERTY(EditAnywhere, Config, meta=(EditCondition="StyleWeightsSource==EStyleTransferStyleWeightsSource::Constant", ClampMin=0, ClampMax=1))
+	float StyleWeightsConstant = 1.f;
+
+	/**
+	 * Only used if the StyleTransferNetwork takes several stacked style parameter sets and one style_weights channel per set.
+	 * The current style is the first set, region i is set i + 1 and the style weights select where each set is used in a single inference.
+	 * At most 3 regions are used because the style weights mask has 4 channels.
+	 */
+	UPROPERTY(EditAnywhere, Config)
+	TArray<FStyleTransferStyleRegion> StyleRegions;
+
+	/** Set if the content input of the StyleTransferNetwork has dynamic spatial dimensions so the content tensor can follow the view size. */
+	UPROPERTY(EditAnywhere, Config)
+	bool bDynamicContentShape = false;
+
+	/** Set if the inputs and the output of the StyleTransferNetwork have a dynamic batch dimension so offline renders can stylize several frames per inference. */
+	UPROPERTY(EditAnywhere, Config)
+	bool bDynamicBatchSize = false;
+
+	/** The content tensor size is a multiple of this. Should match the total downsampling factor of the StyleTransferNetwork. */
+	UPROPERTY(EditAnywhere, Config, meta=(EditCondition="bDynamicContentShape", ClampMin=1))
+	int32 ContentShapeStride = 8;
+
+	/** Relative difference between the view size and the content tensor size that is tolerated before the content tensor is resized. */
+	UPROPERTY(EditAnywhere, Config, meta=(EditCondition="bDynamicContentShape", ClampMin=0, ClampMax=1))
+	float ContentShapeHysteresis = 0.1f;
+
+	/** Number of content tensor sizes whose inference contexts are kept alive so switching back to them is cheap. */
+	UPROPERTY(EditAnywhere, Config, meta=(EditCondition="bDynamicContentShape", ClampMin=1))
+	int32 NumCachedContentShapes = 3;
 };
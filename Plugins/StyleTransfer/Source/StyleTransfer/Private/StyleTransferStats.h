@@ -0,0 +1,31 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Stats/Stats.h"
+
+class UNeuralNetwork;
+
+LLM_DECLARE_TAG(StyleTransfer);
+
+DECLARE_STATS_GROUP(TEXT("StyleTransfer"), STATGROUP_StyleTransfer, STATCAT_Advanced);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Style Transfer Contexts"), STAT_StyleTransfer_TransferContextMemory, STATGROUP_StyleTransfer, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Style Prediction Contexts"), STAT_StyleTransfer_PredictionContextMemory, STATGROUP_StyleTransfer, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Output Textures"), STAT_StyleTransfer_OutputTextureMemory, STATGROUP_StyleTransfer, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Total"), STAT_StyleTransfer_TotalMemory, STATGROUP_StyleTransfer, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Resident Styles"), STAT_StyleTransfer_NumResidentStyles, STATGROUP_StyleTransfer, );
+
+namespace StyleTransferMemory
+{
+	/**
+	 * Size of the input and output tensors every inference context of the network allocates.
+	 * NNI does not expose the size of the intermediate tensors so they are not included.
+	 */
+	int64 GetInferenceContextSize(const UNeuralNetwork* Network);
+
+	/** @return the value of r.StyleTransfer.MemoryBudgetMB in bytes or 0 if there is no budget */
+	int64 GetBudget();
+}
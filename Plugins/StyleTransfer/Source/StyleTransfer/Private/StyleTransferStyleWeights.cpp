@@ -0,0 +1,199 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferStyleWeights.h"
+
+#include "SceneView.h"
+#include "ScreenPass.h"
+#include "StyleTransferModule.h"
+#include "StyleWeightsMaskCS.h"
+#include "SystemTextures.h"
+#include "Engine/Texture.h"
+#include "PostProcess/PostProcessing.h"
+#include "PostProcess/PostProcessMaterial.h"
+
+TAutoConsoleVariable<int32> CVarStyleWeightsDownsample(
+	TEXT("r.StyleTransfer.StyleWeights.Downsample"),
+	2,
+	TEXT("The style weights mask is generated at this many times lower resolution than the style_weights tensor")
+);
+
+TAutoConsoleVariable<int32> CVarStyleWeightsMaxAge(
+	TEXT("r.StyleTransfer.StyleWeights.MaxAge"),
+	0,
+	TEXT("If greater than 0 the style weights are only generated if the view or the main light moved more than the thresholds or they are this many frames old")
+);
+
+TAutoConsoleVariable<float> CVarStyleWeightsLocationThreshold(
+	TEXT("r.StyleTransfer.StyleWeights.LocationThreshold"),
+	10.f,
+	TEXT("Distance in cm the view has to move before the style weights are generated again if r.StyleTransfer.StyleWeights.MaxAge is set")
+);
+
+TAutoConsoleVariable<float> CVarStyleWeightsAngleThreshold(
+	TEXT("r.StyleTransfer.StyleWeights.AngleThreshold"),
+	1.f,
+	TEXT("Angle in degrees the view or the main light has to rotate before the style weights are generated again if r.StyleTransfer.StyleWeights.MaxAge is set")
+);
+
+void FStyleTransferStyleWeights::SetSource_RenderThread(EStyleTransferStyleWeightsSource InSource, float InConstant, UTexture* InTexture, FUintVector4 InStencilValues)
+{
+	check(IsInRenderingThread());
+	Source = InSource;
+	Constant = InConstant;
+	Texture = InTexture;
+	StencilValues = InStencilValues;
+	bSourceChanged = true;
+	bReportedMissingSource = false;
+}
+
+FVector FStyleTransferStyleWeights::GetMainLightDirection(const FViewInfo& View)
+{
+	// the view uniform buffer holds the direction of the scene's main directional light, zero if it has none
+	if (!View.CachedViewUniformShaderParameters)
+		return FVector::ZeroVector;
+
+	return FVector(View.CachedViewUniformShaderParameters->DirectionalLightDirection);
+}
+
+bool FStyleTransferStyleWeights::NeedsUpdate(const FViewInfo& View, const FVector& LightDirection) const
+{
+	const int32 MaxAge = CVarStyleWeightsMaxAge.GetValueOnRenderThread();
+	if (MaxAge <= 0)
+		return true;
+
+	// a constant does not depend on the view
+	if (Source == EStyleTransferStyleWeightsSource::Constant)
+		return false;
+
+	if (View.Family->FrameNumber - LastUpdateFrame >= static_cast<uint32>(MaxAge))
+		return true;
+
+	const float CosAngleThreshold = FMath::Cos(FMath::DegreesToRadians(CVarStyleWeightsAngleThreshold.GetValueOnRenderThread()));
+	return FVector::Dist(View.ViewLocation, LastViewLocation) > CVarStyleWeightsLocationThreshold.GetValueOnRenderThread()
+		|| (View.ViewRotation.Vector() | LastViewRotation.Vector()) < CosAngleThreshold
+		|| (LightDirection | LastLightDirection) < CosAngleThreshold;
+}
+
+FRDGTextureRef FStyleTransferStyleWeights::Update_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FPostProcessMaterialInputs& Inputs, FIntPoint TensorSize, int32 NumStyles, bool bForce)
+{
+	check(IsInRenderingThread());
+
+	const FVector LightDirection = GetMainLightDirection(View);
+	if (!bForce && !bSourceChanged && !NeedsUpdate(View, LightDirection))
+		return nullptr;
+
+	FStyleWeightsMaskCS::EMode Mode = FStyleWeightsMaskCS::EMode::Red;
+	FScreenPassTexture Input;
+	FRDGTextureSRVRef CustomStencil = nullptr;
+	switch (Source)
+	{
+	case EStyleTransferStyleWeightsSource::ShadowMask:
+		// the post process inputs do not carry the shadow mask, only the renderer global does
+		Input = FScreenPassTexture(GScreenShadowMaskTexture, View.ViewRect);
+		break;
+	case EStyleTransferStyleWeightsSource::CustomDepth:
+		Mode = FStyleWeightsMaskCS::EMode::Coverage;
+		if (Inputs.SceneTextures.SceneTextures)
+		{
+			Input = FScreenPassTexture(Inputs.SceneTextures.SceneTextures->GetParameters()->CustomDepthTexture, View.ViewRect);
+		}
+		break;
+	case EStyleTransferStyleWeightsSource::Texture:
+		if (Texture && Texture->GetResource() && Texture->GetResource()->TextureRHI)
+		{
+			Input = FScreenPassTexture(GraphBuilder.RegisterExternalTexture(CreateRenderTarget(Texture->GetResource()->TextureRHI, TEXT("StyleWeightsTexture"))));
+		}
+		if (NumStyles > 1)
+		{
+			Mode = FStyleWeightsMaskCS::EMode::Channels;
+		}
+		break;
+	case EStyleTransferStyleWeightsSource::Constant:
+		Mode = FStyleWeightsMaskCS::EMode::Constant;
+		break;
+	case EStyleTransferStyleWeightsSource::CustomStencil:
+		if (Inputs.SceneTextures.SceneTextures)
+		{
+			CustomStencil = Inputs.SceneTextures.SceneTextures->GetParameters()->CustomStencilTexture;
+			Input = FScreenPassTexture(Inputs.SceneTextures.SceneTextures->GetParameters()->CustomDepthTexture, View.ViewRect);
+		}
+		break;
+	}
+
+	float MaskConstant = Constant;
+	if (Mode != FStyleWeightsMaskCS::EMode::Constant && (!Input.IsValid() || (Source == EStyleTransferStyleWeightsSource::CustomStencil && !CustomStencil)))
+	{
+		if (!bReportedMissingSource)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("The style weights source %s is not available, keeping the previous style weights"), *UEnum::GetValueAsString(Source));
+			bReportedMissingSource = true;
+		}
+		if (!bForce)
+			return nullptr;
+
+		// the tensor never got any weights, full style is the least surprising default
+		Mode = FStyleWeightsMaskCS::EMode::Constant;
+		MaskConstant = NumStyles > 1 ? 0.f : 1.f;
+		CustomStencil = nullptr;
+	}
+
+	bSourceChanged = false;
+	LastViewLocation = View.ViewLocation;
+	LastViewRotation = View.ViewRotation;
+	LastLightDirection = LightDirection;
+	LastUpdateFrame = View.Family->FrameNumber;
+
+	return AddMaskPass(GraphBuilder, Input, CustomStencil, Mode, MaskConstant, TensorSize, NumStyles, StencilValues, *UEnum::GetValueAsString(Source));
+}
+
+FRDGTextureRef FStyleTransferStyleWeights::CreateFullStyleMask(FRDGBuilder& GraphBuilder, FIntPoint TensorSize, int32 NumStyles)
+{
+	// with several styles the constant is the weight of the second one
+	return AddMaskPass(GraphBuilder, FScreenPassTexture(), nullptr, FStyleWeightsMaskCS::EMode::Constant, NumStyles > 1 ? 0.f : 1.f, TensorSize, NumStyles, FUintVector4(0, 0, 0, 0), TEXT("FullStyle"));
+}
+
+FRDGTextureRef FStyleTransferStyleWeights::AddMaskPass(FRDGBuilder& GraphBuilder, const FScreenPassTexture& Input, FRDGTextureSRVRef CustomStencil, FStyleWeightsMaskCS::EMode Mode, float Constant,
+                                                       FIntPoint TensorSize, int32 NumStyles, FUintVector4 StencilValues, const TCHAR* SourceName)
+{
+	check(NumStyles >= 1 && NumStyles <= FStyleWeightsMaskCS::MaxStyles);
+	const int32 Downsample = FMath::Max(CVarStyleWeightsDownsample.GetValueOnRenderThread(), 1);
+	const FIntPoint MaskSize = FIntPoint::DivideAndRoundUp(TensorSize, Downsample);
+	FRDGTextureRef Mask = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(MaskSize, NumStyles > 1 ? PF_FloatRGBA : PF_R16F, FClearValueBinding::Black, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("StyleTransferStyleWeightsMask"));
+
+	FStyleWeightsMaskCS::FParameters* Parameters = GraphBuilder.AllocParameters<FStyleWeightsMaskCS::FParameters>();
+	Parameters->InputTexture = Input.IsValid() ? Input.Texture : GSystemTextures.GetBlackDummy(GraphBuilder);
+	Parameters->InputTextureSampler = TStaticSamplerState<SF_Bilinear>::GetRHI();
+	Parameters->CustomStencilTexture = CustomStencil;
+	Parameters->OutputTexture = GraphBuilder.CreateUAV(Mask);
+	Parameters->OutputDimensions = MaskSize;
+	if (Input.IsValid())
+	{
+		const FIntPoint InputExtent = Input.Texture->Desc.Extent;
+		Parameters->InputUVOffset = FVector2f(Input.ViewRect.Min) / FVector2f(InputExtent);
+		Parameters->InputUVScale = FVector2f(Input.ViewRect.Size()) / FVector2f(InputExtent);
+	}
+	else
+	{
+		Parameters->InputUVOffset = FVector2f::ZeroVector;
+		Parameters->InputUVScale = FVector2f::UnitVector;
+	}
+	Parameters->Mode = static_cast<uint32>(Mode);
+	Parameters->Constant = Constant;
+	Parameters->NumStyles = NumStyles;
+	Parameters->StencilValues = StencilValues;
+
+	FStyleWeightsMaskCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FStyleWeightsMaskCS::FCustomStencilDimension>(CustomStencil != nullptr);
+	const FIntVector ThreadGroupSize = FStyleWeightsMaskCS::GetThreadGroupSize(PermutationVector);
+	TShaderMapRef<FStyleWeightsMaskCS> StyleWeightsMaskCS(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+	FComputeShaderUtils::AddPass(
+		GraphBuilder,
+		RDG_EVENT_NAME("StyleWeightsMask(%s %ix%i)", SourceName, MaskSize.X, MaskSize.Y),
+		StyleWeightsMaskCS,
+		Parameters,
+		FComputeShaderUtils::GetGroupCount(MaskSize, FIntPoint(ThreadGroupSize.X, ThreadGroupSize.Y)));
+
+	return Mask;
+}
\ No newline at end of file
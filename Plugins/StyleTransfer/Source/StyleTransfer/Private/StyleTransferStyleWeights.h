@@ -0,0 +1,59 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+#include "StyleTransferSettings.h"
+#include "StyleWeightsMaskCS.h"
+
+class FViewInfo;
+class UTexture;
+struct FPostProcessMaterialInputs;
+struct FScreenPassTexture;
+
+/**
+ * Generates the mask for the style_weights input from the configured source.
+ * The mask is generated at r.StyleTransfer.StyleWeights.Downsample times lower resolution than the tensor and upsampled by the packing.
+ * With r.StyleTransfer.StyleWeights.MaxAge the previous weights are kept until the view or the main light moved enough or they got too old.
+ * Only used on the render thread after construction.
+ */
+class FStyleTransferStyleWeights
+{
+public:
+	/**
+	 * StyleWeightsTexture is only used by EStyleTransferStyleWeightsSource::Texture and has to stay alive while it is set.
+	 * StencilValues are the custom stencil values of the styles after the first one for EStyleTransferStyleWeightsSource::CustomStencil.
+	 */
+	void SetSource_RenderThread(EStyleTransferStyleWeightsSource InSource, float InConstant, UTexture* InTexture, FUintVector4 InStencilValues);
+
+	/**
+	 * @param TensorSize X is the width of the style_weights tensor
+	 * @param NumStyles number of style parameter sets the network takes, the mask has one channel per set
+	 * @param bForce set if the weights have to be generated because the tensor did not get them yet
+	 * @return the new mask or nullptr if the previous weights are kept
+	 */
+	FRDGTextureRef Update_RenderThread(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FPostProcessMaterialInputs& Inputs, FIntPoint TensorSize, int32 NumStyles, bool bForce);
+
+	/** A mask that applies only the first style with full strength, e.g. for views the sources do not describe */
+	static FRDGTextureRef CreateFullStyleMask(FRDGBuilder& GraphBuilder, FIntPoint TensorSize, int32 NumStyles);
+
+private:
+	static FRDGTextureRef AddMaskPass(FRDGBuilder& GraphBuilder, const FScreenPassTexture& Input, FRDGTextureSRVRef CustomStencil, FStyleWeightsMaskCS::EMode Mode, float Constant,
+	                                  FIntPoint TensorSize, int32 NumStyles, FUintVector4 StencilValues, const TCHAR* SourceName);
+
+	bool NeedsUpdate(const FViewInfo& View, const FVector& LightDirection) const;
+	static FVector GetMainLightDirection(const FViewInfo& View);
+
+	EStyleTransferStyleWeightsSource Source = EStyleTransferStyleWeightsSource::ShadowMask;
+	float Constant = 1.f;
+	UTexture* Texture = nullptr;
+	FUintVector4 StencilValues = FUintVector4(0, 0, 0, 0);
+	bool bSourceChanged = true;
+
+	FVector LastViewLocation = FVector::ZeroVector;
+	FRotator LastViewRotation = FRotator::ZeroRotator;
+	FVector LastLightDirection = FVector::ZeroVector;
+	uint32 LastUpdateFrame = 0;
+	bool bReportedMissingSource = false;
+};
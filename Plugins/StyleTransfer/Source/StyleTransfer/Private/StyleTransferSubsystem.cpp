@@ -5,12 +5,26 @@
 
 #include "IRenderCaptureProvider.h"
 #include "NeuralNetwork.h"
+#include "QuantizeTensorCS.h"
 #include "RenderGraphUtils.h"
 #include "ScreenPass.h"
+#include "StyleTransferAutotuner.h"
+#include "StyleTransferBatchRenderer.h"
+#include "StyleTransferContentShapeCache.h"
+#include "StyleTransferCpuExecutor.h"
+#include "StyleTransferMath.h"
 #include "StyleTransferModule.h"
 #include "StyleTransferSceneViewExtension.h"
 #include "StyleTransferSettings.h"
+#include "StyleTransferStats.h"
+#include "StyleWeightsMaskCS.h"
+#include "SystemTextures.h"
+#include "ImageWriteQueue.h"
 #include "TextureCompiler.h"
+#include "Algo/AllOf.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Engine/GameInstance.h"
+#include "Engine/TextureRenderTarget2D.h"
 #include "Rendering/Texture2DResource.h"
 
 TAutoConsoleVariable<bool> CVarStyleTransferEnabled(
@@ -25,45 +39,240 @@ TAutoConsoleVariable<bool> CVarAutoCaptureStylePrediction(
 	TEXT("Set to true to enable style transfer auto capture for profiling in PIX etc.")
 );
 
+TAutoConsoleVariable<bool> CVarStyleTransferInterpolateStyles(
+	TEXT("r.StyleTransfer.InterpolateStyles"),
+	false,
+	TEXT("Set to true to continuously interpolate between the first two styles using the InterpolationCurve from the settings")
+);
+
+TAutoConsoleVariable<bool> CVarQuantizeStyles(
+	TEXT("r.StyleTransfer.QuantizeStyles"),
+	false,
+	TEXT("Set to true to store resident styles with 8 bit per style param instead of keeping their style prediction context. Saves memory at the cost of some precision. Applies to styles predicted afterwards")
+);
+
+TAutoConsoleVariable<int32> CVarStyleInputCacheSize(
+	TEXT("r.StyleTransfer.StyleInputCache.Size"),
+	8,
+	TEXT("Number of style textures whose packed style prediction input is kept so predicting their style again does not resample them. 0 disables the cache")
+);
+
+TAutoConsoleVariable<int32> CVarLiveStyleUpdateInterval(
+	TEXT("r.StyleTransfer.LiveStyle.UpdateInterval"),
+	4,
+	TEXT("Number of frames between two style predictions from a live style render target")
+);
+
+TAutoConsoleVariable<bool> CVarWarmUpOnInitialize(
+	TEXT("r.StyleTransfer.WarmUpOnInitialize"),
+	false,
+	TEXT("Set to true to load the networks and run one dummy frame while the game instance is initialized so the first stylized frame does not hitch")
+);
+
+TAutoConsoleVariable<int32> CVarNetworkLOD(
+	TEXT("r.StyleTransfer.NetworkLOD"),
+	-1,
+	TEXT("Forces the style transfer network LOD. -1 selects it by r.StyleTransfer.NetworkLOD.TargetMs or sg.PostProcessQuality")
+);
+
+TAutoConsoleVariable<float> CVarNetworkLODTargetMs(
+	TEXT("r.StyleTransfer.NetworkLOD.TargetMs"),
+	0.f,
+	TEXT("If greater than 0 the highest quality network LOD whose CostMs fits into this many milliseconds is used")
+);
+
+TAutoConsoleVariable<bool> CVarInferenceWorker(
+	TEXT("r.StyleTransfer.InferenceWorker"),
+	false,
+	TEXT("Set to true to run the style transfer network in a separate worker process that exchanges the tensors through shared memory. Takes effect when stylizing starts")
+);
+
+TAutoConsoleVariable<bool> CVarCpuExecution(
+	TEXT("r.StyleTransfer.CPU"),
+	false,
+	TEXT("Set to true to run the style transfer network on the CPU, e.g. on machines without a capable GPU. The style prediction stays on the GPU. Takes effect when the networks are loaded")
+);
+
+TAutoConsoleVariable<bool> CVarAutotuneOnFirstLaunch(
+	TEXT("r.StyleTransfer.Autotune.OnFirstLaunch"),
+	true,
+	TEXT("Set to true to measure the thread group sizes of the style transfer kernels during warm up if there are no results for this GPU yet")
+);
+
+FAutoConsoleCommandWithWorldAndArgs StyleTransferRecordCommand(
+	TEXT("r.StyleTransfer.Record"),
+	TEXT("Records the packed network inputs of the next stylized frames so they can be replayed with -run=StyleTransferReplay.\n")
+	TEXT("Usage: r.StyleTransfer.Record [NumFrames=100] [FilePath]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UStyleTransferSubsystem* StyleTransferSubsystem = World && World->GetGameInstance() ? World->GetGameInstance()->GetSubsystem<UStyleTransferSubsystem>() : nullptr;
+		if (!StyleTransferSubsystem)
+			return;
+
+		const int32 NumFrames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100;
+		StyleTransferSubsystem->StartRecording(NumFrames, Args.Num() > 1 ? Args[1] : FString());
+	})
+);
+
+static int64 GetQuantizedStyleParamsSize(const UNeuralNetwork* StylePredictionNetwork)
+{
+	const uint32 Volume = CastNarrowingSafe<uint32>(StylePredictionNetwork->GetOutputTensor(0).Num());
+	return FMath::DivideAndRoundUp(Volume, 4u) * sizeof(uint32) + FMath::DivideAndRoundUp(Volume, FQuantizeTensorCS::ValuesPerBlock) * 2 * sizeof(float);
+}
+
+static int32 FindInputTensorIndex(const UNeuralNetwork* Network, const TCHAR* TensorName)
+{
+	for (uint32 i = 0; i < Network->GetInputTensorNumber(); ++i)
+	{
+		if (Network->GetInputTensor(i).GetName() == TensorName)
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+static int32 FindStyleParamsInputIndex(const UNeuralNetwork* Network)
+{
+	return FindInputTensorIndex(Network, TEXT("style_params"));
+}
+
+/** Networks with one style_weights channel per style take that many stacked style param sets */
+static int32 GetNumStyleSets(const UNeuralNetwork* Network)
+{
+	for (uint32 i = 0; i < Network->GetInputTensorNumber(); ++i)
+	{
+		const FNeuralTensor& Tensor = Network->GetInputTensor(i);
+		if (Tensor.GetName() == "style_weights")
+			return FMath::Max(CastNarrowingSafe<int32>(Tensor.GetSize(3)), 1);
+	}
+	return 1;
+}
+
+BEGIN_SHADER_PARAMETER_STRUCT(FCopyBufferParameters,)
+	RDG_BUFFER_ACCESS(SrcBuffer, ERHIAccess::CopySrc)
+	RDG_BUFFER_ACCESS(DstBuffer, ERHIAccess::CopyDest)
+END_SHADER_PARAMETER_STRUCT()
+
+static void AddCopyStyleParamsPass(FRDGBuilder& GraphBuilder, FRDGBufferRef DstBuffer, FRDGBufferRef SrcBuffer, uint64 NumBytes, uint64 DstOffset = 0, uint64 SrcOffset = 0)
+{
+	FCopyBufferParameters* Parameters = GraphBuilder.AllocParameters<FCopyBufferParameters>();
+	Parameters->SrcBuffer = SrcBuffer;
+	Parameters->DstBuffer = DstBuffer;
+
+	GraphBuilder.AddPass(
+		RDG_EVENT_NAME("CopyBuffer(%s Size=%ubytes)", Parameters->SrcBuffer->Name, Parameters->SrcBuffer->Desc.GetSize()),
+		Parameters,
+		ERDGPassFlags::Copy,
+		[Parameters, NumBytes, DstOffset, SrcOffset](FRHICommandList& RHICmdList)
+		{
+			RHICmdList.CopyBufferRegion(Parameters->DstBuffer->GetRHI(), DstOffset, Parameters->SrcBuffer->GetRHI(), SrcOffset, NumBytes);
+		});
+}
 
 void UStyleTransferSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+	InitializeStyleTransfer();
+}
+
+#if WITH_EDITOR
+UStyleTransferSubsystem* UStyleTransferSubsystem::CreateForEditor(UObject* Outer)
+{
+	// game instance subsystems have to live in a game instance, this one is never initialized and only serves as outer
+	UGameInstance* GameInstance = NewObject<UGameInstance>(Outer, NAME_None, RF_Transient);
+	UStyleTransferSubsystem* Subsystem = NewObject<UStyleTransferSubsystem>(GameInstance, NAME_None, RF_Transient);
+	Subsystem->bEditorPreview = true;
+	Subsystem->InitializeStyleTransfer();
+	return Subsystem;
+}
+#endif
 
+void UStyleTransferSubsystem::InitializeStyleTransfer()
+{
 	CVarStyleTransferEnabled->OnChangedDelegate().AddUObject(this, &UStyleTransferSubsystem::HandleConsoleVariableChanged);
+	SettingsChangedHandle = UStyleTransferSettings::OnSettingsChanged.AddUObject(this, &UStyleTransferSubsystem::HandleSettingsChanged);
+	UpdateAppliedSettings();
+	BuildInterpolationLUT();
+
+	if (CVarWarmUpOnInitialize.GetValueOnGameThread())
+	{
+		WarmUp();
+	}
 }
 
 void UStyleTransferSubsystem::Deinitialize()
 {
+	CVarStyleTransferEnabled->OnChangedDelegate().RemoveAll(this);
+	UStyleTransferSettings::OnSettingsChanged.Remove(SettingsChangedHandle);
+
+	// nobody may wait forever, the continuations of the network loads finish their style requests first
+	for (const TSharedRef<TPromise<bool>>& Promise : MoveTemp(LoadNetworksPromises))
+	{
+		Promise->SetValue(false);
+	}
+	TArray<int32> StyleRequestIds;
+	StyleRequests.GetKeys(StyleRequestIds);
+	for (const int32 RequestId : StyleRequestIds)
+	{
+		FinishStyleRequest(RequestId, INDEX_NONE);
+	}
+	if (NetworkLODPromise)
+	{
+		NetworkLODPromise->SetValue(false);
+		NetworkLODPromise.Reset();
+	}
+
 	StopStylizingViewport();
+	ENQUEUE_RENDER_COMMAND(StyleTransferReleaseStyleInputCache)([this](FRHICommandListImmediate&)
+	{
+		StyleInputCache_RenderThread.Empty();
+		StyleInputCacheMemory = 0;
+	});
+	FlushRenderingCommands();
+	TickRenderThreadCallbacks(true);
+
+	// the ticker keeps ticking until the subsystem is collected, e.g. the one of the editor preview, so it must not create contexts anymore
+	bDeinitialized = true;
+	StyleTransferNetwork = nullptr;
+	StylePredictionNetwork = nullptr;
+	LoadedNetworkLODs.Reset();
+	NetworkLODLoadHandles.Reset();
 
 	Super::Deinitialize();
 }
 
 bool UStyleTransferSubsystem::Tick(float DeltaTime)
 {
-	return false;
+	if (bDeinitialized)
+		return true;
+
+	bViewBlendedOut = StyleTransferSceneViewExtension && StyleTransferSceneViewExtension->IsBlendedOut();
+	TickRenderThreadCallbacks();
+	TickNetworkLOD();
+	TickWarmUp();
+	TickLiveStyle();
+	TickVolumeStyle();
+	UpdateMemoryStats();
+
+	// the interpolated style would not be visible in a blended out view
+	if (!CVarStyleTransferInterpolateStyles.GetValueOnGameThread() || bLiveStyleActive || bViewBlendedOut)
+		return true;
+
 	if (!GetWorld())
 		return true;
 
 
-	if (StylePredictionInferenceContexts.Num() > 1)
+	if (ResidentStyles.Num() > 1)
 	{
-		const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
-		const FRichCurve* InterpCurve = StyleTransferSettings->InterpolationCurve.GetRichCurveConst();
-		float MinTime, MaxTime;
-		InterpCurve->GetTimeRange(MinTime, MaxTime);
-		const double Time = MinTime + FMath::Fmod(GetWorld()->GetTimeSeconds(), static_cast<double>(MaxTime - MinTime));
-		const float Alpha = InterpCurve->Eval(Time);
+		const float Alpha = SampleInterpolationLUT(GetWorld()->GetTimeSeconds());
 		UE_LOG(LogStyleTransfer, VeryVerbose, TEXT("Alpha is %0.4f"), Alpha);
-		InterpolateStyles(StylePredictionInferenceContexts[0], StylePredictionInferenceContexts[1], Alpha);
+		InterpolateStyles(ResidentStyles[0].Handle, ResidentStyles[1].Handle, Alpha);
 	}
 	return true;
 }
 
 void UStyleTransferSubsystem::StartStylizingViewport(FViewportClient* ViewportClient)
 {
-	if (!StylePredictionNetwork->IsLoaded() || !StyleTransferNetwork->IsLoaded())
+	if (!StylePredictionNetwork || !StylePredictionNetwork->IsLoaded() || !StyleTransferNetwork || !StyleTransferNetwork->IsLoaded())
 	{
 		UE_LOG(LogStyleTransfer, Error, TEXT("Not all networks were loaded, can not stylize viewport."));
 		return;
@@ -73,18 +282,21 @@ void UStyleTransferSubsystem::StartStylizingViewport(FViewportClient* ViewportCl
 	{
 		const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
 
-		if (!StyleTransferInferenceContext || *StyleTransferInferenceContext == INDEX_NONE)
+		if (!EnsureStyleTransferInferenceContext())
 		{
-			UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for StyleTransfer"));
-			StyleTransferInferenceContext = MakeShared<int32>(StyleTransferNetwork->CreateInferenceContext());
-			checkf(*StyleTransferInferenceContext != INDEX_NONE, TEXT("Could not create inference context for StyleTransferNetwork"));
+			UE_LOG(LogStyleTransfer, Error, TEXT("Could not create the style transfer inference context, can not stylize viewport."));
+			return;
 		}
 
 		for (uint32 i = 0; i < uint32(StyleTransferSettings->StyleTextures.Num()); ++i)
 		{
 			UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for Style %i"), i);
-			const int32& StylePredictionInferenceContext = StylePredictionInferenceContexts.Emplace_GetRef(StylePredictionNetwork->CreateInferenceContext());
-			checkf(StylePredictionInferenceContext != INDEX_NONE, TEXT("Could not create inference context for StylePredictionNetwork"));
+			const int32 StylePredictionInferenceContext = CreateStylePredictionInferenceContext();
+			if (StylePredictionInferenceContext == INDEX_NONE)
+			{
+				UE_LOG(LogStyleTransfer, Warning, TEXT("Only %i of %i styles are resident because of the memory budget"), i, StyleTransferSettings->StyleTextures.Num());
+				break;
+			}
 
 			UTexture2D* StyleTexture = StyleTransferSettings->StyleTextures[i].LoadSynchronous();
 			//UTexture2D* StyleTexture = LoadObject<UTexture2D>(this, TEXT("/Script/Engine.Texture2D'/StyleTransfer/T_StyleImage.T_StyleImage'"));
@@ -92,10 +304,54 @@ void UStyleTransferSubsystem::StartStylizingViewport(FViewportClient* ViewportCl
 			FTextureCompilingManager::Get().FinishCompilation({StyleTexture});
 #endif
 			UpdateStyle(StyleTexture, i, StylePredictionInferenceContext);
+			AddResidentStyle(StylePredictionInferenceContext, true);
+			++NumSettingsStyles;
 		}
 		//UpdateStyle(FPaths::GetPath("C:\\projects\\realtime-style-transfer\\temp\\style_params_tensor.bin"));
 		UE_LOG(LogStyleTransfer, Log, TEXT("Creating FStyleTransferSceneViewExtension"));
 		StyleTransferSceneViewExtension = FSceneViewExtensions::NewExtension<FStyleTransferSceneViewExtension>(ViewportClient->GetWorld(), ViewportClient, StyleTransferNetwork, StyleTransferInferenceContext.ToSharedRef());
+		StylizedViewportClient = ViewportClient;
+		StyleTransferSceneViewExtension->SetSceneCapturesOnly(bEditorPreview);
+		if (bEditorPreview)
+		{
+			// the style params are kept by the extension, see EnsureStyleTransferInferenceContext
+			UpdateStyleParamsTarget();
+		}
+
+		if (CpuExecutor)
+		{
+			StyleTransferSceneViewExtension->SetCpuExecutor(CpuExecutor);
+		}
+
+		ApplyStyleWeightsSettings();
+		UpdateRegionalStyles();
+		StyleTransferSceneViewExtension->SetFoveatedFocus(FVector2f(FoveatedFocus));
+		StyleTransferSceneViewExtension->SetRequirePostProcessVolume(StyleTransferSettings->bRequirePostProcessVolume);
+
+		const bool bUseInferenceWorker = CVarInferenceWorker.GetValueOnGameThread() && !CpuExecutor;
+		StyleTransferSceneViewExtension->SetUseInferenceWorker(bUseInferenceWorker);
+
+		for (FStylizedSceneCapture& SceneCapture : StylizedSceneCaptures)
+		{
+			RegisterSceneCapture(SceneCapture);
+		}
+
+		if (StyleTransferSettings->bDynamicContentShape && (bUseInferenceWorker || CpuExecutor))
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("bDynamicContentShape is ignored because the inference worker and the CPU execution need fixed tensor sizes"));
+		}
+		// the added views of the editor preview have their own content sizes and nothing else is stylized
+		else if (StyleTransferSettings->bDynamicContentShape && !bEditorPreview)
+		{
+			ContentShapeCache = MakeShared<FStyleTransferContentShapeCache>(StyleTransferNetwork, [this](int64 AdditionalBytes)
+			{
+				return IsWithinMemoryBudget(AdditionalBytes);
+			}, [this](TFunction<void()> Callback)
+			{
+				RunAfterRenderThread(MoveTemp(Callback));
+			});
+			StyleTransferSceneViewExtension->SetContentShapeCache(ContentShapeCache);
+		}
 	}
 	if (StyleTransferSceneViewExtension)
 	{
@@ -105,179 +361,1974 @@ void UStyleTransferSubsystem::StartStylizingViewport(FViewportClient* ViewportCl
 
 void UStyleTransferSubsystem::StopStylizingViewport()
 {
+	StopBatchRendering();
+	ReleaseSceneCaptureContexts();
+	if (bEditorPreview && StyleTransferInferenceContext)
+	{
+		// the style params target references the extension, which is released on the game thread
+		StyleTransferInferenceContext.Reset();
+		UpdateStyleParamsTarget();
+	}
 	FlushRenderingCommands();
+	TickRenderThreadCallbacks(true);
 	StyleTransferSceneViewExtension.Reset();
-	if (StylePredictionInferenceContexts.Num())
+	VolumeStyleIndex = INDEX_NONE;
+	StyleWeightsTexture = nullptr;
+	ContentShapeCache.Reset();
+	if (CpuExecutor)
+	{
+		CpuExecutor.Reset();
+		StyleTransferInferenceContext.Reset();
+		UpdateStyleParamsTarget();
+	}
+	// the rendering commands were flushed, so no prediction is enqueued anymore
+	++LiveStyleGeneration;
+	bLiveStyleParamsPending = false;
+	bLiveStylePredictionInFlight = false;
+	if (WarmUpStylePredictionInferenceContext != INDEX_NONE)
+	{
+		UE_LOG(LogStyleTransfer, Log, TEXT("Style transfer warm up was cancelled"));
+		DestroyStylePredictionInferenceContext(WarmUpStylePredictionInferenceContext);
+		OnStyleTransferReady.Broadcast(false);
+	}
+	DestroyStylePredictionInferenceContext(LiveStylePredictionInferenceContext);
+	for (FResidentStyle& Style : ResidentStyles)
+	{
+		DestroyStylePredictionInferenceContext(Style.StylePredictionInferenceContext);
+	}
+	ResidentStyles.Reset();
+	NumSettingsStyles = 0;
+	LatestSettingsStyleRequests.Reset();
+	if (QuantizedStyleMemory > 0)
 	{
-		for (auto It = StylePredictionInferenceContexts.CreateIterator(); It; ++It)
+		ENQUEUE_RENDER_COMMAND(StyleTransferReleaseQuantizedStyles)([this](FRHICommandListImmediate&)
 		{
-			StylePredictionNetwork->DestroyInferenceContext(*It);
-			It.RemoveCurrent();
-		}
+			QuantizedStyleParams_RenderThread.Reset();
+		});
+		QuantizedStyleMemory = 0;
 	}
 	if (StyleTransferInferenceContext && *StyleTransferInferenceContext != INDEX_NONE)
 	{
 		StyleTransferNetwork->DestroyInferenceContext(*StyleTransferInferenceContext);
 		*StyleTransferInferenceContext = INDEX_NONE;
 		StyleTransferInferenceContext.Reset();
+		UpdateStyleParamsTarget();
 	}
+	UpdateMemoryStats();
 }
 
-BEGIN_SHADER_PARAMETER_STRUCT(FCopyBufferParameters,)
-	RDG_BUFFER_ACCESS(SrcBuffer, ERHIAccess::CopySrc)
-	RDG_BUFFER_ACCESS(DstBuffer, ERHIAccess::CopyDest)
-END_SHADER_PARAMETER_STRUCT()
+void UStyleTransferSubsystem::SetFoveatedFocus(FVector2D ViewUV)
+{
+	FoveatedFocus = FVector2D(FMath::Clamp(ViewUV.X, 0., 1.), FMath::Clamp(ViewUV.Y, 0., 1.));
+	if (StyleTransferSceneViewExtension)
+	{
+		StyleTransferSceneViewExtension->SetFoveatedFocus(FVector2f(FoveatedFocus));
+	}
+}
 
-void UStyleTransferSubsystem::UpdateStyle(UTexture2D* StyleTexture, uint32 StyleIndex, int32 StylePredictionInferenceContext)
+bool UStyleTransferSubsystem::StartBatchRendering(FStyleTransferBatchRenderOptions Options)
 {
-	checkf(StyleTransferInferenceContext.IsValid() && (*StyleTransferInferenceContext) != INDEX_NONE, TEXT("Can not infer style without inference context"));
-	checkf(StylePredictionInferenceContext != INDEX_NONE, TEXT("Can not update style without inference context"));
-	FlushRenderingCommands();
-	ENQUEUE_RENDER_COMMAND(StylePrediction)([this, StyleTexture, StylePredictionInferenceContext, StyleIndex](FRHICommandListImmediate& RHICommandList)
+	if (!(StyleTransferNetwork && StylePredictionNetwork))
 	{
-		IRenderCaptureProvider* RenderCaptureProvider = ConditionalBeginRenderCapture(RHICommandList);
-		FRDGBuilder GraphBuilder(RHICommandList);
+		LoadNetworks();
+	}
+	if (bCpuExecution)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Batch rendering is not available with r.StyleTransfer.CPU"));
+		return false;
+	}
+
+	if (!LoadedNetworkLODs.IsValidIndex(0))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Can not batch render because the networks are not loaded"));
+		return false;
+	}
+
+	// the best LOD for every frame, loaded right away since offline renders can wait
+	if (!IsBatchRendering())
+	{
+		RequestedNetworkLODBeforeBatch = RequestedNetworkLOD;
+	}
+	RequestedNetworkLOD = 0;
+	if (CurrentNetworkLOD != 0 && CVarNetworkLOD.GetValueOnGameThread() < 0)
+	{
+		if (!LoadedNetworkLODs[0])
 		{
-			RDG_EVENT_SCOPE(GraphBuilder, "StylePrediction");
+			PrepareNetworkLOD(0, GetDefault<UStyleTransferSettings>()->StyleTransferNetwork.LoadSynchronous());
+		}
+		if (LoadedNetworkLODs[0])
+		{
+			SwitchNetworkLOD(0, LoadedNetworkLODs[0]);
+		}
+		if (CurrentNetworkLOD != 0)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Batch rendering with network LOD %i because LOD 0 can not be used"), CurrentNetworkLOD);
+		}
+	}
 
-			FNeuralTensor& InputStyleImageTensor = StylePredictionNetwork->GetInputTensorForContextMutable(StylePredictionInferenceContext, 0);
-			FNeuralTensor& InputStyleParams = StyleTransferNetwork->GetInputTensorForContextMutable(*StyleTransferInferenceContext, StyleTransferStyleParamsInputIndex);
-			InputStyleImageTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
-			InputStyleParams.GPUToRDGBuilder_RenderThread(&GraphBuilder);
-			FTextureResource* StyleTextureResource = StyleTexture->GetResource();
-			FRDGTextureRef RDGStyleTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(StyleTextureResource->TextureRHI, TEXT("StyleInputTexture")));
-			FStyleTransferSceneViewExtension::TextureToTensorRGB(GraphBuilder, RDGStyleTexture, InputStyleImageTensor);
+	if (!StyleTransferSceneViewExtension)
+	{
+		UGameViewportClient* GameViewportClient = GetGameInstance()->GetGameViewportClient();
+		if (!GameViewportClient)
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Can not batch render without a game viewport"));
+			return false;
+		}
+		StartStylizingViewport(GameViewportClient);
+	}
+	if (!StyleTransferSceneViewExtension)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Can not batch render because style transfer could not be started"));
+		return false;
+	}
 
+	BatchRenderOptions = MoveTemp(Options);
+	return CreateBatchRenderer();
+}
 
+void UStyleTransferSubsystem::StopBatchRendering()
+{
+	if (!BatchRenderer)
+		return;
 
-			StylePredictionNetwork->Run(GraphBuilder, StylePredictionInferenceContext);
+	StyleTransferSceneViewExtension->FlushBatchRenderer();
+	FModuleManager::LoadModuleChecked<IImageWriteQueueModule>("ImageWriteQueue").GetWriteQueue().CreateFence().Wait();
+	ReleaseBatchRenderer();
+	BatchRenderOptions = FStyleTransferBatchRenderOptions();
+	RequestedNetworkLOD = RequestedNetworkLODBeforeBatch;
+	UE_LOG(LogStyleTransfer, Log, TEXT("Stopped batch rendering"));
+}
 
+bool UStyleTransferSubsystem::CreateBatchRenderer()
+{
+	ReleaseBatchRenderer();
 
-			FNeuralTensor& OutputStyleParams = StylePredictionNetwork->GetOutputTensorForContextMutable(StylePredictionInferenceContext, 0);
-			FRDGBufferRef OutputStyleParamsBuffer = OutputStyleParams.GetBufferSRVRef()->GetParent();
-			FRDGBufferRef InputStyleParamsBuffer = InputStyleParams.GetBufferUAVRef()->GetParent();
-			const uint64 NumBytes = OutputStyleParams.NumInBytes();
-			const uint64 DstOffset = StyleIndex * NumBytes;
+	const bool bDynamicBatchSize = GetDefault<UStyleTransferSettings>()->bDynamicBatchSize;
+	BatchSize = bDynamicBatchSize ? FMath::Max(BatchRenderOptions.BatchSize, 1) : 1;
+	if (!bDynamicBatchSize && BatchRenderOptions.BatchSize > 1)
+	{
+		UE_LOG(LogStyleTransfer, Log, TEXT("Stylizing one frame per inference because the StyleTransferNetwork has no dynamic batch dimension"));
+	}
 
+	if (!IsWithinMemoryBudget(BatchSize * StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork)))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Not creating Inference Context for a batch of %i frames because it exceeds r.StyleTransfer.MemoryBudgetMB"), BatchSize);
+		return false;
+	}
 
-			FCopyBufferParameters* Parameters = GraphBuilder.AllocParameters<FCopyBufferParameters>();
-			Parameters->SrcBuffer = OutputStyleParamsBuffer;
-			Parameters->DstBuffer = InputStyleParamsBuffer;
+	UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for a batch of %i frames"), BatchSize);
+	LLM_SCOPE_BYTAG(StyleTransfer);
+	BatchInferenceContext = StyleTransferNetwork->CreateInferenceContext();
+	checkf(BatchInferenceContext != INDEX_NONE, TEXT("Could not create batch inference context for StyleTransferNetwork"));
+	FStyleTransferBatchRenderer::ResizeBatchTensors(StyleTransferNetwork, BatchInferenceContext, BatchSize);
+	BatchRenderer = MakeShared<FStyleTransferBatchRenderer, ESPMode::ThreadSafe>(StyleTransferNetwork, BatchInferenceContext, BatchSize, BatchRenderOptions.FileNameFormat);
+	StyleTransferSceneViewExtension->SetBatchRenderer(BatchRenderer, BatchRenderOptions.GetFrameNumber);
+	UpdateMemoryStats();
+	return true;
+}
 
-			GraphBuilder.AddPass(
-				RDG_EVENT_NAME("CopyBuffer(%s Size=%ubytes)", Parameters->SrcBuffer->Name, Parameters->SrcBuffer->Desc.GetSize()),
-				Parameters,
-				ERDGPassFlags::Copy,
-				[Parameters, NumBytes, DstOffset](FRHICommandList& RHICmdList)
-				{
-					RHICmdList.CopyBufferRegion(Parameters->DstBuffer->GetRHI(), /*DstOffset*/ 0, Parameters->SrcBuffer->GetRHI(), 0, NumBytes);
-				});
-		}
-		GraphBuilder.Execute();
+void UStyleTransferSubsystem::ReleaseBatchRenderer()
+{
+	if (!BatchRenderer)
+		return;
 
-		if (RenderCaptureProvider)
-		{
-			RenderCaptureProvider->EndCapture(&RHICommandList);
-		}
+	if (StyleTransferSceneViewExtension)
+	{
+		StyleTransferSceneViewExtension->SetBatchRenderer(nullptr, nullptr);
+	}
+	RunAfterRenderThread([PreviousBatchRenderer = BatchRenderer, Network = BatchRenderer->GetNetwork(), PreviousBatchInferenceContext = BatchInferenceContext]() mutable
+	{
+		PreviousBatchRenderer.Reset();
+		Network->DestroyInferenceContext(PreviousBatchInferenceContext);
 	});
-
-	FlushRenderingCommands();
+	BatchRenderer.Reset();
+	BatchInferenceContext = INDEX_NONE;
+	UpdateMemoryStats();
 }
 
-void UStyleTransferSubsystem::UpdateStyle(FString StyleTensorDataPath)
+void UStyleTransferSubsystem::AddStylizedSceneCapture(USceneCaptureComponent2D* SceneCapture, FIntPoint InferenceResolution, int32 UpdateInterval)
 {
-	FArchive& FileReader = *IFileManager::Get().CreateFileReader(*StyleTensorDataPath);
-	TArray<float> StyleParams;
-	StyleParams.SetNumUninitialized(2758); // hardcoded for brevity reasons
+	if (!SceneCapture)
+		return;
 
-	FileReader << StyleParams;
+	RemoveStylizedSceneCapture(SceneCapture);
+	// the extension tells the views of the capture apart by their view state
+	SceneCapture->bAlwaysPersistRenderingState = true;
 
-	ENQUEUE_RENDER_COMMAND(StyleParamsLoad)([this, StyleParams = MoveTemp(StyleParams)](FRHICommandListImmediate& RHICommandList)
+	FStylizedSceneCapture& StylizedSceneCapture = StylizedSceneCaptures.AddDefaulted_GetRef();
+	StylizedSceneCapture.Component = SceneCapture;
+	StylizedSceneCapture.InferenceResolution = InferenceResolution.ComponentMax(FIntPoint(1, 1));
+	StylizedSceneCapture.UpdateInterval = FMath::Max(UpdateInterval, 0);
+	if (StyleTransferSceneViewExtension)
 	{
-		const FNeuralTensor& InputStyleParams = StyleTransferNetwork->GetInputTensorForContext(*StyleTransferInferenceContext, StyleTransferStyleParamsInputIndex);
+		RegisterSceneCapture(StylizedSceneCapture);
+	}
+}
 
-		FRDGBuilder GraphBuilder(RHICommandList);
+void UStyleTransferSubsystem::RemoveStylizedSceneCapture(USceneCaptureComponent2D* SceneCapture)
+{
+	// captures that were destroyed without being removed are dropped as well
+	for (auto It = StylizedSceneCaptures.CreateIterator(); It; ++It)
+	{
+		if (!It->AddedView && (It->Component == SceneCapture || !It->Component.IsValid()))
 		{
-			RDG_EVENT_SCOPE(GraphBuilder, "StyleParamsLoad");
-
-			FRDGBufferRef InputStyleParamsBuffer = GraphBuilder.RegisterExternalBuffer(InputStyleParams.GetPooledBuffer());
-			GraphBuilder.QueueBufferUpload(InputStyleParamsBuffer, StyleParams.GetData(), StyleParams.Num() * StyleParams.GetTypeSize(), ERDGInitialDataFlags::NoCopy);
+			UnregisterSceneCapture(*It);
+			It.RemoveCurrent();
 		}
-		GraphBuilder.Execute();
-	});
-	FlushRenderingCommands();
+	}
 }
 
-void UStyleTransferSubsystem::HandleConsoleVariableChanged(IConsoleVariable* ConsoleVariable)
+void UStyleTransferSubsystem::AddStylizedView(const FSceneViewStateInterface* ViewState, FIntPoint InferenceResolution)
 {
-	check(ConsoleVariable == CVarStyleTransferEnabled.AsVariable());
+	if (!ViewState)
+		return;
 
-	StopStylizingViewport();
+	RemoveStylizedView(ViewState);
 
-	if (CVarStyleTransferEnabled->GetBool())
+	FStylizedSceneCapture& StylizedView = StylizedSceneCaptures.AddDefaulted_GetRef();
+	StylizedView.AddedView = ViewState;
+	StylizedView.InferenceResolution = InferenceResolution.ComponentMax(FIntPoint(1, 1));
+	StylizedView.UpdateInterval = INDEX_NONE;
+	if (StyleTransferSceneViewExtension)
+	{
+		RegisterSceneCapture(StylizedView);
+	}
+}
+
+void UStyleTransferSubsystem::RemoveStylizedView(const FSceneViewStateInterface* ViewState)
+{
+	for (auto It = StylizedSceneCaptures.CreateIterator(); It; ++It)
 	{
-		if (!(StyleTransferNetwork || StylePredictionNetwork))
+		if (It->AddedView == ViewState)
 		{
-			LoadNetworks();
+			UnregisterSceneCapture(*It);
+			It.RemoveCurrent();
 		}
-		StartStylizingViewport(GetGameInstance()->GetGameViewportClient());
 	}
 }
 
-void UStyleTransferSubsystem::LoadNetworks()
+void UStyleTransferSubsystem::RefreshStylizedView(const FSceneViewStateInterface* ViewState)
 {
-	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
-	StyleTransferNetwork = StyleTransferSettings->StyleTransferNetwork.LoadSynchronous();
-	StylePredictionNetwork = StyleTransferSettings->StylePredictionNetwork.LoadSynchronous();
+	if (StyleTransferSceneViewExtension)
+	{
+		StyleTransferSceneViewExtension->RefreshSceneCapture(ViewState);
+	}
+}
+
+void UStyleTransferSubsystem::RegisterSceneCapture(FStylizedSceneCapture& SceneCapture)
+{
+	check(StyleTransferSceneViewExtension);
+	if (bCpuExecution)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Scene captures are not stylized with r.StyleTransfer.CPU"));
+		return;
+	}
+
+	USceneCaptureComponent2D* Component = SceneCapture.Component.Get();
+	const FSceneViewStateInterface* ViewState = SceneCapture.AddedView ? SceneCapture.AddedView : Component ? Component->GetViewState(0) : nullptr;
+	if (!ViewState)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Scene capture %s is not stylized because it has no view state"), *GetNameSafe(Component));
+		return;
+	}
 
-	if (StyleTransferNetwork->IsLoaded())
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	const FIntPoint ContentSize = StyleTransferSettings->bDynamicContentShape
+		                              ? FStyleTransferContentShapeCache::GetContentSizeForView(SceneCapture.InferenceResolution, StyleTransferSettings->ContentShapeStride)
+		                              : FIntPoint::ZeroValue;
+	FSceneCaptureContext* Context = SceneCaptureContexts.FindByPredicate([ContentSize](const FSceneCaptureContext& Entry)
+	{
+		return Entry.ContentSize == ContentSize;
+	});
+	if (!Context)
 	{
-		for (int32 i = 0; i < StyleTransferNetwork->GetInputTensorNumber(); ++i)
+		const int64 Memory = ContentSize == FIntPoint::ZeroValue
+			                     ? StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork)
+			                     : FStyleTransferContentShapeCache::GetContextSize(StyleTransferNetwork, ContentSize);
+		if (!IsWithinMemoryBudget(Memory))
 		{
-			const FNeuralTensor& InputTensor = StyleTransferNetwork->GetInputTensor(i);
-			if (InputTensor.GetName() != "style_params")
-				continue;
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Scene capture %s is not stylized because its context exceeds r.StyleTransfer.MemoryBudgetMB"), *GetNameSafe(Component));
+			return;
+		}
 
-			StyleTransferStyleParamsInputIndex = i;
-			break;
+		UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for scene captures with content size %ix%i"), ContentSize.X, ContentSize.Y);
+		LLM_SCOPE_BYTAG(StyleTransfer);
+		Context = &SceneCaptureContexts.AddDefaulted_GetRef();
+		Context->ContentSize = ContentSize;
+		Context->InferenceContext = StyleTransferNetwork->CreateInferenceContext();
+		Context->Memory = Memory;
+		checkf(Context->InferenceContext != INDEX_NONE, TEXT("Could not create scene capture inference context for StyleTransferNetwork"));
+		if (ContentSize != FIntPoint::ZeroValue)
+		{
+			FStyleTransferContentShapeCache::ResizeTensors(StyleTransferNetwork, Context->InferenceContext, ContentSize);
 		}
-		StyleTransferNetwork->SetDeviceType(ENeuralDeviceType::GPU, ENeuralDeviceType::GPU, ENeuralDeviceType::GPU);
 	}
-	else
+
+	++Context->NumUsers;
+	SceneCapture.ContentSize = ContentSize;
+	SceneCapture.ViewState = ViewState;
+	StyleTransferSceneViewExtension->AddSceneCapture(ViewState, Context->InferenceContext, ContentSize, SceneCapture.UpdateInterval);
+	UpdateMemoryStats();
+}
+
+void UStyleTransferSubsystem::UnregisterSceneCapture(FStylizedSceneCapture& SceneCapture)
+{
+	if (!SceneCapture.ContentSize.IsSet())
+		return;
+
+	if (StyleTransferSceneViewExtension)
 	{
-		UE_LOG(LogStyleTransfer, Error, TEXT("StyleTransferNetwork could not be loaded"));
+		StyleTransferSceneViewExtension->RemoveSceneCapture(SceneCapture.ViewState);
 	}
 
+	const int32 ContextIndex = SceneCaptureContexts.IndexOfByPredicate([ContentSize = SceneCapture.ContentSize.GetValue()](const FSceneCaptureContext& Entry)
+	{
+		return Entry.ContentSize == ContentSize;
+	});
+	if (ContextIndex != INDEX_NONE && --SceneCaptureContexts[ContextIndex].NumUsers == 0)
+	{
+		RunAfterRenderThread([Network = StyleTransferNetwork.Get(), InferenceContext = SceneCaptureContexts[ContextIndex].InferenceContext]()
+		{
+			Network->DestroyInferenceContext(InferenceContext);
+		});
+		SceneCaptureContexts.RemoveAt(ContextIndex);
+	}
+	SceneCapture.ContentSize.Reset();
+	SceneCapture.ViewState = nullptr;
+	UpdateMemoryStats();
+}
 
-	if (StylePredictionNetwork->IsLoaded())
+void UStyleTransferSubsystem::ReleaseSceneCaptureContexts()
+{
+	for (FStylizedSceneCapture& SceneCapture : StylizedSceneCaptures)
 	{
-		StyleTransferNetwork->SetDeviceType(ENeuralDeviceType::GPU, ENeuralDeviceType::GPU, ENeuralDeviceType::GPU);
+		SceneCapture.ContentSize.Reset();
+		SceneCapture.ViewState = nullptr;
 	}
-	else
+	for (const FSceneCaptureContext& Context : SceneCaptureContexts)
 	{
-		UE_LOG(LogStyleTransfer, Error, TEXT("StylePredictionNetwork could not be loaded."));
+		RunAfterRenderThread([Network = StyleTransferNetwork.Get(), InferenceContext = Context.InferenceContext]()
+		{
+			Network->DestroyInferenceContext(InferenceContext);
+		});
+	}
+	SceneCaptureContexts.Reset();
+}
+
+int64 UStyleTransferSubsystem::GetSceneCaptureContextMemory() const
+{
+	int64 Memory = 0;
+	for (const FSceneCaptureContext& Context : SceneCaptureContexts)
+	{
+		Memory += Context.Memory;
+	}
+	return Memory;
+}
+
+void UStyleTransferSubsystem::StartRecording(int32 NumFrames, FString FilePath)
+{
+	if (!StyleTransferSceneViewExtension)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Can not record style transfer inputs while no viewport is stylized"));
+		return;
+	}
+
+	if (FilePath.IsEmpty())
+	{
+		FilePath = FPaths::ProfilingDir() / TEXT("StyleTransfer") / FString::Printf(TEXT("Recording_%s.strec"), *FDateTime::Now().ToString());
+	}
+	StyleTransferSceneViewExtension->StartRecording(FilePath, FMath::Max(NumFrames, 1));
+}
+
+bool UStyleTransferSubsystem::EnsureStyleTransferInferenceContext()
+{
+	// every view of the editor preview has its own context, so the full size one would only cost memory
+	if (bEditorPreview)
+	{
+		if (!StyleTransferInferenceContext)
+		{
+			StyleTransferInferenceContext = MakeShared<int32>(INDEX_NONE);
+		}
+		return true;
+	}
+
+	if (bCpuExecution)
+	{
+		if (!CpuExecutor)
+		{
+			UE_LOG(LogStyleTransfer, Log, TEXT("Creating CPU executor for StyleTransfer"));
+			CpuExecutor = MakeShared<FStyleTransferCpuExecutor, ESPMode::ThreadSafe>(StyleTransferNetwork);
+			// the extension still expects an inference context, it stays unused
+			StyleTransferInferenceContext = MakeShared<int32>(INDEX_NONE);
+			UpdateStyleParamsTarget();
+		}
+		return true;
+	}
+
+	if (!StyleTransferInferenceContext || *StyleTransferInferenceContext == INDEX_NONE)
+	{
+		if (!IsWithinMemoryBudget(StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork)))
+		{
+			UE_LOG(LogStyleTransfer, Error, TEXT("Not creating Inference Context for StyleTransfer because it exceeds r.StyleTransfer.MemoryBudgetMB"));
+			return false;
+		}
+
+		UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for StyleTransfer"));
+		LLM_SCOPE_BYTAG(StyleTransfer);
+		StyleTransferInferenceContext = MakeShared<int32>(StyleTransferNetwork->CreateInferenceContext());
+		checkf(*StyleTransferInferenceContext != INDEX_NONE, TEXT("Could not create inference context for StyleTransferNetwork"));
+		UpdateStyleParamsTarget();
+		UpdateMemoryStats();
+	}
+	return true;
+}
+
+bool UStyleTransferSubsystem::CanTransferStyle() const
+{
+	return CpuExecutor || (StyleTransferInferenceContext && (*StyleTransferInferenceContext != INDEX_NONE || bEditorPreview));
+}
+
+int32 UStyleTransferSubsystem::CreateStylePredictionInferenceContext()
+{
+	if (!IsWithinMemoryBudget(StyleTransferMemory::GetInferenceContextSize(StylePredictionNetwork)))
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Not creating Inference Context for StylePrediction because it exceeds r.StyleTransfer.MemoryBudgetMB"));
+		return INDEX_NONE;
+	}
+
+	LLM_SCOPE_BYTAG(StyleTransfer);
+	const int32 StylePredictionInferenceContext = StylePredictionNetwork->CreateInferenceContext();
+	checkf(StylePredictionInferenceContext != INDEX_NONE, TEXT("Could not create inference context for StylePredictionNetwork"));
+	++NumStylePredictionInferenceContexts;
+	UpdateMemoryStats();
+	return StylePredictionInferenceContext;
+}
+
+void UStyleTransferSubsystem::DestroyStylePredictionInferenceContext(int32& StylePredictionInferenceContext)
+{
+	if (StylePredictionInferenceContext == INDEX_NONE)
+		return;
+
+	StylePredictionNetwork->DestroyInferenceContext(StylePredictionInferenceContext);
+	StylePredictionInferenceContext = INDEX_NONE;
+	--NumStylePredictionInferenceContexts;
+	UpdateMemoryStats();
+}
+
+int64 UStyleTransferSubsystem::GetInferenceContextMemory() const
+{
+	int64 Memory = 0;
+	if (StyleTransferInferenceContext && *StyleTransferInferenceContext != INDEX_NONE)
+	{
+		Memory += StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork);
+	}
+	if (ContentShapeCache)
+	{
+		Memory += ContentShapeCache->GetMemory();
+	}
+	Memory += GetSceneCaptureContextMemory();
+	if (BatchInferenceContext != INDEX_NONE)
+	{
+		Memory += BatchSize * StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork);
+	}
+	if (NumStylePredictionInferenceContexts > 0)
+	{
+		Memory += NumStylePredictionInferenceContexts * StyleTransferMemory::GetInferenceContextSize(StylePredictionNetwork);
+	}
+	return Memory + QuantizedStyleMemory + StyleInputCacheMemory;
+}
+
+bool UStyleTransferSubsystem::IsWithinMemoryBudget(int64 AdditionalBytes) const
+{
+	const int64 Budget = StyleTransferMemory::GetBudget();
+	const int64 OutputTextureMemory = StyleTransferSceneViewExtension ? StyleTransferSceneViewExtension->GetOutputTextureMemory() : 0;
+	return Budget == 0 || GetInferenceContextMemory() + OutputTextureMemory + AdditionalBytes <= Budget;
+}
+
+void UStyleTransferSubsystem::UpdateMemoryStats()
+{
+	const int64 TransferContextMemory = (StyleTransferInferenceContext && *StyleTransferInferenceContext != INDEX_NONE
+		                                     ? StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork)
+		                                     : 0)
+		+ (ContentShapeCache ? ContentShapeCache->GetMemory() : 0)
+		+ GetSceneCaptureContextMemory();
+	SET_MEMORY_STAT(STAT_StyleTransfer_TransferContextMemory, TransferContextMemory);
+	SET_MEMORY_STAT(STAT_StyleTransfer_PredictionContextMemory, GetInferenceContextMemory() - TransferContextMemory);
+	SET_DWORD_STAT(STAT_StyleTransfer_NumResidentStyles, ResidentStyles.Num());
+
+	const int64 OutputTextureMemory = StyleTransferSceneViewExtension ? StyleTransferSceneViewExtension->GetOutputTextureMemory() : 0;
+	SET_MEMORY_STAT(STAT_StyleTransfer_OutputTextureMemory, OutputTextureMemory);
+	SET_MEMORY_STAT(STAT_StyleTransfer_TotalMemory, GetInferenceContextMemory() + OutputTextureMemory);
+}
+
+void UStyleTransferSubsystem::WarmUp()
+{
+	// the editor preview has no fixed size context to warm up, its views are stylized on demand
+	if (bIsReady || bEditorPreview || WarmUpStylePredictionInferenceContext != INDEX_NONE)
+		return;
+
+	if (!(StyleTransferNetwork && StylePredictionNetwork))
+	{
+		LoadNetworks();
+	}
+	if (!StylePredictionNetwork || !StylePredictionNetwork->IsLoaded() || !StyleTransferNetwork || !StyleTransferNetwork->IsLoaded())
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Not all networks were loaded, can not warm up style transfer."));
+		OnStyleTransferReady.Broadcast(false);
+		return;
+	}
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for warm up"));
+	if (!EnsureStyleTransferInferenceContext() || (WarmUpStylePredictionInferenceContext = CreateStylePredictionInferenceContext()) == INDEX_NONE)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not create inference contexts, can not warm up style transfer."));
+		OnStyleTransferReady.Broadcast(false);
+		return;
+	}
+
+	if (CpuExecutor)
+	{
+		// the CPU network has no kernels to tune or shaders to compile, only the prediction needs to be warmed up
+		ENQUEUE_RENDER_COMMAND(StyleTransferWarmUp)([this, StylePredictionInferenceContext = WarmUpStylePredictionInferenceContext](FRHICommandListImmediate& RHICommandList)
+		{
+			FRDGBuilder GraphBuilder(RHICommandList);
+			{
+				RDG_EVENT_SCOPE(GraphBuilder, "StylePredictionWarmUp");
+				PredictStyle_RenderThread(GraphBuilder, GSystemTextures.GetBlackDummy(GraphBuilder), StylePredictionInferenceContext);
+			}
+			GraphBuilder.Execute();
+		});
+		WarmUpFence.BeginFence();
+		return;
+	}
+
+	const bool bAutotune = CVarAutotuneOnFirstLaunch.GetValueOnGameThread() && FStyleTransferAutotuner::NeedsAutotune(StyleTransferNetwork, StylePredictionNetwork);
+	if (bAutotune)
+	{
+		UE_LOG(LogStyleTransfer, Log, TEXT("No autotune results for this GPU, measuring thread group sizes during warm up"));
+	}
+
+	ENQUEUE_RENDER_COMMAND(StyleTransferWarmUp)([this, bAutotune, StylePredictionInferenceContext = WarmUpStylePredictionInferenceContext, InferenceContext = *StyleTransferInferenceContext](FRHICommandListImmediate& RHICommandList)
+	{
+		if (bAutotune)
+		{
+			FStyleTransferAutotuner::Autotune_RenderThread(RHICommandList, 10, false,
+			                                               StyleTransferNetwork, InferenceContext,
+			                                               StylePredictionNetwork, StylePredictionInferenceContext);
+		}
+
+		// the dummy style is applied like every other style, e.g. gathered for a mapped network LOD, and the previous one is restored afterwards
+		const bool bHadStyle = StyleParamsBuffer.IsValid();
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "StylePredictionWarmUp");
+
+			FRDGBufferRef StyleParams = GetStyleParamsBuffer_RenderThread(GraphBuilder);
+			FRDGBufferRef SavedStyleParams = nullptr;
+			if (bHadStyle)
+			{
+				SavedStyleParams = GraphBuilder.CreateBuffer(StyleParams->Desc, TEXT("StyleTransferWarmUpSavedStyleParams"));
+				AddCopyStyleParamsPass(GraphBuilder, SavedStyleParams, StyleParams, StyleParams->Desc.GetSize());
+			}
+			FNeuralTensor& InputStyleParams = StyleTransferNetwork->GetInputTensorForContextMutable(InferenceContext, StyleTransferStyleParamsInputIndex);
+			InputStyleParams.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+			FRDGBufferRef InputStyleParamsBuffer = InputStyleParams.GetBufferUAVRef()->GetParent();
+			FRDGBufferRef SavedInputStyleParams = GraphBuilder.CreateBuffer(InputStyleParamsBuffer->Desc, TEXT("StyleTransferWarmUpSavedInputStyleParams"));
+			AddCopyStyleParamsPass(GraphBuilder, SavedInputStyleParams, InputStyleParamsBuffer, InputStyleParamsBuffer->Desc.GetSize());
+
+			FRDGTextureRef DummyTexture = GSystemTextures.GetBlackDummy(GraphBuilder);
+			PredictStyle_RenderThread(GraphBuilder, DummyTexture, StylePredictionInferenceContext);
+			CopyStyleParams_RenderThread(GraphBuilder, StylePredictionInferenceContext, 0);
+
+			FStyleTransferSceneViewExtension::WarmUp_RenderThread(GraphBuilder, StyleTransferNetwork, InferenceContext, DummyTexture);
+
+			AddCopyStyleParamsPass(GraphBuilder, InputStyleParamsBuffer, SavedInputStyleParams, InputStyleParamsBuffer->Desc.GetSize());
+			if (SavedStyleParams)
+			{
+				AddCopyStyleParamsPass(GraphBuilder, StyleParams, SavedStyleParams, StyleParams->Desc.GetSize());
+			}
+		}
+		GraphBuilder.Execute();
+		// without a previous style the dummy one must not be applied to later targets, see UpdateStyleParamsTarget
+		if (!bHadStyle)
+		{
+			StyleParamsBuffer.SafeRelease();
+		}
+	});
+	WarmUpFence.BeginFence();
+}
+
+void UStyleTransferSubsystem::TickWarmUp()
+{
+	if (WarmUpStylePredictionInferenceContext == INDEX_NONE || !WarmUpFence.IsFenceComplete())
+		return;
+
+	DestroyStylePredictionInferenceContext(WarmUpStylePredictionInferenceContext);
+	FStyleTransferAutotuner::SaveResults();
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Style transfer warm up finished"));
+	bIsReady = true;
+	OnStyleTransferReady.Broadcast(true);
+}
+
+void UStyleTransferSubsystem::UpdateStyle(UTexture2D* StyleTexture, uint32 StyleIndex, int32 StylePredictionInferenceContext)
+{
+	checkf(CanTransferStyle(), TEXT("Can not infer style without inference context"));
+	checkf(StylePredictionInferenceContext != INDEX_NONE, TEXT("Can not update style without inference context"));
+	FlushRenderingCommands();
+	EnqueueStylePrediction(StyleTexture, StylePredictionInferenceContext, true);
+	FlushRenderingCommands();
+}
+
+void UStyleTransferSubsystem::EnqueueStylePrediction(UTexture2D* StyleTexture, int32 StylePredictionInferenceContext, bool bApply)
+{
+	ENQUEUE_RENDER_COMMAND(StylePrediction)([this, StyleTexture, StylePredictionInferenceContext, bApply](FRHICommandListImmediate& RHICommandList)
+	{
+		IRenderCaptureProvider* RenderCaptureProvider = ConditionalBeginRenderCapture(RHICommandList);
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "StylePrediction");
+
+			PredictCachedStyle_RenderThread(GraphBuilder, StyleTexture, StylePredictionInferenceContext);
+			if (bApply)
+			{
+				CopyStyleParams_RenderThread(GraphBuilder, StylePredictionInferenceContext, 0);
+			}
+		}
+		GraphBuilder.Execute();
+
+		if (RenderCaptureProvider)
+		{
+			RenderCaptureProvider->EndCapture(&RHICommandList);
+		}
+	});
+}
+
+TFuture<int32> UStyleTransferSubsystem::RequestStyleAsync(TSoftObjectPtr<UTexture2D> StyleTexture)
+{
+	const int32 RequestId = NextStyleRequestId++;
+	TFuture<int32> Future = StyleRequests.Add(RequestId, MakeShared<TPromise<int32>>())->GetFuture();
+	if (StyleTexture.IsNull())
+	{
+		FinishStyleRequest(RequestId, INDEX_NONE);
+		return Future;
+	}
+
+	TWeakObjectPtr<UStyleTransferSubsystem> WeakThis(this);
+	LoadNetworksAsync().Then([WeakThis, RequestId, StyleTexture](TFuture<bool> bNetworksLoaded)
+	{
+		UStyleTransferSubsystem* This = WeakThis.Get();
+		if (!This)
+			return;
+		if (!bNetworksLoaded.Get())
+		{
+			This->FinishStyleRequest(RequestId, INDEX_NONE);
+			return;
+		}
+
+		This->StreamableManager.RequestAsyncLoad(StyleTexture.ToSoftObjectPath(), FStreamableDelegate::CreateLambda([WeakThis, RequestId, StyleTexture]()
+		{
+			if (UStyleTransferSubsystem* This = WeakThis.Get())
+			{
+				This->PredictRequestedStyle(RequestId, StyleTexture.Get());
+			}
+		}));
+	});
+	return Future;
+}
+
+void UStyleTransferSubsystem::PredictRequestedStyle(int32 RequestId, UTexture2D* StyleTexture)
+{
+	if (!StyleRequests.Contains(RequestId))
+		return;
+
+	if (!StyleTexture)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Requested style texture could not be loaded"));
+		FinishStyleRequest(RequestId, INDEX_NONE);
+		return;
+	}
+
+	const int32 StylePredictionInferenceContext = CreateStylePredictionInferenceContext();
+	if (StylePredictionInferenceContext == INDEX_NONE)
+	{
+		FinishStyleRequest(RequestId, INDEX_NONE);
+		return;
+	}
+
+#if WITH_EDITOR
+	FTextureCompilingManager::Get().FinishCompilation({StyleTexture});
+#endif
+	UE_LOG(LogStyleTransfer, Log, TEXT("Predicting requested style %s"), *StyleTexture->GetName());
+	EnqueueStylePrediction(StyleTexture, StylePredictionInferenceContext, false);
+	// the texture has to stay alive until the render thread used it
+	RunAfterRenderThread([this, RequestId, StylePredictionInferenceContext, StyleTexture = TStrongObjectPtr<UTexture2D>(StyleTexture)]()
+	{
+		FinishStyleRequest(RequestId, AddResidentStyle(StylePredictionInferenceContext, false));
+	});
+}
+
+void UStyleTransferSubsystem::FinishStyleRequest(int32 RequestId, int32 StyleHandle)
+{
+	if (const TSharedRef<TPromise<int32>>* FoundPromise = StyleRequests.Find(RequestId))
+	{
+		const TSharedRef<TPromise<int32>> Promise = *FoundPromise;
+		StyleRequests.Remove(RequestId);
+		Promise->SetValue(StyleHandle);
+	}
+}
+
+void UStyleTransferSubsystem::PredictSettingsStyle(int32 StyleIndex, UTexture2D* StyleTexture)
+{
+	const int32 StylePredictionInferenceContext = CreateStylePredictionInferenceContext();
+	if (StylePredictionInferenceContext == INDEX_NONE)
+		return;
+
+#if WITH_EDITOR
+	FTextureCompilingManager::Get().FinishCompilation({StyleTexture});
+#endif
+	UE_LOG(LogStyleTransfer, Log, TEXT("Predicting changed style %i (%s)"), StyleIndex, *StyleTexture->GetName());
+	EnqueueStylePrediction(StyleTexture, StylePredictionInferenceContext, false);
+	const uint32 Request = NextSettingsStyleRequest++;
+	LatestSettingsStyleRequests.Add(StyleIndex, Request);
+	RunAfterRenderThread([this, StyleIndex, Request, StylePredictionInferenceContext, StyleTexture = TStrongObjectPtr<UTexture2D>(StyleTexture)]() mutable
+	{
+		// the style changed again, was removed or stylizing stopped in the meantime
+		const uint32* LatestRequest = LatestSettingsStyleRequests.Find(StyleIndex);
+		if (!LatestRequest || *LatestRequest != Request || StyleIndex > NumSettingsStyles || !StyleTransferSceneViewExtension)
+		{
+			DestroyStylePredictionInferenceContext(StylePredictionInferenceContext);
+			return;
+		}
+		LatestSettingsStyleRequests.Remove(StyleIndex);
+
+		int32 StyleHandle = INDEX_NONE;
+		if (StyleIndex < NumSettingsStyles)
+		{
+			StyleHandle = ResidentStyles[StyleIndex].Handle;
+			RemoveResidentStyleAt(StyleIndex);
+		}
+		else
+		{
+			++NumSettingsStyles;
+		}
+		AddResidentStyle(StylePredictionInferenceContext, false, StyleHandle);
+		ResidentStyles.Insert(ResidentStyles.Pop(), StyleIndex);
+		// show the edited style right away
+		ApplyStyleAsync(ResidentStyles[StyleIndex].Handle);
+		UpdateRegionalStyles();
+	});
+}
+
+void UStyleTransferSubsystem::RemoveResidentStyleAt(int32 Index)
+{
+	const FResidentStyle Style = ResidentStyles[Index];
+	ResidentStyles.RemoveAt(Index);
+	if (Style.StylePredictionInferenceContext != INDEX_NONE)
+	{
+		RunAfterRenderThread([this, StylePredictionInferenceContext = Style.StylePredictionInferenceContext]() mutable
+		{
+			DestroyStylePredictionInferenceContext(StylePredictionInferenceContext);
+		});
+	}
+	else
+	{
+		ENQUEUE_RENDER_COMMAND(StyleTransferReleaseQuantizedStyle)([this, StyleHandle = Style.Handle](FRHICommandListImmediate&)
+		{
+			QuantizedStyleParams_RenderThread.Remove(StyleHandle);
+		});
+		QuantizedStyleMemory -= GetQuantizedStyleParamsSize(StylePredictionNetwork);
+	}
+	UpdateMemoryStats();
+}
+
+void UStyleTransferSubsystem::TickVolumeStyle()
+{
+	// the interpolation and the live style overwrite the style every tick anyway
+	if (!StyleTransferSceneViewExtension || bLiveStyleActive || CVarStyleTransferInterpolateStyles.GetValueOnGameThread())
+		return;
+
+	const int32 RequestedStyleIndex = StyleTransferSceneViewExtension->GetRequestedStyleIndex();
+	if (RequestedStyleIndex == VolumeStyleIndex)
+		return;
+
+	VolumeStyleIndex = RequestedStyleIndex;
+	// the first resident styles are the StyleTextures of the settings in order
+	if (ResidentStyles.IsValidIndex(VolumeStyleIndex))
+	{
+		UE_LOG(LogStyleTransfer, Log, TEXT("Applying style %i of the post process volumes"), VolumeStyleIndex);
+		ApplyStyleAsync(ResidentStyles[VolumeStyleIndex].Handle);
+	}
+	else if (VolumeStyleIndex != INDEX_NONE)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Style %i of the post process volumes is not resident"), VolumeStyleIndex);
+	}
+}
+
+TFuture<bool> UStyleTransferSubsystem::ApplyStyleAsync(int32 StyleHandle)
+{
+	const FResidentStyle* Style = FindResidentStyle(StyleHandle);
+	if (!Style || !CanTransferStyle())
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Can not apply style %i, it is not resident or no viewport is stylized"), StyleHandle);
+		return MakeFulfilledPromise<bool>(false).GetFuture();
+	}
+
+	ENQUEUE_RENDER_COMMAND(ApplyStyle)([this, Style = *Style](FRHICommandListImmediate& RHICommandList)
+	{
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "ApplyStyle");
+			ApplyResidentStyle_RenderThread(GraphBuilder, Style);
+		}
+		GraphBuilder.Execute();
+	});
+
+	TSharedRef<TPromise<bool>> Promise = MakeShared<TPromise<bool>>();
+	RunAfterRenderThread([Promise]()
+	{
+		Promise->SetValue(true);
+	});
+	return Promise->GetFuture();
+}
+
+void UStyleTransferSubsystem::PredictStyle_RenderThread(FRDGBuilder& GraphBuilder, FRDGTextureRef StyleTexture, int32 StylePredictionInferenceContext)
+{
+	FNeuralTensor& InputStyleImageTensor = StylePredictionNetwork->GetInputTensorForContextMutable(StylePredictionInferenceContext, 0);
+	InputStyleImageTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	FStyleTransferSceneViewExtension::TextureToTensorRGB(GraphBuilder, StyleTexture, InputStyleImageTensor, FIntRect(), INDEX_NONE, true);
+
+	StylePredictionNetwork->Run(GraphBuilder, StylePredictionInferenceContext);
+}
+
+void UStyleTransferSubsystem::PredictCachedStyle_RenderThread(FRDGBuilder& GraphBuilder, const UTexture2D* StyleTexture, int32 StylePredictionInferenceContext)
+{
+	const FRHITexture* StyleTextureRHI = StyleTexture->GetResource()->TextureRHI;
+	const int32 EntryIndex = StyleInputCache_RenderThread.IndexOfByPredicate([TextureKey = FObjectKey(StyleTexture), NetworkKey = FObjectKey(StylePredictionNetwork)](const FStyleInputCacheEntry& Entry)
+	{
+		return Entry.Texture == TextureKey && Entry.Network == NetworkKey;
+	});
+	if (EntryIndex == INDEX_NONE || StyleInputCache_RenderThread[EntryIndex].TextureRHI != StyleTextureRHI)
+	{
+		if (EntryIndex != INDEX_NONE)
+		{
+			StyleInputCacheMemory -= StyleInputCache_RenderThread[EntryIndex].PackedInput->Desc.GetSize();
+			StyleInputCache_RenderThread.RemoveAt(EntryIndex);
+		}
+
+		FRDGTextureRef RDGStyleTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(StyleTexture->GetResource()->TextureRHI, TEXT("StyleInputTexture")));
+		PredictStyle_RenderThread(GraphBuilder, RDGStyleTexture, StylePredictionInferenceContext);
+
+		const int32 CacheSize = CVarStyleInputCacheSize.GetValueOnRenderThread();
+		if (CacheSize <= 0)
+			return;
+
+		while (StyleInputCache_RenderThread.Num() >= CacheSize)
+		{
+			StyleInputCacheMemory -= StyleInputCache_RenderThread[0].PackedInput->Desc.GetSize();
+			StyleInputCache_RenderThread.RemoveAt(0);
+		}
+		const FNeuralTensor& InputStyleImageTensor = StylePredictionNetwork->GetInputTensorForContextMutable(StylePredictionInferenceContext, 0);
+		FStyleInputCacheEntry& Entry = StyleInputCache_RenderThread.AddDefaulted_GetRef();
+		Entry.Texture = FObjectKey(StyleTexture);
+		Entry.Network = FObjectKey(StylePredictionNetwork);
+		Entry.TextureRHI = StyleTextureRHI;
+		Entry.PackedInput = AllocatePooledBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), InputStyleImageTensor.Num()), TEXT("StyleTransferCachedStyleInput"));
+		StyleInputCacheMemory += Entry.PackedInput->Desc.GetSize();
+		AddCopyBufferPass(GraphBuilder, GraphBuilder.RegisterExternalBuffer(Entry.PackedInput), 0, InputStyleImageTensor.GetBufferSRVRef()->GetParent(), 0, InputStyleImageTensor.NumInBytes());
+		return;
+	}
+
+	// most recently used last
+	FStyleInputCacheEntry Entry = MoveTemp(StyleInputCache_RenderThread[EntryIndex]);
+	StyleInputCache_RenderThread.RemoveAt(EntryIndex);
+	FNeuralTensor& InputStyleImageTensor = StylePredictionNetwork->GetInputTensorForContextMutable(StylePredictionInferenceContext, 0);
+	InputStyleImageTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+	AddCopyBufferPass(GraphBuilder, InputStyleImageTensor.GetBufferUAVRef()->GetParent(), 0, GraphBuilder.RegisterExternalBuffer(Entry.PackedInput), 0, InputStyleImageTensor.NumInBytes());
+	StyleInputCache_RenderThread.Add(MoveTemp(Entry));
+
+	StylePredictionNetwork->Run(GraphBuilder, StylePredictionInferenceContext);
+}
+
+void UStyleTransferSubsystem::CopyStyleParams_RenderThread(FRDGBuilder& GraphBuilder, int32 StylePredictionInferenceContext, uint32 StyleIndex)
+{
+	FNeuralTensor& OutputStyleParams = StylePredictionNetwork->GetOutputTensorForContextMutable(StylePredictionInferenceContext, 0);
+	FRDGBufferRef OutputStyleParamsBuffer = OutputStyleParams.GetBufferSRVRef()->GetParent();
+	AddCopyStyleParamsPass(GraphBuilder, GetStyleParamsBuffer_RenderThread(GraphBuilder), OutputStyleParamsBuffer, OutputStyleParams.NumInBytes());
+
+	ApplyStyleParams_RenderThread(GraphBuilder);
+}
+
+int32 UStyleTransferSubsystem::AddResidentStyle(int32 StylePredictionInferenceContext, bool bWait, int32 StyleHandle)
+{
+	FResidentStyle& Style = ResidentStyles.AddDefaulted_GetRef();
+	Style.Handle = StyleHandle != INDEX_NONE ? StyleHandle : NextStyleHandle++;
+	Style.StylePredictionInferenceContext = StylePredictionInferenceContext;
+	if (!CVarQuantizeStyles.GetValueOnGameThread())
+	{
+		UpdateMemoryStats();
+		return Style.Handle;
+	}
+
+	ENQUEUE_RENDER_COMMAND(StyleTransferQuantizeStyle)([this, Style](FRHICommandListImmediate& RHICommandList)
+	{
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "QuantizeStyle");
+			FRDGBufferSRVRef Values, ScaleOffsets;
+			GetQuantizedStyleParams_RenderThread(GraphBuilder, Style, Values, ScaleOffsets);
+			FQuantizedStyleParams& QuantizedStyleParams = QuantizedStyleParams_RenderThread.Add(Style.Handle);
+			GraphBuilder.QueueBufferExtraction(Values->GetParent(), &QuantizedStyleParams.Values);
+			GraphBuilder.QueueBufferExtraction(ScaleOffsets->GetParent(), &QuantizedStyleParams.ScaleOffsets);
+		}
+		GraphBuilder.Execute();
+	});
+
+	QuantizedStyleMemory += GetQuantizedStyleParamsSize(StylePredictionNetwork);
+	if (bWait)
+	{
+		FlushRenderingCommands();
+		DestroyStylePredictionInferenceContext(Style.StylePredictionInferenceContext);
+	}
+	else
+	{
+		RunAfterRenderThread([this, StylePredictionInferenceContext]() mutable
+		{
+			DestroyStylePredictionInferenceContext(StylePredictionInferenceContext);
+		});
+		Style.StylePredictionInferenceContext = INDEX_NONE;
+	}
+	UpdateMemoryStats();
+	return Style.Handle;
+}
+
+const UStyleTransferSubsystem::FResidentStyle* UStyleTransferSubsystem::FindResidentStyle(int32 StyleHandle) const
+{
+	return ResidentStyles.FindByPredicate([StyleHandle](const FResidentStyle& Style)
+	{
+		return Style.Handle == StyleHandle;
+	});
+}
+
+void UStyleTransferSubsystem::GetQuantizedStyleParams_RenderThread(FRDGBuilder& GraphBuilder, const FResidentStyle& Style, FRDGBufferSRVRef& OutValues, FRDGBufferSRVRef& OutScaleOffsets)
+{
+	FRDGBufferRef Values;
+	FRDGBufferRef ScaleOffsets;
+	if (const FQuantizedStyleParams* QuantizedStyleParams = QuantizedStyleParams_RenderThread.Find(Style.Handle))
+	{
+		Values = GraphBuilder.RegisterExternalBuffer(QuantizedStyleParams->Values);
+		ScaleOffsets = GraphBuilder.RegisterExternalBuffer(QuantizedStyleParams->ScaleOffsets);
+	}
+	else
+	{
+		FNeuralTensor& PredictedStyleParams = StylePredictionNetwork->GetOutputTensorForContextMutable(Style.StylePredictionInferenceContext, 0);
+		PredictedStyleParams.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		const uint32 Volume = CastNarrowingSafe<uint32>(PredictedStyleParams.Num());
+		Values = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), FMath::DivideAndRoundUp(Volume, 4u)), TEXT("StyleTransferQuantizedStyleParams"));
+		ScaleOffsets = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), FMath::DivideAndRoundUp(Volume, FQuantizeTensorCS::ValuesPerBlock) * 2), TEXT("StyleTransferStyleParamsScaleOffsets"));
+		FStyleTransferSceneViewExtension::QuantizeBuffer(GraphBuilder, PredictedStyleParams.GetBufferSRVRef(), Volume,
+		                                                 GraphBuilder.CreateUAV(Values, PF_R32_UINT), GraphBuilder.CreateUAV(ScaleOffsets, PF_R32_FLOAT));
+	}
+	OutValues = GraphBuilder.CreateSRV(Values, PF_R32_UINT);
+	OutScaleOffsets = GraphBuilder.CreateSRV(ScaleOffsets, PF_R32_FLOAT);
+}
+
+void UStyleTransferSubsystem::ApplyResidentStyle_RenderThread(FRDGBuilder& GraphBuilder, const FResidentStyle& Style)
+{
+	if (Style.StylePredictionInferenceContext != INDEX_NONE)
+	{
+		CopyStyleParams_RenderThread(GraphBuilder, Style.StylePredictionInferenceContext, 0);
+		return;
+	}
+
+	FRDGBufferSRVRef Values, ScaleOffsets;
+	GetQuantizedStyleParams_RenderThread(GraphBuilder, Style, Values, ScaleOffsets);
+	FStyleTransferSceneViewExtension::InterpolateQuantizedBuffers(GraphBuilder, GraphBuilder.CreateUAV(GetStyleParamsBuffer_RenderThread(GraphBuilder), PF_R32_FLOAT),
+	                                                              Values, ScaleOffsets, Values, ScaleOffsets,
+	                                                              CastNarrowingSafe<uint32>(StylePredictionNetwork->GetOutputTensor(0).Num()), 0.f);
+	ApplyStyleParams_RenderThread(GraphBuilder);
+}
+
+void UStyleTransferSubsystem::UpdateStyleParamsTarget()
+{
+	FStyleParamsTarget StyleParamsTarget;
+	if (CanTransferStyle())
+	{
+		StyleParamsTarget.Network = StyleTransferNetwork;
+		StyleParamsTarget.CpuExecutor = CpuExecutor;
+		StyleParamsTarget.SceneViewExtension = bEditorPreview ? StyleTransferSceneViewExtension : nullptr;
+		StyleParamsTarget.InferenceContext = *StyleTransferInferenceContext;
+		StyleParamsTarget.InputIndex = StyleTransferStyleParamsInputIndex;
+		StyleParamsTarget.Mapping = TArray<int32>(GetDefault<UStyleTransferSettings>()->GetNetworkLODStyleParamsMapping(CurrentNetworkLOD));
+		StyleParamsTarget.NumStyleSets = GetNumStyleSets(StyleTransferNetwork);
+	}
+
+	ENQUEUE_RENDER_COMMAND(StyleTransferUpdateStyleParamsTarget)([this, StyleParamsTarget = MoveTemp(StyleParamsTarget)](FRHICommandListImmediate& RHICommandList)
+	{
+		StyleParamsTarget_RenderThread = StyleParamsTarget;
+
+		// a new target, e.g. of a new network LOD, gets the current style
+		if (StyleParamsTarget_RenderThread.Network && StyleParamsBuffer)
+		{
+			FRDGBuilder GraphBuilder(RHICommandList);
+			{
+				RDG_EVENT_SCOPE(GraphBuilder, "ApplyStyleParams");
+				ApplyStyleParams_RenderThread(GraphBuilder);
+			}
+			GraphBuilder.Execute();
+		}
+	});
+	UpdateRegionalStyles();
+}
+
+FRDGBufferRef UStyleTransferSubsystem::GetStyleParamsBuffer_RenderThread(FRDGBuilder& GraphBuilder)
+{
+	if (!StyleParamsBuffer)
+	{
+		if (!StylePredictionNetwork || !StylePredictionNetwork->IsLoaded())
+			return nullptr;
+
+		const FNeuralTensor& PredictedStyleParams = StylePredictionNetwork->GetOutputTensor(0);
+		StyleParamsBuffer = AllocatePooledBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), PredictedStyleParams.Num()), TEXT("StyleTransferStyleParams"));
+	}
+	return GraphBuilder.RegisterExternalBuffer(StyleParamsBuffer);
+}
+
+void UStyleTransferSubsystem::ApplyStyleParams_RenderThread(FRDGBuilder& GraphBuilder)
+{
+	const FStyleParamsTarget& Target = StyleParamsTarget_RenderThread;
+	FRDGBufferRef PredictedStyleParamsBuffer = GetStyleParamsBuffer_RenderThread(GraphBuilder);
+	if (!PredictedStyleParamsBuffer)
+		return;
+
+	if (Target.CpuExecutor)
+	{
+		Target.CpuExecutor->SetStyleParams_RenderThread(GraphBuilder, PredictedStyleParamsBuffer, Target.Mapping);
+		return;
+	}
+	if (!Target.Network)
+		return;
+
+	FRDGBufferRef InputStyleParamsBuffer;
+	if (Target.InferenceContext != INDEX_NONE)
+	{
+		FNeuralTensor& InputStyleParams = Target.Network->GetInputTensorForContextMutable(Target.InferenceContext, Target.InputIndex);
+		InputStyleParams.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		InputStyleParamsBuffer = InputStyleParams.GetBufferUAVRef()->GetParent();
+	}
+	else if (Target.SceneViewExtension)
+	{
+		InputStyleParamsBuffer = Target.SceneViewExtension->GetSceneCaptureStyleParamsBuffer_RenderThread(GraphBuilder);
+	}
+	else
+	{
+		return;
+	}
+
+	const uint64 NumInputBytes = InputStyleParamsBuffer->Desc.GetSize();
+	if (Target.Mapping.Num())
+	{
+		FStyleTransferSceneViewExtension::GatherBuffer(GraphBuilder, GraphBuilder.CreateUAV(InputStyleParamsBuffer, PF_R32_FLOAT),
+		                                               GraphBuilder.CreateSRV(PredictedStyleParamsBuffer, PF_R32_FLOAT), Target.Mapping);
+	}
+	else if (Target.NumStyleSets > 1)
+	{
+		// the current style is the first set and the set of every region without a resident style,
+		// so regions follow it through ApplyStyleAsync, InterpolateStyles and the live style
+		const uint64 NumSetBytes = NumInputBytes / Target.NumStyleSets;
+		FRDGBufferRef RegionalStyleParams = RegionalStyleParamsBuffer ? GraphBuilder.RegisterExternalBuffer(RegionalStyleParamsBuffer) : nullptr;
+		AddCopyStyleParamsPass(GraphBuilder, InputStyleParamsBuffer, PredictedStyleParamsBuffer, NumSetBytes);
+		for (int32 Region = 0; Region < Target.NumStyleSets - 1; ++Region)
+		{
+			const bool bResidentStyle = RegionalStyleParams && RegionsWithResidentStyle.IsValidIndex(Region) && RegionsWithResidentStyle[Region];
+			AddCopyStyleParamsPass(GraphBuilder, InputStyleParamsBuffer, bResidentStyle ? RegionalStyleParams : PredictedStyleParamsBuffer,
+			                       NumSetBytes, NumSetBytes * (Region + 1), bResidentStyle ? NumSetBytes * Region : 0);
+		}
+	}
+	else
+	{
+		AddCopyStyleParamsPass(GraphBuilder, InputStyleParamsBuffer, PredictedStyleParamsBuffer, NumInputBytes);
+	}
+}
+
+void UStyleTransferSubsystem::UpdateRegionalStyles()
+{
+	if (!CanTransferStyle() || CpuExecutor)
+		return;
+
+	const int32 NumStyleSets = GetNumStyleSets(StyleTransferNetwork);
+	if (NumStyleSets <= 1)
+		return;
+
+	// regions without a resident style use the current style, see ApplyStyleParams_RenderThread
+	const TArray<FStyleTransferStyleRegion>& StyleRegions = GetDefault<UStyleTransferSettings>()->StyleRegions;
+	TArray<TOptional<FResidentStyle>> RegionStyles;
+	for (int32 Region = 0; Region < NumStyleSets - 1; ++Region)
+	{
+		TOptional<FResidentStyle>& RegionStyle = RegionStyles.AddDefaulted_GetRef();
+		if (StyleRegions.IsValidIndex(Region) && StyleRegions[Region].StyleIndex >= 0 && StyleRegions[Region].StyleIndex < NumSettingsStyles)
+		{
+			RegionStyle = ResidentStyles[StyleRegions[Region].StyleIndex];
+		}
+	}
+	if (StyleRegions.Num() > NumStyleSets - 1)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Only %i of %i StyleRegions are used because the network takes %i style sets"), NumStyleSets - 1, StyleRegions.Num(), NumStyleSets);
+	}
+
+	ENQUEUE_RENDER_COMMAND(StyleTransferUpdateRegionalStyles)([this, RegionStyles = MoveTemp(RegionStyles)](FRHICommandListImmediate& RHICommandList)
+	{
+		const uint64 NumSetBytes = StylePredictionNetwork->GetOutputTensor(0).NumInBytes();
+		if (!RegionalStyleParamsBuffer || RegionalStyleParamsBuffer->Desc.GetSize() != NumSetBytes * RegionStyles.Num())
+		{
+			RegionalStyleParamsBuffer = AllocatePooledBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), NumSetBytes / sizeof(float) * RegionStyles.Num()), TEXT("StyleTransferRegionalStyleParams"));
+		}
+
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "UpdateRegionalStyles");
+			FRDGBufferRef RegionalStyleParams = GraphBuilder.RegisterExternalBuffer(RegionalStyleParamsBuffer);
+			RegionsWithResidentStyle.Init(false, RegionStyles.Num());
+			for (int32 Region = 0; Region < RegionStyles.Num(); ++Region)
+			{
+				if (RegionStyles[Region].IsSet())
+				{
+					CopyResidentStyleParams_RenderThread(GraphBuilder, RegionStyles[Region].GetValue(), RegionalStyleParams, NumSetBytes * Region);
+					RegionsWithResidentStyle[Region] = true;
+				}
+			}
+			ApplyStyleParams_RenderThread(GraphBuilder);
+		}
+		GraphBuilder.Execute();
+	});
+}
+
+void UStyleTransferSubsystem::CopyResidentStyleParams_RenderThread(FRDGBuilder& GraphBuilder, const FResidentStyle& Style, FRDGBufferRef Buffer, uint64 Offset)
+{
+	const FNeuralTensor& PredictedStyleParams = StylePredictionNetwork->GetOutputTensor(0);
+	if (Style.StylePredictionInferenceContext != INDEX_NONE)
+	{
+		FNeuralTensor& OutputStyleParams = StylePredictionNetwork->GetOutputTensorForContextMutable(Style.StylePredictionInferenceContext, 0);
+		OutputStyleParams.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+		AddCopyStyleParamsPass(GraphBuilder, Buffer, OutputStyleParams.GetBufferSRVRef()->GetParent(), OutputStyleParams.NumInBytes(), Offset);
+		return;
+	}
+
+	// the dequantization writes whole buffers
+	FRDGBufferRef StyleParams = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(float), PredictedStyleParams.Num()), TEXT("StyleTransferDequantizedStyleParams"));
+	FRDGBufferSRVRef Values, ScaleOffsets;
+	GetQuantizedStyleParams_RenderThread(GraphBuilder, Style, Values, ScaleOffsets);
+	FStyleTransferSceneViewExtension::InterpolateQuantizedBuffers(GraphBuilder, GraphBuilder.CreateUAV(StyleParams, PF_R32_FLOAT),
+	                                                              Values, ScaleOffsets, Values, ScaleOffsets,
+	                                                              CastNarrowingSafe<uint32>(PredictedStyleParams.Num()), 0.f);
+	AddCopyStyleParamsPass(GraphBuilder, Buffer, StyleParams, PredictedStyleParams.NumInBytes(), Offset);
+}
+
+void UStyleTransferSubsystem::StartLiveStyle(UTextureRenderTarget2D* StyleRenderTarget)
+{
+	bLiveStyleActive = true;
+	LiveStyleRenderTarget = StyleRenderTarget;
+}
+
+void UStyleTransferSubsystem::StopLiveStyle()
+{
+	bLiveStyleActive = false;
+	LiveStyleRenderTarget = nullptr;
+	// predictions that are still enqueued are dropped by their generation, they release bLiveStylePredictionInFlight themselves
+	++LiveStyleGeneration;
+}
+
+bool UStyleTransferSubsystem::UpdateLiveStyle_RenderThread(FRDGBuilder& GraphBuilder, FRDGTextureRef StyleTexture)
+{
+	check(IsInRenderingThread());
+
+	const uint32 UpdateInterval = FMath::Max(CVarLiveStyleUpdateInterval.GetValueOnRenderThread(), 1);
+	if (!bLiveStyleActive || bViewBlendedOut || LiveStylePredictionInferenceContext == INDEX_NONE
+		|| GFrameNumberRenderThread - LastLiveStylePredictionFrameRenderThread < UpdateInterval
+		|| bLiveStylePredictionInFlight.exchange(true))
+	{
+		return false;
+	}
+	LastLiveStylePredictionFrameRenderThread = GFrameNumberRenderThread;
+
+	RDG_EVENT_SCOPE(GraphBuilder, "LiveStylePrediction");
+	PredictStyle_RenderThread(GraphBuilder, StyleTexture, LiveStylePredictionInferenceContext);
+	LiveStyleParamsGeneration = LiveStyleGeneration.load();
+	bLiveStyleParamsPending = true;
+	return true;
+}
+
+void UStyleTransferSubsystem::TickLiveStyle()
+{
+	if (!StyleTransferSceneViewExtension)
+		return;
+
+	if (LiveStylePredictionInferenceContext == INDEX_NONE)
+	{
+		if (!bLiveStyleActive)
+			return;
+
+		UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for live style"));
+		LiveStylePredictionInferenceContext = CreateStylePredictionInferenceContext();
+		if (LiveStylePredictionInferenceContext == INDEX_NONE)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Live style is stopped because its inference context does not fit into the memory budget"));
+			StopLiveStyle();
+			return;
+		}
+	}
+
+	// The prediction of the previous tick was added to a graph by now, so swapping the parameters in can not stall on it.
+	if (bLiveStyleParamsPending.exchange(false))
+	{
+		// predictions that finish after StopLiveStyle are dropped
+		if (bLiveStyleActive && LiveStyleParamsGeneration == LiveStyleGeneration)
+		{
+			ENQUEUE_RENDER_COMMAND(ApplyLiveStyle)([this, StylePredictionInferenceContext = LiveStylePredictionInferenceContext](FRHICommandListImmediate& RHICommandList)
+			{
+				FRDGBuilder GraphBuilder(RHICommandList);
+				{
+					RDG_EVENT_SCOPE(GraphBuilder, "ApplyLiveStyle");
+					CopyStyleParams_RenderThread(GraphBuilder, StylePredictionInferenceContext, 0);
+				}
+				GraphBuilder.Execute();
+			});
+		}
+		// the copy is enqueued before any later prediction can overwrite the output tensor
+		bLiveStylePredictionInFlight = false;
+	}
+
+	const uint32 UpdateInterval = FMath::Max(CVarLiveStyleUpdateInterval.GetValueOnGameThread(), 1);
+	if (!LiveStyleRenderTarget || bViewBlendedOut || GFrameCounter - LastLiveStylePredictionFrame < UpdateInterval)
+		return;
+
+	FTextureRenderTargetResource* StyleRenderTargetResource = LiveStyleRenderTarget->GameThread_GetRenderTargetResource();
+	if (!StyleRenderTargetResource || bLiveStylePredictionInFlight.exchange(true))
+		return;
+
+	LastLiveStylePredictionFrame = GFrameCounter;
+	ENQUEUE_RENDER_COMMAND(LiveStylePrediction)([this, StyleRenderTargetResource, StylePredictionInferenceContext = LiveStylePredictionInferenceContext, Generation = LiveStyleGeneration.load()](FRHICommandListImmediate& RHICommandList)
+	{
+		// StopLiveStyle was called after this was enqueued, the render target might not be written anymore
+		if (Generation != LiveStyleGeneration)
+		{
+			bLiveStylePredictionInFlight = false;
+			return;
+		}
+
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "LiveStylePrediction");
+
+			FRDGTextureRef RDGStyleTexture = GraphBuilder.RegisterExternalTexture(CreateRenderTarget(StyleRenderTargetResource->GetRenderTargetTexture(), TEXT("LiveStyleInputTexture")));
+			PredictStyle_RenderThread(GraphBuilder, RDGStyleTexture, StylePredictionInferenceContext);
+			LiveStyleParamsGeneration = Generation;
+			bLiveStyleParamsPending = true;
+		}
+		GraphBuilder.Execute();
+	});
+}
+
+void UStyleTransferSubsystem::UpdateStyle(FString StyleTensorDataPath)
+{
+	const TUniquePtr<FArchive> FileReader(IFileManager::Get().CreateFileReader(*StyleTensorDataPath));
+	if (!FileReader)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Could not read style params from %s"), *StyleTensorDataPath);
+		return;
+	}
+	TArray<float> StyleParams;
+	*FileReader << StyleParams;
+
+	ENQUEUE_RENDER_COMMAND(StyleParamsLoad)([this, StyleTensorDataPath, StyleParams = MoveTemp(StyleParams)](FRHICommandListImmediate& RHICommandList)
+	{
+		FRDGBuilder GraphBuilder(RHICommandList);
+		{
+			RDG_EVENT_SCOPE(GraphBuilder, "StyleParamsLoad");
+
+			// without a StylePredictionNetwork the params go straight into the style_params input
+			FRDGBufferRef StyleParamsBuffer = GetStyleParamsBuffer_RenderThread(GraphBuilder);
+			const FStyleParamsTarget& Target = StyleParamsTarget_RenderThread;
+			if (!StyleParamsBuffer && Target.Network && Target.InferenceContext != INDEX_NONE)
+			{
+				FNeuralTensor& InputStyleParams = Target.Network->GetInputTensorForContextMutable(Target.InferenceContext, Target.InputIndex);
+				InputStyleParams.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				StyleParamsBuffer = InputStyleParams.GetBufferUAVRef()->GetParent();
+			}
+
+			const uint64 NumBytes = StyleParams.Num() * StyleParams.GetTypeSize();
+			if (!StyleParamsBuffer || StyleParamsBuffer->Desc.GetSize() != NumBytes)
+			{
+				UE_LOG(LogStyleTransfer, Error, TEXT("%s has %i style params but %u are expected"), *StyleTensorDataPath, StyleParams.Num(),
+				       StyleParamsBuffer ? StyleParamsBuffer->Desc.GetSize() / static_cast<uint32>(sizeof(float)) : 0u);
+			}
+			else
+			{
+				GraphBuilder.QueueBufferUpload(StyleParamsBuffer, StyleParams.GetData(), NumBytes, ERDGInitialDataFlags::NoCopy);
+				ApplyStyleParams_RenderThread(GraphBuilder);
+			}
+		}
+		GraphBuilder.Execute();
+	});
+	FlushRenderingCommands();
+}
+
+void UStyleTransferSubsystem::HandleConsoleVariableChanged(IConsoleVariable* ConsoleVariable)
+{
+	check(ConsoleVariable == CVarStyleTransferEnabled.AsVariable());
+	if (bEditorPreview)
+		return;
+
+	// keep a warmed up inference context alive if nothing was stylized yet
+	if (StyleTransferSceneViewExtension)
+	{
+		StopStylizingViewport();
+	}
+
+	if (CVarStyleTransferEnabled->GetBool())
+	{
+		if (!StyleTransferNetwork || !StylePredictionNetwork)
+		{
+			LoadNetworks();
+		}
+		StartStylizingViewport(GetGameInstance()->GetGameViewportClient());
+	}
+}
+
+void UStyleTransferSubsystem::UpdateAppliedSettings()
+{
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	AppliedSettings.StyleTextures.Reset();
+	for (const TSoftObjectPtr<UTexture2D>& StyleTexture : StyleTransferSettings->StyleTextures)
+	{
+		AppliedSettings.StyleTextures.Add(StyleTexture.ToSoftObjectPath());
+	}
+	AppliedSettings.StylePredictionNetwork = StyleTransferSettings->StylePredictionNetwork.ToSoftObjectPath();
+	AppliedSettings.NetworkLODs.Reset();
+	AppliedSettings.StyleParamsMappings.Reset();
+	for (int32 LOD = 0; LOD < StyleTransferSettings->GetNumNetworkLODs(); ++LOD)
+	{
+		AppliedSettings.NetworkLODs.Add(StyleTransferSettings->GetNetworkLOD(LOD).ToSoftObjectPath());
+		AppliedSettings.StyleParamsMappings.Add(TArray<int32>(StyleTransferSettings->GetNetworkLODStyleParamsMapping(LOD)));
+	}
+	AppliedSettings.InterpolationCurve = *StyleTransferSettings->InterpolationCurve.GetRichCurveConst();
+	AppliedSettings.StyleWeightsSource = StyleTransferSettings->StyleWeightsSource;
+	AppliedSettings.StyleWeightsConstant = StyleTransferSettings->StyleWeightsConstant;
+	AppliedSettings.StyleWeightsTexture = StyleTransferSettings->StyleWeightsTexture.ToSoftObjectPath();
+	AppliedSettings.StyleRegions.Reset();
+	for (const FStyleTransferStyleRegion& StyleRegion : StyleTransferSettings->StyleRegions)
+	{
+		AppliedSettings.StyleRegions.Emplace(StyleRegion.StyleIndex, StyleRegion.StencilValue);
+	}
+	AppliedSettings.bRequirePostProcessVolume = StyleTransferSettings->bRequirePostProcessVolume;
+	AppliedSettings.bDynamicContentShape = StyleTransferSettings->bDynamicContentShape;
+	AppliedSettings.ContentShapeStride = StyleTransferSettings->ContentShapeStride;
+	AppliedSettings.ContentShapeHysteresis = StyleTransferSettings->ContentShapeHysteresis;
+	AppliedSettings.NumCachedContentShapes = StyleTransferSettings->NumCachedContentShapes;
+}
+
+void UStyleTransferSubsystem::HandleSettingsChanged()
+{
+	const FAppliedSettings PreviousSettings = MoveTemp(AppliedSettings);
+	UpdateAppliedSettings();
+
+	if (!(AppliedSettings.InterpolationCurve == PreviousSettings.InterpolationCurve))
+	{
+		BuildInterpolationLUT();
+	}
+
+	// nothing uses the settings until the networks are loaded
+	if (!StyleTransferNetwork)
+		return;
+
+	// every style and every LOD depends on the StylePredictionNetwork, the content shape cache owns contexts the extension may still use
+	if (AppliedSettings.StylePredictionNetwork != PreviousSettings.StylePredictionNetwork)
+	{
+		RestartStyleTransfer(true);
+		return;
+	}
+	if (AppliedSettings.bDynamicContentShape != PreviousSettings.bDynamicContentShape
+		|| AppliedSettings.ContentShapeStride != PreviousSettings.ContentShapeStride
+		|| AppliedSettings.ContentShapeHysteresis != PreviousSettings.ContentShapeHysteresis
+		|| AppliedSettings.NumCachedContentShapes != PreviousSettings.NumCachedContentShapes)
+	{
+		RestartStyleTransfer(false);
+		return;
+	}
+
+	// LODs whose network changed are validated and loaded again when they are requested
+	const int32 NumNetworkLODs = AppliedSettings.NetworkLODs.Num();
+	bool bCurrentNetworkLODChanged = CurrentNetworkLOD >= NumNetworkLODs;
+	// the render thread may still use the replaced networks
+	TArray<TStrongObjectPtr<UNeuralNetwork>> PreviousNetworks;
+	for (int32 LOD = NumNetworkLODs; LOD < LoadedNetworkLODs.Num(); ++LOD)
+	{
+		PreviousNetworks.Emplace(LoadedNetworkLODs[LOD]);
+	}
+	LoadedNetworkLODs.SetNum(NumNetworkLODs);
+	for (auto It = InvalidNetworkLODs.CreateIterator(); It; ++It)
+	{
+		if (*It >= NumNetworkLODs)
+		{
+			It.RemoveCurrent();
+		}
+	}
+	for (int32 LOD = 0; LOD < NumNetworkLODs; ++LOD)
+	{
+		if (PreviousSettings.NetworkLODs.IsValidIndex(LOD)
+			&& AppliedSettings.NetworkLODs[LOD] == PreviousSettings.NetworkLODs[LOD]
+			&& AppliedSettings.StyleParamsMappings[LOD] == PreviousSettings.StyleParamsMappings[LOD])
+			continue;
+
+		PreviousNetworks.Emplace(LoadedNetworkLODs[LOD]);
+		LoadedNetworkLODs[LOD] = nullptr;
+		InvalidNetworkLODs.Remove(LOD);
+		NetworkLODLoadHandles.Remove(LOD);
+		bCurrentNetworkLODChanged |= LOD == CurrentNetworkLOD;
+	}
+	if (bCurrentNetworkLODChanged)
+	{
+		// migrates the inference contexts, captures and caches like a LOD switch
+		const int32 LOD = GetDesiredNetworkLOD();
+		UNeuralNetwork* Network = GetDefault<UStyleTransferSettings>()->GetNetworkLOD(LOD).LoadSynchronous();
+		if (PrepareNetworkLOD(LOD, Network))
+		{
+			SwitchNetworkLOD(LOD, Network);
+		}
+		else
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Keeping the previous style transfer network because network LOD %i can not be used"), LOD);
+			PreviousNetworks.Emplace(StyleTransferNetwork);
+		}
+	}
+	RunAfterRenderThread([PreviousNetworks = MoveTemp(PreviousNetworks)]() mutable
+	{
+		PreviousNetworks.Empty();
+	});
+
+	if (!StyleTransferSceneViewExtension)
+		return;
+
+	if (AppliedSettings.StyleWeightsSource != PreviousSettings.StyleWeightsSource
+		|| AppliedSettings.StyleWeightsConstant != PreviousSettings.StyleWeightsConstant
+		|| AppliedSettings.StyleWeightsTexture != PreviousSettings.StyleWeightsTexture
+		|| AppliedSettings.StyleRegions != PreviousSettings.StyleRegions)
+	{
+		ApplyStyleWeightsSettings();
+	}
+	if (AppliedSettings.StyleRegions != PreviousSettings.StyleRegions)
+	{
+		UpdateRegionalStyles();
+	}
+	if (AppliedSettings.bRequirePostProcessVolume != PreviousSettings.bRequirePostProcessVolume)
+	{
+		StyleTransferSceneViewExtension->SetRequirePostProcessVolume(AppliedSettings.bRequirePostProcessVolume);
+	}
+
+	// styles are compared by index, so removing one in the middle predicts all following ones again
+	const TArray<TSoftObjectPtr<UTexture2D>>& StyleTextures = GetDefault<UStyleTransferSettings>()->StyleTextures;
+	while (NumSettingsStyles > StyleTextures.Num())
+	{
+		RemoveResidentStyleAt(--NumSettingsStyles);
+	}
+	for (auto It = LatestSettingsStyleRequests.CreateIterator(); It; ++It)
+	{
+		if (It.Key() >= StyleTextures.Num())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	for (int32 i = 0; i < StyleTextures.Num(); ++i)
+	{
+		if (i < NumSettingsStyles && PreviousSettings.StyleTextures.IsValidIndex(i) && AppliedSettings.StyleTextures[i] == PreviousSettings.StyleTextures[i])
+			continue;
+
+		UTexture2D* StyleTexture = StyleTextures[i].LoadSynchronous();
+		if (!StyleTexture)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("Style texture %i could not be loaded"), i);
+			continue;
+		}
+		PredictSettingsStyle(i, StyleTexture);
+	}
+}
+
+void UStyleTransferSubsystem::RestartStyleTransfer(bool bReloadNetworks)
+{
+	UE_LOG(LogStyleTransfer, Log, TEXT("Restarting the style transfer for the changed settings"));
+	const bool bWasStylizing = StyleTransferSceneViewExtension.IsValid();
+	StopStylizingViewport();
+	if (bReloadNetworks)
+	{
+		// callbacks added while stopping may still refer to contexts of the previous networks
+		FlushRenderingCommands();
+		TickRenderThreadCallbacks(true);
+		StyleTransferNetwork = nullptr;
+		StylePredictionNetwork = nullptr;
+		LoadedNetworkLODs.Reset();
+		InvalidNetworkLODs.Reset();
+		NetworkLODLoadHandles.Reset();
+		LoadNetworks();
+	}
+	FViewportClient* ViewportClient = bEditorPreview ? StylizedViewportClient : GetGameInstance()->GetGameViewportClient();
+	if (bWasStylizing && ViewportClient)
+	{
+		StartStylizingViewport(ViewportClient);
+	}
+}
+
+void UStyleTransferSubsystem::BuildInterpolationLUT()
+{
+	constexpr int32 InterpolationLUTSize = 256;
+	const FRichCurve* InterpCurve = GetDefault<UStyleTransferSettings>()->InterpolationCurve.GetRichCurveConst();
+	InterpCurve->GetTimeRange(InterpolationLUTMinTime, InterpolationLUTMaxTime);
+	InterpolationLUT.SetNumUninitialized(InterpolationLUTSize);
+	for (int32 i = 0; i < InterpolationLUTSize; ++i)
+	{
+		InterpolationLUT[i] = InterpCurve->Eval(FMath::Lerp(InterpolationLUTMinTime, InterpolationLUTMaxTime, i / static_cast<float>(InterpolationLUTSize - 1)));
+	}
+}
+
+float UStyleTransferSubsystem::SampleInterpolationLUT(double Time) const
+{
+	const double Duration = InterpolationLUTMaxTime - InterpolationLUTMinTime;
+	if (Duration <= 0.)
+		return InterpolationLUT[0];
+
+	const float Position = FMath::Fmod(Time, Duration) / Duration * (InterpolationLUT.Num() - 1);
+	const int32 Index = FMath::Min(FMath::FloorToInt32(Position), InterpolationLUT.Num() - 2);
+	return FMath::Lerp(InterpolationLUT[Index], InterpolationLUT[Index + 1], Position - Index);
+}
+
+void UStyleTransferSubsystem::ApplyStyleWeightsSettings()
+{
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	if (StyleWeightsTexture)
+	{
+		RunAfterRenderThread([PreviousStyleWeightsTexture = TStrongObjectPtr<UTexture>(StyleWeightsTexture.Get())]() mutable
+		{
+			PreviousStyleWeightsTexture.Reset();
+		});
+		StyleWeightsTexture = nullptr;
+	}
+	if (StyleTransferSettings->StyleWeightsSource == EStyleTransferStyleWeightsSource::Texture)
+	{
+		StyleWeightsTexture = StyleTransferSettings->StyleWeightsTexture.LoadSynchronous();
+		if (!StyleWeightsTexture)
+		{
+			UE_LOG(LogStyleTransfer, Warning, TEXT("StyleWeightsTexture could not be loaded, the style weights stay at their defaults"));
+		}
+	}
+	// the first style set is used where no region matches
+	FUintVector4 StencilValues(0, 0, 0, 0);
+	for (int32 Region = 0; Region < FMath::Min(StyleTransferSettings->StyleRegions.Num(), FStyleWeightsMaskCS::MaxStyles - 1); ++Region)
+	{
+		StencilValues[Region + 1] = StyleTransferSettings->StyleRegions[Region].StencilValue;
+	}
+	StyleTransferSceneViewExtension->SetStyleWeightsSource(StyleTransferSettings->StyleWeightsSource, StyleTransferSettings->StyleWeightsConstant, StyleWeightsTexture, StencilValues);
+}
+
+TFuture<bool> UStyleTransferSubsystem::LoadNetworksAsync()
+{
+	if (StyleTransferNetwork && StylePredictionNetwork)
+		return MakeFulfilledPromise<bool>(StyleTransferNetwork->IsLoaded() && StylePredictionNetwork->IsLoaded()).GetFuture();
+
+	TFuture<bool> Future = LoadNetworksPromises.Add_GetRef(MakeShared<TPromise<bool>>())->GetFuture();
+	// the networks are already being loaded for a previous request
+	if (LoadNetworksPromises.Num() > 1)
+		return Future;
+
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	TArray<FSoftObjectPath> NetworkPaths;
+	NetworkPaths.Add(StyleTransferSettings->StylePredictionNetwork.ToSoftObjectPath());
+	NetworkPaths.AddUnique(StyleTransferSettings->GetNetworkLOD(GetDesiredNetworkLOD()).ToSoftObjectPath());
+	// LoadNetworks falls back to LOD 0
+	NetworkPaths.AddUnique(StyleTransferSettings->StyleTransferNetwork.ToSoftObjectPath());
+	NetworkPaths.RemoveAll([](const FSoftObjectPath& Path) { return Path.IsNull(); });
+
+	if (NetworkPaths.IsEmpty())
+	{
+		HandleNetworksLoaded();
+		return Future;
+	}
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Loading %i networks in the background"), NetworkPaths.Num());
+	StreamableManager.RequestAsyncLoad(NetworkPaths, FStreamableDelegate::CreateUObject(this, &UStyleTransferSubsystem::HandleNetworksLoaded));
+	return Future;
+}
+
+void UStyleTransferSubsystem::HandleNetworksLoaded()
+{
+	// everything is resident by now, so this does not block
+	if (!(StyleTransferNetwork && StylePredictionNetwork))
+	{
+		LoadNetworks();
+	}
+
+	const bool bLoaded = StyleTransferNetwork && StyleTransferNetwork->IsLoaded() && StylePredictionNetwork && StylePredictionNetwork->IsLoaded();
+	for (const TSharedRef<TPromise<bool>>& Promise : MoveTemp(LoadNetworksPromises))
+	{
+		Promise->SetValue(bLoaded);
+	}
+}
+
+void UStyleTransferSubsystem::LoadNetworks()
+{
+	LLM_SCOPE_BYTAG(StyleTransfer);
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	StylePredictionNetwork = StyleTransferSettings->StylePredictionNetwork.LoadSynchronous();
+
+	if (StylePredictionNetwork && StylePredictionNetwork->IsLoaded())
+	{
+		StylePredictionNetwork->SetDeviceType(ENeuralDeviceType::GPU, ENeuralDeviceType::GPU, ENeuralDeviceType::GPU);
+	}
+	else
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("StylePredictionNetwork could not be loaded."));
+	}
+
+	bCpuExecution = CVarCpuExecution.GetValueOnGameThread();
+	LoadedNetworkLODs.SetNum(StyleTransferSettings->GetNumNetworkLODs());
+	CurrentNetworkLOD = GetDesiredNetworkLOD();
+	UNeuralNetwork* Network = StyleTransferSettings->GetNetworkLOD(CurrentNetworkLOD).LoadSynchronous();
+	if (!PrepareNetworkLOD(CurrentNetworkLOD, Network) && CurrentNetworkLOD != 0)
+	{
+		UE_LOG(LogStyleTransfer, Warning, TEXT("Falling back to network LOD 0"));
+		CurrentNetworkLOD = 0;
+		Network = StyleTransferSettings->StyleTransferNetwork.LoadSynchronous();
+		PrepareNetworkLOD(CurrentNetworkLOD, Network);
+	}
+	StyleTransferNetwork = LoadedNetworkLODs[CurrentNetworkLOD];
+
+	if (StyleTransferNetwork)
+	{
+		StyleTransferStyleParamsInputIndex = FindStyleParamsInputIndex(StyleTransferNetwork);
+	}
+	else
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("StyleTransferNetwork could not be loaded"));
+	}
+}
+
+int32 UStyleTransferSubsystem::GetDesiredNetworkLOD() const
+{
+	const UStyleTransferSettings* StyleTransferSettings = GetDefault<UStyleTransferSettings>();
+	const int32 NumNetworkLODs = StyleTransferSettings->GetNumNetworkLODs();
+
+	int32 DesiredNetworkLOD = 0;
+	const int32 ForcedNetworkLOD = CVarNetworkLOD.GetValueOnGameThread();
+	const float TargetMs = CVarNetworkLODTargetMs.GetValueOnGameThread();
+	if (ForcedNetworkLOD >= 0)
+	{
+		DesiredNetworkLOD = ForcedNetworkLOD;
+	}
+	else if (RequestedNetworkLOD != INDEX_NONE)
+	{
+		DesiredNetworkLOD = RequestedNetworkLOD;
+	}
+	else if (TargetMs > 0)
+	{
+		DesiredNetworkLOD = NumNetworkLODs - 1;
+		for (int32 LOD = 0; LOD < NumNetworkLODs; ++LOD)
+		{
+			if (StyleTransferSettings->GetNetworkLODCostMs(LOD) <= TargetMs)
+			{
+				DesiredNetworkLOD = LOD;
+				break;
+			}
+		}
+	}
+	else if (StyleTransferSettings->NetworkLODPerPostProcessQuality.Num())
+	{
+		static const TConsoleVariableData<int32>* CVarPostProcessQuality = IConsoleManager::Get().FindTConsoleVariableDataInt(TEXT("sg.PostProcessQuality"));
+		const int32 PostProcessQuality = CVarPostProcessQuality ? CVarPostProcessQuality->GetValueOnGameThread() : 3;
+		DesiredNetworkLOD = StyleTransferSettings->NetworkLODPerPostProcessQuality[FMath::Clamp(PostProcessQuality, 0, StyleTransferSettings->NetworkLODPerPostProcessQuality.Num() - 1)];
+	}
+
+	// prefer the next cheaper LOD over the next better one if the desired one can not be used
+	DesiredNetworkLOD = FMath::Clamp(DesiredNetworkLOD, 0, NumNetworkLODs - 1);
+	int32 ValidNetworkLOD = DesiredNetworkLOD;
+	while (InvalidNetworkLODs.Contains(ValidNetworkLOD) && ValidNetworkLOD < NumNetworkLODs - 1) ++ValidNetworkLOD;
+	while (InvalidNetworkLODs.Contains(ValidNetworkLOD) && ValidNetworkLOD > 0) --ValidNetworkLOD;
+	return ValidNetworkLOD;
+}
+
+UNeuralNetwork* UStyleTransferSubsystem::RequestNetworkLOD(int32 LOD)
+{
+	if (!LoadedNetworkLODs.IsValidIndex(LOD) || InvalidNetworkLODs.Contains(LOD))
+		return nullptr;
+	if (LoadedNetworkLODs[LOD])
+		return LoadedNetworkLODs[LOD];
+
+	const TSoftObjectPtr<UNeuralNetwork>& SoftNetwork = GetDefault<UStyleTransferSettings>()->GetNetworkLOD(LOD);
+	if (UNeuralNetwork* Network = SoftNetwork.Get())
+	{
+		NetworkLODLoadHandles.Remove(LOD);
+		return PrepareNetworkLOD(LOD, Network) ? Network : nullptr;
+	}
+
+	if (!NetworkLODLoadHandles.Contains(LOD))
+	{
+		UE_LOG(LogStyleTransfer, Log, TEXT("Loading network LOD %i in the background"), LOD);
+		NetworkLODLoadHandles.Add(LOD, StreamableManager.RequestAsyncLoad(SoftNetwork.ToSoftObjectPath()));
+	}
+	return nullptr;
+}
+
+bool UStyleTransferSubsystem::PrepareNetworkLOD(int32 LOD, UNeuralNetwork* Network)
+{
+	if (!Network || !Network->IsLoaded())
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Network LOD %i could not be loaded"), LOD);
+		InvalidNetworkLODs.Add(LOD);
+		return false;
+	}
+
+	// the extension requires these tensors on the render thread
+	const int32 StyleParamsInputIndex = FindStyleParamsInputIndex(Network);
+	if (StyleParamsInputIndex == INDEX_NONE || FindInputTensorIndex(Network, TEXT("content")) == INDEX_NONE || Network->GetOutputTensorNumber() == 0)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Network LOD %i (%s) needs a content and a style_params input and an output"), LOD, *Network->GetName());
+		InvalidNetworkLODs.Add(LOD);
+		return false;
+	}
+
+	// every LOD has to accept the style params of the StylePredictionNetwork, directly or through its mapping
+	const int64 NumStyleParams = Network->GetInputTensor(StyleParamsInputIndex).Num();
+	const int64 NumPredictedStyleParams = StylePredictionNetwork ? StylePredictionNetwork->GetOutputTensor(0).Num() : NumStyleParams;
+	// networks that blend several styles take one set of them per style_weights channel, stacked without mapping
+	const int32 NumStyleSets = GetNumStyleSets(Network);
+	const TConstArrayView<int32> StyleParamsMapping = GetDefault<UStyleTransferSettings>()->GetNetworkLODStyleParamsMapping(LOD);
+	const bool bIsCompatible = StyleParamsMapping.Num()
+		                           ? NumStyleSets == 1 && StyleParamsMapping.Num() == NumStyleParams && Algo::AllOf(StyleParamsMapping, [NumPredictedStyleParams](int32 Index) { return Index >= 0 && Index < NumPredictedStyleParams; })
+		                           : NumStyleParams == NumPredictedStyleParams * NumStyleSets;
+	if (!bIsCompatible)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Network LOD %i (%s) has %lli style params in %i sets but %lli are predicted and its StyleParamsMapping does not match"),
+			LOD, *Network->GetName(), NumStyleParams, NumStyleSets, NumPredictedStyleParams);
+		InvalidNetworkLODs.Add(LOD);
+		return false;
+	}
+	if (NumStyleSets > FStyleWeightsMaskCS::MaxStyles || (NumStyleSets > 1 && bCpuExecution))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Network LOD %i (%s) takes %i style sets, at most %i are supported and only on the GPU"),
+			LOD, *Network->GetName(), NumStyleSets, FStyleWeightsMaskCS::MaxStyles);
+		InvalidNetworkLODs.Add(LOD);
+		return false;
+	}
+
+	if (bCpuExecution)
+	{
+		Network->SetDeviceType(ENeuralDeviceType::CPU, ENeuralDeviceType::CPU, ENeuralDeviceType::CPU);
+	}
+	else
+	{
+		Network->SetDeviceType(ENeuralDeviceType::GPU, ENeuralDeviceType::GPU, ENeuralDeviceType::GPU);
+	}
+	LoadedNetworkLODs[LOD] = Network;
+	return true;
+}
+
+void UStyleTransferSubsystem::TickNetworkLOD()
+{
+	// the networks are only loaded once style transfer is used
+	if (!StyleTransferNetwork)
+		return;
+
+	const int32 DesiredNetworkLOD = GetDesiredNetworkLOD();
+	if (DesiredNetworkLOD != CurrentNetworkLOD)
+	{
+		if (UNeuralNetwork* Network = RequestNetworkLOD(DesiredNetworkLOD))
+		{
+			SwitchNetworkLOD(DesiredNetworkLOD, Network);
+		}
+	}
+
+	// keep the neighbouring LODs loaded so switching to them does not have to wait
+	RequestNetworkLOD(CurrentNetworkLOD - 1);
+	RequestNetworkLOD(CurrentNetworkLOD + 1);
+
+	if (NetworkLODPromise)
+	{
+		if (!LoadedNetworkLODs.IsValidIndex(RequestedNetworkLOD) || InvalidNetworkLODs.Contains(RequestedNetworkLOD) || CVarNetworkLOD.GetValueOnGameThread() >= 0)
+		{
+			NetworkLODPromise->SetValue(false);
+			NetworkLODPromise.Reset();
+		}
+		else if (CurrentNetworkLOD == RequestedNetworkLOD)
+		{
+			RunAfterRenderThread([Promise = NetworkLODPromise.ToSharedRef()]()
+			{
+				Promise->SetValue(true);
+			});
+			NetworkLODPromise.Reset();
+		}
+	}
+}
+
+TFuture<bool> UStyleTransferSubsystem::SetNetworkLODAsync(int32 LOD)
+{
+	if (NetworkLODPromise)
+	{
+		NetworkLODPromise->SetValue(false);
+		NetworkLODPromise.Reset();
+	}
+
+	RequestedNetworkLOD = LOD;
+	if (LOD == INDEX_NONE)
+		return MakeFulfilledPromise<bool>(true).GetFuture();
+
+	// fulfilled by TickNetworkLOD once the LOD was switched to
+	NetworkLODPromise = MakeShared<TPromise<bool>>();
+	return NetworkLODPromise->GetFuture();
+}
+
+void UStyleTransferSubsystem::SwitchNetworkLOD(int32 LOD, UNeuralNetwork* Network)
+{
+	// the frames of the batch belong to the previous network
+	if (BatchRenderer)
+	{
+		StyleTransferSceneViewExtension->FlushBatchRenderer();
+	}
+
+	if (CpuExecutor)
+	{
+		RunAfterRenderThread([PreviousCpuExecutor = CpuExecutor]() mutable
+		{
+			PreviousCpuExecutor.Reset();
+		});
+		CpuExecutor = MakeShared<FStyleTransferCpuExecutor, ESPMode::ThreadSafe>(Network);
+	}
+	else if (StyleTransferInferenceContext && *StyleTransferInferenceContext != INDEX_NONE)
+	{
+		const int64 AdditionalBytes = StyleTransferMemory::GetInferenceContextSize(Network) - StyleTransferMemory::GetInferenceContextSize(StyleTransferNetwork);
+		if (!IsWithinMemoryBudget(AdditionalBytes))
+		{
+			if (LastNetworkLODOverBudget != LOD)
+			{
+				UE_LOG(LogStyleTransfer, Warning, TEXT("Not switching to network LOD %i because it exceeds r.StyleTransfer.MemoryBudgetMB"), LOD);
+				LastNetworkLODOverBudget = LOD;
+			}
+			return;
+		}
+
+		UE_LOG(LogStyleTransfer, Log, TEXT("Creating Inference Context for network LOD %i"), LOD);
+		LLM_SCOPE_BYTAG(StyleTransfer);
+		const int32 InferenceContext = Network->CreateInferenceContext();
+		checkf(InferenceContext != INDEX_NONE, TEXT("Could not create inference context for network LOD %i"), LOD);
+
+		RunAfterRenderThread([PreviousNetwork = StyleTransferNetwork.Get(), PreviousInferenceContext = *StyleTransferInferenceContext]()
+		{
+			PreviousNetwork->DestroyInferenceContext(PreviousInferenceContext);
+		});
+		StyleTransferInferenceContext = MakeShared<int32>(InferenceContext);
+	}
+
+	UE_LOG(LogStyleTransfer, Log, TEXT("Switching style transfer network from LOD %i to LOD %i (%s)"), CurrentNetworkLOD, LOD, *Network->GetName());
+	// the contexts belong to the previous network, the extension drops the captures when it gets the new one
+	ReleaseSceneCaptureContexts();
+	StyleTransferNetwork = Network;
+	CurrentNetworkLOD = LOD;
+	LastNetworkLODOverBudget = INDEX_NONE;
+	StyleTransferStyleParamsInputIndex = FindStyleParamsInputIndex(Network);
+
+	if (StyleTransferSceneViewExtension)
+	{
+		StyleTransferSceneViewExtension->SetStyleTransferNetwork(Network, StyleTransferInferenceContext.ToSharedRef());
+		if (CpuExecutor)
+		{
+			StyleTransferSceneViewExtension->SetCpuExecutor(CpuExecutor);
+		}
+		if (ContentShapeCache)
+		{
+			RunAfterRenderThread([PreviousContentShapeCache = ContentShapeCache]() mutable
+			{
+				PreviousContentShapeCache.Reset();
+			});
+			ContentShapeCache = MakeShared<FStyleTransferContentShapeCache>(Network, [this](int64 AdditionalBytes)
+			{
+				return IsWithinMemoryBudget(AdditionalBytes);
+			}, [this](TFunction<void()> Callback)
+			{
+				RunAfterRenderThread(MoveTemp(Callback));
+			});
+			StyleTransferSceneViewExtension->SetContentShapeCache(ContentShapeCache);
+		}
+		if (BatchRenderer)
+		{
+			CreateBatchRenderer();
+		}
+		for (FStylizedSceneCapture& SceneCapture : StylizedSceneCaptures)
+		{
+			RegisterSceneCapture(SceneCapture);
+		}
+	}
+	// after the extension got the network, it releases the style params it keeps for the editor preview
+	UpdateStyleParamsTarget();
+	UpdateMemoryStats();
+}
+
+void UStyleTransferSubsystem::RunAfterRenderThread(TFunction<void()> Callback)
+{
+	FRenderThreadCallback& RenderThreadCallback = RenderThreadCallbacks.AddDefaulted_GetRef();
+	RenderThreadCallback.Fence = MakeUnique<FRenderCommandFence>();
+	RenderThreadCallback.Fence->BeginFence();
+	RenderThreadCallback.Callback = MoveTemp(Callback);
+}
+
+void UStyleTransferSubsystem::TickRenderThreadCallbacks(bool bFlush)
+{
+	// callbacks may fulfill promises whose continuations add new callbacks
+	TArray<TFunction<void()>> ReadyCallbacks;
+	for (auto It = RenderThreadCallbacks.CreateIterator(); It; ++It)
+	{
+		if (bFlush || It->Fence->IsFenceComplete())
+		{
+			ReadyCallbacks.Add(MoveTemp(It->Callback));
+			It.RemoveCurrent();
+		}
+	}
+	for (TFunction<void()>& Callback : ReadyCallbacks)
+	{
+		Callback();
 	}
 }
 
-void UStyleTransferSubsystem::InterpolateStyles(int32 StylePredictionInferenceContextA, int32 StylePredictionInferenceContextB, float Alpha)
+void UStyleTransferSubsystem::InterpolateStyles(int32 StyleHandleA, int32 StyleHandleB, float Alpha)
 {
-	checkf(StyleTransferInferenceContext.IsValid() && (*StyleTransferInferenceContext) != INDEX_NONE, TEXT("Can not transfer style without inference context"));
-	checkf(StylePredictionInferenceContexts.Contains(StylePredictionInferenceContextA), TEXT("Can not update style without inference context A"));
-	checkf(StylePredictionInferenceContexts.Contains(StylePredictionInferenceContextB), TEXT("Can not update style without inference context B"));
-	ENQUEUE_RENDER_COMMAND(StylePrediction)([this, StylePredictionInferenceContextA, StylePredictionInferenceContextB, Alpha](FRHICommandListImmediate& RHICommandList)
+	checkf(CanTransferStyle(), TEXT("Can not transfer style without inference context"));
+	const FResidentStyle* StyleA = FindResidentStyle(StyleHandleA);
+	const FResidentStyle* StyleB = FindResidentStyle(StyleHandleB);
+	checkf(StyleA, TEXT("Can not interpolate styles without style A"));
+	checkf(StyleB, TEXT("Can not interpolate styles without style B"));
+	ENQUEUE_RENDER_COMMAND(StylePrediction)([this, StyleA = *StyleA, StyleB = *StyleB, Alpha](FRHICommandListImmediate& RHICommandList)
 	{
 		IRenderCaptureProvider* RenderCaptureProvider = ConditionalBeginRenderCapture(RHICommandList);
 		FRDGBuilder GraphBuilder(RHICommandList);
 		{
 			RDG_EVENT_SCOPE(GraphBuilder, "StylePrediction");
 
-			FNeuralTensor& InputStyleImageTensorA = StylePredictionNetwork->GetOutputTensorForContextMutable(StylePredictionInferenceContextA, 0);
-			FNeuralTensor& InputStyleImageTensorB = StylePredictionNetwork->GetOutputTensorForContextMutable(StylePredictionInferenceContextB, 0);
-			FNeuralTensor& OutputStyleParamsTensor = StyleTransferNetwork->GetInputTensorForContextMutable(*StyleTransferInferenceContext, StyleTransferStyleParamsInputIndex);
-			InputStyleImageTensorA.GPUToRDGBuilder_RenderThread(&GraphBuilder);
-			InputStyleImageTensorB.GPUToRDGBuilder_RenderThread(&GraphBuilder);
-			OutputStyleParamsTensor.GPUToRDGBuilder_RenderThread(&GraphBuilder);
-			FStyleTransferSceneViewExtension::InterpolateTensors(GraphBuilder, OutputStyleParamsTensor, InputStyleImageTensorA, InputStyleImageTensorB, Alpha);
+			FRDGBufferRef PredictedStyleParamsBuffer = GetStyleParamsBuffer_RenderThread(GraphBuilder);
+			if (StyleA.StylePredictionInferenceContext != INDEX_NONE && StyleB.StylePredictionInferenceContext != INDEX_NONE)
+			{
+				FNeuralTensor& InputStyleImageTensorA = StylePredictionNetwork->GetOutputTensorForContextMutable(StyleA.StylePredictionInferenceContext, 0);
+				FNeuralTensor& InputStyleImageTensorB = StylePredictionNetwork->GetOutputTensorForContextMutable(StyleB.StylePredictionInferenceContext, 0);
+				InputStyleImageTensorA.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				InputStyleImageTensorB.GPUToRDGBuilder_RenderThread(&GraphBuilder);
+				FStyleTransferSceneViewExtension::InterpolateBuffers(GraphBuilder, GraphBuilder.CreateUAV(PredictedStyleParamsBuffer, PF_R32_FLOAT),
+				                                                     InputStyleImageTensorA.GetBufferSRVRef(), InputStyleImageTensorB.GetBufferSRVRef(),
+				                                                     InputStyleImageTensorA.Num(), Alpha);
+			}
+			else
+			{
+				FRDGBufferSRVRef ValuesA, ScaleOffsetsA, ValuesB, ScaleOffsetsB;
+				GetQuantizedStyleParams_RenderThread(GraphBuilder, StyleA, ValuesA, ScaleOffsetsA);
+				GetQuantizedStyleParams_RenderThread(GraphBuilder, StyleB, ValuesB, ScaleOffsetsB);
+				FStyleTransferSceneViewExtension::InterpolateQuantizedBuffers(GraphBuilder, GraphBuilder.CreateUAV(PredictedStyleParamsBuffer, PF_R32_FLOAT),
+				                                                              ValuesA, ScaleOffsetsA, ValuesB, ScaleOffsetsB,
+				                                                              CastNarrowingSafe<uint32>(StylePredictionNetwork->GetOutputTensor(0).Num()), Alpha);
+			}
+			ApplyStyleParams_RenderThread(GraphBuilder);
 		}
 		GraphBuilder.Execute();
 		if (RenderCaptureProvider) RenderCaptureProvider->EndCapture(&RHICommandList);
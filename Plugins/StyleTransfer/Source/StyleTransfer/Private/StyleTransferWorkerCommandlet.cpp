@@ -0,0 +1,122 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferWorkerCommandlet.h"
+
+#include "NeuralNetwork.h"
+#include "StyleTransferInferenceWorker.h"
+#include "StyleTransferModule.h"
+#include "StyleTransferRecording.h"
+
+UStyleTransferWorkerCommandlet::UStyleTransferWorkerCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UStyleTransferWorkerCommandlet::Main(const FString& Params)
+{
+	FString RingName;
+	if (!FParse::Value(*Params, TEXT("Ring="), RingName))
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Usage: -run=StyleTransferWorker -Ring=<name> [-Affinity=<hex core mask>]"));
+		return 1;
+	}
+
+	// threads the inference runtime creates while loading the network inherit the mask on Linux
+	FString Affinity;
+	if (FParse::Value(*Params, TEXT("Affinity="), Affinity))
+	{
+		const uint64 AffinityMask = FCString::Strtoui64(*Affinity, nullptr, 16);
+		UE_LOG(LogStyleTransfer, Display, TEXT("Pinning inference to core mask 0x%llx"), AffinityMask);
+		FPlatformProcess::SetThreadAffinityMask(AffinityMask);
+	}
+
+	FStyleTransferInferenceRing Ring;
+	if (!Ring.Open(RingName))
+		return 1;
+
+	const FStyleTransferInferenceRingHeader& Header = Ring.GetHeader();
+	const FString NetworkPath = ANSI_TO_TCHAR(Header.NetworkPath);
+	UNeuralNetwork* StyleTransferNetwork = StyleTransferRecording::LoadNetworkForCpu(NetworkPath);
+	if (!StyleTransferNetwork)
+		return 1;
+
+	// the last tensor of the ring is the output
+	const TArrayView<const FStyleTransferRecordingTensorDesc> TensorDescs = Ring.GetTensorDescs();
+	const int32 OutputIndex = TensorDescs.Num() - 1;
+	TArray<int32> InputTensorIndices;
+	if (!StyleTransferRecording::FindInputTensorIndices(StyleTransferNetwork, TensorDescs.Slice(0, OutputIndex), InputTensorIndices))
+		return 1;
+	if (StyleTransferNetwork->GetOutputTensor(0).NumInBytes() != TensorDescs[OutputIndex].NumBytes)
+	{
+		UE_LOG(LogStyleTransfer, Error, TEXT("Output of %s does not match the ring"), *StyleTransferNetwork->GetName());
+		return 1;
+	}
+
+	UE_LOG(LogStyleTransfer, Display, TEXT("Running %s for ring %s of process %u"), *StyleTransferNetwork->GetName(), *RingName, Header.OwnerProcessId);
+
+	int32 NumFramesRun = 0;
+	double RunMsSum = 0;
+	double LastOwnerCheckTime = FPlatformTime::Seconds();
+	while (!FPlatformAtomics::AtomicRead(&Header.bShutdown))
+	{
+		FPlatformAtomics::InterlockedIncrement(&Ring.GetHeader().WorkerHeartbeat);
+
+		// the oldest submitted slot is run first so the outputs complete in fence order
+		int32 SlotIndex = INDEX_NONE;
+		int64 OldestFence = MAX_int64;
+		for (int32 i = 0; i < static_cast<int32>(Header.NumSlots); ++i)
+		{
+			const FStyleTransferInferenceSlotHeader& SlotHeader = Ring.GetSlotHeader(i);
+			const int64 SubmittedFence = FPlatformAtomics::AtomicRead(&SlotHeader.SubmittedFence);
+			if (SubmittedFence != FPlatformAtomics::AtomicRead(&SlotHeader.CompletedFence) && SubmittedFence < OldestFence)
+			{
+				OldestFence = SubmittedFence;
+				SlotIndex = i;
+			}
+		}
+
+		if (SlotIndex == INDEX_NONE)
+		{
+			if (FPlatformTime::Seconds() - LastOwnerCheckTime > 1.)
+			{
+				if (!FPlatformProcess::IsApplicationRunning(Header.OwnerProcessId))
+				{
+					UE_LOG(LogStyleTransfer, Warning, TEXT("Process %u that owns ring %s is gone"), Header.OwnerProcessId, *RingName);
+					break;
+				}
+				LastOwnerCheckTime = FPlatformTime::Seconds();
+			}
+			FPlatformProcess::SleepNoStats(0.0005f);
+			continue;
+		}
+
+		for (int32 TensorIndex = 0; TensorIndex < InputTensorIndices.Num(); ++TensorIndex)
+		{
+			StyleTransferNetwork->SetInputFromVoidPointerCopy(Ring.GetTensorData(SlotIndex, TensorIndex), InputTensorIndices[TensorIndex]);
+		}
+
+		const double RunStartTime = FPlatformTime::Seconds();
+		StyleTransferNetwork->Run();
+		const double RunMs = (FPlatformTime::Seconds() - RunStartTime) * 1000.;
+
+		const TArray<uint8>& OutputData = StyleTransferNetwork->GetOutputTensor(0).GetUnderlyingUInt8ArrayRef();
+		FMemory::Memcpy(Ring.GetTensorData(SlotIndex, OutputIndex), OutputData.GetData(), TensorDescs[OutputIndex].NumBytes);
+
+		FStyleTransferInferenceSlotHeader& SlotHeader = Ring.GetSlotHeader(SlotIndex);
+		SlotHeader.RunMs = RunMs;
+		FPlatformAtomics::AtomicStore(&SlotHeader.CompletedFence, OldestFence);
+
+		++NumFramesRun;
+		RunMsSum += RunMs;
+		if (NumFramesRun % 100 == 0)
+		{
+			UE_LOG(LogStyleTransfer, Display, TEXT("Ran %i frames, average run time %.3fms"), NumFramesRun, RunMsSum / NumFramesRun);
+		}
+	}
+
+	UE_LOG(LogStyleTransfer, Display, TEXT("Inference worker for ring %s exits after %i frames"), *RingName, NumFramesRun);
+	return 0;
+}
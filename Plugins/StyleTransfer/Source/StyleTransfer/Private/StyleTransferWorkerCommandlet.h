@@ -0,0 +1,26 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "StyleTransferWorkerCommandlet.generated.h"
+
+/**
+ * Reference inference worker that runs the style transfer network on the CPU for the frames a game submits through an inference ring.
+ * Launched by the game when r.StyleTransfer.InferenceWorker is set, exits when the game closes the ring.
+ *
+ * Usage: -run=StyleTransferWorker -Ring=<name> [-Affinity=<hex core mask>]
+ */
+UCLASS()
+class UStyleTransferWorkerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UStyleTransferWorkerCommandlet();
+
+	// - UCommandlet
+	virtual int32 Main(const FString& Params) override;
+	// --
+};
@@ -0,0 +1,64 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "StyleTransferAsyncAction.generated.h"
+
+class UStyleTransferSubsystem;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FStyleTransferAsyncActionCompleted, bool, bSuccess, int32, StyleHandle);
+
+/**
+ * Blueprint nodes for the asynchronous operations of the UStyleTransferSubsystem.
+ * Completed fires once the render thread finished the operation. StyleHandle is only set by Request Style and Apply Style.
+ */
+UCLASS()
+class STYLETRANSFER_API UStyleTransferAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	/** Predicts the style of the texture in the background without applying it. StyleHandle can be passed to Apply Style. */
+	UFUNCTION(BlueprintCallable, Category="Style Transfer", meta=(BlueprintInternalUseOnly="true", WorldContext="WorldContextObject"))
+	static UStyleTransferAsyncAction* RequestStyle(UObject* WorldContextObject, TSoftObjectPtr<UTexture2D> StyleTexture);
+
+	/** Makes the style of a handle from Request Style the current one. */
+	UFUNCTION(BlueprintCallable, Category="Style Transfer", meta=(BlueprintInternalUseOnly="true", WorldContext="WorldContextObject"))
+	static UStyleTransferAsyncAction* ApplyStyle(UObject* WorldContextObject, int32 StyleHandle);
+
+	/** Loads the style transfer networks in the background. */
+	UFUNCTION(BlueprintCallable, Category="Style Transfer", meta=(BlueprintInternalUseOnly="true", WorldContext="WorldContextObject"))
+	static UStyleTransferAsyncAction* LoadNetworks(UObject* WorldContextObject);
+
+	/** Switches to the network LOD, -1 selects it automatically again. */
+	UFUNCTION(BlueprintCallable, Category="Style Transfer", meta=(BlueprintInternalUseOnly="true", WorldContext="WorldContextObject"))
+	static UStyleTransferAsyncAction* SetNetworkLOD(UObject* WorldContextObject, int32 LOD);
+
+	UPROPERTY(BlueprintAssignable)
+	FStyleTransferAsyncActionCompleted Completed;
+
+	// - UBlueprintAsyncActionBase
+	virtual void Activate() override;
+	// --
+
+private:
+	enum class EOperation : uint8
+	{
+		RequestStyle,
+		ApplyStyle,
+		LoadNetworks,
+		SetNetworkLOD,
+	};
+
+	static UStyleTransferAsyncAction* Create(UObject* WorldContextObject, EOperation Operation);
+	void Complete(bool bSuccess, int32 StyleHandle = INDEX_NONE);
+
+	EOperation Operation = EOperation::LoadNetworks;
+	TSoftObjectPtr<UTexture2D> StyleTexture;
+	/** Style handle or network LOD depending on the operation */
+	int32 Index = INDEX_NONE;
+
+	TWeakObjectPtr<UStyleTransferSubsystem> StyleTransferSubsystem;
+};
@@ -0,0 +1,64 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/BlendableInterface.h"
+#include "Engine/DataAsset.h"
+#include "StyleTransferBlendable.generated.h"
+
+class FSceneView;
+
+/** What a UStyleTransferBlendable pushes into the post process settings of a view */
+struct FStyleTransferBlendableData
+{
+	static FName GetFName()
+	{
+		static const FName Name(TEXT("FStyleTransferBlendableData"));
+		return Name;
+	}
+
+	float Weight = 0.f;
+	float Strength = 1.f;
+	int32 StyleIndex = INDEX_NONE;
+};
+
+/** Style transfer settings of a view after blending all volumes */
+struct FStyleTransferViewSettings
+{
+	/** 0 skips the stylization entirely, values in between blend the stylized output over the scene color */
+	float Strength = 1.f;
+	/** Index into the StyleTextures of the settings, INDEX_NONE keeps the current style */
+	int32 StyleIndex = INDEX_NONE;
+};
+
+/**
+ * Style transfer settings for the Blendables of post process volumes.
+ * The strength is blended by the weights of the volumes, the style of the last volume with a weight of at least 0.5 wins.
+ */
+UCLASS(BlueprintType)
+class STYLETRANSFER_API UStyleTransferBlendable : public UDataAsset, public IBlendableInterface
+{
+	GENERATED_BODY()
+
+public:
+	// - IBlendableInterface
+	virtual void OverrideBlendableSettings(FSceneView& View, float Weight) const override;
+	// --
+
+	/**
+	 * Blends the settings of all style transfer blendables of the view.
+	 * @param bRequireBlendable if set views without a style transfer blendable have a strength of 0, otherwise 1
+	 */
+	static FStyleTransferViewSettings GetViewSettings(const FSceneView& View, bool bRequireBlendable);
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Style Transfer")
+	bool bEnabled = true;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Style Transfer", meta=(EditCondition="bEnabled", ClampMin=0, ClampMax=1))
+	float Strength = 1.f;
+
+	/** Index into the StyleTextures of the Style Transfer settings, -1 keeps the current style */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Style Transfer", meta=(EditCondition="bEnabled", ClampMin=-1))
+	int32 StyleIndex = INDEX_NONE;
+};
@@ -0,0 +1,37 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "StyleTransferCaptureComponent.generated.h"
+
+class USceneCaptureComponent2D;
+
+/**
+ * Opts the scene capture of its actor in to style transfer while the game viewport is stylized.
+ * Only captures of the final color run the post processing the stylization is part of.
+ */
+UCLASS(ClassGroup=Rendering, meta=(BlueprintSpawnableComponent))
+class STYLETRANSFER_API UStyleTransferCaptureComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// - UActorComponent
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	// --
+
+	/** Stylized capture, the first USceneCaptureComponent2D of the owner if not set */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Style Transfer")
+	TObjectPtr<USceneCaptureComponent2D> SceneCapture;
+
+	/** Content size of the inference if the StyleTransferNetwork has a dynamic content shape. Smaller captures are cheaper to stylize. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Style Transfer", meta=(ClampMin=1))
+	FIntPoint InferenceResolution = FIntPoint(256, 256);
+
+	/** Minimum number of frames between two inferences, the renders in between reuse the previous result. 0 stylizes every render of the capture. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Style Transfer", meta=(ClampMin=0))
+	int32 UpdateInterval = 0;
+};
@@ -1,9 +1,21 @@
 #pragma once
+#include <atomic>
+
+#include "RendererInterface.h"
 #include "SceneViewExtension.h"
 
 struct FNeuralTensor;
 struct FScreenPassRenderTarget;
+class FStyleTransferBatchRenderer;
+class FStyleTransferContentShapeCache;
+class FStyleTransferCpuExecutor;
+class FStyleTransferInferenceWorkerClient;
+class FStyleTransferRecorder;
+class FStyleTransferStyleWeights;
+class FSceneViewStateInterface;
 class UNeuralNetwork;
+class UTexture;
+enum class EStyleTransferStyleWeightsSource : uint8;
 
 class FStyleTransferSceneViewExtension : public FWorldSceneViewExtension
 {
@@ -12,11 +24,14 @@ public:
 	using Ref = TSharedRef<FStyleTransferSceneViewExtension, ESPMode::ThreadSafe>;
 
 	FStyleTransferSceneViewExtension(const FAutoRegister& AutoRegister, UWorld* World, FViewportClient* AssociatedViewportClient, UNeuralNetwork* InStyleTransferNetwork, TSharedRef<int32> InInferenceContext);
+	virtual ~FStyleTransferSceneViewExtension() override;
 
 	// - ISceneViewExtension
 	virtual void SubscribeToPostProcessingPass(EPostProcessingPass Pass, FAfterPassCallbackDelegateArray& InOutPassCallbacks, bool bIsPassEnabled) override;
 
-	virtual void PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily) override;
+	virtual void PreRenderViewFamily_RenderThread(FRDGBuilder& GraphBuilder, FSceneViewFamily& InViewFamily) override
+	{
+	}
 
 	FScreenPassTexture PostProcessPassAfterTonemap_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View,
 	                                                            const FPostProcessMaterialInputs& InOutInputs);
@@ -29,9 +44,7 @@ public:
 	{
 	}
 
-	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override
-	{
-	}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
 
 	virtual bool IsActiveThisFrame_Internal(const FSceneViewExtensionContext& Context) const override;
 	// --
@@ -39,25 +52,223 @@ public:
 	void SetEnabled(bool bInIsEnabled) { bIsEnabled = bInIsEnabled; }
 	bool IsEnabled() const { return bIsEnabled; }
 
+	/** If set views are only stylized inside post process volumes with a UStyleTransferBlendable, see FStyleTransferViewSettings. */
+	void SetRequirePostProcessVolume(bool bInRequirePostProcessVolume);
+
+	/** StyleIndex the post process volumes of the last rendered view family ask for, INDEX_NONE if they ask for none. Game thread only. */
+	int32 GetRequestedStyleIndex() const { return RequestedStyleIndex; }
+	/** Set if the post process volumes blend the stylization of the last rendered view family out entirely. Game thread only. */
+	bool IsBlendedOut() const { return bBlendedOut; }
+
+	/** Size of the intermediate texture the network output is unpacked to in the last stylized frame. */
+	int64 GetOutputTextureMemory() const { return OutputTextureMemory; }
+
+	/** Records the network inputs of the next NumFrames stylized frames to the given file. */
+	void StartRecording(const FString& FilePath, int32 NumFrames);
+
+	/** Switches to another network with the same inputs, e.g. a different LOD. The previous network and context have to stay valid until the render thread caught up. */
+	void SetStyleTransferNetwork(UNeuralNetwork* InStyleTransferNetwork, TSharedRef<int32> InInferenceContext);
+
+	/** Runs the network in an inference worker process instead of in process. The output lags behind by the latency of the worker. */
+	void SetUseInferenceWorker(bool bInUseInferenceWorker);
 
-	static void AddRescalingTextureCopy(FRDGBuilder& GraphBuilder, FRDGTexture& RDGSourceTexture, FScreenPassRenderTarget& DestinationRenderTarget);
-	static FRDGTexture* TensorToTexture(FRDGBuilder& GraphBuilder, const FRDGTextureDesc& BaseDestinationDesc, const FNeuralTensor& SourceTensor);
-	static void TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor);
-	static void TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor);
-	static void InterpolateTensors(FRDGBuilder& GraphBuilder, FNeuralTensor& DestinationTensor, const FNeuralTensor& InputTensorA, const FNeuralTensor& InputTensorB, float Alpha);
+	/** If set the network runs on the CPU through the executor instead of in the InferenceContext. */
+	void SetCpuExecutor(TSharedPtr<FStyleTransferCpuExecutor, ESPMode::ThreadSafe> InCpuExecutor);
+
+	/**
+	 * Hands the views to the batch renderer instead of stylizing them, the views themselves are passed through.
+	 * GetFrameNumber is called on the game thread for every rendered view family and returns the frame number of the first view
+	 * or INDEX_NONE if it should not be stylized. Every frame number is only stylized once.
+	 */
+	void SetBatchRenderer(TSharedPtr<FStyleTransferBatchRenderer, ESPMode::ThreadSafe> InBatchRenderer, TFunction<int32()> InGetFrameNumber);
+	/** Runs the incomplete batch and waits until all stylized frames were passed to the image write queue. */
+	void FlushBatchRenderer();
+
+	/**
+	 * Stylizes the views of a scene capture in their own inference context instead of passing them through.
+	 * @param ViewState identifies the views of the capture, it has to persist its rendering state
+	 * @param ContentSize the content tensor is resized to this if it is not zero, requires a dynamic content shape
+	 * @param UpdateInterval minimum number of frames between two inferences of the capture, renders in between reuse the previous output.
+	 *                       A negative interval only runs the network once the capture is refreshed.
+	 */
+	void AddSceneCapture(const FSceneViewStateInterface* ViewState, int32 InferenceContext, FIntPoint ContentSize, int32 UpdateInterval);
+	void RemoveSceneCapture(const FSceneViewStateInterface* ViewState);
+	/** The next render of the capture runs the network even if its UpdateInterval did not pass yet. */
+	void RefreshSceneCapture(const FSceneViewStateInterface* ViewState);
+	/**
+	 * If set only scene captures and the views added with AddSceneCapture are stylized, every other view is passed through.
+	 * Views of any view state can be added, e.g. editor viewports that should not run the network every frame.
+	 */
+	void SetSceneCapturesOnly(bool bInSceneCapturesOnly);
+	/** Style params of the scene captures if the InferenceContext is INDEX_NONE, e.g. for the editor preview which has no fixed size context. */
+	FRDGBufferRef GetSceneCaptureStyleParamsBuffer_RenderThread(FRDGBuilder& GraphBuilder);
+
+	/**
+	 * Selects where the style_weights input comes from. Texture is only used by EStyleTransferStyleWeightsSource::Texture and has to stay alive while it is set.
+	 * StencilValues are the custom stencil values of the style parameter sets after the first one for EStyleTransferStyleWeightsSource::CustomStencil.
+	 */
+	void SetStyleWeightsSource(EStyleTransferStyleWeightsSource Source, float Constant, UTexture* Texture, FUintVector4 StencilValues = FUintVector4(0, 0, 0, 0));
+
+	/** Focus point of r.StyleTransfer.Foveated in normalized view coordinates, (0.5, 0.5) is the center of the view. */
+	void SetFoveatedFocus(FVector2f InFoveatedFocus);
+
+	/** If set the content tensor follows the view size using the contexts of the cache instead of the fixed size InferenceContext. */
+	void SetContentShapeCache(TSharedPtr<FStyleTransferContentShapeCache> InContentShapeCache) { ContentShapeCache = InContentShapeCache; }
+
+
+	/** With an Opacity below 1 the source is blended over the current content of the destination. */
+	static void AddRescalingTextureCopy(FRDGBuilder& GraphBuilder, FRDGTexture& RDGSourceTexture, FScreenPassRenderTarget& DestinationRenderTarget, float Opacity = 1.f);
+	// SourceRect is the part of the texture that is packed, an empty rect packs the whole texture
+	// PermutationId selects the thread group size, INDEX_NONE uses the fastest one found by the autotuner
+	static FRDGTexture* TensorToTexture(FRDGBuilder& GraphBuilder, const FRDGTextureDesc& BaseDestinationDesc, const FNeuralTensor& SourceTensor, int32 PermutationId = INDEX_NONE);
+	// bFilter reads sources larger than the tensor from a smaller mip and box filters them, e.g. for style images. Scene color takes a single tap per element.
+	static void TextureToTensorRGB(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor, const FIntRect& SourceRect = FIntRect(), int32 PermutationId = INDEX_NONE,
+	                               bool bFilter = false);
+	static void TextureToTensorGrayscale(FRDGBuilder& GraphBuilder, FRDGTextureRef SourceTexture, FNeuralTensor& DestinationTensor, const FIntRect& SourceRect = FIntRect(), int32 PermutationId = INDEX_NONE);
+	static void InterpolateTensors(FRDGBuilder& GraphBuilder, FNeuralTensor& DestinationTensor, const FNeuralTensor& InputTensorA, const FNeuralTensor& InputTensorB, float Alpha, int32 PermutationId = INDEX_NONE);
+	static void InterpolateBuffers(FRDGBuilder& GraphBuilder, FRDGBufferUAVRef Destination, FRDGBufferSRVRef InputA, FRDGBufferSRVRef InputB, uint32 Volume, float Alpha, int32 PermutationId = INDEX_NONE);
+	/**
+	 * Quantizes Volume floats to 8 bit with a scale and offset per FQuantizeTensorCS::ValuesPerBlock values.
+	 * QuantizedOutput needs (Volume + 3) / 4 uint32 and ScaleOffsetOutput two floats per block.
+	 */
+	static void QuantizeBuffer(FRDGBuilder& GraphBuilder, FRDGBufferSRVRef Input, uint32 Volume, FRDGBufferUAVRef QuantizedOutput, FRDGBufferUAVRef ScaleOffsetOutput);
+	/** InterpolateBuffers of two buffers quantized by QuantizeBuffer, dequantizing them on the fly */
+	static void InterpolateQuantizedBuffers(FRDGBuilder& GraphBuilder, FRDGBufferUAVRef Destination, FRDGBufferSRVRef QuantizedInputA, FRDGBufferSRVRef ScaleOffsetsA,
+	                                        FRDGBufferSRVRef QuantizedInputB, FRDGBufferSRVRef ScaleOffsetsB, uint32 Volume, float Alpha);
+	/** DestinationTensor[i] = Source[Indices[i]] */
+	static void GatherTensor(FRDGBuilder& GraphBuilder, FNeuralTensor& DestinationTensor, FRDGBufferSRVRef Source, TConstArrayView<int32> Indices);
+	/** Destination[i] = Source[Indices[i]] */
+	static void GatherBuffer(FRDGBuilder& GraphBuilder, FRDGBufferUAVRef Destination, FRDGBufferSRVRef Source, TConstArrayView<int32> Indices);
+
+	/**
+	 * Runs all passes of a stylized frame once on dummy data so PSOs and network intermediates are created before the first real frame.
+	 * The pipeline states of all compute shader permutations are created as well, including those of passes that only some settings use.
+	 */
+	static void WarmUp_RenderThread(FRDGBuilder& GraphBuilder, UNeuralNetwork* StyleTransferNetwork, int32 InferenceContext, FRDGTextureRef DummySceneColor);
 
 private:
+	void FindInputTensorIndices();
+
+	/** The inputs that are packed every frame in the order they are recorded and sent to the inference worker */
+	TArray<FNeuralTensor*, TInlineAllocator<3>> GetPackedInputTensors_RenderThread(int32 Context) const;
+
+	static TUniquePtr<FStyleTransferInferenceWorkerClient> CreateInferenceWorker(UNeuralNetwork* Network);
+
+	/**
+	 * Runs the network on an inset of the size of the InsetContext around the FoveatedFocus and on the whole view downsampled to the PeripheryContext
+	 * and blends the inset over the upsampled view. StyleWeightsMask has to cover the whole view if the network has style_weights.
+	 * @return the composite of the view size, it covers the view with its whole extent
+	 */
+	FRDGTexture* StylizeFoveated_RenderThread(FRDGBuilder& GraphBuilder, const FScreenPassTexture& SceneColor, int32 InsetContext, int32 PeripheryContext, FRDGTextureRef StyleWeightsMask);
+
+	/** Copies the style params from the fixed size context, which is the only one styles are written to, into Context */
+	void CopyStyleParams_RenderThread(FRDGBuilder& GraphBuilder, int32 Context) const;
+
+	/**
+	 * Unpacks the output tensor straight into the output of the pass instead of into an intermediate texture that is copied.
+	 * @return an invalid texture if the output can not be written by compute shaders, the caller has to fall back to OutputToBackBuffer_RenderThread
+	 */
+	FScreenPassTexture OutputTensorToBackBuffer_RenderThread(FRDGBuilder& GraphBuilder, const FScreenPassTexture& SceneColor, const FPostProcessMaterialInputs& InOutInputs, const FNeuralTensor& OutputTensor);
+
+	FScreenPassTexture StylizeSceneCapture_RenderThread(FRDGBuilder& GraphBuilder, const FSceneView& View, const FScreenPassTexture& SceneColor, const FPostProcessMaterialInputs& InOutInputs);
+
+	/**
+	 * Copies the stylized texture to the output of the pass and blends the scene color over it if the Strength of the view is below 1.
+	 * Without a stylized texture the scene color is passed through.
+	 */
+	FScreenPassTexture OutputToBackBuffer_RenderThread(FRDGBuilder& GraphBuilder, const FScreenPassTexture& SceneColor, const FPostProcessMaterialInputs& InOutInputs, FRDGTexture* StylizedTexture);
+
+	/** The context the ContentShapeCache chose or the fixed size InferenceContext */
+	int32 GetActiveInferenceContext_RenderThread() const { return ContentInferenceContext != INDEX_NONE ? ContentInferenceContext : *InferenceContext; }
+
 	/** The actual Network pointer is not tracked so we need a WeakPtr too so we can check its validity on the game thread. */
 	TWeakObjectPtr<UNeuralNetwork> StyleTransferNetworkWeakPtr;
 	TObjectPtr<UNeuralNetwork> StyleTransferNetwork;
 
 	FViewportClient* LinkedViewportClient;
 
+	/** Only accessed on the render thread after construction */
 	TSharedRef<int32, ESPMode::ThreadSafe> InferenceContext = MakeShared<int32>(-1);
+	TSharedRef<int32, ESPMode::ThreadSafe> InferenceContext_GameThread = InferenceContext;
 
 	bool bIsEnabled = true;
 
-	int32 NumFramesCaptured = -1;
+	/** Only accessed on the render thread */
+	bool bRequirePostProcessVolume = false;
+	/** Strength of the view that is currently post processed. Only accessed on the render thread */
+	float ViewStrength = 1.f;
+	bool bRequirePostProcessVolume_GameThread = false;
+	/** Game thread only */
+	int32 RequestedStyleIndex = INDEX_NONE;
+	/** Game thread only */
+	bool bBlendedOut = false;
+	/** Game thread only */
+	bool bReportedFoveationWithoutContentShape = false;
+
+	/** Game thread only */
+	TSharedPtr<FStyleTransferContentShapeCache> ContentShapeCache;
+
+	/** Context and size chosen by the ContentShapeCache for the current frame. Only accessed on the render thread */
+	int32 ContentInferenceContext = INDEX_NONE;
+	FIntPoint ContentSize = FIntPoint::ZeroValue;
+	/** Contexts chosen by the ContentShapeCache for r.StyleTransfer.Foveated, INDEX_NONE if the view is not foveated. Only accessed on the render thread */
+	int32 FoveatedInsetContext = INDEX_NONE;
+	int32 FoveatedPeripheryContext = INDEX_NONE;
+
+	/** Only accessed on the render thread */
+	TUniquePtr<FStyleTransferRecorder> Recorder;
+
+	/** Game thread only */
+	bool bUseInferenceWorker = false;
+
+	/** Only accessed on the render thread */
+	TUniquePtr<FStyleTransferInferenceWorkerClient> InferenceWorker;
+
+	bool bHasCpuExecutor_GameThread = false;
+	/** Only accessed on the render thread */
+	TSharedPtr<FStyleTransferCpuExecutor, ESPMode::ThreadSafe> CpuExecutor;
+
+	/** Game thread only */
+	TFunction<int32()> GetBatchFrameNumber;
+	int32 LastBatchFrameNumber = INDEX_NONE;
+	/** Only accessed on the render thread */
+	TSharedPtr<FStyleTransferBatchRenderer, ESPMode::ThreadSafe> BatchRenderer;
+	/** Frame number of the next view for the BatchRenderer. Only accessed on the render thread */
+	int32 BatchFrameNumber = INDEX_NONE;
+
+	struct FSceneCapture
+	{
+		int32 InferenceContext = INDEX_NONE;
+		FIntPoint ContentSize = FIntPoint::ZeroValue;
+		uint32 UpdateInterval = 0;
+		uint32 LastRenderedFrame = 0;
+		uint32 LastStylizedFrame = 0;
+		bool bRefreshRequested = false;
+		TRefCountPtr<IPooledRenderTarget> Output;
+		/** View rect the Output was stylized for, it is rescaled for views of another rect */
+		FIntRect OutputViewRect;
+	};
+	bool ShouldStylizeSceneCapture(const FSceneCapture& SceneCapture, uint32 FrameNumber) const;
+
+	/** Only accessed on the render thread */
+	TMap<const FSceneViewStateInterface*, FSceneCapture> SceneCaptures;
+	uint32 SceneCaptureFrameNumber = 0;
+	int32 NumSceneCaptureInferences = 0;
+	/** Only accessed on the render thread */
+	bool bSceneCapturesOnly = false;
+	bool bSceneCapturesOnly_GameThread = false;
+	/** Only accessed on the render thread */
+	TRefCountPtr<FRDGPooledBuffer> SceneCaptureStyleParamsBuffer;
+
+	/** Only accessed on the render thread */
+	FVector2f FoveatedFocus = FVector2f(0.5f, 0.5f);
+
+	/** Only accessed on the render thread */
+	TUniquePtr<FStyleTransferStyleWeights> StyleWeights;
+	/** Tensor or executor that got the last style weights, any other one needs them regenerated. Only accessed on the render thread */
+	const void* StyleWeightsTarget = nullptr;
+
+	std::atomic<int64> OutputTextureMemory = 0;
 
 	int32 ContentInputTensorIndex = INDEX_NONE;
 	int32 StyleWeightsInputTensorIndex = INDEX_NONE;
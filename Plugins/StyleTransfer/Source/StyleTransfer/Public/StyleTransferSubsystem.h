@@ -2,13 +2,40 @@
 
 #pragma once
 
+#include <atomic>
+
 #include "CoreMinimal.h"
 #include "IRenderCaptureProvider.h"
+#include "Async/Future.h"
+#include "Curves/RichCurve.h"
+#include "RenderGraphResources.h"
+#include "RenderingThread.h"
+#include "Engine/StreamableManager.h"
 #include "StyleTransferSceneViewExtension.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "UObject/Object.h"
+#include "UObject/ObjectKey.h"
 #include "StyleTransferSubsystem.generated.h"
 
+class FStyleTransferBatchRenderer;
+class FStyleTransferContentShapeCache;
+class FStyleTransferCpuExecutor;
+class USceneCaptureComponent2D;
+class UTexture;
+class UTextureRenderTarget2D;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnStyleTransferReady, bool /* bSuccess */);
+
+struct FStyleTransferBatchRenderOptions
+{
+	/** Path of the written images, {frame} is replaced by the frame number */
+	FString FileNameFormat;
+	/** Frames per inference. Only used if the StyleTransferNetwork has a dynamic batch dimension. */
+	int32 BatchSize = 4;
+	/** Called on the game thread for every rendered view family, returns the frame number of its first view or INDEX_NONE to skip it */
+	TFunction<int32()> GetFrameNumber;
+};
+
 /**
  *
  */
@@ -32,7 +59,93 @@ public:
 
 	void UpdateStyle(UTexture2D* StyleTexture, uint32 StyleIndex, int32 StylePredictionInferenceContext);
 	void UpdateStyle(FString StyleTensorDataPath);
-	void InterpolateStyles(int32 StylePredictionInferenceContextA, int32 StylePredictionInferenceContextB, float Alpha);
+	void InterpolateStyles(int32 StyleHandleA, int32 StyleHandleB, float Alpha);
+
+	/**
+	 * Continuously predicts the style from the given render target without blocking the game thread.
+	 * Prediction runs at most every r.StyleTransfer.LiveStyle.UpdateInterval frames and the resulting parameters are swapped in on a later frame.
+	 * Without a render target the live style is only fed through UpdateLiveStyle_RenderThread.
+	 */
+	void StartLiveStyle(UTextureRenderTarget2D* StyleRenderTarget = nullptr);
+	void StopLiveStyle();
+
+	/**
+	 * Live style input for textures that only exist in a render graph. Requires StartLiveStyle to be called first.
+	 * @return false if the request was throttled and the texture was not used.
+	 */
+	bool UpdateLiveStyle_RenderThread(FRDGBuilder& GraphBuilder, FRDGTextureRef StyleTexture);
+
+	/**
+	 * Loads the networks, creates the transfer context and runs one dummy frame through every pass without blocking the game thread.
+	 * OnStyleTransferReady is broadcast once the render thread finished the dummy frame,
+	 * or with false if the networks or contexts were missing or StopStylizingViewport cancelled the warm up.
+	 */
+	void WarmUp();
+	bool IsReady() const { return bIsReady; }
+
+	FOnStyleTransferReady OnStyleTransferReady;
+
+	/** Moves the full resolution inset of r.StyleTransfer.Foveated, e.g. to the gaze point. (0.5, 0.5) is the center of the view. */
+	void SetFoveatedFocus(FVector2D ViewUV);
+
+	/**
+	 * Stylizes the rendered frames with the best network LOD in batches and writes them to image files instead of stylizing the views.
+	 * Meant for offline renders like Movie Render Queue where throughput matters more than latency. Not available in CPU mode.
+	 */
+	bool StartBatchRendering(FStyleTransferBatchRenderOptions Options);
+	/** Writes the remaining frames and waits until they are on disk. */
+	void StopBatchRendering();
+	bool IsBatchRendering() const { return BatchRenderer.IsValid(); }
+
+	/**
+	 * Stylizes the final color of the scene capture in its own inference context instead of leaving it unstylized.
+	 * Captures of the same InferenceResolution share a context, at most r.StyleTransfer.SceneCapture.MaxInferencesPerFrame of them run per frame.
+	 * @param InferenceResolution content size of the context, only used if the StyleTransferNetwork has a dynamic content shape
+	 * @param UpdateInterval minimum number of frames between two inferences, 0 stylizes every render of the capture
+	 */
+	void AddStylizedSceneCapture(USceneCaptureComponent2D* SceneCapture, FIntPoint InferenceResolution, int32 UpdateInterval = 0);
+	void RemoveStylizedSceneCapture(USceneCaptureComponent2D* SceneCapture);
+
+	/**
+	 * Stylizes the views of the view state like a scene capture, but the network only runs for them once RefreshStylizedView is called.
+	 * Renders in between reuse the last result. Meant for previews that must not run the network every frame, e.g. the editor viewports.
+	 * @param InferenceResolution content size of the context, only used if the StyleTransferNetwork has a dynamic content shape
+	 */
+	void AddStylizedView(const FSceneViewStateInterface* ViewState, FIntPoint InferenceResolution);
+	void RemoveStylizedView(const FSceneViewStateInterface* ViewState);
+	void RefreshStylizedView(const FSceneViewStateInterface* ViewState);
+
+#if WITH_EDITOR
+	/**
+	 * Creates a subsystem for the editor viewports, which have no game instance. Shut it down with Deinitialize, which releases its networks and stops its tick.
+	 * It ignores r.StyleTransfer.Enabled and only stylizes the views added with AddStylizedView, see UStyleTransferEditorSubsystem.
+	 */
+	static UStyleTransferSubsystem* CreateForEditor(UObject* Outer);
+#endif
+
+	/** Records the packed network inputs of the next NumFrames stylized frames. Replay them with -run=StyleTransferReplay. */
+	void StartRecording(int32 NumFrames, FString FilePath = FString());
+
+	/** The network of the current LOD */
+	UNeuralNetwork* GetStyleTransferNetwork() const { return StyleTransferNetwork; }
+	int32 GetNetworkLOD() const { return CurrentNetworkLOD; }
+	UNeuralNetwork* GetStylePredictionNetwork() const { return StylePredictionNetwork; }
+
+	/**
+	 * Loads the networks and the StyleTexture in the background and predicts the style params of the texture without applying them.
+	 * Fulfilled on the game thread once the render thread ran the prediction with a style handle for ApplyStyleAsync and InterpolateStyles
+	 * or with INDEX_NONE if the style could not be predicted. The handle stays valid until stylizing stops.
+	 */
+	TFuture<int32> RequestStyleAsync(TSoftObjectPtr<UTexture2D> StyleTexture);
+	/** Makes the style of a handle from RequestStyleAsync the current one. Fulfilled once the render thread applied it. */
+	TFuture<bool> ApplyStyleAsync(int32 StyleHandle);
+	/** Loads the networks in the background. Fulfilled with false if not all networks could be loaded. */
+	TFuture<bool> LoadNetworksAsync();
+	/**
+	 * Uses the given network LOD unless r.StyleTransfer.NetworkLOD forces one, INDEX_NONE selects it automatically again.
+	 * Fulfilled once the render thread uses the LOD or with false if it can not be used or another LOD was requested in the meantime.
+	 */
+	TFuture<bool> SetNetworkLODAsync(int32 LOD);
 
 private:
 	FStyleTransferSceneViewExtension::Ptr StyleTransferSceneViewExtension;
@@ -43,14 +156,290 @@ private:
 	UPROPERTY()
 	TObjectPtr<UNeuralNetwork> StylePredictionNetwork;
 
-	TArray<int32> StylePredictionInferenceContexts;
+	/** Every network LOD that was loaded so far. Keeps them alive until the render thread stopped using them. */
+	UPROPERTY()
+	TArray<TObjectPtr<UNeuralNetwork>> LoadedNetworkLODs;
+
+	int32 CurrentNetworkLOD = 0;
+	/** LODs whose network does not match the StylePredictionNetwork */
+	TSet<int32> InvalidNetworkLODs;
+	int32 LastNetworkLODOverBudget = INDEX_NONE;
+	FStreamableManager StreamableManager;
+	TMap<int32, TSharedPtr<FStreamableHandle>> NetworkLODLoadHandles;
+
+	/** LOD requested by SetNetworkLODAsync */
+	int32 RequestedNetworkLOD = INDEX_NONE;
+	TSharedPtr<TPromise<bool>> NetworkLODPromise;
+	/** Fulfilled once the networks requested by LoadNetworksAsync are loaded */
+	TArray<TSharedRef<TPromise<bool>>> LoadNetworksPromises;
+	/** Styles requested by RequestStyleAsync by request id. Every promise is fulfilled, at the latest when the subsystem is deinitialized. */
+	TMap<int32, TSharedRef<TPromise<int32>>> StyleRequests;
+	int32 NextStyleRequestId = 0;
+
+	/** Target of the style params, only accessed on the render thread */
+	struct FStyleParamsTarget
+	{
+		UNeuralNetwork* Network = nullptr;
+		/** Set instead of the InferenceContext if the network runs on the CPU */
+		TSharedPtr<FStyleTransferCpuExecutor, ESPMode::ThreadSafe> CpuExecutor;
+		/** Keeps the style params for its scene captures if there is no InferenceContext, e.g. for the editor preview */
+		FStyleTransferSceneViewExtension::Ptr SceneViewExtension;
+		int32 InferenceContext = INDEX_NONE;
+		int32 InputIndex = INDEX_NONE;
+		TArray<int32> Mapping;
+		/** Number of stacked style param sets of the input, the first is the current style and the others are the StyleRegions */
+		int32 NumStyleSets = 1;
+	};
+	FStyleParamsTarget StyleParamsTarget_RenderThread;
+	/** Style params as predicted by the StylePredictionNetwork before they are mapped to the network LOD. Only accessed on the render thread. */
+	TRefCountPtr<FRDGPooledBuffer> StyleParamsBuffer;
+	/** Predicted style params of the StyleRegions, one set after the other. Only accessed on the render thread. */
+	TRefCountPtr<FRDGPooledBuffer> RegionalStyleParamsBuffer;
+	/** Whether RegionalStyleParamsBuffer holds a resident style for each StyleRegion, the others use the current style. Only accessed on the render thread. */
+	TBitArray<> RegionsWithResidentStyle;
+
+	/** Run once their fence completed, e.g. to release resources the render thread might still use or to fulfill promises */
+	struct FRenderThreadCallback
+	{
+		TUniquePtr<FRenderCommandFence> Fence;
+		TFunction<void()> Callback;
+	};
+	TArray<FRenderThreadCallback> RenderThreadCallbacks;
+
+	/** Styles that can be applied and interpolated */
+	struct FResidentStyle
+	{
+		int32 Handle = INDEX_NONE;
+		/** Holds the predicted style params, INDEX_NONE if they are stored quantized */
+		int32 StylePredictionInferenceContext = INDEX_NONE;
+	};
+	TArray<FResidentStyle> ResidentStyles;
+	int32 NextStyleHandle = 0;
+	/** The first NumSettingsStyles resident styles are the StyleTextures of the settings in order */
+	int32 NumSettingsStyles = 0;
+	/** Latest PredictSettingsStyle request by StyleIndex, older predictions of the same style are dropped */
+	TMap<int32, uint32> LatestSettingsStyleRequests;
+	uint32 NextSettingsStyleRequest = 0;
+	/** Index of the resident style last requested by the post process volumes */
+	int32 VolumeStyleIndex = INDEX_NONE;
+
+	/** Style params with 8 bit per value, see r.StyleTransfer.QuantizeStyles */
+	struct FQuantizedStyleParams
+	{
+		TRefCountPtr<FRDGPooledBuffer> Values;
+		TRefCountPtr<FRDGPooledBuffer> ScaleOffsets;
+	};
+	/** By style handle, only accessed on the render thread */
+	TMap<int32, FQuantizedStyleParams> QuantizedStyleParams_RenderThread;
+	int64 QuantizedStyleMemory = 0;
+
+	/** Packed style input of a style texture so predicting its style again skips the resampling */
+	struct FStyleInputCacheEntry
+	{
+		FObjectKey Texture;
+		FObjectKey Network;
+		/** Only compared, the entry is stale once the texture got a new resource, e.g. after streaming in mips */
+		const FRHITexture* TextureRHI = nullptr;
+		TRefCountPtr<FRDGPooledBuffer> PackedInput;
+	};
+	/** Least recently used first, only accessed on the render thread */
+	TArray<FStyleInputCacheEntry> StyleInputCache_RenderThread;
+	/** Size of the packed inputs in the StyleInputCache_RenderThread, counted against the memory budget */
+	std::atomic<int64> StyleInputCacheMemory = 0;
 	TSharedPtr<int32, ESPMode::ThreadSafe> StyleTransferInferenceContext;
 
+	/** Set if r.StyleTransfer.CPU was set when the networks were loaded */
+	bool bCpuExecution = false;
+	/** Runs the StyleTransferNetwork in CPU mode, the StyleTransferInferenceContext stays INDEX_NONE then */
+	TSharedPtr<FStyleTransferCpuExecutor, ESPMode::ThreadSafe> CpuExecutor;
+
+	/** Only created if the StyleTransferNetwork has a dynamic content shape */
+	TSharedPtr<FStyleTransferContentShapeCache> ContentShapeCache;
+
 
 	int32 StyleTransferStyleParamsInputIndex = INDEX_NONE;
 
+	FVector2D FoveatedFocus = FVector2D(0.5, 0.5);
+
+	FStyleTransferBatchRenderOptions BatchRenderOptions;
+	TSharedPtr<FStyleTransferBatchRenderer, ESPMode::ThreadSafe> BatchRenderer;
+	/** Owned by the BatchRenderer's network */
+	int32 BatchInferenceContext = INDEX_NONE;
+	int32 BatchSize = 1;
+	/** RequestedNetworkLOD before the batch rendering forced LOD 0 */
+	int32 RequestedNetworkLODBeforeBatch = INDEX_NONE;
+
+	struct FStylizedSceneCapture
+	{
+		TWeakObjectPtr<USceneCaptureComponent2D> Component;
+		/** Set instead of the Component for views added with AddStylizedView */
+		const FSceneViewStateInterface* AddedView = nullptr;
+		FIntPoint InferenceResolution = FIntPoint::ZeroValue;
+		int32 UpdateInterval = 0;
+		/** Content size of the context in SceneCaptureContexts, zero if it has the fixed size. Unset while the capture is not registered. */
+		TOptional<FIntPoint> ContentSize;
+		/** Key of the capture at the extension while it is registered */
+		const FSceneViewStateInterface* ViewState = nullptr;
+	};
+	TArray<FStylizedSceneCapture> StylizedSceneCaptures;
+
+	/** Inference contexts of the StyleTransferNetwork shared by the stylized scene captures of the same content size */
+	struct FSceneCaptureContext
+	{
+		FIntPoint ContentSize = FIntPoint::ZeroValue;
+		int32 InferenceContext = INDEX_NONE;
+		int32 NumUsers = 0;
+		int64 Memory = 0;
+	};
+	TArray<FSceneCaptureContext> SceneCaptureContexts;
+
+	/** Kept alive while the extension uses it as style weights source */
+	UPROPERTY()
+	TObjectPtr<UTexture> StyleWeightsTexture;
+
+	UPROPERTY()
+	TObjectPtr<UTextureRenderTarget2D> LiveStyleRenderTarget;
+
+	/** Read on the render thread by UpdateLiveStyle_RenderThread */
+	std::atomic<bool> bLiveStyleActive = false;
+	int32 LiveStylePredictionInferenceContext = INDEX_NONE;
+	uint64 LastLiveStylePredictionFrame = 0;
+	uint32 LastLiveStylePredictionFrameRenderThread = 0;
+	/**
+	 * Only one live style prediction may be in flight so a slow render thread can not queue up predictions.
+	 * Claimed by TickLiveStyle and UpdateLiveStyle_RenderThread alike and released once the parameters were applied or dropped.
+	 */
+	std::atomic<bool> bLiveStylePredictionInFlight = false;
+	/** Incremented by StopLiveStyle, predictions of an earlier generation are dropped */
+	std::atomic<uint32> LiveStyleGeneration = 0;
+	/** Generation of the prediction whose parameters are pending */
+	std::atomic<uint32> LiveStyleParamsGeneration = 0;
+
+	/** Set while the post process volumes blend the stylization out, no live style is predicted then. Read on the render thread */
+	std::atomic<bool> bViewBlendedOut = false;
+	/** Set on the render thread once a prediction was added to a graph. The parameters are then copied on the next game thread tick. */
+	std::atomic<bool> bLiveStyleParamsPending = false;
+
+	/** Set for the subsystem of the editor viewports, it only stylizes the added views and has no game viewport client */
+	bool bEditorPreview = false;
+	/** Set by Deinitialize, the ticker only stops once the subsystem is destroyed */
+	bool bDeinitialized = false;
+	/** Viewport client the extension was last created for */
+	FViewportClient* StylizedViewportClient = nullptr;
+
+	bool bIsReady = false;
+	int32 WarmUpStylePredictionInferenceContext = INDEX_NONE;
+	FRenderCommandFence WarmUpFence;
+
+	void InitializeStyleTransfer();
 	void HandleConsoleVariableChanged(IConsoleVariable*);
 
+	/** The parts of the settings that HandleSettingsChanged applies without restarting the style transfer */
+	struct FAppliedSettings
+	{
+		TArray<FSoftObjectPath> StyleTextures;
+		FSoftObjectPath StylePredictionNetwork;
+		TArray<FSoftObjectPath> NetworkLODs;
+		TArray<TArray<int32>> StyleParamsMappings;
+		FRichCurve InterpolationCurve;
+		EStyleTransferStyleWeightsSource StyleWeightsSource{};
+		float StyleWeightsConstant = 1.f;
+		FSoftObjectPath StyleWeightsTexture;
+		/** StyleIndex and StencilValue of the StyleRegions */
+		TArray<FIntPoint> StyleRegions;
+		bool bRequirePostProcessVolume = false;
+		bool bDynamicContentShape = false;
+		int32 ContentShapeStride = 0;
+		float ContentShapeHysteresis = 0.f;
+		int32 NumCachedContentShapes = 0;
+	};
+	FAppliedSettings AppliedSettings;
+	FDelegateHandle SettingsChangedHandle;
+
+	/** Diffs the settings against the AppliedSettings and only updates what changed */
+	void HandleSettingsChanged();
+	void UpdateAppliedSettings();
+	/** Stops stylizing and starts again with the current settings, reloading the networks if bReloadNetworks is set */
+	void RestartStyleTransfer(bool bReloadNetworks);
+
+	/** The InterpolationCurve sampled over its time range so the interpolation does not evaluate the curve every tick */
+	TArray<float> InterpolationLUT;
+	float InterpolationLUTMinTime = 0.f;
+	float InterpolationLUTMaxTime = 0.f;
+	void BuildInterpolationLUT();
+	float SampleInterpolationLUT(double Time) const;
+
+	/** Number of existing style prediction contexts including the warm up and live style ones. */
+	int32 NumStylePredictionInferenceContexts = 0;
+
+	bool EnsureStyleTransferInferenceContext();
+	/** True if there is an inference context or a CPU executor for the StyleTransferNetwork */
+	bool CanTransferStyle() const;
+	int32 CreateStylePredictionInferenceContext();
+	void DestroyStylePredictionInferenceContext(int32& StylePredictionInferenceContext);
+	int64 GetInferenceContextMemory() const;
+	bool IsWithinMemoryBudget(int64 AdditionalBytes) const;
+	void UpdateMemoryStats();
+	void TickWarmUp();
+	void TickLiveStyle();
+	/** Applies the style the post process volumes of the stylized viewport ask for when it changes */
+	void TickVolumeStyle();
+	/** Predicts the style of the texture into the context and applies it if bApply is set */
+	void EnqueueStylePrediction(UTexture2D* StyleTexture, int32 StylePredictionInferenceContext, bool bApply);
+	void PredictRequestedStyle(int32 RequestId, UTexture2D* StyleTexture);
+	void FinishStyleRequest(int32 RequestId, int32 StyleHandle);
+	/** Predicts the style of the StyleTextures entry in the background and replaces its resident style or adds it if it is the next one */
+	void PredictSettingsStyle(int32 StyleIndex, UTexture2D* StyleTexture);
+	/** Destroys the context or the quantized params of the resident style once the render thread stopped using them */
+	void RemoveResidentStyleAt(int32 Index);
+	/** Loads the StyleWeightsTexture if needed and passes the style weights settings to the extension */
+	void ApplyStyleWeightsSettings();
+	void HandleNetworksLoaded();
+	void PredictStyle_RenderThread(FRDGBuilder& GraphBuilder, FRDGTextureRef StyleTexture, int32 StylePredictionInferenceContext);
+	/** PredictStyle_RenderThread that reuses the packed input of the texture from the StyleInputCache_RenderThread */
+	void PredictCachedStyle_RenderThread(FRDGBuilder& GraphBuilder, const UTexture2D* StyleTexture, int32 StylePredictionInferenceContext);
+	void CopyStyleParams_RenderThread(FRDGBuilder& GraphBuilder, int32 StylePredictionInferenceContext, uint32 StyleIndex);
+	/**
+	 * Makes the style predicted into the context resident and returns its handle.
+	 * With r.StyleTransfer.QuantizeStyles the params are quantized and the context is destroyed, right away if bWait is set.
+	 * @param StyleHandle handle of a removed style to reuse, INDEX_NONE creates a new one
+	 */
+	int32 AddResidentStyle(int32 StylePredictionInferenceContext, bool bWait, int32 StyleHandle = INDEX_NONE);
+	const FResidentStyle* FindResidentStyle(int32 StyleHandle) const;
+	/** Quantizes the params of styles that are not stored quantized into transient buffers */
+	void GetQuantizedStyleParams_RenderThread(FRDGBuilder& GraphBuilder, const FResidentStyle& Style, FRDGBufferSRVRef& OutValues, FRDGBufferSRVRef& OutScaleOffsets);
+	void ApplyResidentStyle_RenderThread(FRDGBuilder& GraphBuilder, const FResidentStyle& Style);
+	void UpdateStyleParamsTarget();
+	/** nullptr if the StylePredictionNetwork is not loaded because the size of the predicted style params is unknown then */
+	FRDGBufferRef GetStyleParamsBuffer_RenderThread(FRDGBuilder& GraphBuilder);
+	/** Maps the predicted style params to the style_params input of the current network LOD */
+	void ApplyStyleParams_RenderThread(FRDGBuilder& GraphBuilder);
+	/** Writes the styles of the StyleRegions into the stacked style params if the network takes several sets */
+	void UpdateRegionalStyles();
+	/** Writes the predicted params of the style into Buffer at Offset in bytes */
+	void CopyResidentStyleParams_RenderThread(FRDGBuilder& GraphBuilder, const FResidentStyle& Style, FRDGBufferRef Buffer, uint64 Offset);
+
+	int32 GetDesiredNetworkLOD() const;
+	/** Returns the network of the LOD if it is loaded and valid, otherwise starts loading it in the background. */
+	UNeuralNetwork* RequestNetworkLOD(int32 LOD);
+	bool PrepareNetworkLOD(int32 LOD, UNeuralNetwork* Network);
+	void SwitchNetworkLOD(int32 LOD, UNeuralNetwork* Network);
+	void TickNetworkLOD();
+
+	/** Creates the BatchRenderer for the current network, releasing the previous one */
+	bool CreateBatchRenderer();
+	void ReleaseBatchRenderer();
+
+	/** Registers the capture at the extension with a context of the current network */
+	void RegisterSceneCapture(FStylizedSceneCapture& SceneCapture);
+	void UnregisterSceneCapture(FStylizedSceneCapture& SceneCapture);
+	/** Destroys the contexts of all captures once the render thread stopped using them, the captures stay stylized once registered again */
+	void ReleaseSceneCaptureContexts();
+	int64 GetSceneCaptureContextMemory() const;
+
+	void RunAfterRenderThread(TFunction<void()> Callback);
+	void TickRenderThreadCallbacks(bool bFlush = false);
+
 	void LoadNetworks();
 };
 
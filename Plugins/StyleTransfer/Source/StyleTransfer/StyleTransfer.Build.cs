@@ -43,10 +43,16 @@ public class StyleTransfer : ModuleRules
 				"Renderer",
 				"Projects",
 				"StyleTransferShaders",
-				"PixWinPlugin",
 				"InputDevice",
 				"DeveloperSettings",
+				"ImageWrapper",
+				"ImageWriteQueue",
 			}
 		);
+
+		if (Target.Platform == UnrealTargetPlatform.Win64)
+		{
+			PrivateDependencyModuleNames.Add("PixWinPlugin");
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,5 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, StyleTransferEditor)
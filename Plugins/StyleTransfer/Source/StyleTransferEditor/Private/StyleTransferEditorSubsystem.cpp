@@ -0,0 +1,173 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "StyleTransferEditorSubsystem.h"
+
+#include "Editor.h"
+#include "LevelEditorViewport.h"
+#include "StyleTransferSubsystem.h"
+
+TAutoConsoleVariable<bool> CVarEditorPreview(
+	TEXT("r.StyleTransfer.Editor.Preview"),
+	false,
+	TEXT("Set to true to stylize the level editor viewports. Only the focused viewport runs the network, the others show their last result")
+);
+
+TAutoConsoleVariable<float> CVarEditorPreviewResolutionScale(
+	TEXT("r.StyleTransfer.Editor.ResolutionScale"),
+	0.5f,
+	TEXT("Inference resolution of the editor viewports relative to their size. Only has an effect if the StyleTransferNetwork has a dynamic content shape")
+);
+
+TAutoConsoleVariable<float> CVarEditorPreviewRefreshRate(
+	TEXT("r.StyleTransfer.Editor.RefreshRate"),
+	2.f,
+	TEXT("Maximum number of times per second the focused editor viewport runs the network. 0 only stylizes it again once its camera stops or it gets focused")
+);
+
+TAutoConsoleVariable<bool> CVarEditorPreviewRefreshOnCameraStop(
+	TEXT("r.StyleTransfer.Editor.RefreshOnCameraStop"),
+	true,
+	TEXT("Set to true to stylize the focused editor viewport again as soon as its camera stops moving instead of waiting for r.StyleTransfer.Editor.RefreshRate")
+);
+
+void UStyleTransferEditorSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	TickHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UStyleTransferEditorSubsystem::Tick));
+}
+
+void UStyleTransferEditorSubsystem::Deinitialize()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	StopPreview();
+
+	Super::Deinitialize();
+}
+
+bool UStyleTransferEditorSubsystem::Tick(float DeltaTime)
+{
+	if (!CVarEditorPreview.GetValueOnGameThread())
+	{
+		StopPreview();
+		return true;
+	}
+
+	if (!StyleTransferSubsystem)
+	{
+		StyleTransferSubsystem = UStyleTransferSubsystem::CreateForEditor(this);
+		NetworksLoaded = StyleTransferSubsystem->LoadNetworksAsync();
+	}
+	// the subsystem logs why the networks could not be loaded, the preview is tried again once it is enabled again
+	if (!NetworksLoaded.IsReady() || !NetworksLoaded.Get())
+		return true;
+
+	// the editor viewports are not rendered while playing in the editor
+	if (GEditor->PlayWorld)
+		return true;
+
+	UpdatePreviewViewports();
+	return true;
+}
+
+void UStyleTransferEditorSubsystem::StopPreview()
+{
+	if (!StyleTransferSubsystem)
+		return;
+
+	StyleTransferSubsystem->Deinitialize();
+	StyleTransferSubsystem = nullptr;
+	NetworksLoaded = TFuture<bool>();
+	StylizedViewportClient = nullptr;
+	StylizedWorld.Reset();
+	PreviewViewports.Reset();
+	FocusedViewportClient = nullptr;
+}
+
+void UStyleTransferEditorSubsystem::UpdatePreviewViewports()
+{
+	const TArray<FLevelEditorViewportClient*>& LevelViewportClients = GEditor->GetLevelViewportClients();
+
+	for (auto It = PreviewViewports.CreateIterator(); It; ++It)
+	{
+		if (!LevelViewportClients.Contains(It->ViewportClient) || It->ViewportClient->ViewState.GetReference() != It->ViewState)
+		{
+			StyleTransferSubsystem->RemoveStylizedView(It->ViewState);
+			It.RemoveCurrent();
+		}
+	}
+
+	if (LevelViewportClients.IsEmpty())
+		return;
+
+	// the extension only stylizes the world it was created for, e.g. not the editor world of a newly opened map
+	if (!LevelViewportClients.Contains(StylizedViewportClient) || StylizedWorld.Get() != StylizedViewportClient->GetWorld())
+	{
+		if (StylizedViewportClient)
+		{
+			StyleTransferSubsystem->StopStylizingViewport();
+		}
+		StylizedViewportClient = LevelViewportClients[0];
+		StylizedWorld = StylizedViewportClient->GetWorld();
+		StyleTransferSubsystem->StartStylizingViewport(StylizedViewportClient);
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	const float ResolutionScale = FMath::Clamp(CVarEditorPreviewResolutionScale.GetValueOnGameThread(), 0.05f, 1.f);
+	const float RefreshRate = CVarEditorPreviewRefreshRate.GetValueOnGameThread();
+	const bool bRefreshOnCameraStop = CVarEditorPreviewRefreshOnCameraStop.GetValueOnGameThread();
+	FLevelEditorViewportClient* PreviousFocusedViewportClient = FocusedViewportClient;
+	FocusedViewportClient = GCurrentLevelEditingViewportClient;
+
+	for (FLevelEditorViewportClient* ViewportClient : LevelViewportClients)
+	{
+		const FSceneViewStateInterface* ViewState = ViewportClient->ViewState.GetReference();
+		if (!ViewState || !ViewportClient->Viewport || ViewportClient->GetWorld() != StylizedWorld.Get())
+			continue;
+
+		const FIntPoint InferenceResolution = (FVector2D(ViewportClient->Viewport->GetSizeXY()) * ResolutionScale).IntPoint().ComponentMax(FIntPoint(1, 1));
+		FPreviewViewport* PreviewViewport = PreviewViewports.FindByPredicate([ViewportClient](const FPreviewViewport& Entry)
+		{
+			return Entry.ViewportClient == ViewportClient;
+		});
+		if (!PreviewViewport)
+		{
+			PreviewViewport = &PreviewViewports.AddDefaulted_GetRef();
+			PreviewViewport->ViewportClient = ViewportClient;
+			PreviewViewport->ViewState = ViewState;
+			PreviewViewport->InferenceResolution = InferenceResolution;
+			StyleTransferSubsystem->AddStylizedView(ViewState, InferenceResolution);
+		}
+
+		const FViewCamera Camera{ViewportClient->GetViewLocation(), ViewportClient->GetViewRotation(), ViewportClient->ViewFOV, ViewportClient->GetOrthoZoom()};
+		const bool bCameraMoving = !Camera.Equals(PreviewViewport->Camera);
+		PreviewViewport->Camera = Camera;
+		PreviewViewport->bCameraMovedSinceRefresh |= bCameraMoving;
+		if (ViewportClient != FocusedViewportClient)
+			continue;
+
+		const bool bFocusChanged = ViewportClient != PreviousFocusedViewportClient;
+		const bool bCameraStopped = bRefreshOnCameraStop && !bCameraMoving && PreviewViewport->bCameraMovedSinceRefresh;
+		const bool bRefreshDue = RefreshRate > 0.f && Now - PreviewViewport->LastRefreshTime >= 1. / RefreshRate;
+		if (!(bFocusChanged || bCameraStopped || bRefreshDue))
+			continue;
+
+		// a context of the new size is only created once the resized viewport is refreshed, not for every step of the resize
+		if (InferenceResolution != PreviewViewport->InferenceResolution)
+		{
+			PreviewViewport->InferenceResolution = InferenceResolution;
+			StyleTransferSubsystem->AddStylizedView(ViewState, InferenceResolution);
+		}
+		StyleTransferSubsystem->RefreshStylizedView(ViewState);
+		PreviewViewport->LastRefreshTime = Now;
+		PreviewViewport->bCameraMovedSinceRefresh = false;
+		// viewports that are not realtime only render once they are invalidated
+		ViewportClient->Invalidate();
+	}
+}
+
+bool UStyleTransferEditorSubsystem::FViewCamera::Equals(const FViewCamera& Other) const
+{
+	return Location.Equals(Other.Location, 0.1) && Rotation.Equals(Other.Rotation, 0.01)
+		&& FMath::IsNearlyEqual(FOV, Other.FOV) && FMath::IsNearlyEqual(OrthoZoom, Other.OrthoZoom);
+}
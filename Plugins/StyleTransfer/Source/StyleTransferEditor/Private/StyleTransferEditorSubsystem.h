@@ -0,0 +1,70 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EditorSubsystem.h"
+#include "Async/Future.h"
+#include "Containers/Ticker.h"
+#include "StyleTransferEditorSubsystem.generated.h"
+
+class FLevelEditorViewportClient;
+class FSceneViewStateInterface;
+class UStyleTransferSubsystem;
+
+/**
+ * Stylizes the level editor viewports with r.StyleTransfer.Editor.Preview so styles can be judged without PIE.
+ * Every viewport is stylized at r.StyleTransfer.Editor.ResolutionScale in its own inference context, but only the focused one runs the network again:
+ * at most r.StyleTransfer.Editor.RefreshRate times per second and once its camera stops. The other viewports keep showing their last result.
+ */
+UCLASS()
+class UStyleTransferEditorSubsystem : public UEditorSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// - UEditorSubsystem
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	// --
+
+private:
+	bool Tick(float DeltaTime);
+
+	void StopPreview();
+	/** Adds and removes the views of the level viewports and refreshes the focused one */
+	void UpdatePreviewViewports();
+
+	UPROPERTY()
+	TObjectPtr<UStyleTransferSubsystem> StyleTransferSubsystem;
+
+	TFuture<bool> NetworksLoaded;
+	FTSTicker::FDelegateHandle TickHandle;
+
+	/** Viewport client the stylization was started for, it is started again if the viewport is closed or shows another world */
+	FLevelEditorViewportClient* StylizedViewportClient = nullptr;
+	TWeakObjectPtr<UWorld> StylizedWorld;
+
+	struct FViewCamera
+	{
+		FVector Location = FVector::ZeroVector;
+		FRotator Rotation = FRotator::ZeroRotator;
+		float FOV = 0.f;
+		float OrthoZoom = 0.f;
+
+		bool Equals(const FViewCamera& Other) const;
+	};
+
+	struct FPreviewViewport
+	{
+		FLevelEditorViewportClient* ViewportClient = nullptr;
+		const FSceneViewStateInterface* ViewState = nullptr;
+		FIntPoint InferenceResolution = FIntPoint::ZeroValue;
+		FViewCamera Camera;
+		/** Set while the camera differs from the one of the last refresh */
+		bool bCameraMovedSinceRefresh = false;
+		double LastRefreshTime = 0.;
+	};
+	TArray<FPreviewViewport> PreviewViewports;
+	FLevelEditorViewportClient* FocusedViewportClient = nullptr;
+};
@@ -0,0 +1,30 @@
+﻿// Copyright Manuel Wagner All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class StyleTransferEditor : ModuleRules
+{
+	public StyleTransferEditor(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"EditorSubsystem",
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Engine",
+				"RenderCore",
+				"StyleTransfer",
+				"UnrealEd",
+			}
+		);
+	}
+}
\ No newline at end of file
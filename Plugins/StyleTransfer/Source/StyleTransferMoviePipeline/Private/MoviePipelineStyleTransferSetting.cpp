@@ -0,0 +1,95 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "MoviePipelineStyleTransferSetting.h"
+
+#include "MoviePipeline.h"
+#include "MoviePipelineAntiAliasingSetting.h"
+#include "MoviePipelineHighResSetting.h"
+#include "MoviePipelineMasterConfig.h"
+#include "MoviePipelineOutputSetting.h"
+#include "StyleTransferSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogStyleTransferMoviePipeline, Log, All);
+
+namespace StyleTransferMoviePipeline
+{
+	UStyleTransferSubsystem* GetSubsystem(const UMoviePipeline* Pipeline)
+	{
+		const UWorld* World = Pipeline ? Pipeline->GetWorld() : nullptr;
+		const UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		return GameInstance ? GameInstance->GetSubsystem<UStyleTransferSubsystem>() : nullptr;
+	}
+
+	/** The batch renderer captures a frame from its first view, which only covers part of the frame with tiles and spatial samples */
+	bool RendersFramesInParts(UMoviePipeline* Pipeline)
+	{
+		const UMoviePipelineMasterConfig* MasterConfig = Pipeline->GetPipelineMasterConfig();
+		const UMoviePipelineHighResSetting* HighResSetting = MasterConfig->FindSetting<UMoviePipelineHighResSetting>();
+		const UMoviePipelineAntiAliasingSetting* AntiAliasingSetting = MasterConfig->FindSetting<UMoviePipelineAntiAliasingSetting>();
+		if ((HighResSetting && HighResSetting->TileCount > 1) || (AntiAliasingSetting && AntiAliasingSetting->SpatialSampleCount > 1))
+			return true;
+
+		for (UMoviePipelineExecutorShot* Shot : Pipeline->GetActiveShotList())
+		{
+			if (Pipeline->FindOrAddSettingForShot<UMoviePipelineHighResSetting>(Shot)->TileCount > 1
+				|| Pipeline->FindOrAddSettingForShot<UMoviePipelineAntiAliasingSetting>(Shot)->SpatialSampleCount > 1)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+void UMoviePipelineStyleTransferSetting::SetupForPipelineImpl(UMoviePipeline* InPipeline)
+{
+	UStyleTransferSubsystem* StyleTransferSubsystem = StyleTransferMoviePipeline::GetSubsystem(InPipeline);
+	if (!StyleTransferSubsystem)
+	{
+		UE_LOG(LogStyleTransferMoviePipeline, Error, TEXT("The movie pipeline has no game instance, frames are not stylized"));
+		return;
+	}
+	if (StyleTransferMoviePipeline::RendersFramesInParts(InPipeline))
+	{
+		UE_LOG(LogStyleTransferMoviePipeline, Error, TEXT("Style transfer does not support spatial samples or high resolution tiles, frames are not stylized"));
+		return;
+	}
+
+	const UMoviePipelineOutputSetting* OutputSetting = InPipeline->GetPipelineMasterConfig()->FindSetting<UMoviePipelineOutputSetting>();
+	check(OutputSetting);
+	FString OutputPath;
+	FMoviePipelineFormatArgs FormatArgs;
+	InPipeline->ResolveFilenameFormatArguments(OutputSetting->OutputDirectory.Path / SubDirectory / TEXT("{sequence_name}"), TMap<FString, FString>(), OutputPath, FormatArgs);
+
+	FStyleTransferBatchRenderOptions Options;
+	Options.FileNameFormat = OutputPath + TEXT(".{frame}.png");
+	Options.BatchSize = BatchSize;
+	Options.GetFrameNumber = [WeakPipeline = TWeakObjectPtr<UMoviePipeline>(InPipeline)]()
+	{
+		const UMoviePipeline* Pipeline = WeakPipeline.Get();
+		if (!Pipeline)
+			return INDEX_NONE;
+
+		// warm up frames and all but the last temporal sample of a frame are not part of the output
+		const FMoviePipelineFrameOutputState& OutputState = Pipeline->GetOutputState();
+		if (OutputState.bSkipRendering || OutputState.bDiscardRenderResult || !OutputState.IsLastTemporalSample())
+			return INDEX_NONE;
+
+		return OutputState.OutputFrameNumber;
+	};
+
+	if (StyleTransferSubsystem->StartBatchRendering(MoveTemp(Options)))
+	{
+		UE_LOG(LogStyleTransferMoviePipeline, Log, TEXT("Writing stylized frames to %s"), *FPaths::GetPath(OutputPath));
+	}
+}
+
+void UMoviePipelineStyleTransferSetting::TeardownForPipelineImpl(UMoviePipeline* InPipeline)
+{
+	if (UStyleTransferSubsystem* StyleTransferSubsystem = StyleTransferMoviePipeline::GetSubsystem(InPipeline))
+	{
+		StyleTransferSubsystem->StopBatchRendering();
+	}
+}
@@ -0,0 +1,41 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MoviePipelineSetting.h"
+#include "MoviePipelineStyleTransferSetting.generated.h"
+
+/**
+ * Stylizes the rendered frames of a Movie Render Queue job with the best network LOD and writes them as PNGs next to the other outputs.
+ * Frames are stylized in batches if the StyleTransferNetwork has a dynamic batch dimension and are written by the image write queue,
+ * so the rendered views themselves stay unstylized. Only the last temporal sample of every output frame is stylized.
+ * Jobs with spatial samples or high resolution tiles are not stylized since every frame is captured from a single view.
+ */
+UCLASS(BlueprintType)
+class STYLETRANSFERMOVIEPIPELINE_API UMoviePipelineStyleTransferSetting : public UMoviePipelineSetting
+{
+	GENERATED_BODY()
+
+public:
+	// - UMoviePipelineSetting
+#if WITH_EDITOR
+	virtual FText GetDisplayText() const override { return NSLOCTEXT("MovieRenderPipeline", "StyleTransferSettingDisplayName", "Style Transfer"); }
+#endif
+	virtual bool IsValidOnShots() const override { return false; }
+	virtual bool IsValidOnMaster() const override { return true; }
+
+protected:
+	virtual void SetupForPipelineImpl(UMoviePipeline* InPipeline) override;
+	virtual void TeardownForPipelineImpl(UMoviePipeline* InPipeline) override;
+	// --
+
+public:
+	/** Frames per inference. Only used if the StyleTransferNetwork has a dynamic batch dimension, see bDynamicBatchSize in the Style Transfer settings. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Style Transfer", meta=(ClampMin=1, UIMax=16))
+	int32 BatchSize = 4;
+
+	/** Directory below the output directory of the job the stylized frames are written to */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="Style Transfer")
+	FString SubDirectory = TEXT("Stylized");
+};
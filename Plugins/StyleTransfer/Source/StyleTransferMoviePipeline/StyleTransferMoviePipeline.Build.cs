@@ -0,0 +1,29 @@
+﻿// Copyright Manuel Wagner All Rights Reserved.
+
+using UnrealBuildTool;
+
+public class StyleTransferMoviePipeline : ModuleRules
+{
+	public StyleTransferMoviePipeline(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"MovieRenderPipelineCore",
+			}
+		);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Engine",
+				"RenderCore",
+				"StyleTransfer",
+			}
+		);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "FoveatedCompositeCS.h"
+
+FIntVector FFoveatedCompositeCS::GetThreadGroupSize(const FPermutationDomain& PermutationVector)
+{
+	return StyleTransferThreadGroupSizes::Get2D(PermutationVector.Get<FThreadGroupSize2DDimension>());
+}
+
+void FFoveatedCompositeCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	const FIntVector ThreadGroupSize = GetThreadGroupSize(FPermutationDomain(Parameters.PermutationId));
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize.X);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Y"), ThreadGroupSize.Y);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Z"), ThreadGroupSize.Z);
+}
+
+
+IMPLEMENT_GLOBAL_SHADER(FFoveatedCompositeCS,
+						"/Plugins/StyleTransfer/Shaders/Private/FoveatedComposite.usf",
+						"FoveatedCompositeCS", SF_Compute); // Path defined in StyleTransferModule.cpp
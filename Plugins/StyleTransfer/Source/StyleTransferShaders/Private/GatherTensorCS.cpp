@@ -0,0 +1,23 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "GatherTensorCS.h"
+
+FIntVector FGatherTensorCS::GetThreadGroupSize(const FPermutationDomain& PermutationVector)
+{
+	return StyleTransferThreadGroupSizes::Get1D(PermutationVector.Get<FThreadGroupSize1DDimension>());
+}
+
+
+void FGatherTensorCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	const FIntVector ThreadGroupSize = GetThreadGroupSize(FPermutationDomain(Parameters.PermutationId));
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize.X);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Y"), ThreadGroupSize.Y);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Z"), ThreadGroupSize.Z);
+}
+
+IMPLEMENT_GLOBAL_SHADER(FGatherTensorCS,
+                        "/Plugins/StyleTransfer/Shaders/Private/GatherTensor.usf",
+                        "GatherTensorCS", SF_Compute); // Path defined in StyleTransferModule.cpp
@@ -2,13 +2,19 @@
 
 #include "InterpolateTensorsCS.h"
 
-const FIntVector FInterpolateTensorsCS::ThreadGroupSize{64, 1, 1};
+#include "QuantizeTensorCS.h"
+
+FIntVector FInterpolateTensorsCS::GetThreadGroupSize(const FPermutationDomain& PermutationVector)
+{
+	return StyleTransferThreadGroupSizes::Get1D(PermutationVector.Get<FThreadGroupSize1DDimension>());
+}
 
 
 void FInterpolateTensorsCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
+	const FIntVector ThreadGroupSize = GetThreadGroupSize(FPermutationDomain(Parameters.PermutationId));
 	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize.X);
 	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Y"), ThreadGroupSize.Y);
 	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Z"), ThreadGroupSize.Z);
@@ -17,3 +23,23 @@ void FInterpolateTensorsCS::ModifyCompilationEnvironment(const FGlobalShaderPerm
 IMPLEMENT_GLOBAL_SHADER(FInterpolateTensorsCS,
                         "/Plugins/StyleTransfer/Shaders/Private/InterpolateTensors.usf",
                         "InterpolateTensorsCS", SF_Compute); // Path defined in StyleTransferModule.cpp
+
+FIntVector FInterpolateQuantizedTensorsCS::GetThreadGroupSize(const FPermutationDomain& PermutationVector)
+{
+	return StyleTransferThreadGroupSizes::Get1D(PermutationVector.Get<FThreadGroupSize1DDimension>());
+}
+
+void FInterpolateQuantizedTensorsCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	const FIntVector ThreadGroupSize = GetThreadGroupSize(FPermutationDomain(Parameters.PermutationId));
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize.X);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Y"), ThreadGroupSize.Y);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Z"), ThreadGroupSize.Z);
+	OutEnvironment.SetDefine(TEXT("QUANTIZATION_BLOCK_SIZE"), FQuantizeTensorCS::ValuesPerBlock);
+}
+
+IMPLEMENT_GLOBAL_SHADER(FInterpolateQuantizedTensorsCS,
+                        "/Plugins/StyleTransfer/Shaders/Private/InterpolateTensors.usf",
+                        "InterpolateQuantizedTensorsCS", SF_Compute); // Path defined in StyleTransferModule.cpp
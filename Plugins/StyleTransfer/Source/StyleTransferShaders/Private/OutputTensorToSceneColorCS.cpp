@@ -2,12 +2,16 @@
 
 #include "OutputTensorToSceneColorCS.h"
 
-const FIntVector FOutputTensorToSceneColorCS::ThreadGroupSize{8, 8, 1};
+FIntVector FOutputTensorToSceneColorCS::GetThreadGroupSize(const FPermutationDomain& PermutationVector)
+{
+	return StyleTransferThreadGroupSizes::Get2D(PermutationVector.Get<FThreadGroupSize2DDimension>());
+}
 
 void FOutputTensorToSceneColorCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
 {
 	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
 
+	const FIntVector ThreadGroupSize = GetThreadGroupSize(FPermutationDomain(Parameters.PermutationId));
 	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize.X);
 	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Y"), ThreadGroupSize.Y);
 	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Z"), ThreadGroupSize.Z);
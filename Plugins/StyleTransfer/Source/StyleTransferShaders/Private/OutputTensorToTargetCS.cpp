@@ -0,0 +1,23 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "OutputTensorToTargetCS.h"
+
+FIntVector FOutputTensorToTargetCS::GetThreadGroupSize(const FPermutationDomain& PermutationVector)
+{
+	return StyleTransferThreadGroupSizes::Get2D(PermutationVector.Get<FThreadGroupSize2DDimension>());
+}
+
+void FOutputTensorToTargetCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	const FIntVector ThreadGroupSize = GetThreadGroupSize(FPermutationDomain(Parameters.PermutationId));
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize.X);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Y"), ThreadGroupSize.Y);
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_Z"), ThreadGroupSize.Z);
+}
+
+
+IMPLEMENT_GLOBAL_SHADER(FOutputTensorToTargetCS,
+						"/Plugins/StyleTransfer/Shaders/Private/OutputTensorToTarget.usf",
+						"OutputTensorToTargetCS", SF_Compute); // Path defined in StyleTransferModule.cpp
@@ -0,0 +1,15 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#include "QuantizeTensorCS.h"
+
+void FQuantizeTensorCS::ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+	OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_X"), ThreadGroupSize);
+}
+
+
+IMPLEMENT_GLOBAL_SHADER(FQuantizeTensorCS,
+						"/Plugins/StyleTransfer/Shaders/Private/QuantizeTensor.usf",
+						"QuantizeTensorCS", SF_Compute); // Path defined in StyleTransferModule.cpp
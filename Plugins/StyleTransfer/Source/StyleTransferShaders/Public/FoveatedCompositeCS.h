@@ -0,0 +1,44 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+// GPU/RHI/shaders
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "ProfilingDebugging/RealtimeGPUProfiler.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
+
+
+/** Blends the stylized inset around the focus point over the stylized periphery */
+class STYLETRANSFERSHADERS_API FFoveatedCompositeCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FFoveatedCompositeCS);
+	SHADER_USE_PARAMETER_STRUCT(FFoveatedCompositeCS, FGlobalShader)
+
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize2DDimension>;
+
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, PeripheryTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, InsetTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, BilinearSampler)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputDimensions)
+		SHADER_PARAMETER(FVector2f, InsetUVMin)
+		SHADER_PARAMETER(FVector2f, InsetUVSize)
+		SHADER_PARAMETER(float, BlendStart)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// - FShader
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return GetMaxSupportedFeatureLevel(Parameters.Platform) >= ERHIFeatureLevel::SM5;
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	// --
+
+private:
+};
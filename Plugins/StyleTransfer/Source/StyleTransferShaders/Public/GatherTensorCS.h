@@ -0,0 +1,44 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+// GPU/RHI/shaders
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "ProfilingDebugging/RealtimeGPUProfiler.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
+
+
+
+/**
+ * OutputUAV[i] = InputSrv[Indices[i]]
+ */
+class STYLETRANSFERSHADERS_API FGatherTensorCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FGatherTensorCS);
+	SHADER_USE_PARAMETER_STRUCT(FGatherTensorCS, FGlobalShader)
+
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize1DDimension>;
+
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
+
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, OutputUAV)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputSrv)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, Indices)
+		SHADER_PARAMETER(uint32, TensorVolume)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// - FShader
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return GetMaxSupportedFeatureLevel(Parameters.Platform) >= ERHIFeatureLevel::SM5;
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	// --
+
+private:
+};
@@ -8,6 +8,7 @@
 #include "ProfilingDebugging/RealtimeGPUProfiler.h"
 #include "RenderGraphUtils.h"
 #include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
 
 
 
@@ -16,8 +17,9 @@ class STYLETRANSFERSHADERS_API FInterpolateTensorsCS : public FGlobalShader
 	DECLARE_GLOBAL_SHADER(FInterpolateTensorsCS);
 	SHADER_USE_PARAMETER_STRUCT(FInterpolateTensorsCS, FGlobalShader)
 
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize1DDimension>;
 
-	static const FIntVector ThreadGroupSize;
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
 
 
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
@@ -39,3 +41,34 @@ class STYLETRANSFERSHADERS_API FInterpolateTensorsCS : public FGlobalShader
 
 private:
 };
+
+/** InterpolateTensorsCS with the inputs quantized by FQuantizeTensorCS */
+class STYLETRANSFERSHADERS_API FInterpolateQuantizedTensorsCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FInterpolateQuantizedTensorsCS);
+	SHADER_USE_PARAMETER_STRUCT(FInterpolateQuantizedTensorsCS, FGlobalShader)
+
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize1DDimension>;
+
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, OutputUAV)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, QuantizedInputSrvA)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, ScaleOffsetSrvA)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, QuantizedInputSrvB)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, ScaleOffsetSrvB)
+		SHADER_PARAMETER(float, Alpha)
+		SHADER_PARAMETER(uint32, TensorVolume)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// - FShader
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return GetMaxSupportedFeatureLevel(Parameters.Platform) >= ERHIFeatureLevel::SM5;
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	// --
+
+private:
+};
\ No newline at end of file
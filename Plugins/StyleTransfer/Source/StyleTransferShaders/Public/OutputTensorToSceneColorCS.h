@@ -8,6 +8,7 @@
 #include "ProfilingDebugging/RealtimeGPUProfiler.h"
 #include "RenderGraphUtils.h"
 #include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
 
 
 
@@ -16,7 +17,11 @@ class STYLETRANSFERSHADERS_API FOutputTensorToSceneColorCS : public FGlobalShade
 	DECLARE_GLOBAL_SHADER(FOutputTensorToSceneColorCS);
 	SHADER_USE_PARAMETER_STRUCT(FOutputTensorToSceneColorCS, FGlobalShader)
 
-	static const FIntVector ThreadGroupSize;
+	/** Dispatches one thread per texture pixel in texture order instead of tensor order which changes whether texture or tensor accesses are coalesced. */
+	class FTransposedDispatchDimension : SHADER_PERMUTATION_BOOL("TRANSPOSED_DISPATCH");
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize2DDimension, FTransposedDispatchDimension>;
+
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
 
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER(uint32, TensorVolume)
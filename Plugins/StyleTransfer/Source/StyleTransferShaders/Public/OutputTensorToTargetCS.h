@@ -0,0 +1,41 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+// GPU/RHI/shaders
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "ProfilingDebugging/RealtimeGPUProfiler.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
+
+
+/** Unpacks an image tensor straight into a rect of the output, scaling it bilinearly if the sizes differ */
+class STYLETRANSFERSHADERS_API FOutputTensorToTargetCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FOutputTensorToTargetCS);
+	SHADER_USE_PARAMETER_STRUCT(FOutputTensorToTargetCS, FGlobalShader)
+
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize2DDimension>;
+
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputTensor)
+		SHADER_PARAMETER(FIntPoint, TensorSize)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputRectMin)
+		SHADER_PARAMETER(FIntPoint, OutputRectSize)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// - FShader
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return GetMaxSupportedFeatureLevel(Parameters.Platform) >= ERHIFeatureLevel::SM5;
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	// --
+
+private:
+};
@@ -0,0 +1,41 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+// GPU/RHI/shaders
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "ProfilingDebugging/RealtimeGPUProfiler.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterUtils.h"
+
+
+/** Quantizes a float tensor to 8 bit per value with a scale and an offset per block of ValuesPerBlock values */
+class STYLETRANSFERSHADERS_API FQuantizeTensorCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FQuantizeTensorCS);
+	SHADER_USE_PARAMETER_STRUCT(FQuantizeTensorCS, FGlobalShader)
+
+	/** Fixed because the blocks have to match between quantizing and dequantizing */
+	static constexpr uint32 ThreadGroupSize = 64;
+	static constexpr uint32 ValuesPerBlock = ThreadGroupSize * 4;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, InputSrv)
+		// four values per element
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, QuantizedOutputUAV)
+		// scale and offset per block
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, ScaleOffsetOutputUAV)
+		SHADER_PARAMETER(uint32, TensorVolume)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// - FShader
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return GetMaxSupportedFeatureLevel(Parameters.Platform) >= ERHIFeatureLevel::SM5;
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	// --
+
+private:
+};
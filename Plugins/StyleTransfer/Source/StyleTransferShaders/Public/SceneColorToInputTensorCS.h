@@ -8,6 +8,7 @@
 #include "ProfilingDebugging/RealtimeGPUProfiler.h"
 #include "RenderGraphUtils.h"
 #include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
 
 
 
@@ -16,8 +17,9 @@ class STYLETRANSFERSHADERS_API FSceneColorToInputTensorCS : public FGlobalShader
 	DECLARE_GLOBAL_SHADER(FSceneColorToInputTensorCS);
 	SHADER_USE_PARAMETER_STRUCT(FSceneColorToInputTensorCS, FGlobalShader)
 
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize2DDimension>;
 
-	static const FIntVector ThreadGroupSize;
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
 
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		// Input variables
@@ -29,6 +31,10 @@ class STYLETRANSFERSHADERS_API FSceneColorToInputTensorCS : public FGlobalShader
 		SHADER_PARAMETER_SAMPLER(SamplerState, InputTextureSampler)
 		SHADER_PARAMETER(FIntPoint, OutputDimensions)
 		SHADER_PARAMETER(FVector2f, HalfPixelUV)
+		SHADER_PARAMETER(FVector2f, InputUVOffset)
+		SHADER_PARAMETER(FVector2f, InputUVScale)
+		SHADER_PARAMETER(float, MipLevel)
+		SHADER_PARAMETER(uint32, SamplesPerAxis)
 	END_SHADER_PARAMETER_STRUCT()
 
 	// - FShader
@@ -8,6 +8,7 @@
 #include "ProfilingDebugging/RealtimeGPUProfiler.h"
 #include "RenderGraphUtils.h"
 #include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
 
 
 class STYLETRANSFERSHADERS_API FShadowMaskToInputTensorCS : public FGlobalShader
@@ -15,8 +16,9 @@ class STYLETRANSFERSHADERS_API FShadowMaskToInputTensorCS : public FGlobalShader
 	DECLARE_GLOBAL_SHADER(FShadowMaskToInputTensorCS);
 	SHADER_USE_PARAMETER_STRUCT(FShadowMaskToInputTensorCS, FGlobalShader)
 
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize2DDimension>;
 
-	static const FIntVector ThreadGroupSize;
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
 
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		// Input variables
@@ -28,6 +30,9 @@ class STYLETRANSFERSHADERS_API FShadowMaskToInputTensorCS : public FGlobalShader
 		SHADER_PARAMETER_SAMPLER(SamplerState, InputTextureSampler)
 		SHADER_PARAMETER(FIntPoint, OutputDimensions)
 		SHADER_PARAMETER(FVector2f, HalfPixelUV)
+		SHADER_PARAMETER(FVector2f, InputUVOffset)
+		SHADER_PARAMETER(FVector2f, InputUVScale)
+		SHADER_PARAMETER(uint32, NumChannels)
 	END_SHADER_PARAMETER_STRUCT()
 
 	// - FShader
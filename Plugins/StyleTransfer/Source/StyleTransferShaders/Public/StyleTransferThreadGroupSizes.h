@@ -0,0 +1,30 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShaderPermutation.h"
+
+/**
+ * Thread group shapes every kernel is compiled with. Which one is used is decided at runtime by the autotuner.
+ */
+namespace StyleTransferThreadGroupSizes
+{
+	constexpr int32 Num2D = 4;
+	constexpr int32 Num1D = 4;
+
+	inline FIntVector Get2D(int32 Index)
+	{
+		static const FIntVector Sizes[Num2D] = {{8, 8, 1}, {16, 8, 1}, {16, 16, 1}, {32, 4, 1}};
+		return Sizes[FMath::Clamp(Index, 0, Num2D - 1)];
+	}
+
+	inline FIntVector Get1D(int32 Index)
+	{
+		static const FIntVector Sizes[Num1D] = {{64, 1, 1}, {128, 1, 1}, {256, 1, 1}, {32, 1, 1}};
+		return Sizes[FMath::Clamp(Index, 0, Num1D - 1)];
+	}
+}
+
+class FThreadGroupSize2DDimension : SHADER_PERMUTATION_INT("THREADGROUP_SIZE_INDEX", StyleTransferThreadGroupSizes::Num2D);
+class FThreadGroupSize1DDimension : SHADER_PERMUTATION_INT("THREADGROUP_SIZE_INDEX", StyleTransferThreadGroupSizes::Num1D);
@@ -0,0 +1,65 @@
+// Copyright Manuel Wagner All Rights Reserved.
+
+#pragma once
+
+// GPU/RHI/shaders
+#include "GlobalShader.h"
+#include "RHI.h"
+#include "ProfilingDebugging/RealtimeGPUProfiler.h"
+#include "RenderGraphUtils.h"
+#include "ShaderParameterUtils.h"
+#include "StyleTransferThreadGroupSizes.h"
+
+
+/** Generates the style weights mask at reduced resolution from a texture of the view, the custom stencil or a constant */
+class STYLETRANSFERSHADERS_API FStyleWeightsMaskCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FStyleWeightsMaskCS);
+	SHADER_USE_PARAMETER_STRUCT(FStyleWeightsMaskCS, FGlobalShader)
+
+	/** Reads the custom stencil instead of the InputTexture */
+	class FCustomStencilDimension : SHADER_PERMUTATION_BOOL("CUSTOM_STENCIL");
+	using FPermutationDomain = TShaderPermutationDomain<FThreadGroupSize2DDimension, FCustomStencilDimension>;
+
+	/** Number of style parameter sets the mask can weigh, one channel each */
+	static constexpr int32 MaxStyles = 4;
+
+	static FIntVector GetThreadGroupSize(const FPermutationDomain& PermutationVector);
+
+	/** Has to match the STYLE_WEIGHTS_MODE_ defines in StyleWeightsMask.usf */
+	enum class EMode : uint32
+	{
+		/** Uses the red channel of the input */
+		Red,
+		/** 1 where the red channel of the input is greater than 0, 0 elsewhere */
+		Coverage,
+		/** Ignores the input */
+		Constant,
+		/** The red, green and blue channel of the input weigh the styles after the first one */
+		Channels,
+	};
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, InputTexture)
+		SHADER_PARAMETER_SAMPLER(SamplerState, InputTextureSampler)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D<uint2>, CustomStencilTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, OutputTexture)
+		SHADER_PARAMETER(FIntPoint, OutputDimensions)
+		SHADER_PARAMETER(FVector2f, InputUVOffset)
+		SHADER_PARAMETER(FVector2f, InputUVScale)
+		SHADER_PARAMETER(uint32, Mode)
+		SHADER_PARAMETER(float, Constant)
+		SHADER_PARAMETER(uint32, NumStyles)
+		SHADER_PARAMETER(FUintVector4, StencilValues)
+	END_SHADER_PARAMETER_STRUCT()
+
+	// - FShader
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters) {
+		return GetMaxSupportedFeatureLevel(Parameters.Platform) >= ERHIFeatureLevel::SM5;
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+	// --
+
+private:
+};